@@ -0,0 +1,38 @@
+#pragma once
+
+struct studiohdr_t;
+struct mstudioanimdesc_t;
+struct mstudioanim_t;
+
+class CAnimBlockCache;
+class CSkeletonLayout;
+
+#define POSE_MAX_BONES 128 // MAXSTUDIOBONES
+
+// bone local transforms of one skeleton pose. kept as structure of arrays so
+// blend and transform kernels can work on several bones per instruction.
+struct alignas(32) CBonePose
+{
+	float m_qx[POSE_MAX_BONES];
+	float m_qy[POSE_MAX_BONES];
+	float m_qz[POSE_MAX_BONES];
+	float m_qw[POSE_MAX_BONES];
+
+	float m_px[POSE_MAX_BONES];
+	float m_py[POSE_MAX_BONES];
+	float m_pz[POSE_MAX_BONES];
+};
+
+// fills the pose with every bone's default transform, or identity for delta animations
+void Studio_InitPose(const studiohdr_t* pMdl, CBonePose& pose, bool bDelta = false);
+
+// the same default pose from the decoded skeleton, for models whose header was dropped
+void Studio_InitPose(const CSkeletonLayout& layout, CBonePose& pose);
+
+// animation data for a frame, NULL when it lives in an .ani block that isn't resident. blocks
+// come from pBlocks when given. pflStall receives how much of the zero frame to blend over the result
+mstudioanim_t* Studio_AnimData(const mstudioanimdesc_t* pAnimDesc, int* piFrame, CAnimBlockCache* pBlocks = nullptr, float* pflStall = nullptr);
+
+// samples an animation at a cycle (0..1). returns false if the data isn't available, the pose
+// then holds the animation's zero frame if it has one, or the default pose
+bool Studio_CalcAnimation(const studiohdr_t* pMdl, int iAnim, float flCycle, CBonePose& pose, CAnimBlockCache* pBlocks = nullptr);
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "mdlfile.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class CModel;
+
+#define ANIMBLOCK_DEFAULT_BUDGET (16 * 1024 * 1024)
+
+struct CAnimBlockStats
+{
+	uint64_t m_nRequests = 0;
+	uint64_t m_nHits = 0;
+	uint64_t m_nStalls = 0;			// requests that found the block missing
+	uint64_t m_nLoads = 0;
+	uint64_t m_nPrefetches = 0;
+	uint64_t m_nEvictions = 0;
+
+	double m_flStallTime = 0.0;		// seconds between a block being missed and it becoming resident
+
+	size_t m_nResidentBytes = 0;
+	size_t m_nPeakResidentBytes = 0;
+};
+
+// demand pages a model's external animation blocks out of its memory mapped
+// .ani file. blocks are copied out of the mapping when first needed, either by
+// the caller or by a background thread for prefetches and non blocking misses,
+// and the least recently used ones are dropped once over the memory budget.
+class CAnimBlockCache
+{
+public:
+	CAnimBlockCache(const CModel& model, size_t nBudgetBytes = ANIMBLOCK_DEFAULT_BUDGET);
+	~CAnimBlockCache();
+
+	CAnimBlockCache(const CAnimBlockCache&) = delete;
+	CAnimBlockCache& operator=(const CAnimBlockCache&) = delete;
+
+	// finds the model's anim block file with FindGameFile()
+	bool Open();
+	bool Open(const std::string& filename);
+	void Close();
+
+	inline bool IsOpen() const;
+	inline int BlockCount() const;
+
+	// data of block iBlock (1 based, block 0 is the .mdl itself), NULL while it isn't
+	// resident. a miss queues the block for the background thread, or pages it in
+	// on the calling thread when bBlocking
+	const char* Block(int iBlock, bool bBlocking = false);
+	bool IsResident(int iBlock) const;
+
+	void Prefetch(int iBlock);
+	void PrefetchAnimation(int iAnim);
+	void PrefetchSequence(int iSequence);
+
+	// drops least recently used blocks down to the budget. pointers returned by
+	// Block() stay valid until the next Update(), so call it between frames
+	void Update();
+
+	inline void SetBudget(size_t nBudgetBytes);
+	CAnimBlockStats Stats() const;
+
+	// seconds on the clock zeroframestalltime is measured with, never 0
+	static float Time();
+
+private:
+	struct CBlock
+	{
+		std::atomic<char*> m_pData{ nullptr };
+		std::atomic<int> m_iState{ 0 };			// BLOCK_*
+		std::atomic<uint32_t> m_nLastUse{ 0 };
+		std::atomic<float> m_flMissTime{ 0.0f };	// when a request first found it missing, 0 if it hasn't
+
+		size_t m_nStart = 0;
+		size_t m_nSize = 0;
+	};
+
+	enum
+	{
+		BLOCK_EMPTY = 0,
+		BLOCK_QUEUED,
+		BLOCK_LOADING,
+		BLOCK_RESIDENT,
+		BLOCK_EVICTING,	// Update() freeing it, nothing loads it until it's empty again
+	};
+
+	const CModel& m_Model;
+
+	CMappedFile m_File;
+
+	std::unique_ptr<CBlock[]> m_pBlocks{};
+	int m_iBlockCount = 0;
+
+	size_t m_nBudget;
+	uint32_t m_nFrame = 1;
+
+	std::atomic<uint64_t> m_nRequests{ 0 };
+	std::atomic<uint64_t> m_nHits{ 0 };
+	std::atomic<uint64_t> m_nStalls{ 0 };
+	std::atomic<uint64_t> m_nLoads{ 0 };
+	std::atomic<uint64_t> m_nPrefetches{ 0 };
+	std::atomic<uint64_t> m_nEvictions{ 0 };
+	std::atomic<uint64_t> m_nStallMicroseconds{ 0 };
+	std::atomic<size_t> m_nResidentBytes{ 0 };
+	std::atomic<size_t> m_nPeakResidentBytes{ 0 };
+
+	// background loader
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::deque<int> m_Queue{};
+	bool m_bStop = false;
+
+	void Queue(int iBlock);
+	void Load(int iBlock, bool bQueued);
+	void ThreadMain();
+	void StopThread();
+};
+
+inline bool CAnimBlockCache::IsOpen() const
+{
+	return m_File.IsOpen();
+}
+
+inline int CAnimBlockCache::BlockCount() const
+{
+	return m_iBlockCount;
+}
+
+inline void CAnimBlockCache::SetBudget(size_t nBudgetBytes)
+{
+	m_nBudget = nBudgetBytes;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+struct matrix3x4_t;
+
+class CModel;
+
+// world transform of one attachment from its entity's bone to world matrices. false if the
+// attachment doesn't exist, out is left alone then
+bool Studio_AttachmentTransform(const CModel& model, int iAttachment, const matrix3x4_t* pBoneToWorld, matrix3x4_t& out);
+
+// world transforms of the same attachments on a batch of entities of one model. ppBoneToWorld
+// holds each entity's bone array and pOut receives [entity * nAttachments + i]. attachments
+// that don't exist come out as identity
+void Studio_AttachmentTransforms(const CModel& model, const int* pAttachments, int nAttachments,
+	const matrix3x4_t* const* ppBoneToWorld, int nEntities, matrix3x4_t* pOut);
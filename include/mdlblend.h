@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mdlanim.h"
+
+#include <vector>
+
+class CModel;
+
+// the animations at the corners of the blend grid cell holding a pose, with their bilinear weights
+struct CBlendCell
+{
+	int m_iAnims[4];
+	float m_flWeights[4];
+};
+
+// samples sequences with a one or two dimensional blend grid (move_x/move_y,
+// aim_yaw/aim_pitch, ...). pose parameters are given in their own units, as
+// described by CModel::GetPoseParameters(), and are wrapped when they loop.
+class CBlendSpace
+{
+public:
+	CBlendSpace(const CModel& model);
+
+	bool FindCell(int iSequence, const float* pPoseParameters, CBlendCell& cell) const;
+
+	// cycle to sample a sequence at, sequences flagged STUDIO_CYCLEPOSE take it from a pose parameter
+	float SequenceCycle(int iSequence, float flCycle, const float* pPoseParameters) const;
+
+	// blends one pose per entity. pose parameters are [entity * PoseParameterCount() + param].
+	// false when the model's header was dropped, every pose is then the rest pose
+	bool Evaluate(const int* pSequences, const float* pCycles, const float* pPoseParameters, int nEntities, CBonePose* pPoses) const;
+
+	inline int PoseParameterCount() const;
+
+	// where animations stored in .ani blocks are paged from, they sample as their zero frame without one
+	inline void SetAnimBlockCache(CAnimBlockCache* pBlocks);
+
+private:
+	struct CBlendAxis
+	{
+		int m_iPose;		// -1 when the axis isn't driven
+		int m_iGroupSize;
+		int m_iKeyOffset;	// into m_vecPoseKeys, -1 for evenly spaced grids
+
+		float m_flScale;	// pose value to 0..1 across the grid
+		float m_flBias;
+
+		float m_flLoop;
+		float m_flLoopShift;
+	};
+
+	struct CBlendSequence
+	{
+		CBlendAxis m_Axes[2];
+
+		int m_iAnimOffset; // into m_vecAnims
+		int m_iCyclePose;
+		float m_flCycleScale;
+		float m_flCycleBias;
+	};
+
+	const CModel& m_Model;
+	CAnimBlockCache* m_pAnimBlocks = nullptr;
+
+	std::vector<CBlendSequence> m_vecSequences{};
+	std::vector<int> m_vecAnims{};
+	std::vector<float> m_vecPoseKeys{};
+
+	int m_iPoseParameterCount = 0;
+
+	void AxisSetting(const CBlendAxis& axis, const float* pPoseParameters, int& iIndex, float& flSetting) const;
+};
+
+inline int CBlendSpace::PoseParameterCount() const
+{
+	return m_iPoseParameterCount;
+}
+
+inline void CBlendSpace::SetAnimBlockCache(CAnimBlockCache* pBlocks)
+{
+	m_pAnimBlocks = pBlocks;
+}
+
+// SoA pose blend kernels, four bones per step where SIMD is available
+void Studio_ScalePose(CBonePose& pose, float flWeight, int nBones);
+void Studio_AccumulatePose(CBonePose& pose, const CBonePose& src, float flWeight, int nBones);
+void Studio_NormalizePose(CBonePose& pose, int nBones);
+
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct studiohdr_t;
+struct matrix3x4_t;
+struct CBonePose;
+
+class CModel;
+
+// which bones of a child model (weapon, hat, ...) follow a parent model's bone
+// of the same name. names are matched case insensitively by walking both
+// models' sorted bone tables side by side.
+class CBoneMerge
+{
+public:
+	bool Build(const studiohdr_t* pChild, const studiohdr_t* pParent);
+
+	// parent bone a child bone follows, -1 when it doesn't
+	inline int ParentBone(int iChildBone) const;
+	inline const std::vector<int>& Map() const;
+
+	inline int ChildBoneCount() const;
+	inline int MergedCount() const;
+
+	// copies the parent's bone to world transforms onto the child bones that follow them
+	void CopyTransforms(const matrix3x4_t* pParentBones, matrix3x4_t* pChildBones) const;
+
+	// the same for a batch of entities, one pair of bone arrays each
+	void CopyTransforms(const matrix3x4_t* const* ppParentBones, matrix3x4_t* const* ppChildBones, int nEntities) const;
+
+	// copies parent bone local transforms onto the child pose
+	void CopyPose(const CBonePose& parent, CBonePose& child) const;
+
+private:
+	std::vector<int> m_vecParentBones{};
+
+	// merged bones only, ordered by child bone
+	std::vector<int> m_vecMergedChild{};
+	std::vector<int> m_vecMergedParent{};
+};
+
+// bone merges between pairs of models, built the first time a pair is seen.
+// keyed by the models' checksums so every instance of a model shares them.
+class CBoneMergeCache
+{
+public:
+	const CBoneMerge& Get(const CModel& child, const CModel& parent);
+
+	int Count();
+	void Clear();
+
+private:
+	std::mutex m_Mutex;
+	std::unordered_map<uint64_t, std::unique_ptr<CBoneMerge>> m_Merges{};
+};
+
+inline int CBoneMerge::ParentBone(int iChildBone) const
+{
+	return (iChildBone >= 0 && iChildBone < (int)m_vecParentBones.size()) ? m_vecParentBones[iChildBone] : -1;
+}
+
+inline const std::vector<int>& CBoneMerge::Map() const
+{
+	return m_vecParentBones;
+}
+
+inline int CBoneMerge::ChildBoneCount() const
+{
+	return (int)m_vecParentBones.size();
+}
+
+inline int CBoneMerge::MergedCount() const
+{
+	return (int)m_vecMergedChild.size();
+}
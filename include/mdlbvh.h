@@ -0,0 +1,77 @@
+#pragma once
+
+#include "valve/vector.h"
+
+#include <vector>
+
+class CSkinnedMesh;
+
+struct CTriangleHit
+{
+	float m_flFraction;		// of the ray's delta, 1 when nothing was hit
+	int m_iTriangle;		// mesh triangle, -1 when nothing was hit
+};
+
+// bounding volume hierarchy over a mesh's triangles for exact hit tests. the
+// triangles are first grouped by the bone that moves them most and each group
+// gets its own subtree (binned surface area heuristic within and between
+// groups). since a group moves with its bone, refitting the bounds after
+// skinning keeps the tree about as good as a rebuild would.
+class CTriangleBVH
+{
+public:
+	// topology and bone groups come from the mesh, bounds from pPositions (mesh.Positions() for the bind pose)
+	bool Build(const CSkinnedMesh& mesh, const Vector* pPositions);
+
+	// new bounds for moved vertices (CSkinnedMesh::Skin()), the tree's shape stays the same
+	void Refit(const Vector* pPositions);
+
+	// traced four at a time, returns how many rays hit
+	int TraceRays(const Vector* pStarts, const Vector* pDeltas, int nRays, CTriangleHit* pHits) const;
+
+	inline int NodeCount() const;
+	inline int TriangleCount() const;
+	inline int GroupCount() const;
+
+private:
+	struct CNode
+	{
+		float m_vecMins[3];
+		int m_iFirst;		// first of the two children, or first triangle of a leaf
+		float m_vecMaxs[3];
+		int m_nTriangles;	// 0 for inner nodes
+	};
+
+	// first vertex and the two edges from it, Moller-Trumbore form
+	struct CTriangle
+	{
+		float m_v0[3];
+		float m_e1[3];
+		float m_e2[3];
+	};
+
+	std::vector<CNode> m_vecNodes{};
+	std::vector<CTriangle> m_vecTriangles{};	// tree order
+	std::vector<int> m_vecTriangleIndex{};		// tree order -> mesh triangle
+	std::vector<int> m_vecIndices{};			// mesh vertex indices, three per mesh triangle
+
+	int m_nGroups = 0;
+
+	void SetTriangles(const Vector* pPositions);
+	void Refit();
+};
+
+inline int CTriangleBVH::NodeCount() const
+{
+	return (int)m_vecNodes.size();
+}
+
+inline int CTriangleBVH::TriangleCount() const
+{
+	return (int)m_vecTriangles.size();
+}
+
+inline int CTriangleBVH::GroupCount() const
+{
+	return m_nGroups;
+}
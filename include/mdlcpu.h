@@ -0,0 +1,31 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MDL_X86 1
+#endif
+
+// SSE2 is part of the x64 baseline, kernels that only need it are compiled in unconditionally
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MDL_SSE2 1
+#endif
+
+// msvc lets any intrinsic be used in any function, gcc and clang need the
+// instruction set enabled per function for the runtime dispatched kernels.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MDL_TARGET(isa)
+#else
+#define MDL_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// instruction sets supported by the host, queried once on first use
+struct CPUInformation
+{
+	bool m_bSSE2 = false;
+	bool m_bSSE41 = false;
+	bool m_bAVX = false;
+	bool m_bAVX2 = false;
+	bool m_bFMA = false;
+	bool m_bF16C = false;
+};
+
+const CPUInformation& GetCPUInformation();
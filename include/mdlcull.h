@@ -0,0 +1,97 @@
+#pragma once
+
+#include "valve/vector.h"
+
+#include <vector>
+
+class CModel;
+
+// inner side is dot(normal, p) >= dist
+struct CCullPlane
+{
+	Vector m_vecNormal;
+	float m_flDist;
+};
+
+// the six planes (left, right, bottom, top, near, far) of a row major, column
+// vector view projection matrix with clip space depth in 0..w
+void Cull_FrustumPlanes(const float viewProj[4][4], CCullPlane planes[6]);
+
+// coarse depth buffer of occluders, each pixel is the view depth (clip w) behind
+// which everything in that pixel is hidden. filled by the caller, for example
+// from a downsampled depth pass or rasterized occluder boxes
+class COcclusionBuffer
+{
+public:
+	// clears every pixel to "nothing hides anything"
+	void Init(const float viewProj[4][4], int iWidth, int iHeight);
+
+	inline float* Depth();
+	inline int Width() const;
+	inline int Height() const;
+
+	// false only when every pixel the box covers is hidden in front of its nearest point
+	bool BoxVisible(const Vector& mins, const Vector& maxs) const;
+
+private:
+	float m_viewProj[4][4];
+	int m_iWidth = 0;
+	int m_iHeight = 0;
+
+	std::vector<float> m_vecDepth{};
+};
+
+// world space boxes of many instances kept as x/y/z center and extent arrays,
+// padded to a multiple of eight so the kernels (AVX2 when the host has it,
+// four wide otherwise) never need a scalar tail.
+class CCullingSet
+{
+public:
+	int Add(const Vector& mins, const Vector& maxs);
+	void Set(int iInstance, const Vector& mins, const Vector& maxs);
+
+	// the model's bounds moved into the world. the sequence's box when iSequence is
+	// valid, the model's hull otherwise
+	int AddModel(const CModel& model, int iSequence, const matrix3x4_t& toWorld);
+	void SetModel(int iInstance, const CModel& model, int iSequence, const matrix3x4_t& toWorld);
+
+	void Clear();
+	inline int Count() const;
+
+	// writes the indices of the instances inside every plane to pVisible (room for
+	// Count()) in increasing order, returns how many there are
+	int CullFrustum(const CCullPlane* pPlanes, int nPlanes, int* pVisible) const;
+
+	// frustum culling followed by the occlusion test on whatever survived it
+	int CullFrustumOcclusion(const CCullPlane* pPlanes, int nPlanes, const COcclusionBuffer& buffer, int* pVisible) const;
+
+private:
+	std::vector<float> m_vecCenterX{};
+	std::vector<float> m_vecCenterY{};
+	std::vector<float> m_vecCenterZ{};
+	std::vector<float> m_vecExtentX{};
+	std::vector<float> m_vecExtentY{};
+	std::vector<float> m_vecExtentZ{};
+
+	int m_nCount = 0;
+};
+
+inline float* COcclusionBuffer::Depth()
+{
+	return m_vecDepth.data();
+}
+
+inline int COcclusionBuffer::Width() const
+{
+	return m_iWidth;
+}
+
+inline int COcclusionBuffer::Height() const
+{
+	return m_iHeight;
+}
+
+inline int CCullingSet::Count() const
+{
+	return m_nCount;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct studiohdr_t;
+
+// one animation event, name and options are indices into the timeline's string table
+struct CAnimEvent
+{
+	float m_flCycle;
+
+	int m_iEvent;
+	int m_iType;
+
+	int m_iName;
+	int m_iOptions;
+};
+
+// every sequence's events sorted by cycle into one flat array. queries fire
+// events with from <= cycle < to, wrapping through the end of looping
+// sequences when to < from, and never allocate.
+class CEventTimeline
+{
+public:
+	bool Build(const studiohdr_t* pMdl);
+
+	// writes up to nMaxEvents pointers and returns how many events fired, which may be more
+	int Query(int iSequence, float flCycleFrom, float flCycleTo, const CAnimEvent** ppEvents, int nMaxEvents) const;
+
+	inline const char* String(int iString) const;
+	inline int FindString(const std::string& str) const; // -1 when no event uses it
+
+	inline int EventCount() const;
+	inline int SequenceCount() const;
+
+	// heap bytes held
+	size_t MemoryUsage() const;
+
+private:
+	struct CSequenceEvents
+	{
+		int m_iFirst;
+		int m_iCount;
+		bool m_bLooping;
+	};
+
+	std::vector<CSequenceEvents> m_vecSequences{};
+
+	// parallel arrays, the cycles alone are what gets binary searched
+	std::vector<float> m_vecCycles{};
+	std::vector<CAnimEvent> m_vecEvents{};
+
+	std::vector<std::string> m_vecStrings{};
+	std::unordered_map<std::string, int> m_StringMap{};
+
+	int Intern(const char* pszString);
+	int Range(const CSequenceEvents& seq, float flFrom, float flTo, int iWritten, const CAnimEvent** ppEvents, int nMaxEvents) const;
+};
+
+inline const char* CEventTimeline::String(int iString) const
+{
+	return (iString >= 0 && iString < (int)m_vecStrings.size()) ? m_vecStrings[iString].c_str() : "";
+}
+
+inline int CEventTimeline::FindString(const std::string& str) const
+{
+	auto it = m_StringMap.find(str);
+	return it != m_StringMap.end() ? it->second : -1;
+}
+
+inline int CEventTimeline::EventCount() const
+{
+	return (int)m_vecEvents.size();
+}
+
+inline int CEventTimeline::SequenceCount() const
+{
+	return (int)m_vecSequences.size();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// finds a file named relative to the game directory ("models/x.ani") from a file
+// loaded out of that tree, checking next to it and then each parent directory.
+// empty if it can't be found
+std::string FindGameFile(const std::string& strFrom, const std::string& strName);
+
+// filename with "..", "." and symlinks resolved, one key for a file however it's
+// named. filename as it is if that fails
+std::string CanonicalPath(const std::string& filename);
+
+// filename up to its extension, where companion files add theirs
+std::string StripExtension(const std::string& filename);
+
+// lowercase copy, model files compare names case insensitively
+std::string LowerCase(const std::string& str);
+
+class CMappedFile;
+
+// whether nCount Ts at p lie inside [pBegin, pEnd), for offsets read from a file
+template <typename T>
+inline bool InRange(const void* p, const char* pBegin, const char* pEnd, size_t nCount = 1)
+{
+	const char* c = (const char*)p;
+	return c >= pBegin && c <= pEnd && (size_t)(pEnd - c) >= sizeof(T) * nCount;
+}
+
+template <typename T>
+inline bool InRange(const void* p, const CMappedFile& file, size_t nCount = 1);
+
+// read only memory mapping of a whole file, the OS pages it in as it's touched
+class CMappedFile
+{
+public:
+	CMappedFile() {}
+	~CMappedFile();
+
+	CMappedFile(const CMappedFile&) = delete;
+	CMappedFile& operator=(const CMappedFile&) = delete;
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	inline bool IsOpen() const;
+	inline const char* Data() const;
+	inline size_t Size() const;
+
+private:
+	const char* m_pData = nullptr;
+	size_t m_nSize = 0;
+
+#ifdef _WIN32
+	void* m_hFile = nullptr;
+	void* m_hMapping = nullptr;
+#else
+	int m_iFile = -1;
+#endif
+};
+
+inline bool CMappedFile::IsOpen() const
+{
+	return m_pData != nullptr;
+}
+
+inline const char* CMappedFile::Data() const
+{
+	return m_pData;
+}
+
+inline size_t CMappedFile::Size() const
+{
+	return m_nSize;
+}
+
+template <typename T>
+inline bool InRange(const void* p, const CMappedFile& file, size_t nCount)
+{
+	return InRange<T>(p, file.Data(), file.Data() + file.Size(), nCount);
+}
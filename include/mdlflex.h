@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct studiohdr_t;
+struct mstudioflexrule_t;
+
+// instances evaluated together per pass, keeps the register file in L1
+#define FLEX_BATCH_SIZE		64
+#define FLEX_MAX_REGISTERS	32
+
+enum FlexOpCode_t
+{
+	FLEXOP_NOP = 0,
+	FLEXOP_CONST,		// r[dst] = a
+	FLEXOP_CONTROLLER,	// r[dst] = controller[index]
+	FLEXOP_WEIGHT,		// r[dst] = weight[index]
+	FLEXOP_REMAP,		// r[dst] = clamp(controller[index] * a + b, 0, 1) * c + d
+	FLEXOP_STEP,		// r[dst] = controller[index] >= a ? b : c
+	FLEXOP_ADD,			// r[dst] += r[index]
+	FLEXOP_SUB,			// r[dst] -= r[index]
+	FLEXOP_MUL,			// r[dst] *= r[index]
+	FLEXOP_DIV,			// r[dst] /= r[index], 0 when r[index] is not positive
+	FLEXOP_MIN,			// r[dst] = min(r[dst], r[index])
+	FLEXOP_MAX,			// r[dst] = max(r[dst], r[index])
+	FLEXOP_NEG,			// r[dst] = -r[dst]
+	FLEXOP_SCALEBIAS,	// r[dst] = r[dst] * a + b
+	FLEXOP_DOMINATE,	// r[dst] *= 1 - r[index]
+	FLEXOP_NWAY,		// r[dst] = ramp(controller[index2], r[dst..dst+3]) * controller[index]
+	FLEXOP_STORE,		// weight[index] = r[dst]
+};
+
+// one register machine instruction. the stack of the source rule is resolved
+// at compile time so every operand is a fixed register, controller or weight.
+struct CFlexOp
+{
+	unsigned char m_nOpCode;
+	unsigned char m_nDst;
+	unsigned short m_nIndex;
+	unsigned short m_nIndex2;
+
+	float m_flArgs[4];
+};
+
+// a model's flex rules compiled into a flat op array and run for many
+// instances at once. buffers are SoA: value [i * nInstances + instance].
+class CFlexProgram
+{
+public:
+	bool Compile(const studiohdr_t* pMdl);
+
+	void Evaluate(const float* pControllers, float* pWeights, int nInstances) const;
+
+	// the same with rows nStride apart, for buffers that have room for more instances than are in use
+	void Evaluate(const float* pControllers, float* pWeights, int nInstances, int nStride) const;
+
+	inline const std::vector<CFlexOp>& GetOps() const;
+
+	inline int ControllerCount() const;
+	inline int FlexDescCount() const;
+	inline int RuleCount() const;
+	inline int InvalidRuleCount() const;
+
+	// heap bytes held
+	size_t MemoryUsage() const;
+
+private:
+	std::vector<CFlexOp> m_vecOps{};
+
+	int m_iControllerCount = 0;
+	int m_iFlexDescCount = 0;
+	int m_iRuleCount = 0;
+	int m_iInvalidRuleCount = 0;
+
+	bool CompileRule(const studiohdr_t* pMdl, const mstudioflexrule_t* pRule);
+	void Run(const float* pControllers, float* pWeights, int nStride, int nCount, float* pRegisters) const;
+};
+
+inline const std::vector<CFlexOp>& CFlexProgram::GetOps() const
+{
+	return m_vecOps;
+}
+
+inline int CFlexProgram::ControllerCount() const
+{
+	return m_iControllerCount;
+}
+
+inline int CFlexProgram::FlexDescCount() const
+{
+	return m_iFlexDescCount;
+}
+
+inline int CFlexProgram::RuleCount() const
+{
+	return m_iRuleCount;
+}
+
+inline int CFlexProgram::InvalidRuleCount() const
+{
+	return m_iInvalidRuleCount;
+}
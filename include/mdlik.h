@@ -0,0 +1,107 @@
+#pragma once
+
+#include "valve/vector.h"
+
+#include <vector>
+
+class CModel;
+
+// one ik chain of one entity to solve, everything in world space
+struct CIKRequest
+{
+	matrix3x4_t* m_pBoneToWorld;
+	int m_iChain;
+
+	Vector m_vecTarget;		// where the foot should end up
+	Quaternion m_qTarget;	// and its rotation there
+
+	float m_flPosWeight;	// 1 reaches m_vecTarget, 0 leaves the foot where it is
+	float m_flRotWeight;	// 1 takes m_qTarget, 0 keeps the foot's animated rotation
+};
+
+// where an entity wants one of its chains, kept from tick to tick. a target
+// with no position weight isn't solved
+struct CIKTarget
+{
+	Vector m_vecTarget;
+	Quaternion m_qTarget;
+
+	float m_flPosWeight;
+	float m_flRotWeight;
+};
+
+// analytic two bone ik (thigh, knee, foot) with the engine's Studio_SolveIK
+// limits. requests are queued and solved four chains per instruction, so all
+// the feet of a tick can go through one Solve(). only the chain's own bones are
+// moved, bones parented below the foot have to be rebuilt by the caller.
+//
+// chains without a knee direction bend towards where the animated knee sticks
+// out of the line from thigh to foot, and aren't solved when the animated leg is
+// too straight to tell, as in the engine.
+class CIKSolver
+{
+public:
+	CIKSolver(const CModel& model);
+
+	// ignored when the chain isn't a two bone chain of the model
+	void Add(const CIKRequest& request);
+
+	// a request per target with a position weight, targets are [entity * ChainCount() + chain]
+	void AddTargets(const CIKTarget* pTargets, matrix3x4_t* const* ppBoneToWorlds, int nEntities);
+
+	// a request per ik lock of the sequence and autoplay lock of the model, pulling each foot
+	// towards where it is in pLockedBoneToWorld by the lock's position weight. like
+	// CIKContext::SolveLock the foot then takes the locked rotation, and its rotation relative
+	// to the knee is slerped back towards the animated one by the lock's local weight. that
+	// happens even when the chain has no solution. the engine then rebuilds the foot's
+	// position from the knee, here it stays where the solver put it, which differs only
+	// by how the knee's new frame is rolled about the shin
+	void AddLocks(int iSequence, matrix3x4_t* pBoneToWorld, const matrix3x4_t* pLockedBoneToWorld);
+
+	// solves and clears the queue, returns how many chains had a solution. chains that
+	// don't (the target is unreachable along the knee direction) are left untouched,
+	// apart from the rotation of a lock's foot
+	int Solve();
+
+	inline void Clear();
+	inline int RequestCount() const;
+	inline int ChainCount() const;
+
+private:
+	struct CChain
+	{
+		int m_iThigh;
+		int m_iKnee;
+		int m_iFoot;
+
+		Vector m_vecKneeDir; // in the thigh's space, zero to bend towards the current knee
+	};
+
+	struct CQueuedRequest
+	{
+		CIKRequest m_Request;
+		float m_flLocalQWeight; // locks only, -1 for requests that slerp the foot in world space
+	};
+
+	const CModel& m_Model;
+
+	std::vector<CChain> m_vecChains{};
+	std::vector<bool> m_vecValid{};
+
+	std::vector<CQueuedRequest> m_vecRequests{};
+};
+
+inline void CIKSolver::Clear()
+{
+	m_vecRequests.clear();
+}
+
+inline int CIKSolver::RequestCount() const
+{
+	return (int)m_vecRequests.size();
+}
+
+inline int CIKSolver::ChainCount() const
+{
+	return (int)m_vecChains.size();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "mdlfile.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CModel;
+
+// what an index term names
+enum IndexTerm_t
+{
+	INDEXTERM_MATERIAL = 0,
+	INDEXTERM_BONE,
+	INDEXTERM_SURFACEPROP,	// of the model or any of its bones
+
+	INDEXTERM_COUNT
+};
+
+#define MODELINDEX_MAGIC (('X' << 24) + ('D' << 16) + ('I' << 8) + 'M') // little-endian "MIDX"
+#define MODELINDEX_VERSION 1
+
+// an index file, in native byte order. offsets are from the start of the file
+struct CModelIndexHeader
+{
+	uint32_t m_nMagic;
+	uint32_t m_nVersion;
+	uint32_t m_nSize;			// of the whole file
+	uint32_t m_nModels;
+	uint32_t m_nTerms;
+	uint32_t m_nModelIndex;		// a string offset per model, models sorted by name
+	uint32_t m_nTermIndex;		// a CModelIndexTerm per term, sorted by kind then name
+	uint32_t m_nStringIndex;	// nul terminated strings, offsets are from here
+	uint32_t m_nPostingIndex;	// each term's model ids, ascending, as varint gaps
+};
+
+struct CModelIndexTerm
+{
+	uint32_t m_nName;		// string offset
+	uint32_t m_iKind;		// IndexTerm_t
+	uint32_t m_nPostings;	// from m_nPostingIndex
+	uint32_t m_nCount;		// models with the term
+};
+
+// read only view of an index file, usually memory mapped. a term's id is its
+// position in the term table, names are matched case insensitively with
+// backslashes taken as slashes
+class CModelIndex
+{
+public:
+	bool Open(const std::string& filename);
+	bool Open(const char* pData, size_t nSize); // memory the caller keeps around
+	void Close();
+
+	inline bool IsOpen() const;
+	inline int ModelCount() const;
+	inline int TermCount() const;
+
+	const char* ModelName(int iModel) const;
+
+	// -1 if no model has it
+	int FindTerm(IndexTerm_t iKind, const std::string& strName) const;
+
+	IndexTerm_t TermKind(int iTerm) const;
+	const char* TermName(int iTerm) const;
+	int TermModelCount(int iTerm) const;
+
+	// ids of the models with the term, ascending
+	void Models(int iTerm, std::vector<int>& vecModels) const;
+
+	// the above with FindTerm(), false if no model has it
+	bool Find(IndexTerm_t iKind, const std::string& strName, std::vector<int>& vecModels) const;
+
+private:
+	CMappedFile m_File;
+
+	const CModelIndexHeader* m_pHeader = nullptr;
+	const uint32_t* m_pModels = nullptr;
+	const CModelIndexTerm* m_pTerms = nullptr;
+	const char* m_pStrings = nullptr;
+	const unsigned char* m_pPostings = nullptr;
+	const unsigned char* m_pEnd = nullptr;
+};
+
+inline bool CModelIndex::IsOpen() const
+{
+	return m_pHeader != nullptr;
+}
+
+inline int CModelIndex::ModelCount() const
+{
+	return m_pHeader ? (int)m_pHeader->m_nModels : 0;
+}
+
+inline int CModelIndex::TermCount() const
+{
+	return m_pHeader ? (int)m_pHeader->m_nTerms : 0;
+}
+
+// collects models' terms and writes them out as a CModelIndex. models are added
+// under a name, normally their path, and adding one again replaces it, so an
+// index can be kept up to date by loading it and re-adding what changed
+class CModelIndexBuilder
+{
+public:
+	// starts from an index written before
+	void Load(const CModelIndex& index);
+
+	void Add(const std::string& strModel, const CModel& model);
+	void Remove(const std::string& strModel);
+	void Clear();
+
+	inline int ModelCount() const;
+
+	void Write(std::vector<char>& vecOut) const;
+
+	// replaces the file with one rename, so readers with the old index open or mapped keep reading it
+	bool Write(const std::string& filename) const;
+
+private:
+	// kind then normalized name -> term id
+	std::unordered_map<std::string, int> m_TermIds{};
+	std::vector<std::string> m_vecTerms{};
+
+	// model name -> ids of its terms
+	std::unordered_map<std::string, std::vector<int>> m_Models{};
+
+	int Intern(IndexTerm_t iKind, const std::string& strName);
+};
+
+inline int CModelIndexBuilder::ModelCount() const
+{
+	return (int)m_Models.size();
+}
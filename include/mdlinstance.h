@@ -0,0 +1,298 @@
+#pragma once
+
+#include "mdlanim.h"
+#include "mdlik.h"
+#include "mdlpose.h"
+#include "valve/vector.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CModel;
+
+// names an instance. the serial changes every time a slot is reused, so handles
+// to despawned instances stop resolving instead of finding the next occupant
+struct CInstanceHandle
+{
+	int m_iSlot = -1;
+	uint32_t m_iSerial = 0;
+};
+
+// many instances of one model. the model is shared and never changes, all the
+// state an instance can change lives in arenas with one row per live instance,
+// packed into [0, Count()) so batch evaluators stream straight through them:
+//
+//   blend.Evaluate(Sequences(), Cycles(), PoseParameters(), Count(), Poses());
+//   PoseEvaluator().ApplyControllers(Controllers(), Poses(), Count());
+//   flex.Evaluate(FlexControllers(), FlexWeights(), Count(), Capacity());
+//   procbones.Evaluate(BoneToWorlds(), Count());
+//   ik.AddTargets(IKTargets(), BoneToWorlds(), Count()); ik.Solve();
+//
+// despawning moves the last row into the hole, so rows move and handles don't.
+// spawn and despawn are O(1), spawn only allocates when the arenas grow.
+class CModelInstances
+{
+public:
+	// pModel can't be NULL, nReserve instances fit before the arenas grow
+	CModelInstances(std::shared_ptr<const CModel> pModel, int nReserve = 0);
+
+	// the new instance starts on sequence 0 at cycle 0 in the default pose, with
+	// every pose parameter, controller and flex controller at 0 and no ik target
+	CInstanceHandle Spawn();
+
+	// false when the handle is stale
+	bool Despawn(const CInstanceHandle& handle);
+	void Clear();
+
+	void Reserve(int nInstances);
+
+	// row of a live instance, -1 for stale handles
+	inline int Row(const CInstanceHandle& handle) const;
+	inline const CInstanceHandle& Handle(int iRow) const;
+
+	inline int Count() const;
+	inline int Capacity() const; // also the row stride of the flex arenas
+
+	inline const CModel& Model() const;
+	inline const std::shared_ptr<const CModel>& SharedModel() const;
+	inline const CPoseEvaluator& PoseEvaluator() const;
+
+	inline int BoneCount() const;
+	inline int PoseParameterCount() const;
+	inline int FlexControllerCount() const;
+	inline int FlexWeightCount() const;
+	inline int IKChainCount() const;
+
+	// [row]
+	inline int* Sequences();
+	inline float* Cycles();
+	inline CBonePose* Poses();
+
+	// [row * PoseParameterCount() + param], in the parameters' own units
+	inline float* PoseParameters();
+
+	// [row * POSE_CONTROLLER_INPUTS + input], normalized as CPoseEvaluator::EncodeControllers() leaves them
+	inline float* Controllers();
+
+	// [index * Capacity() + row]
+	inline float* FlexControllers();
+	inline float* FlexWeights();
+
+	// [row * IKChainCount() + chain]
+	inline CIKTarget* IKTargets();
+
+	// [bone], what ik and procedural bones work on in place
+	inline matrix3x4_t* BoneToWorld(int iRow);
+
+	// one bone array per row
+	inline matrix3x4_t* const* BoneToWorlds();
+
+	inline const int* Sequences() const;
+	inline const float* Cycles() const;
+	inline const CBonePose* Poses() const;
+	inline const float* PoseParameters() const;
+	inline const float* Controllers() const;
+	inline const float* FlexControllers() const;
+	inline const float* FlexWeights() const;
+	inline const CIKTarget* IKTargets() const;
+	inline const matrix3x4_t* BoneToWorld(int iRow) const;
+
+private:
+	struct CSlot
+	{
+		int m_iRow;
+		uint32_t m_iSerial;
+	};
+
+	std::shared_ptr<const CModel> m_pModel;
+	CPoseEvaluator m_PoseEvaluator;
+
+	std::vector<CSlot> m_vecSlots{};
+	std::vector<int> m_vecFreeSlots{};
+	std::vector<CInstanceHandle> m_vecHandles{}; // [row]
+
+	std::vector<int> m_vecSequences{};
+	std::vector<float> m_vecCycles{};
+	std::vector<CBonePose> m_vecPoses{};
+	std::vector<float> m_vecPoseParameters{};
+	std::vector<float> m_vecControllers{};
+	std::vector<float> m_vecFlexControllers{};
+	std::vector<float> m_vecFlexWeights{};
+	std::vector<CIKTarget> m_vecIKTargets{};
+	std::vector<matrix3x4_t> m_vecBoneToWorld{};
+	std::vector<matrix3x4_t*> m_vecBoneToWorlds{};
+
+	float m_flDefaultControllers[POSE_CONTROLLER_INPUTS];
+
+	int m_nCount = 0;
+	int m_nCapacity = 0;
+
+	int m_nBones = 0;
+	int m_nPoseParameters = 0;
+	int m_nFlexControllers = 0;
+	int m_nFlexWeights = 0;
+	int m_nIKChains = 0;
+
+	void ResetRow(int iRow);
+	void MoveRow(int iFrom, int iTo);
+};
+
+inline int CModelInstances::Row(const CInstanceHandle& handle) const
+{
+	if (handle.m_iSlot < 0 || handle.m_iSlot >= (int)m_vecSlots.size())
+		return -1;
+
+	const CSlot& slot = m_vecSlots[handle.m_iSlot];
+	return slot.m_iSerial == handle.m_iSerial ? slot.m_iRow : -1;
+}
+
+inline const CInstanceHandle& CModelInstances::Handle(int iRow) const
+{
+	return m_vecHandles[iRow];
+}
+
+inline int CModelInstances::Count() const
+{
+	return m_nCount;
+}
+
+inline int CModelInstances::Capacity() const
+{
+	return m_nCapacity;
+}
+
+inline const CModel& CModelInstances::Model() const
+{
+	return *m_pModel;
+}
+
+inline const std::shared_ptr<const CModel>& CModelInstances::SharedModel() const
+{
+	return m_pModel;
+}
+
+inline const CPoseEvaluator& CModelInstances::PoseEvaluator() const
+{
+	return m_PoseEvaluator;
+}
+
+inline int CModelInstances::BoneCount() const
+{
+	return m_nBones;
+}
+
+inline int CModelInstances::PoseParameterCount() const
+{
+	return m_nPoseParameters;
+}
+
+inline int CModelInstances::FlexControllerCount() const
+{
+	return m_nFlexControllers;
+}
+
+inline int CModelInstances::FlexWeightCount() const
+{
+	return m_nFlexWeights;
+}
+
+inline int CModelInstances::IKChainCount() const
+{
+	return m_nIKChains;
+}
+
+inline int* CModelInstances::Sequences()
+{
+	return m_vecSequences.data();
+}
+
+inline float* CModelInstances::Cycles()
+{
+	return m_vecCycles.data();
+}
+
+inline CBonePose* CModelInstances::Poses()
+{
+	return m_vecPoses.data();
+}
+
+inline float* CModelInstances::PoseParameters()
+{
+	return m_vecPoseParameters.data();
+}
+
+inline float* CModelInstances::Controllers()
+{
+	return m_vecControllers.data();
+}
+
+inline float* CModelInstances::FlexControllers()
+{
+	return m_vecFlexControllers.data();
+}
+
+inline float* CModelInstances::FlexWeights()
+{
+	return m_vecFlexWeights.data();
+}
+
+inline CIKTarget* CModelInstances::IKTargets()
+{
+	return m_vecIKTargets.data();
+}
+
+inline matrix3x4_t* CModelInstances::BoneToWorld(int iRow)
+{
+	return m_vecBoneToWorld.data() + (size_t)iRow * m_nBones;
+}
+
+inline matrix3x4_t* const* CModelInstances::BoneToWorlds()
+{
+	return m_vecBoneToWorlds.data();
+}
+
+inline const int* CModelInstances::Sequences() const
+{
+	return m_vecSequences.data();
+}
+
+inline const float* CModelInstances::Cycles() const
+{
+	return m_vecCycles.data();
+}
+
+inline const CBonePose* CModelInstances::Poses() const
+{
+	return m_vecPoses.data();
+}
+
+inline const float* CModelInstances::PoseParameters() const
+{
+	return m_vecPoseParameters.data();
+}
+
+inline const float* CModelInstances::Controllers() const
+{
+	return m_vecControllers.data();
+}
+
+inline const float* CModelInstances::FlexControllers() const
+{
+	return m_vecFlexControllers.data();
+}
+
+inline const float* CModelInstances::FlexWeights() const
+{
+	return m_vecFlexWeights.data();
+}
+
+inline const CIKTarget* CModelInstances::IKTargets() const
+{
+	return m_vecIKTargets.data();
+}
+
+inline const matrix3x4_t* CModelInstances::BoneToWorld(int iRow) const
+{
+	return m_vecBoneToWorld.data() + (size_t)iRow * m_nBones;
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include "mdlcpu.h"
+#include "valve/vector.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define MDL_NEON 1
+#endif
+
+#if defined(MDL_SSE2)
+#include <emmintrin.h>
+#if defined(__FMA__)
+#include <immintrin.h>
+#endif
+#elif defined(MDL_NEON)
+#include <arm_neon.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// four wide float vectors. SSE2 on x86, NEON on arm64 and a plain struct
+// everywhere else, so every kernel written against these compiles anywhere.
+// comparisons return all-ones/all-zero lane masks.
+//-----------------------------------------------------------------------------
+
+#if defined(MDL_SSE2)
+
+typedef __m128 fltx4;
+
+inline fltx4 LoadAlignedSIMD(const float* p) { return _mm_load_ps(p); }
+inline fltx4 LoadUnalignedSIMD(const float* p) { return _mm_loadu_ps(p); }
+inline void StoreAlignedSIMD(float* p, const fltx4& a) { _mm_store_ps(p, a); }
+inline void StoreUnalignedSIMD(float* p, const fltx4& a) { _mm_storeu_ps(p, a); }
+
+inline fltx4 ReplicateX4(float f) { return _mm_set1_ps(f); }
+inline fltx4 LoadZeroSIMD() { return _mm_setzero_ps(); }
+
+inline fltx4 AddSIMD(const fltx4& a, const fltx4& b) { return _mm_add_ps(a, b); }
+inline fltx4 SubSIMD(const fltx4& a, const fltx4& b) { return _mm_sub_ps(a, b); }
+inline fltx4 MulSIMD(const fltx4& a, const fltx4& b) { return _mm_mul_ps(a, b); }
+inline fltx4 DivSIMD(const fltx4& a, const fltx4& b) { return _mm_div_ps(a, b); }
+inline fltx4 SqrtSIMD(const fltx4& a) { return _mm_sqrt_ps(a); }
+inline fltx4 MaxSIMD(const fltx4& a, const fltx4& b) { return _mm_max_ps(a, b); }
+inline fltx4 MinSIMD(const fltx4& a, const fltx4& b) { return _mm_min_ps(a, b); }
+
+inline fltx4 AndSIMD(const fltx4& a, const fltx4& b) { return _mm_and_ps(a, b); }
+inline fltx4 AndNotSIMD(const fltx4& a, const fltx4& b) { return _mm_andnot_ps(a, b); } // ~a & b
+inline fltx4 OrSIMD(const fltx4& a, const fltx4& b) { return _mm_or_ps(a, b); }
+inline fltx4 XorSIMD(const fltx4& a, const fltx4& b) { return _mm_xor_ps(a, b); }
+
+inline fltx4 CmpGtSIMD(const fltx4& a, const fltx4& b) { return _mm_cmpgt_ps(a, b); }
+inline fltx4 CmpGeSIMD(const fltx4& a, const fltx4& b) { return _mm_cmpge_ps(a, b); }
+inline fltx4 CmpLtSIMD(const fltx4& a, const fltx4& b) { return _mm_cmplt_ps(a, b); }
+inline fltx4 CmpLeSIMD(const fltx4& a, const fltx4& b) { return _mm_cmple_ps(a, b); }
+inline fltx4 CmpEqSIMD(const fltx4& a, const fltx4& b) { return _mm_cmpeq_ps(a, b); }
+
+// lane mask of each comparison result packed into the low four bits
+inline int TestSignSIMD(const fltx4& a) { return _mm_movemask_ps(a); }
+
+inline void TransposeSIMD(fltx4& a, fltx4& b, fltx4& c, fltx4& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+#elif defined(MDL_NEON)
+
+typedef float32x4_t fltx4;
+
+inline fltx4 LoadAlignedSIMD(const float* p) { return vld1q_f32(p); }
+inline fltx4 LoadUnalignedSIMD(const float* p) { return vld1q_f32(p); }
+inline void StoreAlignedSIMD(float* p, const fltx4& a) { vst1q_f32(p, a); }
+inline void StoreUnalignedSIMD(float* p, const fltx4& a) { vst1q_f32(p, a); }
+
+inline fltx4 ReplicateX4(float f) { return vdupq_n_f32(f); }
+inline fltx4 LoadZeroSIMD() { return vdupq_n_f32(0.0f); }
+
+inline fltx4 AddSIMD(const fltx4& a, const fltx4& b) { return vaddq_f32(a, b); }
+inline fltx4 SubSIMD(const fltx4& a, const fltx4& b) { return vsubq_f32(a, b); }
+inline fltx4 MulSIMD(const fltx4& a, const fltx4& b) { return vmulq_f32(a, b); }
+inline fltx4 DivSIMD(const fltx4& a, const fltx4& b) { return vdivq_f32(a, b); }
+inline fltx4 SqrtSIMD(const fltx4& a) { return vsqrtq_f32(a); }
+inline fltx4 MaxSIMD(const fltx4& a, const fltx4& b) { return vmaxq_f32(a, b); }
+inline fltx4 MinSIMD(const fltx4& a, const fltx4& b) { return vminq_f32(a, b); }
+
+inline fltx4 AndSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline fltx4 AndNotSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(b), vreinterpretq_u32_f32(a))); }
+inline fltx4 OrSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline fltx4 XorSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+
+inline fltx4 CmpGtSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+inline fltx4 CmpGeSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+inline fltx4 CmpLtSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+inline fltx4 CmpLeSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+inline fltx4 CmpEqSIMD(const fltx4& a, const fltx4& b) { return vreinterpretq_f32_u32(vceqq_f32(a, b)); }
+
+inline int TestSignSIMD(const fltx4& a)
+{
+	uint32x4_t sign = vshrq_n_u32(vreinterpretq_u32_f32(a), 31);
+	return (int)(vgetq_lane_u32(sign, 0) | (vgetq_lane_u32(sign, 1) << 1) | (vgetq_lane_u32(sign, 2) << 2) | (vgetq_lane_u32(sign, 3) << 3));
+}
+
+inline void TransposeSIMD(fltx4& a, fltx4& b, fltx4& c, fltx4& d)
+{
+	float32x4x2_t ab = vtrnq_f32(a, b);
+	float32x4x2_t cd = vtrnq_f32(c, d);
+	a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+#else
+
+struct fltx4
+{
+	float m128_f32[4];
+};
+
+namespace simd_scalar
+{
+	inline uint32_t Bits(float f) { uint32_t u; memcpy(&u, &f, sizeof(u)); return u; }
+	inline float Float(uint32_t u) { float f; memcpy(&f, &u, sizeof(f)); return f; }
+	inline float Mask(bool b) { return Float(b ? 0xFFFFFFFFu : 0u); }
+}
+
+#define SIMD_SCALAR_OP(expr) fltx4 r; for (int i = 0; i < 4; i++) { r.m128_f32[i] = (expr); } return r;
+
+inline fltx4 LoadAlignedSIMD(const float* p) { SIMD_SCALAR_OP(p[i]) }
+inline fltx4 LoadUnalignedSIMD(const float* p) { SIMD_SCALAR_OP(p[i]) }
+inline void StoreAlignedSIMD(float* p, const fltx4& a) { for (int i = 0; i < 4; i++) p[i] = a.m128_f32[i]; }
+inline void StoreUnalignedSIMD(float* p, const fltx4& a) { for (int i = 0; i < 4; i++) p[i] = a.m128_f32[i]; }
+
+inline fltx4 ReplicateX4(float f) { SIMD_SCALAR_OP(f) }
+inline fltx4 LoadZeroSIMD() { SIMD_SCALAR_OP(0.0f) }
+
+inline fltx4 AddSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(a.m128_f32[i] + b.m128_f32[i]) }
+inline fltx4 SubSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(a.m128_f32[i] - b.m128_f32[i]) }
+inline fltx4 MulSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(a.m128_f32[i] * b.m128_f32[i]) }
+inline fltx4 DivSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(a.m128_f32[i] / b.m128_f32[i]) }
+inline fltx4 SqrtSIMD(const fltx4& a) { SIMD_SCALAR_OP(sqrtf(a.m128_f32[i])) }
+inline fltx4 MaxSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(a.m128_f32[i] > b.m128_f32[i] ? a.m128_f32[i] : b.m128_f32[i]) }
+inline fltx4 MinSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(a.m128_f32[i] < b.m128_f32[i] ? a.m128_f32[i] : b.m128_f32[i]) }
+
+inline fltx4 AndSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Float(simd_scalar::Bits(a.m128_f32[i]) & simd_scalar::Bits(b.m128_f32[i]))) }
+inline fltx4 AndNotSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Float(~simd_scalar::Bits(a.m128_f32[i]) & simd_scalar::Bits(b.m128_f32[i]))) }
+inline fltx4 OrSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Float(simd_scalar::Bits(a.m128_f32[i]) | simd_scalar::Bits(b.m128_f32[i]))) }
+inline fltx4 XorSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Float(simd_scalar::Bits(a.m128_f32[i]) ^ simd_scalar::Bits(b.m128_f32[i]))) }
+
+inline fltx4 CmpGtSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Mask(a.m128_f32[i] > b.m128_f32[i])) }
+inline fltx4 CmpGeSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Mask(a.m128_f32[i] >= b.m128_f32[i])) }
+inline fltx4 CmpLtSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Mask(a.m128_f32[i] < b.m128_f32[i])) }
+inline fltx4 CmpLeSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Mask(a.m128_f32[i] <= b.m128_f32[i])) }
+inline fltx4 CmpEqSIMD(const fltx4& a, const fltx4& b) { SIMD_SCALAR_OP(simd_scalar::Mask(a.m128_f32[i] == b.m128_f32[i])) }
+
+#undef SIMD_SCALAR_OP
+
+inline int TestSignSIMD(const fltx4& a)
+{
+	int iMask = 0;
+	for (int i = 0; i < 4; i++)
+		iMask |= (int)(simd_scalar::Bits(a.m128_f32[i]) >> 31) << i;
+	return iMask;
+}
+
+inline void TransposeSIMD(fltx4& a, fltx4& b, fltx4& c, fltx4& d)
+{
+	fltx4* rows[4] = { &a, &b, &c, &d };
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = i + 1; j < 4; j++)
+		{
+			float t = rows[i]->m128_f32[j];
+			rows[i]->m128_f32[j] = rows[j]->m128_f32[i];
+			rows[j]->m128_f32[i] = t;
+		}
+	}
+}
+
+#endif
+
+// a * b + c and c - a * b, fused when the build targets an instruction set that has it
+#if defined(MDL_SSE2) && defined(__FMA__)
+inline fltx4 MaddSIMD(const fltx4& a, const fltx4& b, const fltx4& c) { return _mm_fmadd_ps(a, b, c); }
+inline fltx4 MsubSIMD(const fltx4& a, const fltx4& b, const fltx4& c) { return _mm_fnmadd_ps(a, b, c); }
+#elif defined(MDL_NEON)
+inline fltx4 MaddSIMD(const fltx4& a, const fltx4& b, const fltx4& c) { return vfmaq_f32(c, a, b); }
+inline fltx4 MsubSIMD(const fltx4& a, const fltx4& b, const fltx4& c) { return vfmsq_f32(c, a, b); }
+#else
+inline fltx4 MaddSIMD(const fltx4& a, const fltx4& b, const fltx4& c) { return AddSIMD(MulSIMD(a, b), c); }
+inline fltx4 MsubSIMD(const fltx4& a, const fltx4& b, const fltx4& c) { return SubSIMD(c, MulSIMD(a, b)); }
+#endif
+
+inline fltx4 NegSIMD(const fltx4& a) { return XorSIMD(a, ReplicateX4(-0.0f)); }
+inline fltx4 AbsSIMD(const fltx4& a) { return AndNotSIMD(ReplicateX4(-0.0f), a); }
+
+// mask ? a : b
+inline fltx4 MaskedAssign(const fltx4& mask, const fltx4& a, const fltx4& b) { return OrSIMD(AndSIMD(mask, a), AndNotSIMD(mask, b)); }
+
+// full precision, zero length lanes come back as zero rather than inf
+inline fltx4 ReciprocalSqrtSaturateSIMD(const fltx4& a)
+{
+	fltx4 inv = DivSIMD(ReplicateX4(1.0f), SqrtSIMD(a));
+	return AndSIMD(inv, CmpGtSIMD(a, LoadZeroSIMD()));
+}
+
+// four vectors / quaternions in SoA registers
+struct FourVectors
+{
+	fltx4 x, y, z;
+};
+
+struct FourQuaternions
+{
+	fltx4 x, y, z, w;
+};
+
+//-----------------------------------------------------------------------------
+// single value math, same semantics as the engine's mathlib
+//-----------------------------------------------------------------------------
+
+void AngleQuaternion(const RadianEuler& angles, Quaternion& q);
+void QuaternionAngles(const Quaternion& q, RadianEuler& angles);
+
+void QuaternionAlign(const Quaternion& p, const Quaternion& q, Quaternion& qt);
+float QuaternionNormalize(Quaternion& q);
+void QuaternionBlend(const Quaternion& p, const Quaternion& q, float t, Quaternion& qt); // normalized lerp
+void QuaternionSlerp(const Quaternion& p, const Quaternion& q, float t, Quaternion& qt);
+void QuaternionMult(const Quaternion& p, const Quaternion& q, Quaternion& qt);
+void QuaternionConjugate(const Quaternion& p, Quaternion& q);
+
+void QuaternionMatrix(const Quaternion& q, const Vector& pos, matrix3x4_t& matrix);
+void MatrixQuaternion(const matrix3x4_t& matrix, Quaternion& q);
+void MatrixPosition(const matrix3x4_t& matrix, Vector& position);
+void SetIdentityMatrix(matrix3x4_t& matrix);
+
+void ConcatTransforms(const matrix3x4_t& in1, const matrix3x4_t& in2, matrix3x4_t& out);
+void MatrixInvert(const matrix3x4_t& in, matrix3x4_t& out);			// rotation + translation only
+bool MatrixInverseGeneral(const matrix3x4_t& in, matrix3x4_t& out);	// any invertible affine transform
+
+void VectorTransform(const Vector& in, const matrix3x4_t& matrix, Vector& out);
+void VectorITransform(const Vector& in, const matrix3x4_t& matrix, Vector& out);
+void VectorRotate(const Vector& in, const matrix3x4_t& matrix, Vector& out);
+void VectorIRotate(const Vector& in, const matrix3x4_t& matrix, Vector& out);
+
+//-----------------------------------------------------------------------------
+// four-at-a-time forms
+//-----------------------------------------------------------------------------
+
+FourQuaternions QuaternionAlignSIMD(const FourQuaternions& p, const FourQuaternions& q);
+FourQuaternions QuaternionNormalizeSIMD(const FourQuaternions& q);
+FourQuaternions QuaternionBlendSIMD(const FourQuaternions& p, const FourQuaternions& q, const fltx4& t);
+FourQuaternions QuaternionSlerpSIMD(const FourQuaternions& p, const FourQuaternions& q, const fltx4& t); // within 4e-4 of QuaternionSlerp, see tests/test_math.cpp
+FourQuaternions QuaternionMultSIMD(const FourQuaternions& p, const FourQuaternions& q);
+FourVectors QuaternionRotateSIMD(const FourQuaternions& q, const FourVectors& v);
+
+//-----------------------------------------------------------------------------
+// batch forms over SoA arrays, the count doesn't have to be a multiple of four
+//-----------------------------------------------------------------------------
+
+struct CQuaternionSoA
+{
+	float* x;
+	float* y;
+	float* z;
+	float* w;
+};
+
+struct CVectorSoA
+{
+	float* x;
+	float* y;
+	float* z;
+};
+
+void QuaternionNormalizeSoA(const CQuaternionSoA& q, int nCount);
+void QuaternionBlendSoA(const CQuaternionSoA& p, const CQuaternionSoA& q, float t, const CQuaternionSoA& out, int nCount);
+void QuaternionSlerpSoA(const CQuaternionSoA& p, const CQuaternionSoA& q, float t, const CQuaternionSoA& out, int nCount);
+void QuaternionMultSoA(const CQuaternionSoA& p, const CQuaternionSoA& q, const CQuaternionSoA& out, int nCount);
+
+// out += src * weight with src flipped onto out's hemisphere, the building block for n-way blends
+void QuaternionAccumulateSoA(const CQuaternionSoA& out, const CQuaternionSoA& src, float flWeight, int nCount);
+
+void QuaternionMatrixSoA(const CQuaternionSoA& q, const CVectorSoA& pos, matrix3x4_t* pOut, int nCount);
+void VectorTransformSoA(const matrix3x4_t& matrix, const CVectorSoA& in, const CVectorSoA& out, int nCount);
+
+// AoS matrix batches
+void ConcatTransformsBatch(const matrix3x4_t* pIn1, const matrix3x4_t* pIn2, matrix3x4_t* pOut, int nCount);
+void MatrixInvertBatch(const matrix3x4_t* pIn, matrix3x4_t* pOut, int nCount);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// what a CModel costs in bytes, by what the bytes hold. each field counts the
+// containers' heap blocks (hash map nodes are estimated from their contents
+// plus two pointers), the model object itself is counted under m_nOther
+struct CModelMemory
+{
+	size_t m_nRawData = 0;		// the file buffer
+	size_t m_nBones = 0;
+	size_t m_nBodyParts = 0;	// body parts, their studio models and eyeballs
+	size_t m_nHitBoxes = 0;
+	size_t m_nMaterials = 0;	// material strings
+	size_t m_nAnimations = 0;	// animation descs and their ik rules
+	size_t m_nSequences = 0;
+	size_t m_nFlex = 0;			// flex descs, controllers, ui and the compiled program
+	size_t m_nDerived = 0;		// event timeline, transition graph, skeleton layout
+	size_t m_nOther = 0;		// controllers, attachments, pose parameters, ik chains, names
+
+	inline size_t Total() const;
+};
+
+inline size_t CModelMemory::Total() const
+{
+	return m_nRawData + m_nBones + m_nBodyParts + m_nHitBoxes + m_nMaterials + m_nAnimations + m_nSequences + m_nFlex + m_nDerived + m_nOther;
+}
+
+// heap bytes behind a string, zero while it fits in the string's own small buffer
+inline size_t HeapBytes(const std::string& str)
+{
+	const char* pData = str.data();
+	const char* pObject = (const char*)&str;
+
+	return (pData >= pObject && pData < pObject + sizeof(str)) ? 0 : str.capacity() + 1;
+}
+
+template<typename T>
+inline size_t HeapBytes(const std::vector<T>& vec)
+{
+	return vec.capacity() * sizeof(T);
+}
+
+inline size_t HeapBytes(const std::vector<std::string>& vec)
+{
+	size_t nBytes = vec.capacity() * sizeof(std::string);
+
+	for (const std::string& str : vec)
+		nBytes += HeapBytes(str);
+
+	return nBytes;
+}
+
+template<typename K, typename V>
+inline size_t HeapBytes(const std::unordered_map<K, V>& map)
+{
+	return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(typename std::unordered_map<K, V>::value_type) + 2 * sizeof(void*));
+}
+
+template<typename V>
+inline size_t HeapBytes(const std::unordered_map<std::string, V>& map)
+{
+	size_t nBytes = map.bucket_count() * sizeof(void*) + map.size() * (sizeof(typename std::unordered_map<std::string, V>::value_type) + 2 * sizeof(void*));
+
+	for (const auto& entry : map)
+		nBytes += HeapBytes(entry.first);
+
+	return nBytes;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "valve/vector.h"
+
+#include <string>
+#include <vector>
+
+class CModel;
+
+// the triangles of a model, read from the .vvd and .vtx files next to it.
+// only lod 0 of the models a body value selects (one per body part) is kept,
+// as one vertex pool and a flat triangle list into it.
+class CSkinnedMesh
+{
+public:
+	// both files have to carry the model's checksum
+	bool Load(const CModel& model, int iBody = 0);
+
+	inline int VertexCount() const;
+	inline int TriangleCount() const;
+
+	// bind pose, model space
+	inline const std::vector<Vector>& Positions() const;
+
+	// three vertex indices per triangle
+	inline const std::vector<int>& Indices() const;
+
+	// bone with the largest share of a triangle's vertex weights
+	inline int TriangleBone(int iTriangle) const;
+
+	inline int BoneCount() const;
+
+	// bind pose positions moved by the bone to world matrices, pOut holds VertexCount() vectors
+	void Skin(const matrix3x4_t* pBoneToWorld, Vector* pOut) const;
+
+private:
+	struct CVertexWeights
+	{
+		float m_flWeight[3];
+		int m_iBone[3];
+		int m_nBones;
+	};
+
+	std::vector<Vector> m_vecPositions{};
+	std::vector<CVertexWeights> m_vecWeights{};
+	std::vector<int> m_vecIndices{};
+	std::vector<int> m_vecTriangleBones{};
+	std::vector<matrix3x4_t> m_vecPoseToBone{};
+};
+
+inline int CSkinnedMesh::VertexCount() const
+{
+	return (int)m_vecPositions.size();
+}
+
+inline int CSkinnedMesh::TriangleCount() const
+{
+	return (int)m_vecIndices.size() / 3;
+}
+
+inline const std::vector<Vector>& CSkinnedMesh::Positions() const
+{
+	return m_vecPositions;
+}
+
+inline const std::vector<int>& CSkinnedMesh::Indices() const
+{
+	return m_vecIndices;
+}
+
+inline int CSkinnedMesh::TriangleBone(int iTriangle) const
+{
+	return m_vecTriangleBones[iTriangle];
+}
+
+inline int CSkinnedMesh::BoneCount() const
+{
+	return (int)m_vecPoseToBone.size();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "mdlblend.h"
+#include "valve/vector.h"
+
+#include <vector>
+
+class CModel;
+
+// root motion of every animation, flattened at load so that a displacement
+// query is a table lookup rather than a walk over the movement blocks.
+// yaws are in degrees, cycles outside 0..1 count whole loops of the animation.
+class CRootMotion
+{
+public:
+	CRootMotion(const CModel& model);
+
+	// offset from the start of the animation. false when it has no movement
+	bool AnimPosition(int iAnim, float flCycle, Vector& vecPos, float& flYaw) const;
+
+	// movement between two cycles, relative to the facing at flCycleFrom
+	bool AnimMovement(int iAnim, float flCycleFrom, float flCycleTo, Vector& vecDeltaPos, float& flDeltaYaw) const;
+
+	// weighted movement of the animations blended at the pose parameters
+	bool SeqMovement(int iSequence, float flCycleFrom, float flCycleTo, const float* pPoseParameters, Vector& vecDeltaPos, float& flDeltaYaw) const;
+
+	// one query per entity. pose parameters are [entity * PoseParameterCount() + param]
+	void SeqMovement(const int* pSequences, const float* pCyclesFrom, const float* pCyclesTo, const float* pPoseParameters, int nEntities, Vector* pDeltaPos, float* pDeltaYaw) const;
+
+	inline int PoseParameterCount() const;
+
+private:
+	struct CAnimMotion
+	{
+		int m_iFirstBlock;	// into the block tables
+		int m_iBlockCount;
+		int m_iFrameOffset;	// into m_vecFrameBlocks
+
+		float m_flLastFrame;
+
+		// cumulative movement of one full loop
+		Vector m_vecLoopPos;
+		float m_flLoopYaw;
+
+		bool m_bStatic; // no movement blocks and not a delta, sequences using it still count as moving (by zero)
+	};
+
+	const CModel& m_Model;
+	CBlendSpace m_BlendSpace;
+
+	std::vector<CAnimMotion> m_vecAnims{};
+
+	// per block, SoA. start values are the cumulative position/yaw where the block begins
+	std::vector<float> m_vecStartFrame{};
+	std::vector<float> m_vecFrameRange{};
+	std::vector<float> m_vecV0{};
+	std::vector<float> m_vecDV{}; // v1 - v0
+	std::vector<float> m_vecStartYaw{};
+	std::vector<float> m_vecEndYaw{};
+	std::vector<Vector> m_vecStartPos{};
+	std::vector<Vector> m_vecDirection{};
+
+	// per animation and whole frame, the block that frame falls in
+	std::vector<int> m_vecFrameBlocks{};
+
+	void Position(const CAnimMotion& anim, float flCycle, Vector& vecPos, float& flYaw) const;
+};
+
+inline int CRootMotion::PoseParameterCount() const
+{
+	return m_BlendSpace.PoseParameterCount();
+}
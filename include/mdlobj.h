@@ -4,6 +4,15 @@
 #include <vector>
 #include <unordered_map>
 
+#include "mdlflex.h"
+#include "mdlevents.h"
+#include "mdltransition.h"
+#include "mdlskeleton.h"
+#include "mdlmemory.h"
+#include "mdlstats.h"
+#include "mdlrawdata.h"
+#include "valve/vector.h"
+
 struct studiohdr_t;
 struct mstudioeyeball_t;
 struct mstudiomodel_t;
@@ -12,8 +21,15 @@ struct mstudiobodyparts_t;
 struct mstudiobone_t;
 struct mstudiohitboxset_t;
 struct mstudiobbox_t;
-
-class Vector;
+struct mstudioflexcontroller_t;
+struct mstudioflexcontrollerui_t;
+struct mstudioposeparamdesc_t;
+struct mstudioanimdesc_t;
+struct mstudioseqdesc_t;
+struct mstudioattachment_t;
+struct mstudioikchain_t;
+struct mstudioikrule_t;
+struct mstudioiklock_t;
 
 struct Vector3D
 {
@@ -127,6 +143,7 @@ struct CBoneController : ICacheable<mstudiobonecontroller_t>
 struct CModelBone : ICacheable<mstudiobone_t>
 {
 	std::string m_strName;
+	std::string m_strSurfaceProp;
 
 	int m_iParent;
 	int m_iFlags;
@@ -137,21 +154,210 @@ struct CModelBone : ICacheable<mstudiobone_t>
 	virtual void Cache(mstudiobone_t* pBone) override;
 };
 
+struct CAttachment : ICacheable<mstudioattachment_t>
+{
+	std::string m_strName;
+
+	int m_iFlags;
+	int m_iBone;
+
+	matrix3x4_t m_matLocal; // relative to the bone
+
+	virtual void Cache(mstudioattachment_t* pAttachment) override;
+};
+
+struct CFlexController : ICacheable<mstudioflexcontroller_t>
+{
+	std::string m_strName;
+	std::string m_strType;
+
+	float m_flMin;
+	float m_flMax;
+
+	virtual void Cache(mstudioflexcontroller_t* pController) override;
+};
+
+struct CFlexControllerUI : ICacheable<mstudioflexcontrollerui_t>
+{
+	std::string m_strName;
+
+	int m_iRemapType; // FlexControllerRemapType_t
+	bool m_bStereo;
+
+	// controller indices: control (or left, right when stereo) followed by the nway value control. -1 when unused
+	int m_iControllers[3] = { -1, -1, -1 };
+
+	virtual void Cache(mstudioflexcontrollerui_t* pUI) override;
+};
+
+struct CPoseParameter : ICacheable<mstudioposeparamdesc_t>
+{
+	std::string m_strName;
+
+	int m_iFlags;
+
+	float m_flStart;
+	float m_flEnd;
+	float m_flLoop; // looping range, 0 when the parameter doesn't wrap
+
+	virtual void Cache(mstudioposeparamdesc_t* pPose) override;
+};
+
+// two bone chain, m_vecBones runs thigh, knee, foot
+struct CIKChain : ICacheable<mstudioikchain_t>
+{
+	std::string m_strName;
+
+	int m_iLinkType;
+
+	std::vector<int> m_vecBones;
+	std::vector<Vector3D> m_vecKneeDirs; // per link, in the link bone's space. zero when the knee bends freely
+
+	virtual void Cache(mstudioikchain_t* pChain) override;
+};
+
+struct CIKRule : ICacheable<mstudioikrule_t>
+{
+	int m_iType; // IK_*
+	int m_iChain;
+	int m_iBone;
+	int m_iSlot;
+
+	float m_flHeight;
+	float m_flRadius;
+	float m_flFloor;
+
+	Vector3D m_vecPos;
+	Quaternion m_q;
+
+	// cycles of the influence ramp
+	float m_flStart;
+	float m_flPeak;
+	float m_flTail;
+	float m_flEnd;
+
+	float m_flContact;
+	float m_flDrop;
+	float m_flTop;
+
+	std::string m_strAttachment;
+
+	virtual void Cache(mstudioikrule_t* pRule) override;
+};
+
+struct CIKLock : ICacheable<mstudioiklock_t>
+{
+	int m_iChain;
+	int m_iFlags;
+
+	float m_flPosWeight;
+	float m_flLocalQWeight;
+
+	virtual void Cache(mstudioiklock_t* pLock) override;
+};
+
+struct CAnimDesc : ICacheable<mstudioanimdesc_t>
+{
+	std::string m_strName;
+
+	float m_flFPS;
+	int m_iFlags;
+
+	int m_iFrameCount;
+	int m_iMovementCount;
+
+	int m_iAnimBlock;
+	int m_iSectionFrames;
+
+	int m_iIKRuleCount;
+	std::vector<CIKRule> m_vecIKRules; // empty when they're stored in an .ani block
+
+	virtual void Cache(mstudioanimdesc_t* pAnimDesc) override;
+};
+
+struct CSequence : ICacheable<mstudioseqdesc_t>
+{
+	std::string m_strLabel;
+	std::string m_strActivityName;
+
+	int m_iFlags;
+	int m_iActivity;
+	int m_iActivityWeight;
+
+	int m_iEventCount;
+
+	Vector3D m_bbMin;
+	Vector3D m_bbMax;
+
+	// blend grid, m_vecAnims[y * m_iGroupSize[0] + x] is a local animation index
+	int m_iGroupSize[2];
+	int m_iParamIndex[2]; // pose parameter per axis, -1 when unused
+	float m_flParamStart[2];
+	float m_flParamEnd[2];
+
+	std::vector<int> m_vecAnims;
+	std::vector<float> m_vecPoseKeys; // [axis * m_iGroupSize[0] + i], empty unless the grid is irregular
+	std::vector<float> m_vecBoneWeights;
+	std::vector<CIKLock> m_vecIKLocks;
+
+	float m_flFadeInTime;
+	float m_flFadeOutTime;
+
+	int m_iEntryNode;
+	int m_iExitNode;
+	int m_iNodeFlags;
+
+	int m_iNextSequence;
+	int m_iCyclePoseIndex;
+
+	virtual void Cache(mstudioseqdesc_t* pSeqDesc) override;
+};
+
 class CModel
 {
 public:
-	CModel(const std::string& filename);
+	CModel(const std::string& filename, RawDataPolicy_t iRawDataPolicy = RAWDATA_KEEP_ALL);
 
 	const CModelBone* Bone(int iIndex) const;
 	const std::string* Texture(int iIndex) const;
 
+	// attachment index by name (case insensitive), -1 if there isn't one
+	int FindAttachment(const std::string& strName) const;
+
 	inline const std::vector<std::string>& GetMaterials() const;
 	inline const std::vector<CBoneController>& GetBoneControllers() const;
 	inline const std::vector<CModelBodyParts>& GetBodyParts() const;
 	inline const std::vector<CHitBoxSet>& GetHitBoxSets() const;
+	inline const std::vector<CAttachment>& GetAttachments() const;
+	inline const std::vector<std::string>& GetFlexDescs() const;
+	inline const std::vector<CFlexController>& GetFlexControllers() const;
+	inline const std::vector<CFlexControllerUI>& GetFlexControllerUIs() const;
+	inline const CFlexProgram& GetFlexProgram() const;
+	inline const std::vector<CPoseParameter>& GetPoseParameters() const;
+	inline const std::vector<CAnimDesc>& GetAnimations() const;
+	inline const std::vector<CSequence>& GetSequences() const;
+	inline const std::vector<CIKChain>& GetIKChains() const;
+	inline const std::vector<CIKLock>& GetIKAutoplayLocks() const;
+	inline const CEventTimeline& GetEventTimeline() const;
+	inline const CTransitionGraph& GetTransitionGraph() const;
+	inline const CSkeletonLayout& GetSkeletonLayout() const;
+
+	// the file as kept after load, all of it, a compacted copy or nothing, see RawDataPolicy()
 	inline const std::vector<char>& GetRawData() const;
+	inline RawDataPolicy_t RawDataPolicy() const;
+
+	// per phase load times, zero unless built with MDL_LOAD_STATS
+	inline const CLoadStats& LoadStats() const;
+
+	// bytes the model holds by section, counted once when it's loaded
+	inline const CModelMemory& MemoryUsage() const;
+
+	// the raw studio header, NULL if nothing was loaded or the model was loaded with RAWDATA_DROP
+	inline const studiohdr_t* StudioHdr() const;
 
 	inline const std::string& Name() const;
+	inline const std::string& FileName() const;
+	inline const std::string& SurfaceProp() const;
 
 	inline const Vector3D& HullMins() const;
 	inline const Vector3D& HullMaxs() const;
@@ -161,14 +367,33 @@ public:
 
 private:
 	std::unordered_map<int, CModelBone> m_BoneMap{};
+	std::unordered_map<std::string, int> m_AttachmentMap{}; // lowercase name -> index
 
 	std::vector<CBoneController> m_vecBoneControllers{};
 	std::vector<CModelBodyParts> m_vecBodyParts{};
 	std::vector<CHitBoxSet> m_vecHitBoxSets{};
+	std::vector<CAttachment> m_vecAttachments{};
 	std::vector<std::string> m_vecTextures{};
+	std::vector<std::string> m_vecFlexDescs{};
+	std::vector<CFlexController> m_vecFlexControllers{};
+	std::vector<CFlexControllerUI> m_vecFlexControllerUIs{};
+	std::vector<CPoseParameter> m_vecPoseParameters{};
+	std::vector<CAnimDesc> m_vecAnimations{};
+	std::vector<CSequence> m_vecSequences{};
+	std::vector<CIKChain> m_vecIKChains{};
+	std::vector<CIKLock> m_vecIKAutoplayLocks{};
 	std::vector<char> m_vecRawData{};
 
+	CFlexProgram m_FlexProgram{};
+	CEventTimeline m_EventTimeline{};
+	CTransitionGraph m_TransitionGraph{};
+	CSkeletonLayout m_SkeletonLayout{};
+	CLoadStats m_LoadStats{};
+	CModelMemory m_Memory{};
+
 	std::string m_strModelName{};
+	std::string m_strFileName{};
+	std::string m_strSurfaceProp{};
 
 	Vector3D m_hullMins{};
 	Vector3D m_hullMaxs{};
@@ -177,15 +402,26 @@ private:
 
 	int m_iVersion = -1;
 
+	RawDataPolicy_t m_iRawDataPolicy = RAWDATA_KEEP_ALL;
+
 	int m_iBoneCount = 0;
 	int m_iMaterialCount = 0;
 	int m_iBoneControllerCount = 0;
 	int m_iBodyPartsCount = 0;
 	int m_iSequenceCount = 0;
 	int m_iHitBoxSetCount = 0;
-
-	bool LoadFile(const std::string& filename);
+	int m_iAttachmentCount = 0;
+	int m_iFlexDescCount = 0;
+	int m_iFlexControllerCount = 0;
+	int m_iFlexRuleCount = 0;
+	int m_iFlexControllerUICount = 0;
+	int m_iPoseParameterCount = 0;
+	int m_iAnimationCount = 0;
+	int m_iIKChainCount = 0;
+
+	bool LoadFile(const std::string& filename, RawDataPolicy_t iRawDataPolicy);
 	void CacheModelInfo(studiohdr_t* pMdl);
+	void CountMemory();
 
 	CModel() {}
 };
@@ -215,16 +451,111 @@ inline const std::vector<CHitBoxSet>& CModel::GetHitBoxSets() const
 	return m_vecHitBoxSets;
 }
 
+inline const std::vector<CAttachment>& CModel::GetAttachments() const
+{
+	return m_vecAttachments;
+}
+
+inline const std::vector<std::string>& CModel::GetFlexDescs() const
+{
+	return m_vecFlexDescs;
+}
+
+inline const std::vector<CFlexController>& CModel::GetFlexControllers() const
+{
+	return m_vecFlexControllers;
+}
+
+inline const std::vector<CFlexControllerUI>& CModel::GetFlexControllerUIs() const
+{
+	return m_vecFlexControllerUIs;
+}
+
+inline const CFlexProgram& CModel::GetFlexProgram() const
+{
+	return m_FlexProgram;
+}
+
+inline const std::vector<CPoseParameter>& CModel::GetPoseParameters() const
+{
+	return m_vecPoseParameters;
+}
+
+inline const std::vector<CAnimDesc>& CModel::GetAnimations() const
+{
+	return m_vecAnimations;
+}
+
+inline const std::vector<CSequence>& CModel::GetSequences() const
+{
+	return m_vecSequences;
+}
+
+inline const std::vector<CIKChain>& CModel::GetIKChains() const
+{
+	return m_vecIKChains;
+}
+
+inline const std::vector<CIKLock>& CModel::GetIKAutoplayLocks() const
+{
+	return m_vecIKAutoplayLocks;
+}
+
+inline const CEventTimeline& CModel::GetEventTimeline() const
+{
+	return m_EventTimeline;
+}
+
+inline const CTransitionGraph& CModel::GetTransitionGraph() const
+{
+	return m_TransitionGraph;
+}
+
+inline const CSkeletonLayout& CModel::GetSkeletonLayout() const
+{
+	return m_SkeletonLayout;
+}
+
+inline const CLoadStats& CModel::LoadStats() const
+{
+	return m_LoadStats;
+}
+
+inline const CModelMemory& CModel::MemoryUsage() const
+{
+	return m_Memory;
+}
+
 inline const std::vector<char>& CModel::GetRawData() const
 {
 	return m_vecRawData;
 }
 
+inline RawDataPolicy_t CModel::RawDataPolicy() const
+{
+	return m_iRawDataPolicy;
+}
+
+inline const studiohdr_t* CModel::StudioHdr() const
+{
+	return m_vecRawData.empty() ? nullptr : reinterpret_cast<const studiohdr_t*>(m_vecRawData.data());
+}
+
 inline const std::string& CModel::Name() const
 {
 	return m_strModelName;
 }
 
+inline const std::string& CModel::FileName() const
+{
+	return m_strFileName;
+}
+
+inline const std::string& CModel::SurfaceProp() const
+{
+	return m_strSurfaceProp;
+}
+
 inline const Vector3D& CModel::HullMins() const
 {
 	return m_hullMins;
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "valve/vector.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ivpcompactledge_t;
+
+class CModel;
+
+// one convex piece of a solid, ranges into the collision model's point and plane arrays
+struct CCollisionHull
+{
+	int m_iFirstPoint;
+	int m_nPoints;
+
+	int m_iFirstPlane;
+	int m_nPlanes;
+
+	Vector m_vecMins;
+	Vector m_vecMaxs;
+};
+
+// a solid's entry in the key value text
+struct CCollisionSolidInfo
+{
+	std::string m_strName;
+	std::string m_strParent;
+	std::string m_strSurfaceProp;
+
+	float m_flMass = 0.0f;
+
+	int m_iBone = -1; // -1 when the name isn't one of the model's bones (static props)
+};
+
+// the collision solids of a model's .phy file. each solid is a set of convex
+// hulls kept as flat x/y/z point and plane arrays, in game units and in the
+// space of the bone the solid is named after (model space when there's none).
+// the key value text is only parsed the first time something asks for it.
+class CCollisionModel
+{
+public:
+	// the .phy next to the model's file. fails if its checksum isn't the model's
+	bool Load(const CModel& model);
+	bool Load(const std::string& filename);
+
+	inline int SolidCount() const;
+	inline int HullCount() const;
+
+	inline int SolidFirstHull(int iSolid) const;
+	inline int SolidHullCount(int iSolid) const;
+
+	inline const CCollisionHull& Hull(int iHull) const;
+
+	inline Vector Point(int iPoint) const;
+	inline Vector PlaneNormal(int iPlane) const;
+	inline float PlaneDist(int iPlane) const;
+
+	inline int Checksum() const;
+	inline const std::string& KeyValues() const;
+
+	// NULL when iSolid is out of range
+	const CCollisionSolidInfo* SolidInfo(int iSolid) const;
+
+	// first solid following the bone, -1 if none does
+	int FindSolid(int iBone) const;
+
+	// whether each point (in the solid's space) is inside any of the solid's hulls
+	void PointsInSolid(int iSolid, const Vector* pPoints, int nPoints, bool* pInside) const;
+
+	// fraction of each ray's delta travelled before it enters the solid, 1 when it
+	// misses and 0 when it starts inside. returns how many rays hit
+	int RaysVsSolid(int iSolid, const Vector* pStarts, const Vector* pDeltas, int nRays, float* pFractions) const;
+
+private:
+	std::vector<int> m_vecSolidHulls{}; // first hull of each solid, plus the end
+	std::vector<CCollisionHull> m_vecHulls{};
+
+	std::vector<float> m_vecPointX{};
+	std::vector<float> m_vecPointY{};
+	std::vector<float> m_vecPointZ{};
+
+	// outward normals, a point is outside a plane when dot(n, p) > d
+	std::vector<float> m_vecPlaneX{};
+	std::vector<float> m_vecPlaneY{};
+	std::vector<float> m_vecPlaneZ{};
+	std::vector<float> m_vecPlaneD{};
+
+	std::string m_strKeyValues{};
+	std::vector<std::string> m_vecBoneNames{}; // lowercase, empty unless loaded with a model
+
+	int m_iChecksum = 0;
+
+	mutable std::mutex m_KeyValuesMutex;
+	mutable bool m_bKeyValuesParsed = false;
+	mutable std::vector<CCollisionSolidInfo> m_vecSolidInfo{};
+
+	bool Decode(const char* pData, size_t nSize);
+	void DecodeLedge(const ivpcompactledge_t* pLedge, const char* pBegin, const char* pEnd);
+	void ParseKeyValues() const;
+};
+
+inline int CCollisionModel::SolidCount() const
+{
+	return m_vecSolidHulls.empty() ? 0 : (int)m_vecSolidHulls.size() - 1;
+}
+
+inline int CCollisionModel::HullCount() const
+{
+	return (int)m_vecHulls.size();
+}
+
+inline int CCollisionModel::SolidFirstHull(int iSolid) const
+{
+	return (iSolid >= 0 && iSolid < SolidCount()) ? m_vecSolidHulls[iSolid] : 0;
+}
+
+inline int CCollisionModel::SolidHullCount(int iSolid) const
+{
+	return (iSolid >= 0 && iSolid < SolidCount()) ? m_vecSolidHulls[iSolid + 1] - m_vecSolidHulls[iSolid] : 0;
+}
+
+inline const CCollisionHull& CCollisionModel::Hull(int iHull) const
+{
+	return m_vecHulls[iHull];
+}
+
+inline Vector CCollisionModel::Point(int iPoint) const
+{
+	return Vector(m_vecPointX[iPoint], m_vecPointY[iPoint], m_vecPointZ[iPoint]);
+}
+
+inline Vector CCollisionModel::PlaneNormal(int iPlane) const
+{
+	return Vector(m_vecPlaneX[iPlane], m_vecPlaneY[iPlane], m_vecPlaneZ[iPlane]);
+}
+
+inline float CCollisionModel::PlaneDist(int iPlane) const
+{
+	return m_vecPlaneD[iPlane];
+}
+
+inline int CCollisionModel::Checksum() const
+{
+	return m_iChecksum;
+}
+
+inline const std::string& CCollisionModel::KeyValues() const
+{
+	return m_strKeyValues;
+}
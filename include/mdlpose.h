@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+
+class CModel;
+struct CBonePose;
+
+#define POSE_CONTROLLER_INPUTS 5 // MAXSTUDIOBONECTRLS user set inputs, then the mouth
+
+// turns pose parameter and bone controller inputs, given in their own units,
+// into the normalized 0..1 values the engine keeps per entity, and applies the
+// controllers' bone adjustments to poses. the ranges are flattened at load so
+// a batch of entities runs straight through without allocating.
+class CPoseEvaluator
+{
+public:
+	CPoseEvaluator(const CModel& model);
+
+	// [entity * PoseParameterCount() + param]. looping parameters are wrapped into their range first
+	void NormalizePoseParameters(const float* pValues, float* pNormalized, int nEntities) const;
+
+	// back to the parameters' units, as CBlendSpace and CRootMotion take them
+	void DecodePoseParameters(const float* pNormalized, float* pValues, int nEntities) const;
+
+	// [entity * POSE_CONTROLLER_INPUTS + input], snapped to the 8 bit steps the engine stores them in.
+	// inputs no controller reads come out as 0
+	void EncodeControllers(const float* pValues, float* pNormalized, int nEntities) const;
+
+	// rotates/translates the controlled bones of one pose per entity. only bones whose
+	// flags share a bit with iBoneMask are touched, the default touches every bone
+	void ApplyControllers(const float* pNormalized, CBonePose* pPoses, int nEntities, int iBoneMask = ~0) const;
+
+	inline int PoseParameterCount() const;
+	inline int ControllerCount() const;
+
+private:
+	struct CController
+	{
+		int m_iBone;
+		int m_iBoneFlags;
+		int m_iInput;
+
+		int m_iAxis;		// 0..2, -1 for types the engine doesn't apply
+		bool m_bRotation;
+
+		float m_flStart;
+		float m_flEnd;
+	};
+
+	// per pose parameter
+	std::vector<float> m_vecPoseStart{};
+	std::vector<float> m_vecPoseRange{};	// end - start
+	std::vector<float> m_vecPoseScale{};	// 1 / range, 0 when the range is empty
+	std::vector<float> m_vecPoseLoop{};
+	std::vector<float> m_vecPoseShift{};
+
+	std::vector<CController> m_vecControllers{};
+
+	// controller that encodes each input, the first one reading it as in the engine. -1 if none
+	int m_iInputController[POSE_CONTROLLER_INPUTS];
+};
+
+inline int CPoseEvaluator::PoseParameterCount() const
+{
+	return (int)m_vecPoseStart.size();
+}
+
+inline int CPoseEvaluator::ControllerCount() const
+{
+	return (int)m_vecControllers.size();
+}
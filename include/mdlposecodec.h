@@ -0,0 +1,79 @@
+#pragma once
+
+#include "mdlskeleton.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CModel;
+struct CBonePose;
+
+#define POSECODEC_ROTATION_BITS 10 // per smallest three component, at most 10
+
+// a pose after quantization. sender and receiver both keep these for the ticks
+// they may delta against, so a baseline means exactly the same values on either side
+struct CQuantizedPose
+{
+	std::vector<uint32_t> m_vecRotations;	// index of the dropped component in the top two bits, the other three below
+	std::vector<int16_t> m_vecPositions;	// x, y, z per bone, posscale steps from the bone's default position
+};
+
+// quantizes and bit packs the local pose of one model's bones for network
+// replication. rotations are sent as their three smallest components and
+// positions as posscale steps from the bone's default position, the resolution
+// the animations were compiled at, so a sampled pose round trips exactly. an
+// axis without posscale is never animated and isn't sent. a packet is either
+// a full snapshot or a delta against a baseline both ends have, in which a bone
+// that didn't move costs two bits and small moves are sent as offsets.
+class CPoseCodec
+{
+public:
+	// encodes the bones in the mask (every bone by default), parents first
+	CPoseCodec(const CModel& model, int iRotationBits = POSECODEC_ROTATION_BITS);
+	CPoseCodec(const CModel& model, const CBoneMask& mask, int iRotationBits = POSECODEC_ROTATION_BITS);
+
+	inline int BoneCount() const;
+	inline const std::vector<int>& Bones() const;
+
+	void Quantize(const CBonePose& pose, CQuantizedPose& out) const;
+
+	// only the encoded bones are written, the rest of the pose is left alone
+	void Dequantize(const CQuantizedPose& in, CBonePose& pose) const;
+
+	// appends a packet. a full snapshot when pBaseline is NULL (or isn't a pose of this codec)
+	void Write(const CQuantizedPose& pose, const CQuantizedPose* pBaseline, std::vector<unsigned char>& vecOut) const;
+
+	// false when the packet is truncated, or is a delta and there's no usable baseline
+	bool Read(const unsigned char* pData, size_t nSize, const CQuantizedPose* pBaseline, CQuantizedPose& out) const;
+
+private:
+	std::vector<int> m_vecBones{};
+
+	// per encoded bone, padded to a multiple of four. inverse scale is 0 for axes that aren't sent
+	std::vector<float> m_vecBase[3];
+	std::vector<float> m_vecScale[3];
+	std::vector<float> m_vecInvScale[3];
+
+	std::vector<unsigned char> m_vecAxes{}; // bit per axis that is sent
+
+	int m_iRotationBits = POSECODEC_ROTATION_BITS;
+
+	void Init(const CModel& model, const CBoneMask& mask, int iRotationBits);
+	inline bool IsPose(const CQuantizedPose* pPose) const;
+};
+
+inline int CPoseCodec::BoneCount() const
+{
+	return (int)m_vecBones.size();
+}
+
+inline const std::vector<int>& CPoseCodec::Bones() const
+{
+	return m_vecBones;
+}
+
+inline bool CPoseCodec::IsPose(const CQuantizedPose* pPose) const
+{
+	return pPose && pPose->m_vecRotations.size() == m_vecBones.size() && pPose->m_vecPositions.size() == m_vecBones.size() * 3;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "valve/vector.h"
+
+#include <vector>
+
+class CModel;
+
+// procedural helper bones (twist, corrective and aim bones) evaluated on bone
+// to world matrices once forward kinematics is done. the rules are decoded at
+// load into one array per type so each kernel runs straight through its own
+// array. a rule that reads another procedural bone goes into a later pass.
+class CProceduralBones
+{
+public:
+	CProceduralBones(const CModel& model);
+
+	// one bone to world array per entity. only the procedural bones are written, anything
+	// parented to them has to be built afterwards (they're leaves on nearly every model)
+	void Evaluate(matrix3x4_t* const* ppBoneToWorld, int nEntities) const;
+
+	inline int RuleCount() const;
+	inline int PassCount() const;
+
+	// jiggle bones need a simulation over time, they're listed but never evaluated
+	inline const std::vector<int>& JiggleBones() const;
+
+private:
+	struct CAxisInterpRule
+	{
+		int m_iBone;
+		int m_iParent;
+		int m_iControl;
+		int m_iControlParent;
+		int m_iAxis;
+
+		Vector m_pos[6];		// X+, X-, Y+, Y-, Z+, Z-
+		Quaternion m_quat[6];
+	};
+
+	struct CQuatTrigger
+	{
+		float m_flInvTolerance;
+		Quaternion m_qTrigger;
+		Vector m_vecPos;
+		Quaternion m_q;
+	};
+
+	struct CQuatInterpRule
+	{
+		int m_iBone;
+		int m_iParent;
+		int m_iControl;
+		int m_iControlParent;
+
+		int m_iFirstTrigger; // into m_vecTriggers
+		int m_iTriggerCount;
+	};
+
+	struct CAimAtRule
+	{
+		int m_iBone;
+		int m_iParent;
+		int m_iAimBone;			// the bone aimed at, or the attachment's bone
+
+		bool m_bAttachment;
+		matrix3x4_t m_matAttachment;
+
+		Vector m_vecAim;
+		Vector m_vecUp;
+		Vector m_vecBasePos;
+	};
+
+	// [first, end) of each type's rules
+	struct CPass
+	{
+		int m_iAxisInterp[2];
+		int m_iQuatInterp[2];
+		int m_iAimAt[2];
+	};
+
+	std::vector<CAxisInterpRule> m_vecAxisInterp{};
+	std::vector<CQuatInterpRule> m_vecQuatInterp{};
+	std::vector<CQuatTrigger> m_vecTriggers{};
+	std::vector<CAimAtRule> m_vecAimAt{};
+	std::vector<int> m_vecJiggleBones{};
+
+	std::vector<CPass> m_vecPasses{};
+
+	void EvaluateAxisInterp(int iFirst, int iEnd, matrix3x4_t* const* ppBoneToWorld, int nEntities) const;
+	void EvaluateQuatInterp(int iFirst, int iEnd, matrix3x4_t* const* ppBoneToWorld, int nEntities) const;
+	void EvaluateAimAt(int iFirst, int iEnd, matrix3x4_t* const* ppBoneToWorld, int nEntities) const;
+};
+
+inline int CProceduralBones::RuleCount() const
+{
+	return (int)(m_vecAxisInterp.size() + m_vecQuatInterp.size() + m_vecAimAt.size());
+}
+
+inline int CProceduralBones::PassCount() const
+{
+	return (int)m_vecPasses.size();
+}
+
+inline const std::vector<int>& CProceduralBones::JiggleBones() const
+{
+	return m_vecJiggleBones;
+}
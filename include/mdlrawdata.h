@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+// how much of the file a CModel keeps after decoding it
+enum RawDataPolicy_t
+{
+	RAWDATA_KEEP_ALL = 0,	// the whole file
+	RAWDATA_COMPACT,		// what's still read after load, see Studio_CompactRawData()
+	RAWDATA_DROP,			// nothing, StudioHdr() is NULL and only the decoded data is left
+};
+
+// what still reads the header after load, and so does nothing under RAWDATA_DROP:
+//	animation sampling (Studio_CalcAnimation, CVirtualModel, and CBlendSpace and
+//	CModelInstances, which fall back to rest poses), CAnimBlockCache, CRootMotion
+//	(no movement), CProceduralBones (no rules), CBoneMergeCache, CPoseCodec, and
+//	CSkinnedMesh and CCollisionModel, which check the companion files' checksums
+//	against it. bone counts, the hierarchy and rest poses come from
+//	GetSkeletonLayout() and work without it
+
+// copies a .mdl without the sections CModel decodes completely at load (textures,
+// skins, hitboxes, bone controllers, flex descs/controllers/rules/ui and mesh vertex
+// animation) or never reads (the studiohdr2 extension with its src bone transforms,
+// linear bone table and bone flex drivers), rebasing the offsets of everything
+// kept. bones, animations, sequences, attachments, pose parameters, ik chains,
+// includes, transitions and body parts down to meshes stay readable through the
+// header. dropped bytes come out in whole 16 byte steps so what's kept stays
+// aligned, the few left over from each run of dropped sections are zeroed. false
+// when the file's sections don't add up, vecOut is untouched then
+bool Studio_CompactRawData(const std::vector<char>& vecIn, std::vector<char>& vecOut);
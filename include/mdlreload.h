@@ -0,0 +1,151 @@
+#pragma once
+
+#include "mdlrawdata.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class CModel;
+
+// called on the thread running Poll() after a watched model's files change.
+// strChanged is the file that was written: the .mdl itself, in which case pModel
+// is the freshly loaded model, or a companion (.vvd, .vtx, .phy, .ani) that's
+// for the listener to re-read, pModel is the unchanged current model then
+typedef void (*ModelReloadFn)(void* pUser, const std::string& filename, const std::string& strChanged, const std::shared_ptr<const CModel>& pModel);
+
+// a model kept current by CModelReloader. Get() is a lock free read of whichever
+// model was swapped in last, the old one lives on for as long as someone holds it
+class CWatchedModel
+{
+public:
+	inline std::shared_ptr<const CModel> Get() const;
+	inline const std::string& FileName() const;
+
+private:
+	friend class CModelReloader;
+
+	std::string m_strFileName{};
+	std::string m_strDirectory{};
+	std::string m_strStem{};	// file name up to the extension, companions share it
+
+	std::shared_ptr<const CModel> m_pModel{};
+
+	// of the file the current model was read from, a write leaving both alone isn't reloaded
+	int m_iChecksum = 0;
+	int m_iLength = 0;
+};
+
+inline std::shared_ptr<const CModel> CWatchedModel::Get() const
+{
+	return std::atomic_load(&m_pModel);
+}
+
+inline const std::string& CWatchedModel::FileName() const
+{
+	return m_strFileName;
+}
+
+// hot reload for models being worked on: watches the directories of loaded models
+// (inotify on linux, modification times elsewhere), re-reads a .mdl when it's
+// rewritten with a different checksum or length and swaps it in, and tells
+// listeners about the model and its companion files changing.
+class CModelReloader
+{
+public:
+	CModelReloader(RawDataPolicy_t iRawDataPolicy = RAWDATA_KEEP_ALL);
+	~CModelReloader();
+
+	CModelReloader(const CModelReloader&) = delete;
+	CModelReloader& operator=(const CModelReloader&) = delete;
+
+	// loads and starts watching filename, or returns it if it's already watched.
+	// NULL if it can't be read
+	std::shared_ptr<const CWatchedModel> Watch(const std::string& filename);
+	void Unwatch(const std::string& filename);
+
+	// the current model, NULL if filename isn't watched
+	std::shared_ptr<const CModel> Get(const std::string& filename);
+
+	void AddListener(ModelReloadFn pfnListener, void* pUser);
+	void RemoveListener(ModelReloadFn pfnListener, void* pUser);
+
+	// handles the file changes waiting, waiting up to iTimeoutMs for the first.
+	// returns the number of models swapped
+	int Poll(int iTimeoutMs = 0);
+
+	// Poll()s on a background thread until Stop()
+	void Start();
+	void Stop();
+
+	inline uint64_t ReloadCount() const;
+	inline uint64_t SkipCount() const;	// .mdl writes (or rechecks after lost events) that left checksum and length alone
+
+private:
+	struct CListener
+	{
+		ModelReloadFn m_pfnListener;
+		void* m_pUser;
+	};
+
+	struct CChange
+	{
+		std::shared_ptr<CWatchedModel> m_pWatched;
+		std::string m_strChanged;
+	};
+
+	RawDataPolicy_t m_iRawDataPolicy;
+
+	std::mutex m_Mutex;
+	std::unordered_map<std::string, std::shared_ptr<CWatchedModel>> m_Models{}; // keyed by canonical path
+	std::vector<CListener> m_vecListeners{};
+
+	// directory -> watch descriptor and the number of models in it
+	std::unordered_map<std::string, std::pair<int, int>> m_Directories{};
+
+	// models added after their file may have changed, Poll() rechecks them
+	std::vector<std::shared_ptr<CWatchedModel>> m_vecRechecks{};
+
+#ifdef __linux__
+	int m_iNotify = -1;
+#else
+	std::unordered_map<std::string, int64_t> m_WriteTimes{}; // file -> last write time seen
+#endif
+
+	std::mutex m_PollMutex;	// one Poll() at a time
+
+	std::thread m_Thread;
+	std::atomic<bool> m_bStop{ false };
+
+	std::atomic<uint64_t> m_nReloads{ 0 };
+	std::atomic<uint64_t> m_nSkips{ 0 };
+
+	// true for the directory's first model. both are called with m_Mutex held
+	bool WatchDirectory(const std::string& strDirectory);
+	void UnwatchDirectory(const std::string& strDirectory);
+
+#ifndef __linux__
+	void RecordWriteTimes(const std::string& strDirectory);
+#endif
+
+	void FindChanges(int iTimeoutMs, std::vector<CChange>& vecChanges);
+	void AddChange(const std::string& strDirectory, const std::string& strName, std::vector<CChange>& vecChanges);
+
+	bool Reload(CWatchedModel& watched);
+	void Notify(const CWatchedModel& watched, const std::string& strChanged);
+};
+
+inline uint64_t CModelReloader::ReloadCount() const
+{
+	return m_nReloads.load();
+}
+
+inline uint64_t CModelReloader::SkipCount() const
+{
+	return m_nSkips.load();
+}
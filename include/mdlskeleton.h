@@ -0,0 +1,134 @@
+#pragma once
+
+#include "valve/vector.h"
+
+#include <bitset>
+#include <vector>
+
+struct studiohdr_t;
+
+#define SKELETON_MAX_BONES 128 // MAXSTUDIOBONES
+
+typedef std::bitset<SKELETON_MAX_BONES> CBoneMask;
+
+// bone hierarchy worked out once per model. bones are ordered by depth so
+// every parent comes before its children and each depth is one contiguous
+// run (the bones of a level only read the level above, so a level can be
+// built in parallel). masks say which bones a query needs, always with
+// their ancestors included so they can be built on their own.
+class CSkeletonLayout
+{
+public:
+	bool Build(const studiohdr_t* pMdl);
+
+	inline int BoneCount() const;
+	inline int Parent(int iBone) const;
+	inline int Depth(int iBone) const;
+	inline int Flags(int iBone) const;
+
+	// the bone's default local transform, kept so rest poses don't need the header
+	inline const Quaternion& RestRotation(int iBone) const;
+	inline const Vector& RestPosition(int iBone) const;
+
+	// every bone, parents first
+	inline const std::vector<int>& Order() const;
+
+	// bones at iDepth are Order()[LevelStart(iDepth)] up to Order()[LevelStart(iDepth + 1)]
+	inline int LevelCount() const;
+	inline int LevelStart(int iDepth) const;
+
+	// bones used by a hitbox set's boxes, or by all sets when iSet is -1
+	CBoneMask HitboxMask(int iSet = -1) const;
+	inline const CBoneMask& AttachmentMask() const;
+
+	// bones whose studio flags (BONE_USED_BY_...) share a bit with iFlags
+	CBoneMask FlagMask(int iFlags) const;
+
+	inline const CBoneMask& AllBones() const;
+
+	// adds the ancestors of every bone in the mask
+	CBoneMask WithAncestors(const CBoneMask& mask) const;
+
+	// bones in the mask, parents first
+	void OrderedBones(const CBoneMask& mask, std::vector<int>& vecBones) const;
+
+	// heap bytes held
+	size_t MemoryUsage() const;
+
+private:
+	struct CBoneInfo
+	{
+		int m_iParent;
+		int m_iDepth;
+		int m_iFlags;
+
+		Quaternion m_qRest;
+		Vector m_vecRest;
+	};
+
+	std::vector<CBoneInfo> m_vecBones{};
+	std::vector<int> m_vecOrder{};
+	std::vector<int> m_vecLevels{}; // start of each depth in m_vecOrder, plus the end
+
+	std::vector<CBoneMask> m_vecHitboxMasks{};	// per set, then the union of them all
+	CBoneMask m_AttachmentMask{};
+	CBoneMask m_AllBones{};
+};
+
+inline int CSkeletonLayout::BoneCount() const
+{
+	return (int)m_vecBones.size();
+}
+
+inline int CSkeletonLayout::Parent(int iBone) const
+{
+	return (iBone >= 0 && iBone < BoneCount()) ? m_vecBones[iBone].m_iParent : -1;
+}
+
+inline int CSkeletonLayout::Depth(int iBone) const
+{
+	return (iBone >= 0 && iBone < BoneCount()) ? m_vecBones[iBone].m_iDepth : -1;
+}
+
+inline int CSkeletonLayout::Flags(int iBone) const
+{
+	return (iBone >= 0 && iBone < BoneCount()) ? m_vecBones[iBone].m_iFlags : 0;
+}
+
+inline const Quaternion& CSkeletonLayout::RestRotation(int iBone) const
+{
+	return m_vecBones[iBone].m_qRest;
+}
+
+inline const Vector& CSkeletonLayout::RestPosition(int iBone) const
+{
+	return m_vecBones[iBone].m_vecRest;
+}
+
+inline const std::vector<int>& CSkeletonLayout::Order() const
+{
+	return m_vecOrder;
+}
+
+inline int CSkeletonLayout::LevelCount() const
+{
+	return m_vecLevels.empty() ? 0 : (int)m_vecLevels.size() - 1;
+}
+
+inline int CSkeletonLayout::LevelStart(int iDepth) const
+{
+	if (iDepth <= 0)
+		return 0;
+
+	return iDepth < (int)m_vecLevels.size() ? m_vecLevels[iDepth] : (int)m_vecOrder.size();
+}
+
+inline const CBoneMask& CSkeletonLayout::AttachmentMask() const
+{
+	return m_AttachmentMask;
+}
+
+inline const CBoneMask& CSkeletonLayout::AllBones() const
+{
+	return m_AllBones;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// the parts of CModel's load that get timed when the library is built with MDL_LOAD_STATS
+enum LoadPhase_t
+{
+	LOADPHASE_READ = 0,		// reading the file
+	LOADPHASE_COPY,			// copying it into the raw buffer
+	LOADPHASE_TEXTURES,
+	LOADPHASE_BONES,
+	LOADPHASE_CONTROLLERS,
+	LOADPHASE_BODYPARTS,
+	LOADPHASE_POSEPARAMS,
+	LOADPHASE_ANIMATIONS,
+	LOADPHASE_SEQUENCES,
+	LOADPHASE_IK,
+	LOADPHASE_HITBOXSETS,
+	LOADPHASE_ATTACHMENTS,
+	LOADPHASE_FLEX,
+	LOADPHASE_DERIVED,		// flex program, event timeline, transition graph, skeleton layout
+	LOADPHASE_COMPACT,		// applying the raw data policy
+
+	LOADPHASE_COUNT
+};
+
+const char* LoadPhaseName(int iPhase);
+
+// where a load's time and allocations went. stays zero unless the library is
+// built with MDL_LOAD_STATS, the timers aren't compiled in otherwise
+struct CLoadStats
+{
+	int64_t m_nPhaseNs[LOADPHASE_COUNT] = {};
+	int64_t m_nPhaseAllocs[LOADPHASE_COUNT] = {};		// CountLoadAllocation() calls
+	int64_t m_nPhaseAllocBytes[LOADPHASE_COUNT] = {};
+
+	int64_t m_nFileBytes = 0;
+	int m_nModels = 0; // loads added up into these stats
+
+	int64_t TotalNs() const;
+	int64_t TotalAllocs() const;
+	int64_t TotalAllocBytes() const;
+
+	CLoadStats& operator+=(const CLoadStats& other);
+};
+
+// adds an allocation to the load running on this thread, if any. the library leaves
+// the global allocator alone: an application wanting allocation counts includes
+// mdlstats_new.h in one of its own source files, or calls this from its allocator
+void CountLoadAllocation(size_t nSize);
+
+// gets every timed phase, on whichever thread did the load. times are in
+// nanoseconds from an arbitrary point fixed for the process
+typedef void (*LoadTraceFn)(void* pUser, const std::string& filename, int iPhase, int64_t nStartNs, int64_t nDurationNs);
+
+// one sink for the whole process, NULL removes it. only the loads that start afterwards
+// see it, and loads keep the sink they started with until they finish, so this waits for
+// the running ones before returning. once it has, the old sink isn't called again and
+// pUser can be freed. it mustn't be called from inside a sink, which would wait on itself
+void SetLoadTraceSink(LoadTraceFn pfnSink, void* pUser);
+
+// a sink writing Chrome's trace event JSON, for chrome://tracing or Perfetto:
+//   SetLoadTraceSink(&CChromeTraceFile::Sink, &trace);
+// take it out with SetLoadTraceSink(NULL, NULL) before the trace is destroyed
+class CChromeTraceFile
+{
+public:
+	~CChromeTraceFile();
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	static void Sink(void* pUser, const std::string& filename, int iPhase, int64_t nStartNs, int64_t nDurationNs);
+
+private:
+	std::mutex m_Mutex;
+	FILE* m_pFile = nullptr;
+	bool m_bFirst = true;
+};
+
+#ifdef MDL_LOAD_STATS
+
+// times consecutive phases of one load: each Next() ends the running phase and
+// starts another, the last one ends with End() or the clock
+class CLoadPhaseClock
+{
+public:
+	CLoadPhaseClock(CLoadStats& stats, const std::string& filename);
+	~CLoadPhaseClock();
+
+	void Next(int iPhase);
+	void End();
+
+private:
+	CLoadStats& m_Stats;
+	const std::string& m_strFileName;
+
+	LoadTraceFn m_pfnSink;
+	void* m_pSinkUser;
+	uint64_t m_iSinkGeneration;
+
+	int m_iPhase = -1;
+	int64_t m_nStartNs = 0;
+	int64_t m_nStartAllocs = 0;
+	int64_t m_nStartAllocBytes = 0;
+};
+
+#define MDL_LOAD_CLOCK(stats, filename) CLoadPhaseClock loadClock(stats, filename)
+#define MDL_LOAD_PHASE(iPhase) loadClock.Next(iPhase)
+#define MDL_LOAD_PHASE_END() loadClock.End()
+
+#else
+
+#define MDL_LOAD_CLOCK(stats, filename)
+#define MDL_LOAD_PHASE(iPhase)
+#define MDL_LOAD_PHASE_END()
+
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "mdlstats.h"
+
+#include <cstdlib>
+#include <new>
+
+// replacement global operator new and delete that feed CountLoadAllocation(), for
+// CLoadStats' allocation counts. replacing them is the application's call, not the
+// library's, so include this in exactly one of the application's source files, and
+// not at all when something else already replaces them. aligned forms aren't counted
+
+void* operator new(std::size_t nSize)
+{
+	CountLoadAllocation(nSize);
+
+	for (;;)
+	{
+		if (void* p = std::malloc(nSize ? nSize : 1))
+			return p;
+
+		std::new_handler pfnHandler = std::get_new_handler();
+		if (!pfnHandler)
+			throw std::bad_alloc();
+
+		pfnHandler();
+	}
+}
+
+void* operator new[](std::size_t nSize)
+{
+	return operator new(nSize);
+}
+
+void* operator new(std::size_t nSize, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(nSize);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t nSize, const std::nothrow_t&) noexcept
+{
+	return operator new(nSize, std::nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
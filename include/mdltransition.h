@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct studiohdr_t;
+
+// the sequence node graph with the next step between every pair of nodes
+// resolved at load, so picking a transition sequence is a single table read.
+// the steps are studiomdl's own next node table, routes follow it exactly as
+// the engine does. nodes are numbered from 1 as in the file, 0 means a
+// sequence has no node.
+class CTransitionGraph
+{
+public:
+	bool Build(const studiohdr_t* pMdl);
+
+	// next sequence to play on the way from iCurrent to iGoal, iGoal itself when
+	// it can be blended to directly. iDir is the direction iCurrent is playing in
+	// (1 forward, -1 reversed) and receives the direction to play the result in.
+	int FindTransition(int iCurrent, int iGoal, int& iDir) const;
+
+	// next node on the way between two nodes, 0 when they aren't connected
+	inline int NextNode(int iFrom, int iTo) const;
+
+	inline int EntryNode(int iSequence) const;
+	inline int ExitNode(int iSequence) const;
+
+	inline int NodeCount() const;
+	inline const std::string& NodeName(int iNode) const;
+
+	// heap bytes held
+	size_t MemoryUsage() const;
+
+private:
+	struct CRoute
+	{
+		int m_iSequence;	// -1 when no sequence connects to the next node
+		int m_iDir;
+	};
+
+	struct CSequenceNodes
+	{
+		int m_iEntry;
+		int m_iExit;
+		bool m_bReversible;
+	};
+
+	int m_iNodeCount = 0;
+
+	std::vector<std::string> m_vecNodeNames{};
+	std::vector<CSequenceNodes> m_vecSequences{};
+
+	// [(from - 1) * m_iNodeCount + (to - 1)]
+	std::vector<int> m_vecNextNode{};
+	std::vector<CRoute> m_vecRoutes{};
+};
+
+inline int CTransitionGraph::NextNode(int iFrom, int iTo) const
+{
+	if (iFrom < 1 || iFrom > m_iNodeCount || iTo < 1 || iTo > m_iNodeCount)
+		return 0;
+
+	return m_vecNextNode[(iFrom - 1) * m_iNodeCount + (iTo - 1)];
+}
+
+inline int CTransitionGraph::EntryNode(int iSequence) const
+{
+	return (iSequence >= 0 && iSequence < (int)m_vecSequences.size()) ? m_vecSequences[iSequence].m_iEntry : 0;
+}
+
+inline int CTransitionGraph::ExitNode(int iSequence) const
+{
+	return (iSequence >= 0 && iSequence < (int)m_vecSequences.size()) ? m_vecSequences[iSequence].m_iExit : 0;
+}
+
+inline int CTransitionGraph::NodeCount() const
+{
+	return m_iNodeCount;
+}
+
+inline const std::string& CTransitionGraph::NodeName(int iNode) const
+{
+	static const std::string strEmpty;
+	return (iNode >= 1 && iNode <= m_iNodeCount) ? m_vecNodeNames[iNode - 1] : strEmpty;
+}
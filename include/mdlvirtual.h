@@ -0,0 +1,165 @@
+#pragma once
+
+#include "mdlstats.h"
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CModel;
+struct CAnimDesc;
+struct CSequence;
+struct CPoseParameter;
+struct CBonePose;
+
+// bone indices between a model and one of its includes, -1 where a bone only exists on one side
+struct CBoneRemap
+{
+	std::vector<int> m_vecToMaster;		// include bone -> model bone
+	std::vector<int> m_vecFromMaster;	// model bone -> include bone
+};
+
+// include models shared between every model that names them. each file is
+// loaded once, and the by name bone remap between a model and an include is
+// worked out the first time the pair is seen. safe to use from several threads.
+class CModelCache
+{
+public:
+	// the model at filename, loaded on first use. NULL if it couldn't be read. threads
+	// loading different models don't wait for each other
+	std::shared_ptr<const CModel> Load(const std::string& filename);
+
+	// an include named relative to the game directory, looked for with FindGameFile() from model's file
+	std::shared_ptr<const CModel> LoadInclude(const CModel& model, const std::string& strName);
+
+	const CBoneRemap& BoneRemap(const CModel& model, const CModel& include);
+
+	int ModelCount();
+	void Clear();
+
+	// load stats of every model the cache has loaded, including ones since cleared
+	CLoadStats LoadStats();
+
+private:
+	std::mutex m_Mutex;
+	CLoadStats m_LoadStats{};
+
+	// keyed by canonical path, failed loads are kept as NULL so they aren't retried.
+	// an entry is added when its load starts, anyone else wanting it waits on it
+	std::unordered_map<std::string, std::shared_future<std::shared_ptr<const CModel>>> m_Models{};
+	std::unordered_map<std::string, std::unique_ptr<CBoneRemap>> m_Remaps{};
+};
+
+// a sequence or animation of the merged model, index is local to the group's model
+struct CVirtualIndex
+{
+	int m_iGroup;
+	int m_iIndex;
+};
+
+// a model merged with every model it includes (and those include) into one
+// sequence, animation and pose parameter index space. group 0 is the model
+// itself and keeps its own indices. same named sequences and animations resolve
+// to the first group that has them, except sequences that group only forward
+// declares (STUDIO_OVERRIDE). the model and cache have to outlive it.
+class CVirtualModel
+{
+public:
+	CVirtualModel(const CModel& model, CModelCache& cache);
+
+	inline int GroupCount() const;
+	inline const CModel& GroupModel(int iGroup) const;
+	inline const CBoneRemap* GroupBoneRemap(int iGroup) const; // NULL for group 0
+
+	inline int SequenceCount() const;
+	inline int AnimationCount() const;
+	inline int PoseParameterCount() const;
+
+	inline const CVirtualIndex& Sequence(int iSequence) const;
+	inline const CVirtualIndex& Animation(int iAnim) const;
+
+	const CSequence* SequenceDesc(int iSequence) const;
+	const CAnimDesc* AnimDesc(int iAnim) const;
+	const CPoseParameter* PoseParameter(int iParam) const;
+
+	// -1 when there's no such name
+	int FindSequence(const std::string& strLabel) const;
+	int FindAnimation(const std::string& strName) const;
+	int FindPoseParameter(const std::string& strName) const;
+
+	// group local indices (a sequence's m_vecAnims, m_iParamIndex, ...) to merged ones, -1 when out of range
+	int GroupAnimation(int iGroup, int iAnim) const;
+	int GroupPoseParameter(int iGroup, int iParam) const;
+	int GroupBone(int iGroup, int iBone) const;
+
+	// samples a merged animation into the model's skeleton. bones the animation's
+	// model doesn't have keep their default (or identity for delta animations)
+	bool CalcAnimation(int iAnim, float flCycle, CBonePose& pose) const;
+
+private:
+	struct CGroup
+	{
+		const CModel* m_pModel;
+		const CBoneRemap* m_pBoneRemap;
+
+		std::vector<int> m_vecAnims{};	// local animation -> merged
+		std::vector<int> m_vecParams{};	// local pose parameter -> merged
+	};
+
+	std::vector<CGroup> m_vecGroups{};
+	std::vector<std::shared_ptr<const CModel>> m_vecIncludes{};
+
+	std::vector<CVirtualIndex> m_vecSequences{};
+	std::vector<CVirtualIndex> m_vecAnims{};
+	std::vector<CVirtualIndex> m_vecParams{};
+
+	// lowercase name -> merged index
+	std::unordered_map<std::string, int> m_SequenceNames{};
+	std::unordered_map<std::string, int> m_AnimNames{};
+	std::unordered_map<std::string, int> m_ParamNames{};
+
+	void AddGroup(const CModel& model, const CBoneRemap* pRemap);
+};
+
+inline int CVirtualModel::GroupCount() const
+{
+	return (int)m_vecGroups.size();
+}
+
+inline const CModel& CVirtualModel::GroupModel(int iGroup) const
+{
+	return *m_vecGroups[iGroup].m_pModel;
+}
+
+inline const CBoneRemap* CVirtualModel::GroupBoneRemap(int iGroup) const
+{
+	return m_vecGroups[iGroup].m_pBoneRemap;
+}
+
+inline int CVirtualModel::SequenceCount() const
+{
+	return (int)m_vecSequences.size();
+}
+
+inline int CVirtualModel::AnimationCount() const
+{
+	return (int)m_vecAnims.size();
+}
+
+inline int CVirtualModel::PoseParameterCount() const
+{
+	return (int)m_vecParams.size();
+}
+
+inline const CVirtualIndex& CVirtualModel::Sequence(int iSequence) const
+{
+	return m_vecSequences[iSequence];
+}
+
+inline const CVirtualIndex& CVirtualModel::Animation(int iAnim) const
+{
+	return m_vecAnims[iAnim];
+}
@@ -2,6 +2,10 @@
 
 #pragma once
 
+#include "vector.h"
+#include <cmath>
+#include <cstdint>
+
 const int float32bias = 127;
 const int float16bias = 15;
 
@@ -210,4 +214,135 @@ protected:
 
 
 	float16bits m_storage;
-};
\ No newline at end of file
+};
+
+//=========================================================
+// 48 bit Vector, fp16 components
+//=========================================================
+
+class Vector48
+{
+public:
+	// Construction/destruction:
+	Vector48(void) {}
+	Vector48(vec_t X, vec_t Y, vec_t Z) { x.SetFloat(X); y.SetFloat(Y); z.SetFloat(Z); }
+
+	// assignment
+	Vector48& operator=(const Vector& vOther);
+	operator Vector();
+
+	const float operator[](int i) const { return (((float16*)this)[i]).GetFloat(); }
+
+	float16 x;
+	float16 y;
+	float16 z;
+};
+
+inline Vector48& Vector48::operator=(const Vector& vOther)
+{
+	x.SetFloat(vOther.x);
+	y.SetFloat(vOther.y);
+	z.SetFloat(vOther.z);
+	return *this;
+}
+
+inline Vector48::operator Vector()
+{
+	Vector tmp;
+
+	tmp.x = x.GetFloat();
+	tmp.y = y.GetFloat();
+	tmp.z = z.GetFloat();
+
+	return tmp;
+}
+
+//=========================================================
+// 48 bit Quaternion
+//=========================================================
+
+class Quaternion48
+{
+public:
+	// Construction/destruction:
+	Quaternion48(void) {}
+
+	operator Quaternion();
+
+	unsigned short x : 16;
+	unsigned short y : 16;
+	unsigned short z : 15;
+	unsigned short wneg : 1;
+};
+
+inline Quaternion48::operator Quaternion()
+{
+	Quaternion tmp;
+
+	tmp.x = ((int)x - 32768) * (1 / 32768.0);
+	tmp.y = ((int)y - 32768) * (1 / 32768.0);
+	tmp.z = ((int)z - 16384) * (1 / 16384.0);
+	tmp.w = sqrt(1 - tmp.x * tmp.x - tmp.y * tmp.y - tmp.z * tmp.z);
+	if (wneg)
+		tmp.w = -tmp.w;
+	return tmp;
+}
+
+//=========================================================
+// 64 bit Quaternion
+//=========================================================
+
+class Quaternion64
+{
+public:
+	// Construction/destruction:
+	Quaternion64(void) {}
+
+	operator Quaternion();
+
+	uint64_t x : 21;
+	uint64_t y : 21;
+	uint64_t z : 21;
+	uint64_t wneg : 1;
+};
+
+inline Quaternion64::operator Quaternion()
+{
+	Quaternion tmp;
+
+	// shift to -1048576, + 1048575, then round down slightly to -1.0 < x < 1.0
+	tmp.x = ((int)x - 1048576) * (1 / 1048576.5f);
+	tmp.y = ((int)y - 1048576) * (1 / 1048576.5f);
+	tmp.z = ((int)z - 1048576) * (1 / 1048576.5f);
+	tmp.w = sqrt(1 - tmp.x * tmp.x - tmp.y * tmp.y - tmp.z * tmp.z);
+	if (wneg)
+		tmp.w = -tmp.w;
+	return tmp;
+}
+
+// Bulk conversion between half and single precision floats. The fastest kernel the
+// host supports (AVX2, F16C, SSE2) is picked at runtime; every path produces the
+// same bits as float16::GetFloat()/SetFloat().
+void ConvertFloat16ToFloat32(const unsigned short* pIn, float* pOut, int nCount);
+void ConvertFloat32ToFloat16(const float* pIn, unsigned short* pOut, int nCount);
+
+// one of the kernels above, for checking and timing them one by one
+struct CFloat16Kernel
+{
+	const char* m_pszName;
+	void (*m_pfnHalfToFloat)(const unsigned short* pIn, float* pOut, int nCount);
+	void (*m_pfnFloatToHalf)(const float* pIn, unsigned short* pOut, int nCount);
+};
+
+// the kernels the host can run, best first. the first is the one the conversions use
+int GetFloat16Kernels(const CFloat16Kernel** ppKernels);
+
+inline void ConvertFloat16ToFloat32(const float16* pIn, float* pOut, int nCount)
+{
+	ConvertFloat16ToFloat32(reinterpret_cast<const unsigned short*>(pIn), pOut, nCount);
+}
+
+inline void ConvertFloat32ToFloat16(const float* pIn, float16* pOut, int nCount)
+{
+	ConvertFloat32ToFloat16(pIn, reinterpret_cast<unsigned short*>(pOut), nCount);
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#pragma once
+
+// .vtx optimized model file, the triangles of each mesh as strips of indices
+// into per strip group vertex lists. body parts, models and meshes are in the
+// same order as in the .mdl
+
+#define OPTIMIZED_MODEL_FILE_VERSION 7
+
+namespace OptimizedModel
+{
+
+#pragma pack(1)
+
+struct BoneStateChangeHeader_t
+{
+	int hardwareID;
+	int newBoneID;
+};
+
+struct Vertex_t
+{
+	// these index into the mesh's vert[origMeshVertID]'s bones
+	unsigned char boneWeightIndex[3];
+	unsigned char numBones;
+
+	unsigned short origMeshVertID;
+
+	// for sw skinned verts, these are indices into the global list of bones
+	// for hw skinned verts, these are hardware bone indices
+	char boneID[3];
+};
+
+enum StripHeaderFlags_t
+{
+	STRIP_IS_TRILIST = 0x01,
+	STRIP_IS_TRISTRIP = 0x02
+};
+
+// a strip is a piece of a stripgroup which is divided by bones
+struct StripHeader_t
+{
+	int numIndices;
+	int indexOffset;	// into the strip group's indices
+
+	int numVerts;
+	int vertOffset;
+
+	short numBones;
+
+	unsigned char flags;
+
+	int numBoneStateChanges;
+	int boneStateChangeOffset;
+};
+
+struct StripGroupHeader_t
+{
+	// These are the arrays of all verts and indices for this mesh.  strips index into this.
+	int numVerts;
+	int vertOffset;
+	inline const Vertex_t* pVertex(int i) const { return (const Vertex_t*)((const char*)this + vertOffset) + i; }
+
+	int numIndices;
+	int indexOffset;
+	inline const unsigned short* pIndex(int i) const { return (const unsigned short*)((const char*)this + indexOffset) + i; }
+
+	int numStrips;
+	int stripOffset;
+	inline const StripHeader_t* pStrip(int i) const { return (const StripHeader_t*)((const char*)this + stripOffset) + i; }
+
+	unsigned char flags;
+};
+
+struct MeshHeader_t
+{
+	int numStripGroups;
+	int stripGroupHeaderOffset;
+	inline const StripGroupHeader_t* pStripGroup(int i) const { return (const StripGroupHeader_t*)((const char*)this + stripGroupHeaderOffset) + i; }
+
+	unsigned char flags;
+};
+
+struct ModelLODHeader_t
+{
+	int numMeshes;
+	int meshOffset;
+	inline const MeshHeader_t* pMesh(int i) const { return (const MeshHeader_t*)((const char*)this + meshOffset) + i; }
+
+	float switchPoint;
+};
+
+// This maps one to one with models in the mdl file.
+struct ModelHeader_t
+{
+	int numLODs; // This is also specified in FileHeader_t
+	int lodOffset;
+	inline const ModelLODHeader_t* pLOD(int i) const { return (const ModelLODHeader_t*)((const char*)this + lodOffset) + i; }
+};
+
+struct BodyPartHeader_t
+{
+	int numModels;
+	int modelOffset;
+	inline const ModelHeader_t* pModel(int i) const { return (const ModelHeader_t*)((const char*)this + modelOffset) + i; }
+};
+
+struct FileHeader_t
+{
+	// file version as defined by OPTIMIZED_MODEL_FILE_VERSION
+	int version;
+
+	// hardware params that affect how the model is to be optimized.
+	int vertCacheSize;
+	unsigned short maxBonesPerStrip;
+	unsigned short maxBonesPerTri;
+	int maxBonesPerVert;
+
+	// must match checkSum in the .mdl
+	int checkSum;
+
+	int numLODs; // garbage, but keep it around for compatibility
+
+	// one of these for each LOD
+	int materialReplacementListOffset;
+
+	int numBodyParts;
+	int bodyPartOffset;
+	inline const BodyPartHeader_t* pBodyPart(int i) const { return (const BodyPartHeader_t*)((const char*)this + bodyPartOffset) + i; }
+};
+
+#pragma pack()
+
+}
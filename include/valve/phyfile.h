@@ -0,0 +1,99 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#pragma once
+
+#include "vector.h"
+
+// .phy header, followed by solidCount solids and then the key value text
+struct phyheader_t
+{
+	int		size;			// sizeof(phyheader_t)
+	int		id;
+	int		solidCount;
+	int		checkSum;		// checksum of source .mdl file
+};
+
+#define VPHYSICS_COLLISION_ID		(('Y'<<24)|('H'<<16)|('P'<<8)|'V')	// "VPHY"
+#define VPHYSICS_COLLISION_VERSION	0x0100
+
+#define COLLIDE_POLY	0
+#define COLLIDE_MOPP	1
+
+// each solid starts with its size (not counting the size field itself). newer files
+// follow it with this header, older ones go straight into the compact surface
+struct compactsurfaceheader_t
+{
+	int		size;
+	int		vphysicsID;		// VPHYSICS_COLLISION_ID
+	short	version;
+	short	modelType;
+	int		surfaceSize;
+	Vector	dragAxisAreas;
+	int		axisMapSize;
+};
+
+// IVP compact surface layout, positions are in meters with y pointing down
+
+#define IVP_COMPACT_SURFACE_ID		(('S'<<24)|('P'<<16)|('V'<<8)|'I')	// "IVPS"
+
+struct ivpcompactsurface_t
+{
+	float	mass_center[3];
+	float	rotation_inertia[3];
+	float	upper_limit_radius;
+
+	unsigned int	max_factor_surface_deviation : 8;
+	int				byte_size : 24;
+
+	int		offset_ledgetree_root;	// relative to this
+	int		dummy[3];				// dummy[2] is IVP_COMPACT_SURFACE_ID
+};
+
+struct ivpcompactledgetreenode_t
+{
+	int		offset_right_node;		// relative to this, 0 for a leaf. the left node follows this one
+	int		offset_compact_ledge;	// relative to this, leaves only
+	float	center[3];
+	float	radius;
+	unsigned char	box_sizes[3];
+	unsigned char	free_0;
+
+	inline bool IsTerminal() const { return offset_right_node == 0; }
+	inline const ivpcompactledgetreenode_t* pLeft() const { return this + 1; }
+	inline const ivpcompactledgetreenode_t* pRight() const { return (const ivpcompactledgetreenode_t*)((const char*)this + offset_right_node); }
+};
+
+struct ivpcompactedge_t
+{
+	unsigned int	start_point_index : 16;
+	int				opposite_index : 15;
+	unsigned int	is_virtual : 1;
+};
+
+struct ivpcompacttriangle_t
+{
+	unsigned int	tri_index : 12;
+	unsigned int	pierce_index : 12;
+	unsigned int	material_index : 7;
+	unsigned int	is_virtual : 1;
+
+	ivpcompactedge_t	c_three_edges[3];
+};
+
+// one convex piece, its triangles follow it
+struct ivpcompactledge_t
+{
+	int		c_point_offset;			// relative to this, points are float[4]
+	int		client_data;
+
+	unsigned int	has_children_flag : 2;
+	int				is_compact_flag : 2;
+	unsigned int	dummy : 4;
+	unsigned int	size_div_16 : 24;
+
+	short	n_triangles;
+	short	for_future_use;
+
+	inline const float* pPoint(int i) const { return (const float*)((const char*)this + c_point_offset) + i * 4; }
+	inline const ivpcompacttriangle_t* pTriangle(int i) const { return (const ivpcompacttriangle_t*)(this + 1) + i; }
+};
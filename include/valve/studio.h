@@ -36,8 +36,75 @@
 //Adrian - Remove this when we completely phase out the old event system.
 #define NEW_EVENT_STYLE ( 1 << 10 )
 
+#define BONE_CALCULATE_MASK			0x1F
+#define BONE_PHYSICALLY_SIMULATED	0x01	// bone is physically simulated when physics are active
+#define BONE_PHYSICS_PROCEDURAL		0x02	// procedural when physics is active
+#define BONE_ALWAYS_PROCEDURAL		0x04	// bone is always procedurally animated
+#define BONE_SCREEN_ALIGN_SPHERE	0x08	// bone aligns to the screen, not constrained in motion.
+#define BONE_SCREEN_ALIGN_CYLINDER	0x10	// bone aligns to the screen, constrained by it's own axis.
+
+#define BONE_USED_MASK				0x0007FF00
+#define BONE_USED_BY_ANYTHING		0x0007FF00
+#define BONE_USED_BY_HITBOX			0x00000100	// bone (or child) is used by a hit box
+#define BONE_USED_BY_ATTACHMENT		0x00000200	// bone (or child) is used by an attachment point
+#define BONE_USED_BY_VERTEX_MASK	0x0003FC00
+#define BONE_USED_BY_VERTEX_LOD0	0x00000400	// bone (or child) is used by the toplevel model via skinned vertex
+#define BONE_USED_BY_VERTEX_LOD1	0x00000800	
+#define BONE_USED_BY_VERTEX_LOD2	0x00001000  
+#define BONE_USED_BY_VERTEX_LOD3	0x00002000
+#define BONE_USED_BY_VERTEX_LOD4	0x00004000
+#define BONE_USED_BY_VERTEX_LOD5	0x00008000
+#define BONE_USED_BY_VERTEX_LOD6	0x00010000
+#define BONE_USED_BY_VERTEX_LOD7	0x00020000
+#define BONE_USED_BY_BONE_MERGE		0x00040000	// bone is available for bone merge to occur against it
+
+#define BONE_TYPE_MASK				0x00F00000
+#define BONE_FIXED_ALIGNMENT		0x00100000	// bone can't spin 360 degrees, all interpolation is normalized around a fixed orientation
+
+#define BONE_HAS_SAVEFRAME_POS		0x00200000	// Vector48
+#define BONE_HAS_SAVEFRAME_ROT		0x00400000	// Quaternion64
+
+// sequence and autolayer flags
+#define STUDIO_LOOPING	0x0001		// ending frame should be the same as the starting frame
+#define STUDIO_SNAP		0x0002		// do not interpolate between previous animation and this one
+#define STUDIO_DELTA	0x0004		// this sequence "adds" to the base sequences, not slerp blends
+#define STUDIO_AUTOPLAY	0x0008		// temporary flag that forces the sequence to always play
+#define STUDIO_POST		0x0010		// 
+#define STUDIO_ALLZEROS	0x0020		// this animation/sequence has no real animation data
+//						0x0040
+#define STUDIO_CYCLEPOSE 0x0080		// cycle index is taken from a pose parameter index
+#define STUDIO_REALTIME	0x0100		// cycle index is taken from a real-time clock, not the animations cycle index
+#define STUDIO_LOCAL	0x0200		// sequence has a local context sequence
+#define STUDIO_HIDDEN	0x0400		// don't show in default selection views
+#define STUDIO_OVERRIDE	0x0800		// a forward declared sequence (empty)
+#define STUDIO_ACTIVITY	0x1000		// Has been updated at runtime to activity index
+#define STUDIO_EVENT	0x2000		// Has been updated at runtime to event index
+#define STUDIO_WORLD	0x4000		// sequence blends in worldspace
+
+// bone controller types
+#define STUDIO_X		0x00000001
+#define STUDIO_Y		0x00000002
+#define STUDIO_Z		0x00000004
+#define STUDIO_XR		0x00000008
+#define STUDIO_YR		0x00000010
+#define STUDIO_ZR		0x00000020
+
+#define STUDIO_LX		0x00000040
+#define STUDIO_LY		0x00000080
+#define STUDIO_LZ		0x00000100
+#define STUDIO_LXR		0x00000200
+#define STUDIO_LYR		0x00000400
+#define STUDIO_LZR		0x00000800
+
+#define STUDIO_LINEAR	0x00001000
+
+#define STUDIO_TYPES	0x0003FFFF
+#define STUDIO_RLOOP	0x00040000	// controller that wraps shortest distance
+
 typedef unsigned char byte;
 
+struct studiohdr_t;
+
 struct mstudiodata_t
 {
 	int		count;
@@ -74,20 +141,64 @@ struct mstudioiface_t
 struct mstudio_modelvertexdata_t
 {
 	// base of external vertex data stores
-	const void* pVertexData;
-	const void* pTangentData;
+	// pointer slots, 32 bits on disk whatever the build's pointer size
+	int pVertexData;
+	int pTangentData;
 };
 
 struct mstudio_meshvertexdata_t
 {
 	// indirection to this mesh's model's vertex data
-	const mstudio_modelvertexdata_t* modelvertexdata;
+	int modelvertexdata; // pointer slot
 
 	// used for fixup calcs when culling top level lods
 	// expected number of mesh verts at desired lod
 	int					numLODVertexes[MAX_NUM_LODS];
 };
 
+// .vvd vertex file, the vertices mstudiomodel_t::vertexindex and mstudiomesh_t::vertexoffset point into
+
+#define MODEL_VERTEX_FILE_ID		(('V'<<24)+('D'<<16)+('S'<<8)+'I')
+#define MODEL_VERTEX_FILE_VERSION	4
+
+struct mstudioboneweight_t
+{
+	float	weight[MAX_NUM_BONES_PER_VERT];
+	char	bone[MAX_NUM_BONES_PER_VERT];
+	byte	numbones;
+};
+
+struct mstudiovertex_t
+{
+	mstudioboneweight_t	m_BoneWeights;
+	Vector				m_vecPosition;
+	Vector				m_vecNormal;
+	float				m_vecTexCoord[2];
+};
+
+struct vertexFileHeader_t
+{
+	int		id;								// MODEL_VERTEX_FILE_ID
+	int		version;						// MODEL_VERTEX_FILE_VERSION
+	int		checksum;						// same as studiohdr_t, ensures sync
+	int		numLODs;						// num of valid lods
+	int		numLODVertexes[MAX_NUM_LODS];	// num verts for desired root lod
+	int		numFixups;						// num of vertexFileFixup_t
+	int		fixupTableStart;				// offset from base to fixup table
+	int		vertexDataStart;				// offset from base to vertex block
+	int		tangentDataStart;				// offset from base to tangent block
+
+	inline const mstudiovertex_t* pVertex(int i) const { return (const mstudiovertex_t*)((const byte*)this + vertexDataStart) + i; }
+};
+
+// apply sequentially to lod sorted vertex and tangent pools to re-establish mesh order
+struct vertexFileFixup_t
+{
+	int		lod;				// used to skip culled root lod
+	int		sourceVertexID;		// absolute index from start of vertex/tangent blocks
+	int		numVertexes;
+};
+
 struct mstudiobonecontroller_t
 {
 	int					bone;	// -1 == 0
@@ -280,6 +391,116 @@ struct mstudioflex_t
 	int					unused[6];
 };
 
+struct mstudioflexdesc_t
+{
+	int					szFACSindex;
+	inline char* const pszFACS(void) const { return ((char*)this) + szFACSindex; }
+};
+
+struct mstudioflexcontroller_t
+{
+	int					sztypeindex;
+	inline char* const pszType(void) const { return ((char*)this) + sztypeindex; }
+	int					sznameindex;
+	inline char* const pszName(void) const { return ((char*)this) + sznameindex; }
+	mutable int			localToGlobal;	// remapped at load time to master list
+	float				min;
+	float				max;
+};
+
+enum FlexControllerRemapType_t
+{
+	FLEXCONTROLLER_REMAP_PASSTHRU = 0,
+	FLEXCONTROLLER_REMAP_2WAY,	// Control 0 -> ramps from 1-0 from 0->0.5. Control 1 -> ramps from 0-1 from 0.5->1
+	FLEXCONTROLLER_REMAP_NWAY,	// StepSize = 1 / (control count-1) Control n -> ramps from 0-1-0 from (n-1)*StepSize to n*StepSize to (n+1)*StepSize. A second control is needed to specify amount to use 
+	FLEXCONTROLLER_REMAP_EYELID
+};
+
+struct mstudioflexcontrollerui_t
+{
+	int					sznameindex;
+	inline char* const pszName(void) const { return ((char*)this) + sznameindex; }
+
+	// These are used like a union to save space
+	// Here are the possible configurations for a UI controller
+	//
+	// SIMPLE NON-STEREO:	0: control	1: unused	2: unused
+	// STEREO:				0: left		1: right	2: unused
+	// NWAY NON-STEREO:		0: control	1: unused	2: value
+	// NWAY STEREO:			0: left		1: right	2: value
+
+	int					szindex0;
+	int					szindex1;
+	int					szindex2;
+
+	inline const mstudioflexcontroller_t* pController(void) const
+	{
+		return !stereo ? (mstudioflexcontroller_t*)((char*)this + szindex0) : NULL;
+	}
+
+	inline const mstudioflexcontroller_t* pLeftController(void) const
+	{
+		return stereo ? (mstudioflexcontroller_t*)((char*)this + szindex0) : NULL;
+	}
+
+	inline const mstudioflexcontroller_t* pRightController(void) const
+	{
+		return stereo ? (mstudioflexcontroller_t*)((char*)this + szindex1) : NULL;
+	}
+
+	inline const mstudioflexcontroller_t* pNWayValueController(void) const
+	{
+		return remaptype == FLEXCONTROLLER_REMAP_NWAY ? (mstudioflexcontroller_t*)((char*)this + szindex2) : NULL;
+	}
+
+	// Number of controllers this ui description contains, 1, 2 or 3
+	inline int			Count() const { return (stereo ? 2 : 1) + (remaptype == FLEXCONTROLLER_REMAP_NWAY ? 1 : 0); }
+
+	unsigned char		remaptype;	// See the FlexControllerRemapType_t enum
+	bool				stereo;		// Is this a stereo control?
+	byte				unused[2];
+};
+
+#define STUDIO_CONST	1	// get float
+#define STUDIO_FETCH1	2	// get Flexcontroller value
+#define STUDIO_FETCH2	3	// get flex weight
+#define STUDIO_ADD		4
+#define STUDIO_SUB		5
+#define STUDIO_MUL		6
+#define STUDIO_DIV		7
+#define STUDIO_NEG		8	// not implemented
+#define STUDIO_EXP		9	// not implemented
+#define STUDIO_OPEN		10	// only used in token parsing
+#define STUDIO_CLOSE	11
+#define STUDIO_COMMA	12	// only used in token parsing
+#define STUDIO_MAX		13
+#define STUDIO_MIN		14
+#define STUDIO_2WAY_0	15	// Fetch a value from a 2 Way slider for the 1st value RemapVal( 0.0, 0.5, 0.0, 1.0 )
+#define STUDIO_2WAY_1	16	// Fetch a value from a 2 Way slider for the 2nd value RemapVal( 0.5, 1.0, 0.0, 1.0 )
+#define STUDIO_NWAY		17	// Fetch a value from a 2 Way slider for the 2nd value RemapVal( 0.5, 1.0, 0.0, 1.0 )
+#define STUDIO_COMBO	18	// Perform a combo operation (essentially multiply the last N values on the stack)
+#define STUDIO_DOMINATE	19	// Performs a combination domination operation
+#define STUDIO_DME_LOWER_EYELID 20	// 
+#define STUDIO_DME_UPPER_EYELID 21	// 
+
+struct mstudioflexop_t
+{
+	int		op;
+	union
+	{
+		int		index;
+		float	value;
+	} d;
+};
+
+struct mstudioflexrule_t
+{
+	int					flex;
+	int					numops;
+	int					opindex;
+	inline mstudioflexop_t* iFlexOp(int i) const { return  (mstudioflexop_t*)(((byte*)this) + opindex) + i; };
+};
+
 struct mstudiomodel_t;
 
 struct mstudiomesh_t
@@ -398,6 +619,65 @@ struct mstudiobodyparts_t
 	inline mstudiomodel_t* pModel(int i) const { return (mstudiomodel_t*)(((byte*)this) + modelindex) + i; };
 };
 
+struct mstudioposeparamdesc_t
+{
+	int					sznameindex;
+	inline char* const pszName(void) const { return ((char*)this) + sznameindex; }
+	int					flags;	// ????
+	float				start;	// starting value
+	float				end;	// ending value
+	float				loop;	// looping range, 0 for no looping, 360 for rotations, etc.
+};
+
+union mstudioanimvalue_t
+{
+	struct
+	{
+		byte	valid;
+		byte	total;
+	} num;
+	short		value;
+};
+
+struct mstudioanim_valueptr_t
+{
+	short	offset[3];
+	inline mstudioanimvalue_t* pAnimvalue(int i) const { if (offset[i] > 0) return  (mstudioanimvalue_t*)(((byte*)this) + offset[i]); else return NULL; };
+};
+
+#define STUDIO_ANIM_RAWPOS	0x01 // Vector48
+#define STUDIO_ANIM_RAWROT	0x02 // Quaternion48
+#define STUDIO_ANIM_ANIMPOS	0x04 // mstudioanim_valueptr_t
+#define STUDIO_ANIM_ANIMROT	0x08 // mstudioanim_valueptr_t
+#define STUDIO_ANIM_DELTA	0x10
+#define STUDIO_ANIM_RAWROT2	0x20 // Quaternion64
+
+// per bone per animation DOF and weight pointers
+struct mstudioanim_t
+{
+	byte				bone;
+	byte				flags;		// weighing options
+
+	// valid for animating data only
+	inline byte* pData(void) const { return (((byte*)this) + sizeof(struct mstudioanim_t)); };
+	inline mstudioanim_valueptr_t* pRotV(void) const { return (mstudioanim_valueptr_t*)(pData()); };
+	inline mstudioanim_valueptr_t* pPosV(void) const { return (mstudioanim_valueptr_t*)(pData()) + ((flags & STUDIO_ANIM_ANIMROT) != 0); };
+
+	// valid if animation unvaring over timeline
+	inline Quaternion48* pQuat48(void) const { return (Quaternion48*)(pData()); };
+	inline Quaternion64* pQuat64(void) const { return (Quaternion64*)(pData()); };
+	inline Vector48* pPos(void) const { return (Vector48*)(pData() + ((flags & STUDIO_ANIM_RAWROT) != 0) * sizeof(*pQuat48()) + ((flags & STUDIO_ANIM_RAWROT2) != 0) * sizeof(*pQuat64())); };
+
+	short				nextoffset;
+	inline mstudioanim_t* pNext(void) const { if (nextoffset != 0) return  (mstudioanim_t*)(((byte*)this) + nextoffset); else return NULL; };
+};
+
+struct mstudioanimblock_t
+{
+	int					datastart;
+	int					dataend;
+};
+
 struct mstudioanimsections_t
 {
 	int					animblock;
@@ -429,6 +709,87 @@ struct mstudioautolayer_t
 	float				end;	// end of all influence
 };
 
+// ik rule types
+#define IK_SELF 1
+#define IK_WORLD 2
+#define IK_GROUND 3
+#define IK_RELEASE 4
+#define IK_ATTACHMENT 5
+#define IK_UNLATCH 6
+
+struct mstudioikerror_t
+{
+	Vector		pos;
+	Quaternion	q;
+};
+
+struct mstudiocompressedikerror_t
+{
+	float	scale[6];
+	short	offset[6];
+};
+
+struct mstudioikrule_t
+{
+	int			index;
+
+	int			type;
+	int			chain;
+
+	int			bone;
+
+	int			slot;	// iktarget slot.  Usually same as chain.
+	float		height;
+	float		radius;
+	float		floor;
+	Vector		pos;
+	Quaternion	q;
+
+	int			compressedikerrorindex;
+	inline mstudiocompressedikerror_t* pCompressedError() const { return (mstudiocompressedikerror_t*)(((byte*)this) + compressedikerrorindex); };
+	int			unused2;
+
+	int			iStart;
+	int			ikerrorindex;
+	inline mstudioikerror_t* pError(int i) const { return  (ikerrorindex) ? (mstudioikerror_t*)(((byte*)this) + ikerrorindex) + (i - iStart) : NULL; };
+
+	float		start;	// beginning of influence
+	float		peak;	// start of full influence
+	float		tail;	// end of full influence
+	float		end;	// end of all influence
+
+	float		unused3;	// 
+	float		contact;	// frame footstep makes ground concact
+	float		drop;		// how far down the foot should drop when reaching for IK
+	float		top;		// top of the foot box
+
+	int			unused6;
+	int			unused7;
+	int			unused8;
+
+	int			szattachmentindex;		// name of world attachment
+	inline char* const pszAttachment(void) const { return ((char*)this) + szattachmentindex; }
+
+	int			unused[7];
+};
+
+struct mstudioiklink_t
+{
+	int		bone;
+	Vector	kneeDir;	// ideal bending direction (per link, if applicable)
+	Vector	unused0;	// unused
+};
+
+struct mstudioikchain_t
+{
+	int				sznameindex;
+	inline char* const pszName(void) const { return ((char*)this) + sznameindex; }
+	int				linktype;
+	int				numlinks;
+	int				linkindex;
+	inline mstudioiklink_t* pLink(int i) const { return (mstudioiklink_t*)(((byte*)this) + linkindex) + i; };
+};
+
 struct mstudioiklock_t
 {
 	int			chain;
@@ -490,7 +851,7 @@ struct mstudioanimdesc_t
 	int					numikrules;
 	int					ikruleindex;	// non-zero when IK data is stored in the mdl
 	int					animblockikruleindex; // non-zero when IK data is stored in animblock file
-//	mstudioikrule_t* pIKRule(int i) const;
+	inline mstudioikrule_t* pIKRule(int i) const { return ikruleindex ? (mstudioikrule_t*)(((byte*)this) + ikruleindex) + i : NULL; } // NULL when the rules are in the animblock
 
 	int					numlocalhierarchy;
 	int					localhierarchyindex;
@@ -618,6 +979,46 @@ private:
 	mstudioseqdesc_t(const mstudioseqdesc_t& vOther);
 };
 
+// procedural bone rule types
+#define STUDIO_PROC_AXISINTERP	1
+#define STUDIO_PROC_QUATINTERP	2
+#define STUDIO_PROC_AIMATBONE	3
+#define STUDIO_PROC_AIMATATTACH 4
+#define STUDIO_PROC_JIGGLE		5
+
+struct mstudioaxisinterpbone_t
+{
+	int				control;// local transformation of this bone used to calc 3 point blend
+	int				axis;	// axis to check
+	Vector			pos[6];	// X+, X-, Y+, Y-, Z+, Z-
+	Quaternion		quat[6];// X+, X-, Y+, Y-, Z+, Z-
+};
+
+struct mstudioquatinterpinfo_t
+{
+	float			inv_tolerance;	// 1 / radian angle of trigger influence
+	Quaternion		trigger;	// angle to match
+	Vector		pos;		// new position
+	Quaternion		quat;		// new angle
+};
+
+struct mstudioquatinterpbone_t
+{
+	int				control;// local transformation to check
+	int				numtriggers;
+	int				triggerindex;
+	inline mstudioquatinterpinfo_t* pTrigger(int i) const { return  (mstudioquatinterpinfo_t*)(((byte*)this) + triggerindex) + i; };
+};
+
+struct mstudioaimatbone_t
+{
+	int				parent;
+	int				aim;		// Might be bone or attach
+	Vector			aimvector;
+	Vector			upvector;
+	Vector			basepos;
+};
+
 struct mstudiobone_t
 {
 	int					sznameindex;
@@ -659,12 +1060,83 @@ struct mstudiotexture_t
 	int						flags;
 	int						used;
 	int						unused1;
-	mutable void* material;  // fixme: this needs to go away . .isn't used by the engine, but is used by studiomdl
-	mutable void* clientmaterial;	// gary, replace with client material pointer if used
+	mutable int material;  // pointer slot. fixme: this needs to go away . .isn't used by the engine, but is used by studiomdl
+	mutable int clientmaterial;	// pointer slot. gary, replace with client material pointer if used
 
 	int						unused[10];
 };
 
+#define ATTACHMENT_FLAG_WORLD_ALIGN 0x10000
+
+// attachment
+struct mstudioattachment_t
+{
+	int					sznameindex;
+	inline char* const pszName(void) const { return ((char*)this) + sznameindex; }
+	unsigned int		flags;
+	int					localbone;
+	matrix3x4_t			local; // attachment point
+	int					unused[8];
+};
+
+// shared animation models included by name
+struct mstudiomodelgroup_t
+{
+	int					szlabelindex;	// textual name
+	inline char* const pszLabel(void) const { return ((char*)this) + szlabelindex; }
+	int					sznameindex;	// file name
+	inline char* const pszName(void) const { return ((char*)this) + sznameindex; }
+};
+
+struct mstudiosrcbonetransform_t
+{
+	int					sznameindex;
+	inline const char* pszName(void) const { return ((char*)this) + sznameindex; }
+	matrix3x4_t			pretransform;
+	matrix3x4_t			posttransform;
+};
+
+// bone data laid out per field, for the engine's SIMD setup
+struct mstudiolinearbone_t
+{
+	int numbones;
+
+	int flagsindex;
+	int	parentindex;
+	int	posindex;
+	int quatindex;
+	int rotindex;
+	int posetoboneindex;
+	int	posscaleindex;
+	int	rotscaleindex;
+	int	qalignmentindex;
+
+	int unused[6];
+};
+
+struct mstudioboneflexdrivercontrol_t
+{
+	int m_nBoneComponent;		// Bone component that drives flex, StudioBoneFlexComponent_t
+	int m_nFlexControllerIndex;	// Flex controller to drive
+	float m_flMin;				// Min value of bone component mapped to 0 on flex controller
+	float m_flMax;				// Max value of bone component mapped to 1 on flex controller
+};
+
+// drives flex controllers from a bone's position
+struct mstudioboneflexdriver_t
+{
+	int m_nBoneIndex;			// Bone to drive flex controller
+	int m_nControlCount;		// Number of flex controllers being driven
+	int m_nControlIndex;		// Index into data where controllers are (relative to this)
+
+	inline mstudioboneflexdrivercontrol_t* pBoneFlexDriverControl(int i) const
+	{
+		return (mstudioboneflexdrivercontrol_t*)(((byte*)this) + m_nControlIndex) + i;
+	}
+
+	int unused[3];
+};
+
 struct studiohdr2_t
 {
 	// NOTE: For forward compat, make sure any methods in this struct
@@ -673,6 +1145,7 @@ struct studiohdr2_t
 
 	int numsrcbonetransform;
 	int srcbonetransformindex;
+	inline mstudiosrcbonetransform_t* pSrcBoneTransform(int i) const { return (mstudiosrcbonetransform_t*)(((byte*)this) + srcbonetransformindex) + i; }
 
 	int	illumpositionattachmentindex;
 	inline int			IllumPositionAttachmentIndex() const { return illumpositionattachmentindex; }
@@ -681,12 +1154,14 @@ struct studiohdr2_t
 	inline float		MaxEyeDeflection() const { return flMaxEyeDeflection != 0.0f ? flMaxEyeDeflection : 0.866f; } // default to cos(30) if not set
 
 	int linearboneindex;
+	inline mstudiolinearbone_t* pLinearBones() const { return (linearboneindex) ? (mstudiolinearbone_t*)(((byte*)this) + linearboneindex) : NULL; }
 	
 	int sznameindex;
 	inline char* pszName() { return (sznameindex) ? (char*)(((byte*)this) + sznameindex) : NULL; }
 
 	int m_nBoneFlexDriverCount;
 	int m_nBoneFlexDriverIndex;
+	inline mstudioboneflexdriver_t* pBoneFlexDriver(int i) const { return (mstudioboneflexdriver_t*)(((byte*)this) + m_nBoneFlexDriverIndex) + i; }
 
 	int reserved[56];
 };
@@ -797,6 +1272,7 @@ struct studiohdr_t
 //private:
 	int					numlocalattachments;
 	int					localattachmentindex;
+	inline mstudioattachment_t* pLocalAttachment(int i) const { assert(i >= 0 && i < numlocalattachments); return (mstudioattachment_t*)(((byte*)this) + localattachmentindex) + i; };
 	//public:
 
 	// animation node to animation node transition graph
@@ -815,15 +1291,19 @@ struct studiohdr_t
 
 	int					numflexdesc;
 	int					flexdescindex;
+	inline mstudioflexdesc_t* pFlexdesc(int i) const { assert(i >= 0 && i < numflexdesc); return (mstudioflexdesc_t*)(((byte*)this) + flexdescindex) + i; };
 
 	int					numflexcontrollers;
 	int					flexcontrollerindex;
+	inline mstudioflexcontroller_t* pFlexcontroller(int i) const { assert(i >= 0 && i < numflexcontrollers); return (mstudioflexcontroller_t*)(((byte*)this) + flexcontrollerindex) + i; };
 
 	int					numflexrules;
 	int					flexruleindex;
+	inline mstudioflexrule_t* pFlexRule(int i) const { assert(i >= 0 && i < numflexrules); return (mstudioflexrule_t*)(((byte*)this) + flexruleindex) + i; };
 
 	int					numikchains;
 	int					ikchainindex;
+	inline mstudioikchain_t* pIKChain(int i) const { assert(i >= 0 && i < numikchains); return (mstudioikchain_t*)(((byte*)this) + ikchainindex) + i; };
 
 	int					nummouths;
 	int					mouthindex;
@@ -831,6 +1311,7 @@ struct studiohdr_t
 	//private:
 	int					numlocalposeparameters;
 	int					localposeparamindex;
+	inline mstudioposeparamdesc_t* pLocalPoseParameter(int i) const { assert(i >= 0 && i < numlocalposeparameters); return (mstudioposeparamdesc_t*)(((byte*)this) + localposeparamindex) + i; };
 	//public:
 
 	int					surfacepropindex;
@@ -843,6 +1324,7 @@ struct studiohdr_t
 
 	int					numlocalikautoplaylocks;
 	int					localikautoplaylockindex;
+	inline mstudioiklock_t* pLocalIKAutolock(int i) const { assert(i >= 0 && i < numlocalikautoplaylocks); return (mstudioiklock_t*)(((byte*)this) + localikautoplaylockindex) + i; };
 
 
 	// The collision model mass that jay wanted
@@ -852,16 +1334,18 @@ struct studiohdr_t
 	// external animations, models, etc.
 	int					numincludemodels;
 	int					includemodelindex;
+	inline mstudiomodelgroup_t* pModelGroup(int i) const { assert(i >= 0 && i < numincludemodels); return (mstudiomodelgroup_t*)(((byte*)this) + includemodelindex) + i; };
 
 	// implementation specific back pointer to virtual data
-	mutable void* virtualModel;
+	mutable int virtualModel; // pointer slot, 32 bits on disk
 
 	// for demand loaded animation blocks
 	int					szanimblocknameindex;
 	inline char* const pszAnimBlockName(void) const { return ((char*)this) + szanimblocknameindex; }
 	int					numanimblocks;
 	int					animblockindex;
-	mutable void* animblockModel;
+	mutable int animblockModel; // pointer slot
+	inline mstudioanimblock_t* pAnimBlock(int i) const { assert(i > 0 && i < numanimblocks); return (mstudioanimblock_t*)(((byte*)this) + animblockindex) + i; }
 //	byte* GetAnimBlock(int i) const;
 
 	int					bonetablebynameindex;
@@ -869,8 +1353,8 @@ struct studiohdr_t
 
 	// used by tools only that don't cache, but persist mdl's peer data
 	// engine uses virtualModel to back link to cache pointers
-	void* pVertexBase;
-	void* pIndexBase;
+	int pVertexBase; // pointer slots
+	int pIndexBase;
 
 	// if STUDIOHDR_FLAGS_CONSTANT_DIRECTIONAL_LIGHT_DOT is set,
 	// this value is used to calculate directional components of lighting 
@@ -894,6 +1378,7 @@ struct studiohdr_t
 
 	int					numflexcontrollerui;
 	int					flexcontrolleruiindex;
+	inline mstudioflexcontrollerui_t* pFlexControllerUI(int i) const { assert(i >= 0 && i < numflexcontrollerui); return (mstudioflexcontrollerui_t*)(((byte*)this) + flexcontrolleruiindex) + i; }
 
 	float				flVertAnimFixedPointScale;
 
@@ -8,6 +8,11 @@ typedef float vec_t;
 class Quaternion				// same data-layout as engine's vec4_t,
 {								//		which is a vec_t[4]
 public:
+	inline void Init(vec_t ix = 0.0f, vec_t iy = 0.0f, vec_t iz = 0.0f, vec_t iw = 0.0f) { x = ix; y = iy; z = iz; w = iw; }
+
+	vec_t operator[](int i) const { return (&x)[i]; }
+	vec_t& operator[](int i) { return (&x)[i]; }
+
 	vec_t x, y, z, w;
 };
 
@@ -26,10 +31,33 @@ public:
 		x = y = z = XYZ;
 	}
 
+	inline void Init(vec_t ix = 0.0f, vec_t iy = 0.0f, vec_t iz = 0.0f) { x = ix; y = iy; z = iz; }
+
+	vec_t operator[](int i) const { return (&x)[i]; }
+	vec_t& operator[](int i) { return (&x)[i]; }
+
+	Vector& operator+=(const Vector& v) { x += v.x; y += v.y; z += v.z; return *this; }
+	Vector& operator-=(const Vector& v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+	Vector& operator*=(float s) { x *= s; y *= s; z *= s; return *this; }
+
+	Vector operator-(void) const { return Vector(-x, -y, -z); }
+	Vector operator+(const Vector& v) const { return Vector(x + v.x, y + v.y, z + v.z); }
+	Vector operator-(const Vector& v) const { return Vector(x - v.x, y - v.y, z - v.z); }
+	Vector operator*(float s) const { return Vector(x * s, y * s, z * s); }
 
 	vec_t x, y, z;
 };
 
+inline vec_t DotProduct(const Vector& a, const Vector& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vector CrossProduct(const Vector& a, const Vector& b)
+{
+	return Vector(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
 
 
 class RadianEuler
@@ -51,5 +79,8 @@ struct matrix3x4_t
 		m_flMatVal[2][0] = m20;	m_flMatVal[2][1] = m21; m_flMatVal[2][2] = m22; m_flMatVal[2][3] = m23;
 	}
 
+	float* operator[](int i) { return m_flMatVal[i]; }
+	const float* operator[](int i) const { return m_flMatVal[i]; }
+
 	float m_flMatVal[3][4];
 };
\ No newline at end of file
@@ -4,7 +4,11 @@
 
 #include "vector2d.h"
 #include <float.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
 #include <xmmintrin.h>	// For SSE
+#define VECTOR4D_HAS_M128
+#endif
 
 
 class Vector4D
@@ -112,7 +116,7 @@ public:
 const Vector4D vec4_origin(0.0f, 0.0f, 0.0f, 0.0f);
 const Vector4D vec4_invalid(FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX);
 
-class __declspec(align(16)) Vector4DAligned : public Vector4D
+class alignas(16) Vector4DAligned : public Vector4D
 {
 public:
 	Vector4DAligned(void) {}
@@ -121,8 +125,10 @@ public:
 	inline void Set(vec_t X, vec_t Y, vec_t Z, vec_t W);
 	inline void InitZero(void);
 
+#ifdef VECTOR4D_HAS_M128
 	inline __m128& AsM128() { return *(__m128*) & x; }
 	inline const __m128& AsM128() const { return *(const __m128*) & x; }
+#endif
 
 private:
 	// No copy constructors allowed if we're in optimal mode
@@ -130,4 +136,14 @@ private:
 
 	// No assignment operators either...
 	Vector4DAligned& operator=(Vector4DAligned const& src);
-};
\ No newline at end of file
+};
+
+inline void Vector4DAligned::Set(vec_t X, vec_t Y, vec_t Z, vec_t W)
+{
+	x = X; y = Y; z = Z; w = W;
+}
+
+inline void Vector4DAligned::InitZero(void)
+{
+	x = y = z = w = 0.0f;
+}
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "valve/compressed_vector.h"
+#include "mdlcpu.h"
+
+#ifdef MDL_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // exposes the protected scalar converters, they are the reference every kernel must match
+    class float16_reference : public float16
+    {
+    public:
+        using float16::Convert16bitFloatTo32bits;
+        using float16::ConvertFloatTo16bits;
+    };
+
+    typedef void (*HalfToFloatFn)(const unsigned short* pIn, float* pOut, int nCount);
+    typedef void (*FloatToHalfFn)(const float* pIn, unsigned short* pOut, int nCount);
+
+    void HalfToFloat_Scalar(const unsigned short* pIn, float* pOut, int nCount)
+    {
+        for (int i = 0; i < nCount; i++)
+            pOut[i] = float16_reference::Convert16bitFloatTo32bits(pIn[i]);
+    }
+
+    void FloatToHalf_Scalar(const float* pIn, unsigned short* pOut, int nCount)
+    {
+        for (int i = 0; i < nCount; i++)
+            pOut[i] = float16_reference::ConvertFloatTo16bits(pIn[i]);
+    }
+
+#ifdef MDL_X86
+    // the integer kernels reproduce the reference bit for bit:
+    //  half -> float: infinity saturates to +-maxfloat16bits, NaN becomes +0
+    //  float -> half: values clamp to +-maxfloat16bits, mantissas truncate, NaN keeps only its sign
+
+    const int HALF_EXP_ADJUST = (float32bias - float16bias) << 23;
+    const int HALF_MIN_NORMAL_AS_FLOAT = 0x38800000; // 2^-14
+    const float HALF_DENORM_SCALE = 1.0f / 16777216.0f; // 2^-24
+    const float FLOAT_TO_HALF_DENORM = 16777216.0f;
+
+    MDL_TARGET("sse2")
+    inline __m128i Select128(__m128i mask, __m128i a, __m128i b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
+    MDL_TARGET("sse2")
+    void HalfToFloat_SSE2(const unsigned short* pIn, float* pOut, int nCount)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i signMask = _mm_set1_epi32(0x8000);
+        const __m128i absMask = _mm_set1_epi32(0x7fff);
+        const __m128i expAdjust = _mm_set1_epi32(HALF_EXP_ADJUST);
+        const __m128i minNormal = _mm_set1_epi32(0x0400);
+        const __m128i infinity = _mm_set1_epi32(0x7c00);
+        const __m128i maxHalf = _mm_castps_si128(_mm_set1_ps(maxfloat16bits));
+        const __m128 denormScale = _mm_set1_ps(HALF_DENORM_SCALE);
+
+        int i = 0;
+        for (; i + 4 <= nCount; i += 4)
+        {
+            __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(pIn + i)), zero);
+
+            __m128i sign = _mm_slli_epi32(_mm_and_si128(h, signMask), 16);
+            __m128i em = _mm_and_si128(h, absMask);
+
+            __m128i normal = _mm_add_epi32(_mm_slli_epi32(em, 13), expAdjust);
+            __m128i denorm = _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(em), denormScale));
+
+            __m128i bits = Select128(_mm_cmplt_epi32(em, minNormal), denorm, normal);
+            bits = Select128(_mm_cmpeq_epi32(em, infinity), maxHalf, bits);
+            bits = _mm_or_si128(bits, sign);
+            bits = _mm_andnot_si128(_mm_cmpgt_epi32(em, infinity), bits);
+
+            _mm_storeu_ps(pOut + i, _mm_castsi128_ps(bits));
+        }
+
+        HalfToFloat_Scalar(pIn + i, pOut + i, nCount - i);
+    }
+
+    MDL_TARGET("sse2")
+    void FloatToHalf_SSE2(const float* pIn, unsigned short* pOut, int nCount)
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 maxHalf = _mm_set1_ps(maxfloat16bits);
+        const __m128 denormScale = _mm_set1_ps(FLOAT_TO_HALF_DENORM);
+        const __m128i expAdjust = _mm_set1_epi32(HALF_EXP_ADJUST);
+        const __m128i minNormal = _mm_set1_epi32(HALF_MIN_NORMAL_AS_FLOAT);
+
+        int i = 0;
+        for (; i + 4 <= nCount; i += 4)
+        {
+            __m128 f = _mm_loadu_ps(pIn + i);
+
+            __m128i sign = _mm_srli_epi32(_mm_castps_si128(_mm_and_ps(f, signMask)), 16);
+            __m128i nan = _mm_castps_si128(_mm_cmpunord_ps(f, f));
+
+            __m128 a = _mm_min_ps(_mm_andnot_ps(signMask, f), maxHalf);
+            __m128i ua = _mm_castps_si128(a);
+
+            __m128i normal = _mm_srli_epi32(_mm_sub_epi32(ua, expAdjust), 13);
+            __m128i denorm = _mm_cvttps_epi32(_mm_mul_ps(a, denormScale));
+
+            __m128i bits = Select128(_mm_cmplt_epi32(ua, minNormal), denorm, normal);
+            bits = _mm_or_si128(_mm_andnot_si128(nan, bits), sign);
+
+            // sign extend so the signed saturating pack keeps all 16 bits
+            bits = _mm_srai_epi32(_mm_slli_epi32(bits, 16), 16);
+            _mm_storel_epi64((__m128i*)(pOut + i), _mm_packs_epi32(bits, bits));
+        }
+
+        FloatToHalf_Scalar(pIn + i, pOut + i, nCount - i);
+    }
+
+    MDL_TARGET("avx2")
+    inline __m256i Select256(__m256i mask, __m256i a, __m256i b)
+    {
+        return _mm256_blendv_epi8(b, a, mask);
+    }
+
+    MDL_TARGET("avx2")
+    void HalfToFloat_AVX2(const unsigned short* pIn, float* pOut, int nCount)
+    {
+        const __m256i signMask = _mm256_set1_epi32(0x8000);
+        const __m256i absMask = _mm256_set1_epi32(0x7fff);
+        const __m256i expAdjust = _mm256_set1_epi32(HALF_EXP_ADJUST);
+        const __m256i minNormal = _mm256_set1_epi32(0x0400);
+        const __m256i infinity = _mm256_set1_epi32(0x7c00);
+        const __m256i maxHalf = _mm256_castps_si256(_mm256_set1_ps(maxfloat16bits));
+        const __m256 denormScale = _mm256_set1_ps(HALF_DENORM_SCALE);
+
+        int i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pIn + i)));
+
+            __m256i sign = _mm256_slli_epi32(_mm256_and_si256(h, signMask), 16);
+            __m256i em = _mm256_and_si256(h, absMask);
+
+            __m256i normal = _mm256_add_epi32(_mm256_slli_epi32(em, 13), expAdjust);
+            __m256i denorm = _mm256_castps_si256(_mm256_mul_ps(_mm256_cvtepi32_ps(em), denormScale));
+
+            __m256i bits = Select256(_mm256_cmpgt_epi32(minNormal, em), denorm, normal);
+            bits = Select256(_mm256_cmpeq_epi32(em, infinity), maxHalf, bits);
+            bits = _mm256_or_si256(bits, sign);
+            bits = _mm256_andnot_si256(_mm256_cmpgt_epi32(em, infinity), bits);
+
+            _mm256_storeu_ps(pOut + i, _mm256_castsi256_ps(bits));
+        }
+
+        HalfToFloat_SSE2(pIn + i, pOut + i, nCount - i);
+    }
+
+    MDL_TARGET("avx2")
+    void FloatToHalf_AVX2(const float* pIn, unsigned short* pOut, int nCount)
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 maxHalf = _mm256_set1_ps(maxfloat16bits);
+        const __m256 denormScale = _mm256_set1_ps(FLOAT_TO_HALF_DENORM);
+        const __m256i expAdjust = _mm256_set1_epi32(HALF_EXP_ADJUST);
+        const __m256i minNormal = _mm256_set1_epi32(HALF_MIN_NORMAL_AS_FLOAT);
+
+        int i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m256 f = _mm256_loadu_ps(pIn + i);
+
+            __m256i sign = _mm256_srli_epi32(_mm256_castps_si256(_mm256_and_ps(f, signMask)), 16);
+            __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(f, f, _CMP_UNORD_Q));
+
+            __m256 a = _mm256_min_ps(_mm256_andnot_ps(signMask, f), maxHalf);
+            __m256i ua = _mm256_castps_si256(a);
+
+            __m256i normal = _mm256_srli_epi32(_mm256_sub_epi32(ua, expAdjust), 13);
+            __m256i denorm = _mm256_cvttps_epi32(_mm256_mul_ps(a, denormScale));
+
+            __m256i bits = Select256(_mm256_cmpgt_epi32(minNormal, ua), denorm, normal);
+            bits = _mm256_or_si256(_mm256_andnot_si256(nan, bits), sign);
+
+            // every lane is already in 0..0xffff so the unsigned pack is exact,
+            // it works per 128 bit lane so the two halves are gathered afterwards
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(bits, bits), 0x08);
+            _mm_storeu_si128((__m128i*)(pOut + i), _mm256_castsi256_si128(packed));
+        }
+
+        FloatToHalf_SSE2(pIn + i, pOut + i, nCount - i);
+    }
+
+    MDL_TARGET("avx,f16c")
+    void HalfToFloat_F16C(const unsigned short* pIn, float* pOut, int nCount)
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 infinity = _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800000));
+        const __m256 maxHalf = _mm256_set1_ps(maxfloat16bits);
+
+        int i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m256 f = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(pIn + i)));
+
+            __m256 isInf = _mm256_cmp_ps(_mm256_andnot_ps(signMask, f), infinity, _CMP_EQ_OQ);
+            f = _mm256_blendv_ps(f, _mm256_or_ps(_mm256_and_ps(f, signMask), maxHalf), isInf);
+            f = _mm256_andnot_ps(_mm256_cmp_ps(f, f, _CMP_UNORD_Q), f);
+
+            _mm256_storeu_ps(pOut + i, f);
+        }
+
+        HalfToFloat_Scalar(pIn + i, pOut + i, nCount - i);
+    }
+
+    MDL_TARGET("avx,f16c")
+    void FloatToHalf_F16C(const float* pIn, unsigned short* pOut, int nCount)
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 maxHalf = _mm256_set1_ps(maxfloat16bits);
+        const __m256 minHalf = _mm256_set1_ps(-maxfloat16bits);
+
+        int i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m256 f = _mm256_loadu_ps(pIn + i);
+
+            f = _mm256_blendv_ps(f, _mm256_and_ps(f, signMask), _mm256_cmp_ps(f, f, _CMP_UNORD_Q));
+            f = _mm256_min_ps(_mm256_max_ps(f, minHalf), maxHalf);
+
+            // the reference truncates the mantissa rather than rounding
+            __m128i h = _mm256_cvtps_ph(f, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+            _mm_storeu_si128((__m128i*)(pOut + i), h);
+        }
+
+        FloatToHalf_Scalar(pIn + i, pOut + i, nCount - i);
+    }
+#endif
+
+    // the integer AVX2 kernels beat F16C once the saturation fixups are added,
+    // F16C is still the best choice on AVX hosts without AVX2
+    struct CFloat16Kernels
+    {
+        CFloat16Kernel m_Kernels[4];
+        int m_nCount = 0;
+
+        CFloat16Kernels()
+        {
+#ifdef MDL_X86
+            const CPUInformation& cpu = GetCPUInformation();
+
+            if (cpu.m_bAVX2)
+                m_Kernels[m_nCount++] = CFloat16Kernel{ "avx2", HalfToFloat_AVX2, FloatToHalf_AVX2 };
+            if (cpu.m_bF16C)
+                m_Kernels[m_nCount++] = CFloat16Kernel{ "f16c", HalfToFloat_F16C, FloatToHalf_F16C };
+            if (cpu.m_bSSE2)
+                m_Kernels[m_nCount++] = CFloat16Kernel{ "sse2", HalfToFloat_SSE2, FloatToHalf_SSE2 };
+#endif
+            m_Kernels[m_nCount++] = CFloat16Kernel{ "scalar", HalfToFloat_Scalar, FloatToHalf_Scalar };
+        }
+    };
+
+    const CFloat16Kernels& Kernels()
+    {
+        static const CFloat16Kernels kernels;
+        return kernels;
+    }
+}
+
+int GetFloat16Kernels(const CFloat16Kernel** ppKernels)
+{
+    *ppKernels = Kernels().m_Kernels;
+    return Kernels().m_nCount;
+}
+
+void ConvertFloat16ToFloat32(const unsigned short* pIn, float* pOut, int nCount)
+{
+    static const HalfToFloatFn pfnConvert = Kernels().m_Kernels[0].m_pfnHalfToFloat;
+
+    if (nCount > 0)
+        pfnConvert(pIn, pOut, nCount);
+}
+
+void ConvertFloat32ToFloat16(const float* pIn, unsigned short* pOut, int nCount)
+{
+    static const FloatToHalfFn pfnConvert = Kernels().m_Kernels[0].m_pfnFloatToHalf;
+
+    if (nCount > 0)
+        pfnConvert(pIn, pOut, nCount);
+}
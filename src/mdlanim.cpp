@@ -0,0 +1,434 @@
+#include "mdlanim.h"
+#include "mdlanimblock.h"
+#include "mdlmath.h"
+#include "mdlskeleton.h"
+#include "valve/studio.h"
+#include "valve/compressed_vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static_assert(POSE_MAX_BONES == MAXSTUDIOBONES, "pose buffers must hold every studio bone");
+
+namespace
+{
+    // decodes one channel of run length encoded animation data at a frame, and the frame after it
+    void ExtractAnimValue(int frame, mstudioanimvalue_t* panimvalue, float scale, float& v1, float& v2)
+    {
+        if (!panimvalue)
+        {
+            v1 = v2 = 0;
+            return;
+        }
+
+        int k = frame;
+
+        // find the data list that has the frame
+        while (panimvalue->num.total <= k)
+        {
+            k -= panimvalue->num.total;
+            panimvalue += panimvalue->num.valid + 1;
+
+            // running off the end of the animation stream
+            if (panimvalue->num.total == 0)
+            {
+                v1 = v2 = 0;
+                return;
+            }
+        }
+
+        if (panimvalue->num.valid > k)
+        {
+            // has valid animation data
+            v1 = panimvalue[k + 1].value * scale;
+
+            if (panimvalue->num.valid > k + 1)
+                v2 = panimvalue[k + 2].value * scale; // has valid animation blend data
+            else if (panimvalue->num.total > k + 1)
+                v2 = v1; // data repeats, no blend
+            else
+                v2 = panimvalue[panimvalue->num.valid + 2].value * scale; // pull blend from first data block in next list
+        }
+        else
+        {
+            // get last valid data block
+            v1 = panimvalue[panimvalue->num.valid].value * scale;
+
+            if (panimvalue->num.total > k + 1)
+                v2 = v1;
+            else
+                v2 = panimvalue[panimvalue->num.valid + 2].value * scale;
+        }
+    }
+
+    void CalcBoneQuaternion(int frame, float s, const mstudiobone_t* pBone, const mstudioanim_t* panim, Quaternion& q)
+    {
+        if (panim->flags & STUDIO_ANIM_RAWROT)
+        {
+            q = *(panim->pQuat48());
+            return;
+        }
+
+        if (panim->flags & STUDIO_ANIM_RAWROT2)
+        {
+            q = *(panim->pQuat64());
+            return;
+        }
+
+        if (!(panim->flags & STUDIO_ANIM_ANIMROT))
+        {
+            if (panim->flags & STUDIO_ANIM_DELTA)
+                q = Quaternion{ 0.0f, 0.0f, 0.0f, 1.0f };
+            else
+                q = pBone->quat;
+
+            return;
+        }
+
+        mstudioanim_valueptr_t* pValues = panim->pRotV();
+
+        float a1[3], a2[3];
+        const float* pScale = &pBone->rotscale.x;
+        const float* pBase = &pBone->rot.x;
+
+        for (int j = 0; j < 3; j++)
+        {
+            ExtractAnimValue(frame, pValues->pAnimvalue(j), pScale[j], a1[j], a2[j]);
+
+            if (!(panim->flags & STUDIO_ANIM_DELTA))
+            {
+                a1[j] += pBase[j];
+                a2[j] += pBase[j];
+            }
+        }
+
+        if (s > 0.001f && (a1[0] != a2[0] || a1[1] != a2[1] || a1[2] != a2[2]))
+        {
+            Quaternion q1, q2;
+            AngleQuaternion(RadianEuler{ a1[0], a1[1], a1[2] }, q1);
+            AngleQuaternion(RadianEuler{ a2[0], a2[1], a2[2] }, q2);
+            QuaternionBlend(q1, q2, s, q);
+        }
+        else
+        {
+            AngleQuaternion(RadianEuler{ a1[0], a1[1], a1[2] }, q);
+        }
+
+        // align to unified bone
+        if (!(panim->flags & STUDIO_ANIM_DELTA) && (pBone->flags & BONE_FIXED_ALIGNMENT))
+            QuaternionAlign(pBone->qAlignment, q, q);
+    }
+
+    void CalcBonePosition(int frame, float s, const mstudiobone_t* pBone, const mstudioanim_t* panim, Vector& pos)
+    {
+        if (panim->flags & STUDIO_ANIM_RAWPOS)
+        {
+            pos = *(panim->pPos());
+            return;
+        }
+
+        if (!(panim->flags & STUDIO_ANIM_ANIMPOS))
+        {
+            if (panim->flags & STUDIO_ANIM_DELTA)
+                pos = Vector(0.0f);
+            else
+                pos = pBone->pos;
+
+            return;
+        }
+
+        mstudioanim_valueptr_t* pValues = panim->pPosV();
+
+        float* pOut = &pos.x;
+        const float* pScale = &pBone->posscale.x;
+        const float* pBase = &pBone->pos.x;
+
+        for (int j = 0; j < 3; j++)
+        {
+            float v1, v2;
+            ExtractAnimValue(frame, pValues->pAnimvalue(j), pScale[j], v1, v2);
+
+            pOut[j] = (s > 0.001f) ? v1 * (1.0f - s) + v2 * s : v1;
+
+            if (!(panim->flags & STUDIO_ANIM_DELTA))
+                pOut[j] += pBase[j];
+        }
+    }
+
+    inline void StorePoseBone(CBonePose& pose, int i, const Quaternion& q, const Vector& pos)
+    {
+        pose.m_qx[i] = q.x;
+        pose.m_qy[i] = q.y;
+        pose.m_qz[i] = q.z;
+        pose.m_qw[i] = q.w;
+
+        pose.m_px[i] = pos.x;
+        pose.m_py[i] = pos.y;
+        pose.m_pz[i] = pos.z;
+    }
+
+    // blends the animation's saved zero frames into the pose. the .mdl keeps a
+    // low resolution copy of the first frame of every span so something can be
+    // shown while the real data is paged in from the .ani
+    void CalcZeroFrameData(const studiohdr_t* pMdl, const mstudioanimdesc_t* pAnimDesc, float flFrame, float flWeight, CBonePose& pose)
+    {
+        const byte* pData = pAnimDesc->pZeroFrameData();
+
+        if (!pData || pAnimDesc->zeroframecount <= 0)
+            return;
+
+        // frames between two saved spans are interpolated linearly
+        int nCount = pAnimDesc->zeroframecount;
+        int i0 = 0, i1 = 0;
+        float s = 0.0f;
+
+        if (nCount > 1 && pAnimDesc->zeroframespan > 0)
+        {
+            i0 = std::min((int)(flFrame / pAnimDesc->zeroframespan), nCount - 2);
+            i1 = i0 + 1;
+            s = std::min(std::max((flFrame - i0 * pAnimDesc->zeroframespan) / pAnimDesc->zeroframespan, 0.0f), 1.0f);
+        }
+
+        int nBones = pMdl->numbones < POSE_MAX_BONES ? pMdl->numbones : POSE_MAX_BONES;
+
+        for (int i = 0; i < pMdl->numbones; i++)
+        {
+            int iFlags = pMdl->pBone(i)->flags;
+
+            if (iFlags & BONE_HAS_SAVEFRAME_POS)
+            {
+                Vector48 p0, p1;
+                memcpy(&p0, pData + i0 * sizeof(Vector48), sizeof(Vector48));
+                memcpy(&p1, pData + i1 * sizeof(Vector48), sizeof(Vector48));
+
+                if (i < nBones)
+                {
+                    Vector a = p0, b = p1;
+                    Vector p = a * (1.0f - s) + b * s;
+
+                    pose.m_px[i] = pose.m_px[i] * (1.0f - flWeight) + p.x * flWeight;
+                    pose.m_py[i] = pose.m_py[i] * (1.0f - flWeight) + p.y * flWeight;
+                    pose.m_pz[i] = pose.m_pz[i] * (1.0f - flWeight) + p.z * flWeight;
+                }
+
+                pData += sizeof(Vector48) * nCount;
+            }
+
+            if (iFlags & BONE_HAS_SAVEFRAME_ROT)
+            {
+                Quaternion64 q0, q1;
+                memcpy(&q0, pData + i0 * sizeof(Quaternion64), sizeof(Quaternion64));
+                memcpy(&q1, pData + i1 * sizeof(Quaternion64), sizeof(Quaternion64));
+
+                if (i < nBones)
+                {
+                    Quaternion a = q0, b = q1, q;
+                    QuaternionBlend(a, b, s, q);
+
+                    Quaternion cur{ pose.m_qx[i], pose.m_qy[i], pose.m_qz[i], pose.m_qw[i] };
+                    QuaternionBlend(cur, q, flWeight, cur);
+
+                    pose.m_qx[i] = cur.x;
+                    pose.m_qy[i] = cur.y;
+                    pose.m_qz[i] = cur.z;
+                    pose.m_qw[i] = cur.w;
+                }
+
+                pData += sizeof(Quaternion64) * nCount;
+            }
+        }
+    }
+}
+
+void Studio_InitPose(const studiohdr_t* pMdl, CBonePose& pose, bool bDelta)
+{
+    int nBones = pMdl->numbones < POSE_MAX_BONES ? pMdl->numbones : POSE_MAX_BONES;
+
+    for (int i = 0; i < nBones; i++)
+    {
+        if (bDelta)
+        {
+            StorePoseBone(pose, i, Quaternion{ 0.0f, 0.0f, 0.0f, 1.0f }, Vector(0.0f));
+        }
+        else
+        {
+            const mstudiobone_t* pBone = pMdl->pBone(i);
+            StorePoseBone(pose, i, pBone->quat, pBone->pos);
+        }
+    }
+}
+
+void Studio_InitPose(const CSkeletonLayout& layout, CBonePose& pose)
+{
+    int nBones = std::min(layout.BoneCount(), POSE_MAX_BONES);
+
+    for (int i = 0; i < nBones; i++)
+        StorePoseBone(pose, i, layout.RestRotation(i), layout.RestPosition(i));
+}
+
+mstudioanim_t* Studio_AnimData(const mstudioanimdesc_t* pAnimDesc, int* piFrame, CAnimBlockCache* pBlocks, float* pflStall)
+{
+    int block = pAnimDesc->animblock;
+    int index = pAnimDesc->animindex;
+    int section = 0;
+
+    if (pAnimDesc->sectionframes != 0)
+    {
+        if (pAnimDesc->numframes > pAnimDesc->sectionframes && *piFrame == pAnimDesc->numframes - 1)
+        {
+            // last frame on long anims is stored separately
+            *piFrame = 0;
+            section = (pAnimDesc->numframes / pAnimDesc->sectionframes) + 1;
+        }
+        else
+        {
+            section = *piFrame / pAnimDesc->sectionframes;
+            *piFrame -= section * pAnimDesc->sectionframes;
+        }
+
+        block = pAnimDesc->pSection(section)->animblock;
+        index = pAnimDesc->pSection(section)->animindex;
+    }
+
+    if (pflStall)
+        *pflStall = 0.0f;
+
+    if (block == -1)
+        return NULL;
+
+    if (block == 0)
+        return (mstudioanim_t*)(((byte*)pAnimDesc) + index);
+
+    // anything else lives in the external .ani file
+    const char* pBlock = pBlocks ? pBlocks->Block(block) : NULL;
+    mstudioanim_t* panim = pBlock ? (mstudioanim_t*)(pBlock + index) : NULL;
+
+    if (pBlocks && pAnimDesc->sectionframes != 0)
+    {
+        // warm the next block this animation plays into
+        int count = (pAnimDesc->numframes / pAnimDesc->sectionframes) + 2;
+        for (int i = section + 1; i < count; i++)
+        {
+            if (pAnimDesc->pSection(i)->animblock != block)
+            {
+                pBlocks->Prefetch(pAnimDesc->pSection(i)->animblock);
+                break;
+            }
+        }
+    }
+
+    if (!panim && pBlocks)
+    {
+        // hold the last frame of the closest earlier section that is resident
+        while (--section >= 0)
+        {
+            const char* pEarlier = pBlocks->Block(pAnimDesc->pSection(section)->animblock);
+
+            if (pEarlier)
+            {
+                panim = (mstudioanim_t*)(pEarlier + pAnimDesc->pSection(section)->animindex);
+                *piFrame = pAnimDesc->sectionframes - 1;
+                break;
+            }
+        }
+    }
+
+    // same stall bookkeeping as the engine: stall fully while nothing is there,
+    // then fade out the zero frame over 0.2 seconds once the data arrives
+    float flStall = 0.0f;
+
+    if (!panim && section <= 0)
+    {
+        pAnimDesc->zeroframestalltime = CAnimBlockCache::Time();
+        flStall = 1.0f;
+    }
+    else if (panim && pAnimDesc->zeroframestalltime != 0.0f)
+    {
+        float dt = CAnimBlockCache::Time() - pAnimDesc->zeroframestalltime;
+
+        if (dt >= 0.0f)
+        {
+            float v = std::min(std::max((0.2f - dt) * 5.0f, 0.0f), 1.0f);
+            flStall = v * v * (3.0f - 2.0f * v);
+        }
+
+        if (flStall == 0.0f)
+            pAnimDesc->zeroframestalltime = 0.0f;
+    }
+
+    if (pflStall)
+        *pflStall = flStall;
+
+    return panim;
+}
+
+bool Studio_CalcAnimation(const studiohdr_t* pMdl, int iAnim, float flCycle, CBonePose& pose, CAnimBlockCache* pBlocks)
+{
+    if (iAnim < 0 || iAnim >= pMdl->numlocalanim)
+    {
+        Studio_InitPose(pMdl, pose);
+        return false;
+    }
+
+    const mstudioanimdesc_t* pAnimDesc = pMdl->pLocalAnimdesc(iAnim);
+    bool bDelta = (pAnimDesc->flags & STUDIO_DELTA) != 0;
+
+    if (pAnimDesc->numframes <= 0)
+    {
+        Studio_InitPose(pMdl, pose, bDelta);
+        return false;
+    }
+
+    flCycle = flCycle < 0.0f ? 0.0f : (flCycle > 1.0f ? 1.0f : flCycle);
+
+    float flFrame = flCycle * (pAnimDesc->numframes - 1);
+    int iFrame = (int)flFrame;
+    float s = flFrame - iFrame;
+
+    float flStall;
+    mstudioanim_t* panim = Studio_AnimData(pAnimDesc, &iFrame, pBlocks, &flStall);
+
+    if (!panim)
+    {
+        // the low resolution copy kept in the .mdl stands in until the block arrives
+        Studio_InitPose(pMdl, pose, bDelta);
+        CalcZeroFrameData(pMdl, pAnimDesc, flFrame, 1.0f, pose);
+        return false;
+    }
+
+    int nBones = pMdl->numbones < POSE_MAX_BONES ? pMdl->numbones : POSE_MAX_BONES;
+
+    for (int i = 0; i < nBones; i++)
+    {
+        const mstudiobone_t* pBone = pMdl->pBone(i);
+
+        Quaternion q;
+        Vector pos;
+
+        if (panim && panim->bone == i)
+        {
+            CalcBoneQuaternion(iFrame, s, pBone, panim, q);
+            CalcBonePosition(iFrame, s, pBone, panim, pos);
+
+            panim = panim->pNext();
+        }
+        else if (bDelta)
+        {
+            q = Quaternion{ 0.0f, 0.0f, 0.0f, 1.0f };
+            pos = Vector(0.0f);
+        }
+        else
+        {
+            q = pBone->quat;
+            pos = pBone->pos;
+        }
+
+        StorePoseBone(pose, i, q, pos);
+    }
+
+    if (flStall > 0.0f)
+        CalcZeroFrameData(pMdl, pAnimDesc, flFrame, flStall, pose);
+
+    return true;
+}
@@ -0,0 +1,304 @@
+#include "mdlanimblock.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+CAnimBlockCache::CAnimBlockCache(const CModel& model, size_t nBudgetBytes) : m_Model(model), m_nBudget(nBudgetBytes)
+{
+}
+
+CAnimBlockCache::~CAnimBlockCache()
+{
+    Close();
+}
+
+float CAnimBlockCache::Time()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return 1.0f + std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool CAnimBlockCache::Open()
+{
+    const studiohdr_t* pMdl = m_Model.StudioHdr();
+
+    if (!pMdl || pMdl->numanimblocks <= 1 || pMdl->szanimblocknameindex == 0)
+        return false;
+
+    std::string filename = FindGameFile(m_Model.FileName(), pMdl->pszAnimBlockName());
+    return !filename.empty() && Open(filename);
+}
+
+bool CAnimBlockCache::Open(const std::string& filename)
+{
+    Close();
+
+    const studiohdr_t* pMdl = m_Model.StudioHdr();
+
+    if (!pMdl || pMdl->numanimblocks <= 1 || !m_File.Open(filename))
+        return false;
+
+    m_iBlockCount = pMdl->numanimblocks;
+    m_pBlocks.reset(new CBlock[m_iBlockCount]);
+
+    for (int i = 1; i < m_iBlockCount; i++)
+    {
+        const mstudioanimblock_t* pBlock = pMdl->pAnimBlock(i);
+
+        // blocks that don't fit in the file stay empty and never load
+        if (pBlock->datastart < 0 || pBlock->dataend <= pBlock->datastart || (size_t)pBlock->dataend > m_File.Size())
+            continue;
+
+        m_pBlocks[i].m_nStart = (size_t)pBlock->datastart;
+        m_pBlocks[i].m_nSize = (size_t)(pBlock->dataend - pBlock->datastart);
+    }
+
+    return true;
+}
+
+void CAnimBlockCache::Close()
+{
+    StopThread();
+
+    for (int i = 0; i < m_iBlockCount; i++)
+        delete[] m_pBlocks[i].m_pData.exchange(nullptr);
+
+    m_pBlocks.reset();
+    m_iBlockCount = 0;
+    m_nResidentBytes = 0;
+
+    m_File.Close();
+}
+
+void CAnimBlockCache::StopThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStop = true;
+        m_Queue.clear();
+    }
+
+    m_Wake.notify_all();
+
+    if (m_Thread.joinable())
+        m_Thread.join();
+
+    m_bStop = false;
+}
+
+// the background thread only takes blocks still queued, an entry left behind by
+// a blocking load may since have been evicted and belong to nobody
+void CAnimBlockCache::Load(int iBlock, bool bQueued)
+{
+    CBlock& block = m_pBlocks[iBlock];
+
+    int iState = block.m_iState.load();
+    if ((iState != BLOCK_QUEUED && (bQueued || iState != BLOCK_EMPTY)) || !block.m_iState.compare_exchange_strong(iState, BLOCK_LOADING))
+        return;
+
+    char* pData = new char[block.m_nSize];
+    memcpy(pData, m_File.Data() + block.m_nStart, block.m_nSize);
+
+    block.m_pData.store(pData);
+    block.m_iState.store(BLOCK_RESIDENT);
+
+    m_nLoads++;
+
+    size_t nResident = (m_nResidentBytes += block.m_nSize);
+    size_t nPeak = m_nPeakResidentBytes.load();
+    while (nResident > nPeak && !m_nPeakResidentBytes.compare_exchange_weak(nPeak, nResident))
+        ;
+
+    float flMissTime = block.m_flMissTime.exchange(0.0f);
+    if (flMissTime != 0.0f)
+        m_nStallMicroseconds += (uint64_t)((Time() - flMissTime) * 1e6f);
+}
+
+void CAnimBlockCache::ThreadMain()
+{
+    for (;;)
+    {
+        int iBlock;
+
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Wake.wait(lock, [this] { return m_bStop || !m_Queue.empty(); });
+
+            if (m_bStop)
+                return;
+
+            iBlock = m_Queue.front();
+            m_Queue.pop_front();
+        }
+
+        Load(iBlock, true);
+    }
+}
+
+void CAnimBlockCache::Queue(int iBlock)
+{
+    CBlock& block = m_pBlocks[iBlock];
+
+    int iState = BLOCK_EMPTY;
+    if (block.m_nSize == 0 || !block.m_iState.compare_exchange_strong(iState, BLOCK_QUEUED))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (!m_Thread.joinable())
+            m_Thread = std::thread(&CAnimBlockCache::ThreadMain, this);
+
+        m_Queue.push_back(iBlock);
+    }
+
+    m_Wake.notify_one();
+}
+
+const char* CAnimBlockCache::Block(int iBlock, bool bBlocking)
+{
+    if (iBlock <= 0 || iBlock >= m_iBlockCount)
+        return nullptr;
+
+    CBlock& block = m_pBlocks[iBlock];
+
+    m_nRequests++;
+    block.m_nLastUse.store(m_nFrame, std::memory_order_relaxed);
+
+    if (block.m_iState.load() == BLOCK_RESIDENT)
+    {
+        m_nHits++;
+        return block.m_pData.load();
+    }
+
+    if (block.m_nSize == 0)
+        return nullptr;
+
+    m_nStalls++;
+
+    float flExpected = 0.0f;
+    block.m_flMissTime.compare_exchange_strong(flExpected, Time());
+
+    if (!bBlocking)
+    {
+        Queue(iBlock);
+        return nullptr;
+    }
+
+    Load(iBlock, false);
+
+    // the background thread may have had it mid copy
+    while (block.m_iState.load() != BLOCK_RESIDENT)
+    {
+        std::this_thread::yield();
+        Load(iBlock, false);
+    }
+
+    return block.m_pData.load();
+}
+
+bool CAnimBlockCache::IsResident(int iBlock) const
+{
+    return iBlock > 0 && iBlock < m_iBlockCount && m_pBlocks[iBlock].m_iState.load() == BLOCK_RESIDENT;
+}
+
+void CAnimBlockCache::Prefetch(int iBlock)
+{
+    if (iBlock <= 0 || iBlock >= m_iBlockCount)
+        return;
+
+    if (m_pBlocks[iBlock].m_iState.load() == BLOCK_EMPTY)
+        m_nPrefetches++;
+
+    // a block that's about to be needed shouldn't be the next one evicted
+    m_pBlocks[iBlock].m_nLastUse.store(m_nFrame, std::memory_order_relaxed);
+
+    Queue(iBlock);
+}
+
+void CAnimBlockCache::PrefetchAnimation(int iAnim)
+{
+    const studiohdr_t* pMdl = m_Model.StudioHdr();
+
+    if (!pMdl || iAnim < 0 || iAnim >= pMdl->numlocalanim)
+        return;
+
+    const mstudioanimdesc_t* pAnimDesc = pMdl->pLocalAnimdesc(iAnim);
+
+    if (pAnimDesc->sectionframes == 0)
+    {
+        Prefetch(pAnimDesc->animblock);
+        return;
+    }
+
+    int nSections = pAnimDesc->numframes / pAnimDesc->sectionframes + 2;
+    for (int i = 0; i < nSections; i++)
+        Prefetch(pAnimDesc->pSection(i)->animblock);
+}
+
+void CAnimBlockCache::PrefetchSequence(int iSequence)
+{
+    const std::vector<CSequence>& sequences = m_Model.GetSequences();
+
+    if (iSequence < 0 || iSequence >= (int)sequences.size())
+        return;
+
+    for (int iAnim : sequences[iSequence].m_vecAnims)
+        PrefetchAnimation(iAnim);
+}
+
+void CAnimBlockCache::Update()
+{
+    m_nFrame++;
+
+    if (m_nResidentBytes.load() <= m_nBudget)
+        return;
+
+    std::vector<int> vecResident;
+    for (int i = 1; i < m_iBlockCount; i++)
+    {
+        if (m_pBlocks[i].m_iState.load() == BLOCK_RESIDENT)
+            vecResident.push_back(i);
+    }
+
+    std::sort(vecResident.begin(), vecResident.end(), [this](int a, int b) { return m_pBlocks[a].m_nLastUse.load() < m_pBlocks[b].m_nLastUse.load(); });
+
+    for (int i : vecResident)
+    {
+        if (m_nResidentBytes.load() <= m_nBudget)
+            break;
+
+        CBlock& block = m_pBlocks[i];
+
+        int iState = BLOCK_RESIDENT;
+        if (!block.m_iState.compare_exchange_strong(iState, BLOCK_EVICTING))
+            continue;
+
+        // freed before the block reads as empty, so a load can't store a buffer this then frees
+        delete[] block.m_pData.exchange(nullptr);
+
+        m_nResidentBytes -= block.m_nSize;
+        m_nEvictions++;
+
+        block.m_iState.store(BLOCK_EMPTY);
+    }
+}
+
+CAnimBlockStats CAnimBlockCache::Stats() const
+{
+    CAnimBlockStats stats;
+    stats.m_nRequests = m_nRequests.load();
+    stats.m_nHits = m_nHits.load();
+    stats.m_nStalls = m_nStalls.load();
+    stats.m_nLoads = m_nLoads.load();
+    stats.m_nPrefetches = m_nPrefetches.load();
+    stats.m_nEvictions = m_nEvictions.load();
+    stats.m_flStallTime = m_nStallMicroseconds.load() / 1e6;
+    stats.m_nResidentBytes = m_nResidentBytes.load();
+    stats.m_nPeakResidentBytes = m_nPeakResidentBytes.load();
+    return stats;
+}
@@ -0,0 +1,101 @@
+#include "mdlattachment.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+namespace
+{
+    // rows of the attachment's local matrix with the implicit (0, 0, 0, 1) as the fourth
+    struct CLocalRows
+    {
+        fltx4 b[4];
+        bool bWorldAlign;
+    };
+
+    void LoadLocalRows(const CAttachment& attachment, CLocalRows& rows)
+    {
+        float lastRow[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+        for (int i = 0; i < 3; i++)
+            rows.b[i] = LoadUnalignedSIMD(attachment.m_matLocal[i]);
+
+        rows.b[3] = LoadUnalignedSIMD(lastRow);
+        rows.bWorldAlign = (attachment.m_iFlags & ATTACHMENT_FLAG_WORLD_ALIGN) != 0;
+    }
+
+    inline void AttachmentToWorld(const CLocalRows& rows, const matrix3x4_t& bone, matrix3x4_t& out)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            const float* a = bone[i];
+            fltx4 row = MulSIMD(ReplicateX4(a[0]), rows.b[0]);
+            row = MaddSIMD(ReplicateX4(a[1]), rows.b[1], row);
+            row = MaddSIMD(ReplicateX4(a[2]), rows.b[2], row);
+            row = MaddSIMD(ReplicateX4(a[3]), rows.b[3], row);
+            StoreUnalignedSIMD(out[i], row);
+        }
+
+        // world aligned attachments only follow the bone's position
+        if (rows.bWorldAlign)
+        {
+            out[0][0] = 1.0f; out[0][1] = 0.0f; out[0][2] = 0.0f;
+            out[1][0] = 0.0f; out[1][1] = 1.0f; out[1][2] = 0.0f;
+            out[2][0] = 0.0f; out[2][1] = 0.0f; out[2][2] = 1.0f;
+        }
+    }
+
+    const CAttachment* FindValidAttachment(const CModel& model, int iAttachment)
+    {
+        const std::vector<CAttachment>& attachments = model.GetAttachments();
+
+        if (iAttachment < 0 || iAttachment >= (int)attachments.size())
+            return nullptr;
+
+        const CAttachment& attachment = attachments[iAttachment];
+
+        if (attachment.m_iBone < 0 || attachment.m_iBone >= model.GetSkeletonLayout().BoneCount())
+            return nullptr;
+
+        return &attachment;
+    }
+}
+
+bool Studio_AttachmentTransform(const CModel& model, int iAttachment, const matrix3x4_t* pBoneToWorld, matrix3x4_t& out)
+{
+    const CAttachment* pAttachment = FindValidAttachment(model, iAttachment);
+
+    if (!pAttachment)
+        return false;
+
+    CLocalRows rows;
+    LoadLocalRows(*pAttachment, rows);
+
+    AttachmentToWorld(rows, pBoneToWorld[pAttachment->m_iBone], out);
+    return true;
+}
+
+void Studio_AttachmentTransforms(const CModel& model, const int* pAttachments, int nAttachments,
+    const matrix3x4_t* const* ppBoneToWorld, int nEntities, matrix3x4_t* pOut)
+{
+    // attachment outer so its local matrix is loaded once for the whole batch
+    for (int i = 0; i < nAttachments; i++)
+    {
+        const CAttachment* pAttachment = FindValidAttachment(model, pAttachments[i]);
+
+        if (!pAttachment)
+        {
+            for (int e = 0; e < nEntities; e++)
+                SetIdentityMatrix(pOut[e * nAttachments + i]);
+
+            continue;
+        }
+
+        CLocalRows rows;
+        LoadLocalRows(*pAttachment, rows);
+
+        int iBone = pAttachment->m_iBone;
+
+        for (int e = 0; e < nEntities; e++)
+            AttachmentToWorld(rows, ppBoneToWorld[e][iBone], pOut[e * nAttachments + i]);
+    }
+}
@@ -0,0 +1,291 @@
+#include "mdlblend.h"
+#include "mdlobj.h"
+#include "mdlmath.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <cmath>
+
+CBlendSpace::CBlendSpace(const CModel& model) : m_Model(model)
+{
+    const std::vector<CPoseParameter>& poses = model.GetPoseParameters();
+    const std::vector<CSequence>& sequences = model.GetSequences();
+
+    m_iPoseParameterCount = (int)poses.size();
+    m_vecSequences.reserve(sequences.size());
+
+    for (const CSequence& seq : sequences)
+    {
+        CBlendSequence blend;
+
+        blend.m_iAnimOffset = (int)m_vecAnims.size();
+        m_vecAnims.insert(m_vecAnims.end(), seq.m_vecAnims.begin(), seq.m_vecAnims.end());
+
+        for (int iAxis = 0; iAxis < 2; iAxis++)
+        {
+            CBlendAxis& axis = blend.m_Axes[iAxis];
+
+            int iPose = seq.m_iParamIndex[iAxis];
+            axis.m_iPose = (iPose >= 0 && iPose < m_iPoseParameterCount) ? iPose : -1;
+            axis.m_iGroupSize = std::max(seq.m_iGroupSize[iAxis], 1);
+            axis.m_iKeyOffset = -1;
+            axis.m_flScale = 0.0f;
+            axis.m_flBias = 0.0f;
+            axis.m_flLoop = 0.0f;
+            axis.m_flLoopShift = 0.0f;
+
+            if (axis.m_iPose < 0)
+                continue;
+
+            const CPoseParameter& pose = poses[axis.m_iPose];
+
+            if (pose.m_flLoop != 0.0f)
+            {
+                float flWrap = (pose.m_flStart + pose.m_flEnd) / 2.0f + pose.m_flLoop / 2.0f;
+
+                axis.m_flLoop = pose.m_flLoop;
+                axis.m_flLoopShift = pose.m_flLoop - flWrap;
+            }
+
+            if (!seq.m_vecPoseKeys.empty())
+            {
+                // irregular grid, cells are found by searching the keys
+                axis.m_iKeyOffset = (int)m_vecPoseKeys.size();
+
+                for (int i = 0; i < axis.m_iGroupSize; i++)
+                    m_vecPoseKeys.push_back(seq.m_vecPoseKeys[iAxis * seq.m_iGroupSize[0] + i]);
+            }
+            else if (seq.m_flParamEnd[iAxis] != seq.m_flParamStart[iAxis])
+            {
+                axis.m_flScale = 1.0f / (seq.m_flParamEnd[iAxis] - seq.m_flParamStart[iAxis]);
+                axis.m_flBias = -seq.m_flParamStart[iAxis] * axis.m_flScale;
+            }
+        }
+
+        blend.m_iCyclePose = -1;
+        blend.m_flCycleScale = 1.0f;
+        blend.m_flCycleBias = 0.0f;
+
+        int iCyclePose = seq.m_iCyclePoseIndex;
+        if ((seq.m_iFlags & STUDIO_CYCLEPOSE) && iCyclePose >= 0 && iCyclePose < m_iPoseParameterCount)
+        {
+            const CPoseParameter& pose = poses[iCyclePose];
+
+            if (pose.m_flEnd != pose.m_flStart)
+            {
+                blend.m_iCyclePose = iCyclePose;
+                blend.m_flCycleScale = 1.0f / (pose.m_flEnd - pose.m_flStart);
+                blend.m_flCycleBias = -pose.m_flStart * blend.m_flCycleScale;
+            }
+        }
+
+        m_vecSequences.push_back(blend);
+    }
+}
+
+void CBlendSpace::AxisSetting(const CBlendAxis& axis, const float* pPoseParameters, int& iIndex, float& flSetting) const
+{
+    iIndex = 0;
+    flSetting = 0.0f;
+
+    if (axis.m_iPose < 0 || axis.m_iGroupSize < 2)
+        return;
+
+    float flValue = pPoseParameters[axis.m_iPose];
+
+    if (axis.m_flLoop != 0.0f)
+        flValue = flValue - axis.m_flLoop * floorf((flValue + axis.m_flLoopShift) / axis.m_flLoop);
+
+    if (axis.m_iKeyOffset < 0)
+    {
+        flSetting = std::min(std::max(flValue * axis.m_flScale + axis.m_flBias, 0.0f), 1.0f);
+
+        if (axis.m_iGroupSize > 2)
+        {
+            float flScaled = flSetting * (axis.m_iGroupSize - 1);
+
+            iIndex = std::min((int)flScaled, axis.m_iGroupSize - 2);
+            flSetting = flScaled - iIndex;
+        }
+    }
+    else
+    {
+        // first cell whose upper key reaches the value, the last cell takes anything beyond it
+        const float* pKeys = m_vecPoseKeys.data() + axis.m_iKeyOffset;
+        const float* pUpper = std::lower_bound(pKeys + 1, pKeys + axis.m_iGroupSize - 1, flValue);
+
+        iIndex = (int)(pUpper - (pKeys + 1));
+
+        float flRange = pKeys[iIndex + 1] - pKeys[iIndex];
+        flSetting = flRange != 0.0f ? (flValue - pKeys[iIndex]) / flRange : 0.0f;
+        flSetting = std::min(std::max(flSetting, 0.0f), 1.0f);
+    }
+}
+
+bool CBlendSpace::FindCell(int iSequence, const float* pPoseParameters, CBlendCell& cell) const
+{
+    if (iSequence < 0 || iSequence >= (int)m_vecSequences.size())
+        return false;
+
+    const CBlendSequence& blend = m_vecSequences[iSequence];
+
+    int i0, i1;
+    float s0, s1;
+    AxisSetting(blend.m_Axes[0], pPoseParameters, i0, s0);
+    AxisSetting(blend.m_Axes[1], pPoseParameters, i1, s1);
+
+    int iSizeX = blend.m_Axes[0].m_iGroupSize;
+    int iSizeY = blend.m_Axes[1].m_iGroupSize;
+    const int* pAnims = m_vecAnims.data() + blend.m_iAnimOffset;
+
+    // same clamping as mstudioseqdesc_t::anim()
+    auto Anim = [&](int x, int y) { return pAnims[std::min(y, iSizeY - 1) * iSizeX + std::min(x, iSizeX - 1)]; };
+
+    cell.m_iAnims[0] = Anim(i0, i1);
+    cell.m_iAnims[1] = Anim(i0 + 1, i1);
+    cell.m_iAnims[2] = Anim(i0, i1 + 1);
+    cell.m_iAnims[3] = Anim(i0 + 1, i1 + 1);
+
+    cell.m_flWeights[0] = (1.0f - s0) * (1.0f - s1);
+    cell.m_flWeights[1] = s0 * (1.0f - s1);
+    cell.m_flWeights[2] = (1.0f - s0) * s1;
+    cell.m_flWeights[3] = s0 * s1;
+
+    return true;
+}
+
+float CBlendSpace::SequenceCycle(int iSequence, float flCycle, const float* pPoseParameters) const
+{
+    if (iSequence < 0 || iSequence >= (int)m_vecSequences.size())
+        return flCycle;
+
+    const CBlendSequence& blend = m_vecSequences[iSequence];
+
+    if (blend.m_iCyclePose < 0)
+        return flCycle;
+
+    return pPoseParameters[blend.m_iCyclePose] * blend.m_flCycleScale + blend.m_flCycleBias;
+}
+
+bool CBlendSpace::Evaluate(const int* pSequences, const float* pCycles, const float* pPoseParameters, int nEntities, CBonePose* pPoses) const
+{
+    const studiohdr_t* pMdl = m_Model.StudioHdr();
+
+    // without the header there is no animation data to sample
+    if (!pMdl)
+    {
+        for (int e = 0; e < nEntities; e++)
+            Studio_InitPose(m_Model.GetSkeletonLayout(), pPoses[e]);
+
+        return false;
+    }
+
+    int nBones = std::min(pMdl->numbones, POSE_MAX_BONES);
+
+    CBonePose sample;
+
+    for (int e = 0; e < nEntities; e++)
+    {
+        const float* pEntityPoses = pPoseParameters + (size_t)e * m_iPoseParameterCount;
+        CBonePose& pose = pPoses[e];
+
+        CBlendCell cell;
+        if (!FindCell(pSequences[e], pEntityPoses, cell))
+        {
+            Studio_InitPose(pMdl, pose);
+            continue;
+        }
+
+        float flCycle = SequenceCycle(pSequences[e], pCycles[e], pEntityPoses);
+
+        // corners that share an animation are sampled once
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = i + 1; j < 4; j++)
+            {
+                if (cell.m_iAnims[j] == cell.m_iAnims[i])
+                {
+                    cell.m_flWeights[i] += cell.m_flWeights[j];
+                    cell.m_flWeights[j] = 0.0f;
+                }
+            }
+        }
+
+        int nSamples = 0;
+
+        for (int i = 0; i < 4; i++)
+        {
+            float flWeight = cell.m_flWeights[i];
+
+            if (flWeight <= 0.0f)
+                continue;
+
+            if (nSamples == 0)
+            {
+                Studio_CalcAnimation(pMdl, cell.m_iAnims[i], flCycle, pose, m_pAnimBlocks);
+
+                if (flWeight < 1.0f)
+                    Studio_ScalePose(pose, flWeight, nBones);
+            }
+            else
+            {
+                Studio_CalcAnimation(pMdl, cell.m_iAnims[i], flCycle, sample, m_pAnimBlocks);
+                Studio_AccumulatePose(pose, sample, flWeight, nBones);
+            }
+
+            nSamples++;
+        }
+
+        if (nSamples > 1)
+            Studio_NormalizePose(pose, nBones);
+        else if (nSamples == 0)
+            Studio_InitPose(pMdl, pose);
+    }
+
+    return true;
+}
+
+namespace
+{
+    inline CQuaternionSoA PoseRotations(CBonePose& pose)
+    {
+        return CQuaternionSoA{ pose.m_qx, pose.m_qy, pose.m_qz, pose.m_qw };
+    }
+
+    inline CQuaternionSoA PoseRotations(const CBonePose& pose)
+    {
+        return PoseRotations(const_cast<CBonePose&>(pose));
+    }
+}
+
+void Studio_ScalePose(CBonePose& pose, float flWeight, int nBones)
+{
+    // pose buffers are padded to POSE_MAX_BONES so whole registers can be done past nBones
+    fltx4 weight = ReplicateX4(flWeight);
+    float* pChannels[] = { pose.m_qx, pose.m_qy, pose.m_qz, pose.m_qw, pose.m_px, pose.m_py, pose.m_pz };
+
+    for (float* pChannel : pChannels)
+    {
+        for (int i = 0; i < nBones; i += 4)
+            StoreAlignedSIMD(pChannel + i, MulSIMD(LoadAlignedSIMD(pChannel + i), weight));
+    }
+}
+
+void Studio_AccumulatePose(CBonePose& pose, const CBonePose& src, float flWeight, int nBones)
+{
+    QuaternionAccumulateSoA(PoseRotations(pose), PoseRotations(src), flWeight, nBones);
+
+    fltx4 weight = ReplicateX4(flWeight);
+
+    for (int i = 0; i < nBones; i += 4)
+    {
+        StoreAlignedSIMD(pose.m_px + i, MaddSIMD(LoadAlignedSIMD(src.m_px + i), weight, LoadAlignedSIMD(pose.m_px + i)));
+        StoreAlignedSIMD(pose.m_py + i, MaddSIMD(LoadAlignedSIMD(src.m_py + i), weight, LoadAlignedSIMD(pose.m_py + i)));
+        StoreAlignedSIMD(pose.m_pz + i, MaddSIMD(LoadAlignedSIMD(src.m_pz + i), weight, LoadAlignedSIMD(pose.m_pz + i)));
+    }
+}
+
+void Studio_NormalizePose(CBonePose& pose, int nBones)
+{
+    QuaternionNormalizeSoA(PoseRotations(pose), nBones);
+}
@@ -0,0 +1,155 @@
+#include "mdlbonemerge.h"
+#include "mdlanim.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+    int StrICmp(const char* a, const char* b)
+    {
+        for (;; a++, b++)
+        {
+            int ca = std::tolower((unsigned char)*a);
+            int cb = std::tolower((unsigned char)*b);
+
+            if (ca != cb || ca == 0)
+                return ca - cb;
+        }
+    }
+
+    // bone indices in name order. studiomdl writes this table, but older or
+    // hand made files may not have one (or have it in another order)
+    void SortedBones(const studiohdr_t* pMdl, std::vector<int>& vecBones)
+    {
+        int nBones = pMdl->numbones;
+        vecBones.resize(nBones);
+
+        bool bSorted = pMdl->bonetablebynameindex != 0;
+
+        for (int i = 0; i < nBones && bSorted; i++)
+        {
+            vecBones[i] = pMdl->GetBoneTableSortedByName()[i];
+
+            if (vecBones[i] >= nBones || (i > 0 && StrICmp(pMdl->pBone(vecBones[i - 1])->pszName(), pMdl->pBone(vecBones[i])->pszName()) > 0))
+                bSorted = false;
+        }
+
+        if (bSorted)
+            return;
+
+        for (int i = 0; i < nBones; i++)
+            vecBones[i] = i;
+
+        std::sort(vecBones.begin(), vecBones.end(),
+            [pMdl](int a, int b) { return StrICmp(pMdl->pBone(a)->pszName(), pMdl->pBone(b)->pszName()) < 0; });
+    }
+}
+
+bool CBoneMerge::Build(const studiohdr_t* pChild, const studiohdr_t* pParent)
+{
+    m_vecParentBones.clear();
+    m_vecMergedChild.clear();
+    m_vecMergedParent.clear();
+
+    if (!pChild || !pParent)
+        return false;
+
+    m_vecParentBones.assign(pChild->numbones, -1);
+
+    std::vector<int> vecChild, vecParent;
+    SortedBones(pChild, vecChild);
+    SortedBones(pParent, vecParent);
+
+    size_t i = 0, j = 0;
+    while (i < vecChild.size() && j < vecParent.size())
+    {
+        int iCmp = StrICmp(pChild->pBone(vecChild[i])->pszName(), pParent->pBone(vecParent[j])->pszName());
+
+        if (iCmp < 0)
+            i++;
+        else if (iCmp > 0)
+            j++;
+        else
+            m_vecParentBones[vecChild[i++]] = vecParent[j];
+    }
+
+    for (int iBone = 0; iBone < pChild->numbones; iBone++)
+    {
+        if (m_vecParentBones[iBone] < 0)
+            continue;
+
+        m_vecMergedChild.push_back(iBone);
+        m_vecMergedParent.push_back(m_vecParentBones[iBone]);
+    }
+
+    return true;
+}
+
+void CBoneMerge::CopyTransforms(const matrix3x4_t* pParentBones, matrix3x4_t* pChildBones) const
+{
+    const int* pChild = m_vecMergedChild.data();
+    const int* pParent = m_vecMergedParent.data();
+
+    for (int i = 0, n = MergedCount(); i < n; i++)
+        pChildBones[pChild[i]] = pParentBones[pParent[i]];
+}
+
+void CBoneMerge::CopyTransforms(const matrix3x4_t* const* ppParentBones, matrix3x4_t* const* ppChildBones, int nEntities) const
+{
+    for (int i = 0; i < nEntities; i++)
+        CopyTransforms(ppParentBones[i], ppChildBones[i]);
+}
+
+void CBoneMerge::CopyPose(const CBonePose& parent, CBonePose& child) const
+{
+    for (int i = 0, n = MergedCount(); i < n; i++)
+    {
+        int iChild = m_vecMergedChild[i];
+        int iParent = m_vecMergedParent[i];
+
+        if (iChild >= POSE_MAX_BONES || iParent >= POSE_MAX_BONES)
+            continue;
+
+        child.m_qx[iChild] = parent.m_qx[iParent];
+        child.m_qy[iChild] = parent.m_qy[iParent];
+        child.m_qz[iChild] = parent.m_qz[iParent];
+        child.m_qw[iChild] = parent.m_qw[iParent];
+        child.m_px[iChild] = parent.m_px[iParent];
+        child.m_py[iChild] = parent.m_py[iParent];
+        child.m_pz[iChild] = parent.m_pz[iParent];
+    }
+}
+
+const CBoneMerge& CBoneMergeCache::Get(const CModel& child, const CModel& parent)
+{
+    const studiohdr_t* pChild = child.StudioHdr();
+    const studiohdr_t* pParent = parent.StudioHdr();
+
+    uint64_t key = ((uint64_t)(uint32_t)(pChild ? pChild->checksum : 0) << 32) | (uint32_t)(pParent ? pParent->checksum : 0);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::unique_ptr<CBoneMerge>& pMerge = m_Merges[key];
+    if (!pMerge)
+    {
+        pMerge.reset(new CBoneMerge);
+        pMerge->Build(pChild, pParent);
+    }
+
+    return *pMerge;
+}
+
+int CBoneMergeCache::Count()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return (int)m_Merges.size();
+}
+
+void CBoneMergeCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Merges.clear();
+}
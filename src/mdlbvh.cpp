@@ -0,0 +1,431 @@
+#include "mdlbvh.h"
+#include "mdlmath.h"
+#include "mdlmesh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#define BVH_BINS 12
+#define BVH_LEAF_TRIANGLES 4
+#define BVH_SAH_DEPTH 40     // past it nodes split in half, which bounds the depth
+#define BVH_STACK_SIZE 128
+
+namespace
+{
+    struct CBox
+    {
+        Vector m_vecMins = Vector(FLT_MAX);
+        Vector m_vecMaxs = Vector(-FLT_MAX);
+
+        void Add(const Vector& p)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                m_vecMins[i] = std::min(m_vecMins[i], p[i]);
+                m_vecMaxs[i] = std::max(m_vecMaxs[i], p[i]);
+            }
+        }
+
+        void Add(const CBox& box)
+        {
+            Add(box.m_vecMins);
+            Add(box.m_vecMaxs);
+        }
+
+        float Area() const
+        {
+            Vector d = m_vecMaxs - m_vecMins;
+            return (d.x < 0.0f) ? 0.0f : d.x * d.y + d.y * d.z + d.z * d.x;
+        }
+
+        Vector Center() const
+        {
+            return (m_vecMins + m_vecMaxs) * 0.5f;
+        }
+    };
+
+    // splits pItems by the cheapest of the binned planes along the widest axis of
+    // their centers, returns how many end up on the left. halves when they can't be told apart
+    int PartitionSAH(int* pItems, int n, const std::vector<CBox>& bounds)
+    {
+        CBox centers;
+        for (int i = 0; i < n; i++)
+            centers.Add(bounds[pItems[i]].Center());
+
+        Vector extent = centers.m_vecMaxs - centers.m_vecMins;
+        int iAxis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+
+        if (extent[iAxis] <= 0.0f)
+            return n / 2;
+
+        float flMin = centers.m_vecMins[iAxis];
+        float flScale = BVH_BINS / extent[iAxis];
+
+        auto Bin = [&](int iItem) { return std::min((int)((bounds[iItem].Center()[iAxis] - flMin) * flScale), BVH_BINS - 1); };
+
+        CBox binBounds[BVH_BINS];
+        int binCounts[BVH_BINS] = {};
+
+        for (int i = 0; i < n; i++)
+        {
+            int iBin = Bin(pItems[i]);
+            binBounds[iBin].Add(bounds[pItems[i]]);
+            binCounts[iBin]++;
+        }
+
+        // right side costs swept from the far end, then the left side from the near one
+        float rightCost[BVH_BINS];
+        CBox right;
+        int nRight = 0;
+
+        for (int i = BVH_BINS - 1; i > 0; i--)
+        {
+            right.Add(binBounds[i]);
+            nRight += binCounts[i];
+            rightCost[i] = right.Area() * nRight;
+        }
+
+        CBox left;
+        int nLeft = 0;
+        int iBestSplit = -1;
+        float flBestCost = FLT_MAX;
+
+        for (int i = 1; i < BVH_BINS; i++)
+        {
+            left.Add(binBounds[i - 1]);
+            nLeft += binCounts[i - 1];
+
+            if (nLeft == 0 || nLeft == n)
+                continue;
+
+            float flCost = left.Area() * nLeft + rightCost[i];
+            if (flCost < flBestCost)
+            {
+                flBestCost = flCost;
+                iBestSplit = i;
+            }
+        }
+
+        if (iBestSplit < 0)
+            return n / 2;
+
+        return (int)(std::partition(pItems, pItems + n, [&](int iItem) { return Bin(iItem) < iBestSplit; }) - pItems);
+    }
+
+    inline fltx4 Dot4(const fltx4& ax, const fltx4& ay, const fltx4& az, const float* b)
+    {
+        return MaddSIMD(ax, ReplicateX4(b[0]), MaddSIMD(ay, ReplicateX4(b[1]), MulSIMD(az, ReplicateX4(b[2]))));
+    }
+}
+
+bool CTriangleBVH::Build(const CSkinnedMesh& mesh, const Vector* pPositions)
+{
+    m_vecNodes.clear();
+    m_vecTriangles.clear();
+    m_vecTriangleIndex.clear();
+    m_vecIndices = mesh.Indices();
+    m_nGroups = 0;
+
+    int nTriangles = mesh.TriangleCount();
+
+    if (nTriangles == 0 || !pPositions)
+        return false;
+
+    std::vector<CBox> triangleBounds(nTriangles);
+
+    for (int i = 0; i < nTriangles; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            triangleBounds[i].Add(pPositions[m_vecIndices[i * 3 + j]]);
+    }
+
+    // triangles sorted by bone, one group per bone that has any
+    m_vecTriangleIndex.resize(nTriangles);
+
+    for (int i = 0; i < nTriangles; i++)
+        m_vecTriangleIndex[i] = i;
+
+    std::stable_sort(m_vecTriangleIndex.begin(), m_vecTriangleIndex.end(),
+        [&mesh](int a, int b) { return mesh.TriangleBone(a) < mesh.TriangleBone(b); });
+
+    std::vector<int> vecGroupStart;
+    std::vector<CBox> groupBounds;
+
+    for (int i = 0; i < nTriangles; i++)
+    {
+        int iTriangle = m_vecTriangleIndex[i];
+
+        if (i == 0 || mesh.TriangleBone(iTriangle) != mesh.TriangleBone(m_vecTriangleIndex[i - 1]))
+        {
+            vecGroupStart.push_back(i);
+            groupBounds.emplace_back();
+        }
+
+        groupBounds.back().Add(triangleBounds[iTriangle]);
+    }
+
+    m_nGroups = (int)groupBounds.size();
+    vecGroupStart.push_back(nTriangles);
+
+    std::vector<int> vecGroups(m_nGroups);
+    for (int i = 0; i < m_nGroups; i++)
+        vecGroups[i] = i;
+
+    // groups are split among themselves first, each one then splits its own triangles
+    struct CTask
+    {
+        int m_iNode;
+        int m_iFirst;
+        int m_nCount;
+        int m_iDepth;
+        bool m_bGroups;
+    };
+
+    std::vector<CTask> vecTasks{ CTask{ 0, 0, m_nGroups, 0, true } };
+    m_vecNodes.emplace_back();
+
+    while (!vecTasks.empty())
+    {
+        CTask task = vecTasks.back();
+        vecTasks.pop_back();
+
+        if (task.m_bGroups && task.m_nCount == 1)
+        {
+            int iGroup = vecGroups[task.m_iFirst];
+            task = CTask{ task.m_iNode, vecGroupStart[iGroup], vecGroupStart[iGroup + 1] - vecGroupStart[iGroup], task.m_iDepth, false };
+        }
+
+        int* pItems = task.m_bGroups ? &vecGroups[task.m_iFirst] : &m_vecTriangleIndex[task.m_iFirst];
+        const std::vector<CBox>& bounds = task.m_bGroups ? groupBounds : triangleBounds;
+
+        CNode& node = m_vecNodes[task.m_iNode];
+
+        if (!task.m_bGroups && task.m_nCount <= BVH_LEAF_TRIANGLES)
+        {
+            node.m_iFirst = task.m_iFirst;
+            node.m_nTriangles = task.m_nCount;
+            continue;
+        }
+
+        int nLeft = task.m_iDepth < BVH_SAH_DEPTH ? PartitionSAH(pItems, task.m_nCount, bounds) : task.m_nCount / 2;
+        int iChildren = (int)m_vecNodes.size();
+
+        node.m_iFirst = iChildren;
+        node.m_nTriangles = 0;
+
+        m_vecNodes.emplace_back();
+        m_vecNodes.emplace_back();
+
+        vecTasks.push_back(CTask{ iChildren + 1, task.m_iFirst + nLeft, task.m_nCount - nLeft, task.m_iDepth + 1, task.m_bGroups });
+        vecTasks.push_back(CTask{ iChildren, task.m_iFirst, nLeft, task.m_iDepth + 1, task.m_bGroups });
+    }
+
+    m_vecTriangles.resize(nTriangles);
+    Refit(pPositions);
+
+    return true;
+}
+
+void CTriangleBVH::Refit(const Vector* pPositions)
+{
+    if (m_vecNodes.empty())
+        return;
+
+    SetTriangles(pPositions);
+    Refit();
+}
+
+void CTriangleBVH::SetTriangles(const Vector* pPositions)
+{
+    for (int i = 0; i < TriangleCount(); i++)
+    {
+        const int* pIndices = &m_vecIndices[m_vecTriangleIndex[i] * 3];
+
+        const Vector& a = pPositions[pIndices[0]];
+        Vector e1 = pPositions[pIndices[1]] - a;
+        Vector e2 = pPositions[pIndices[2]] - a;
+
+        CTriangle& triangle = m_vecTriangles[i];
+
+        for (int j = 0; j < 3; j++)
+        {
+            triangle.m_v0[j] = a[j];
+            triangle.m_e1[j] = e1[j];
+            triangle.m_e2[j] = e2[j];
+        }
+    }
+}
+
+void CTriangleBVH::Refit()
+{
+    // children always come after their parent
+    for (int i = NodeCount() - 1; i >= 0; i--)
+    {
+        CNode& node = m_vecNodes[i];
+        CBox box;
+
+        if (node.m_nTriangles > 0)
+        {
+            for (int j = node.m_iFirst; j < node.m_iFirst + node.m_nTriangles; j++)
+            {
+                const CTriangle& triangle = m_vecTriangles[j];
+                Vector v0(triangle.m_v0[0], triangle.m_v0[1], triangle.m_v0[2]);
+
+                box.Add(v0);
+                box.Add(v0 + Vector(triangle.m_e1[0], triangle.m_e1[1], triangle.m_e1[2]));
+                box.Add(v0 + Vector(triangle.m_e2[0], triangle.m_e2[1], triangle.m_e2[2]));
+            }
+        }
+        else
+        {
+            for (int j = 0; j < 2; j++)
+            {
+                const CNode& child = m_vecNodes[node.m_iFirst + j];
+                box.Add(Vector(child.m_vecMins[0], child.m_vecMins[1], child.m_vecMins[2]));
+                box.Add(Vector(child.m_vecMaxs[0], child.m_vecMaxs[1], child.m_vecMaxs[2]));
+            }
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            node.m_vecMins[j] = box.m_vecMins[j];
+            node.m_vecMaxs[j] = box.m_vecMaxs[j];
+        }
+    }
+}
+
+int CTriangleBVH::TraceRays(const Vector* pStarts, const Vector* pDeltas, int nRays, CTriangleHit* pHits) const
+{
+    int nHits = 0;
+
+    fltx4 zero = LoadZeroSIMD();
+    fltx4 one = ReplicateX4(1.0f);
+    fltx4 epsilon = ReplicateX4(1.0e-8f);
+
+    for (int i = 0; i < nRays; i += 4)
+    {
+        // the last packet repeats its final ray into the unused lanes
+        alignas(16) float o[3][4], d[3][4], inv[3][4];
+
+        for (int j = 0; j < 4; j++)
+        {
+            int iRay = std::min(i + j, nRays - 1);
+
+            for (int k = 0; k < 3; k++)
+            {
+                o[k][j] = pStarts[iRay][k];
+                d[k][j] = pDeltas[iRay][k];
+
+                // keeps the slab test free of 0 * inf
+                float flDelta = std::fabs(d[k][j]) < 1.0e-12f ? (d[k][j] < 0.0f ? -1.0e-12f : 1.0e-12f) : d[k][j];
+                inv[k][j] = 1.0f / flDelta;
+            }
+        }
+
+        fltx4 ox = LoadAlignedSIMD(o[0]), oy = LoadAlignedSIMD(o[1]), oz = LoadAlignedSIMD(o[2]);
+        fltx4 dx = LoadAlignedSIMD(d[0]), dy = LoadAlignedSIMD(d[1]), dz = LoadAlignedSIMD(d[2]);
+        fltx4 ix = LoadAlignedSIMD(inv[0]), iy = LoadAlignedSIMD(inv[1]), iz = LoadAlignedSIMD(inv[2]);
+
+        fltx4 best = one;
+        int iTriangle[4] = { -1, -1, -1, -1 };
+
+        int stack[BVH_STACK_SIZE];
+        int nStack = m_vecNodes.empty() ? 0 : 1;
+        stack[0] = 0;
+
+        while (nStack > 0)
+        {
+            const CNode& node = m_vecNodes[stack[--nStack]];
+
+            // slab test of the node's box against all four rays up to their closest hit so far
+            fltx4 t1 = MulSIMD(SubSIMD(ReplicateX4(node.m_vecMins[0]), ox), ix);
+            fltx4 t2 = MulSIMD(SubSIMD(ReplicateX4(node.m_vecMaxs[0]), ox), ix);
+            fltx4 tNear = MaxSIMD(zero, MinSIMD(t1, t2));
+            fltx4 tFar = MinSIMD(best, MaxSIMD(t1, t2));
+
+            t1 = MulSIMD(SubSIMD(ReplicateX4(node.m_vecMins[1]), oy), iy);
+            t2 = MulSIMD(SubSIMD(ReplicateX4(node.m_vecMaxs[1]), oy), iy);
+            tNear = MaxSIMD(tNear, MinSIMD(t1, t2));
+            tFar = MinSIMD(tFar, MaxSIMD(t1, t2));
+
+            t1 = MulSIMD(SubSIMD(ReplicateX4(node.m_vecMins[2]), oz), iz);
+            t2 = MulSIMD(SubSIMD(ReplicateX4(node.m_vecMaxs[2]), oz), iz);
+            tNear = MaxSIMD(tNear, MinSIMD(t1, t2));
+            tFar = MinSIMD(tFar, MaxSIMD(t1, t2));
+
+            if (TestSignSIMD(CmpLeSIMD(tNear, tFar)) == 0)
+                continue;
+
+            if (node.m_nTriangles == 0)
+            {
+                if (nStack + 2 > BVH_STACK_SIZE)
+                    continue;
+
+                stack[nStack++] = node.m_iFirst + 1;
+                stack[nStack++] = node.m_iFirst;
+                continue;
+            }
+
+            for (int j = node.m_iFirst; j < node.m_iFirst + node.m_nTriangles; j++)
+            {
+                const CTriangle& triangle = m_vecTriangles[j];
+
+                // pvec = d x e2
+                fltx4 px = SubSIMD(MulSIMD(dy, ReplicateX4(triangle.m_e2[2])), MulSIMD(dz, ReplicateX4(triangle.m_e2[1])));
+                fltx4 py = SubSIMD(MulSIMD(dz, ReplicateX4(triangle.m_e2[0])), MulSIMD(dx, ReplicateX4(triangle.m_e2[2])));
+                fltx4 pz = SubSIMD(MulSIMD(dx, ReplicateX4(triangle.m_e2[1])), MulSIMD(dy, ReplicateX4(triangle.m_e2[0])));
+
+                fltx4 det = Dot4(px, py, pz, triangle.m_e1);
+                fltx4 valid = CmpGtSIMD(AbsSIMD(det), epsilon);
+                fltx4 invDet = DivSIMD(one, MaskedAssign(valid, det, one));
+
+                fltx4 tx = SubSIMD(ox, ReplicateX4(triangle.m_v0[0]));
+                fltx4 ty = SubSIMD(oy, ReplicateX4(triangle.m_v0[1]));
+                fltx4 tz = SubSIMD(oz, ReplicateX4(triangle.m_v0[2]));
+
+                fltx4 u = MulSIMD(MaddSIMD(tx, px, MaddSIMD(ty, py, MulSIMD(tz, pz))), invDet);
+
+                // qvec = tvec x e1
+                fltx4 qx = SubSIMD(MulSIMD(ty, ReplicateX4(triangle.m_e1[2])), MulSIMD(tz, ReplicateX4(triangle.m_e1[1])));
+                fltx4 qy = SubSIMD(MulSIMD(tz, ReplicateX4(triangle.m_e1[0])), MulSIMD(tx, ReplicateX4(triangle.m_e1[2])));
+                fltx4 qz = SubSIMD(MulSIMD(tx, ReplicateX4(triangle.m_e1[1])), MulSIMD(ty, ReplicateX4(triangle.m_e1[0])));
+
+                fltx4 v = MulSIMD(MaddSIMD(dx, qx, MaddSIMD(dy, qy, MulSIMD(dz, qz))), invDet);
+                fltx4 t = MulSIMD(Dot4(qx, qy, qz, triangle.m_e2), invDet);
+
+                fltx4 hit = AndSIMD(valid, CmpGeSIMD(u, zero));
+                hit = AndSIMD(hit, CmpGeSIMD(v, zero));
+                hit = AndSIMD(hit, CmpLeSIMD(AddSIMD(u, v), one));
+                hit = AndSIMD(hit, CmpGeSIMD(t, zero));
+                hit = AndSIMD(hit, CmpLtSIMD(t, best));
+
+                int iMask = TestSignSIMD(hit);
+                if (iMask == 0)
+                    continue;
+
+                best = MaskedAssign(hit, t, best);
+
+                for (int k = 0; k < 4; k++)
+                {
+                    if (iMask & (1 << k))
+                        iTriangle[k] = m_vecTriangleIndex[j];
+                }
+            }
+        }
+
+        alignas(16) float fractions[4];
+        StoreAlignedSIMD(fractions, best);
+
+        for (int j = 0; j < 4 && i + j < nRays; j++)
+        {
+            pHits[i + j].m_flFraction = iTriangle[j] < 0 ? 1.0f : fractions[j];
+            pHits[i + j].m_iTriangle = iTriangle[j];
+
+            if (iTriangle[j] >= 0)
+                nHits++;
+        }
+    }
+
+    return nHits;
+}
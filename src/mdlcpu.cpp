@@ -0,0 +1,82 @@
+#include "mdlcpu.h"
+
+#ifdef MDL_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+#ifdef MDL_X86
+    void CPUID(int iLeaf, int iSubLeaf, unsigned int regs[4])
+    {
+#if defined(_MSC_VER)
+        int out[4];
+        __cpuidex(out, iLeaf, iSubLeaf);
+
+        for (int i = 0; i < 4; i++)
+            regs[i] = (unsigned int)out[i];
+#else
+        __cpuid_count(iLeaf, iSubLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // the OS has to save the ymm registers on a context switch before AVX can be used
+    bool OSSavesYMM()
+    {
+#if defined(_MSC_VER)
+        return (_xgetbv(0) & 0x6) == 0x6;
+#else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (eax & 0x6) == 0x6;
+#endif
+    }
+
+    CPUInformation QueryCPU()
+    {
+        CPUInformation info;
+        unsigned int regs[4] = {};
+
+        CPUID(0, 0, regs);
+        unsigned int iMaxLeaf = regs[0];
+
+        if (iMaxLeaf < 1)
+            return info;
+
+        CPUID(1, 0, regs);
+
+        info.m_bSSE2 = (regs[3] & (1u << 26)) != 0;
+        info.m_bSSE41 = (regs[2] & (1u << 19)) != 0;
+
+        bool bOSXSave = (regs[2] & (1u << 27)) != 0;
+        bool bYMM = bOSXSave && OSSavesYMM();
+
+        info.m_bAVX = bYMM && (regs[2] & (1u << 28)) != 0;
+        info.m_bFMA = info.m_bAVX && (regs[2] & (1u << 12)) != 0;
+        info.m_bF16C = info.m_bAVX && (regs[2] & (1u << 29)) != 0;
+
+        if (iMaxLeaf >= 7)
+        {
+            CPUID(7, 0, regs);
+            info.m_bAVX2 = info.m_bAVX && (regs[1] & (1u << 5)) != 0;
+        }
+
+        return info;
+    }
+#else
+    CPUInformation QueryCPU()
+    {
+        return CPUInformation{};
+    }
+#endif
+}
+
+const CPUInformation& GetCPUInformation()
+{
+    static const CPUInformation info = QueryCPU();
+    return info;
+}
@@ -0,0 +1,387 @@
+#include "mdlcull.h"
+#include "mdlcpu.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#ifdef MDL_X86
+#include <immintrin.h>
+#endif
+
+#define CULL_PAD 8
+#define CULL_NEAR_W 1.0e-3f
+
+namespace
+{
+    typedef int (*CullFn)(const float* const* ppBoxes, int nBoxes, const CCullPlane* pPlanes, int nPlanes, int* pVisible);
+
+    // ppBoxes is center x, y, z then extent x, y, z, readable up to the next multiple
+    // of eight. a box is outside a plane when its center is further behind it than
+    // the box reaches along the normal
+#if !defined(MDL_SSE2) && !defined(__ARM_NEON)
+    int Cull_Scalar(const float* const* ppBoxes, int nBoxes, const CCullPlane* pPlanes, int nPlanes, int* pVisible)
+    {
+        int nVisible = 0;
+
+        for (int i = 0; i < nBoxes; i++)
+        {
+            bool bVisible = true;
+
+            for (int j = 0; j < nPlanes && bVisible; j++)
+            {
+                const Vector& n = pPlanes[j].m_vecNormal;
+
+                float d = n.x * ppBoxes[0][i] + n.y * ppBoxes[1][i] + n.z * ppBoxes[2][i] - pPlanes[j].m_flDist;
+                float r = std::fabs(n.x) * ppBoxes[3][i] + std::fabs(n.y) * ppBoxes[4][i] + std::fabs(n.z) * ppBoxes[5][i];
+
+                bVisible = d + r >= 0.0f;
+            }
+
+            if (bVisible)
+                pVisible[nVisible++] = i;
+        }
+
+        return nVisible;
+    }
+#else
+    int Cull_SIMD(const float* const* ppBoxes, int nBoxes, const CCullPlane* pPlanes, int nPlanes, int* pVisible)
+    {
+        int nVisible = 0;
+        fltx4 zero = LoadZeroSIMD();
+
+        for (int i = 0; i < nBoxes; i += 4)
+        {
+            fltx4 cx = LoadUnalignedSIMD(ppBoxes[0] + i), cy = LoadUnalignedSIMD(ppBoxes[1] + i), cz = LoadUnalignedSIMD(ppBoxes[2] + i);
+            fltx4 ex = LoadUnalignedSIMD(ppBoxes[3] + i), ey = LoadUnalignedSIMD(ppBoxes[4] + i), ez = LoadUnalignedSIMD(ppBoxes[5] + i);
+
+            fltx4 outside = zero;
+
+            for (int j = 0; j < nPlanes; j++)
+            {
+                const Vector& n = pPlanes[j].m_vecNormal;
+
+                fltx4 d = MaddSIMD(cx, ReplicateX4(n.x), MaddSIMD(cy, ReplicateX4(n.y), MulSIMD(cz, ReplicateX4(n.z))));
+                fltx4 r = MaddSIMD(ex, ReplicateX4(std::fabs(n.x)), MaddSIMD(ey, ReplicateX4(std::fabs(n.y)), MulSIMD(ez, ReplicateX4(std::fabs(n.z)))));
+
+                outside = OrSIMD(outside, CmpLtSIMD(AddSIMD(d, r), ReplicateX4(pPlanes[j].m_flDist)));
+
+                if (TestSignSIMD(outside) == 0xF)
+                    break;
+            }
+
+            int iMask = ~TestSignSIMD(outside) & 0xF & ((1 << std::min(nBoxes - i, 4)) - 1);
+
+            for (int j = 0; iMask; j++, iMask >>= 1)
+            {
+                if (iMask & 1)
+                    pVisible[nVisible++] = i + j;
+            }
+        }
+
+        return nVisible;
+    }
+#endif
+
+#ifdef MDL_X86
+    // lane indices of every 8 bit mask's set bits packed to the front
+    struct CCompactTable
+    {
+        alignas(32) int m_iLanes[256][8];
+        int m_nLanes[256];
+
+        CCompactTable()
+        {
+            for (int iMask = 0; iMask < 256; iMask++)
+            {
+                int n = 0;
+
+                for (int j = 0; j < 8; j++)
+                {
+                    if (iMask & (1 << j))
+                        m_iLanes[iMask][n++] = j;
+                }
+
+                m_nLanes[iMask] = n;
+
+                for (int j = n; j < 8; j++)
+                    m_iLanes[iMask][j] = 0;
+            }
+        }
+    };
+
+    MDL_TARGET("avx2")
+    int Cull_AVX2(const float* const* ppBoxes, int nBoxes, const CCullPlane* pPlanes, int nPlanes, int* pVisible)
+    {
+        static const CCompactTable table;
+
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        int nVisible = 0;
+
+        for (int i = 0; i < nBoxes; i += 8)
+        {
+            __m256 cx = _mm256_loadu_ps(ppBoxes[0] + i), cy = _mm256_loadu_ps(ppBoxes[1] + i), cz = _mm256_loadu_ps(ppBoxes[2] + i);
+            __m256 ex = _mm256_loadu_ps(ppBoxes[3] + i), ey = _mm256_loadu_ps(ppBoxes[4] + i), ez = _mm256_loadu_ps(ppBoxes[5] + i);
+
+            __m256 outside = _mm256_setzero_ps();
+
+            for (int j = 0; j < nPlanes; j++)
+            {
+                __m256 nx = _mm256_set1_ps(pPlanes[j].m_vecNormal.x);
+                __m256 ny = _mm256_set1_ps(pPlanes[j].m_vecNormal.y);
+                __m256 nz = _mm256_set1_ps(pPlanes[j].m_vecNormal.z);
+
+                __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, nx), _mm256_mul_ps(cy, ny)), _mm256_mul_ps(cz, nz));
+                __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_and_ps(nx, absMask)), _mm256_mul_ps(ey, _mm256_and_ps(ny, absMask))), _mm256_mul_ps(ez, _mm256_and_ps(nz, absMask)));
+
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_set1_ps(pPlanes[j].m_flDist), _CMP_LT_OQ));
+
+                if (_mm256_movemask_ps(outside) == 0xFF)
+                    break;
+            }
+
+            int iMask = ~_mm256_movemask_ps(outside) & 0xFF & ((1 << std::min(nBoxes - i, 8)) - 1);
+            if (iMask == 0)
+                continue;
+
+            // visible lanes packed to the front, only as many as there are get copied out
+            __m256i lanes = _mm256_load_si256((const __m256i*)table.m_iLanes[iMask]);
+            __m256i indices = _mm256_add_epi32(lanes, _mm256_set1_epi32(i));
+
+            alignas(32) int packed[8];
+            _mm256_store_si256((__m256i*)packed, indices);
+
+            for (int j = 0; j < table.m_nLanes[iMask]; j++)
+                pVisible[nVisible++] = packed[j];
+        }
+
+        return nVisible;
+    }
+#endif
+
+    CullFn SelectCull()
+    {
+#ifdef MDL_X86
+        if (GetCPUInformation().m_bAVX2)
+            return Cull_AVX2;
+#endif
+#if defined(MDL_SSE2) || defined(__ARM_NEON)
+        return Cull_SIMD;
+#else
+        return Cull_Scalar;
+#endif
+    }
+
+    inline Vector Project(const float m[4][4], const Vector& p, float& w)
+    {
+        w = m[3][0] * p.x + m[3][1] * p.y + m[3][2] * p.z + m[3][3];
+        return Vector(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+            m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+            m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+    }
+
+    // world box of a local one, the extent is the local one through the absolute rotation
+    void TransformBox(const Vector& mins, const Vector& maxs, const matrix3x4_t& toWorld, Vector& center, Vector& extent)
+    {
+        Vector localCenter = (mins + maxs) * 0.5f;
+        Vector localExtent = (maxs - mins) * 0.5f;
+
+        VectorTransform(localCenter, toWorld, center);
+
+        for (int i = 0; i < 3; i++)
+            extent[i] = std::fabs(toWorld[i][0]) * localExtent.x + std::fabs(toWorld[i][1]) * localExtent.y + std::fabs(toWorld[i][2]) * localExtent.z;
+    }
+}
+
+void Cull_FrustumPlanes(const float viewProj[4][4], CCullPlane planes[6])
+{
+    const float* r0 = viewProj[0];
+    const float* r1 = viewProj[1];
+    const float* r2 = viewProj[2];
+    const float* r3 = viewProj[3];
+
+    float coeffs[6][4];
+
+    for (int i = 0; i < 4; i++)
+    {
+        coeffs[0][i] = r3[i] + r0[i];	// left
+        coeffs[1][i] = r3[i] - r0[i];	// right
+        coeffs[2][i] = r3[i] + r1[i];	// bottom
+        coeffs[3][i] = r3[i] - r1[i];	// top
+        coeffs[4][i] = r2[i];			// near
+        coeffs[5][i] = r3[i] - r2[i];	// far
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        Vector n(coeffs[i][0], coeffs[i][1], coeffs[i][2]);
+        float flLength = std::sqrt(DotProduct(n, n));
+        float flScale = flLength > 0.0f ? 1.0f / flLength : 0.0f;
+
+        planes[i].m_vecNormal = n * flScale;
+        planes[i].m_flDist = -coeffs[i][3] * flScale;
+    }
+}
+
+void COcclusionBuffer::Init(const float viewProj[4][4], int iWidth, int iHeight)
+{
+    std::copy(&viewProj[0][0], &viewProj[0][0] + 16, &m_viewProj[0][0]);
+
+    m_iWidth = std::max(iWidth, 0);
+    m_iHeight = std::max(iHeight, 0);
+    m_vecDepth.assign((size_t)m_iWidth * m_iHeight, FLT_MAX);
+}
+
+bool COcclusionBuffer::BoxVisible(const Vector& mins, const Vector& maxs) const
+{
+    if (m_vecDepth.empty())
+        return true;
+
+    float flMinX = FLT_MAX, flMinY = FLT_MAX, flMaxX = -FLT_MAX, flMaxY = -FLT_MAX;
+    float flNearest = FLT_MAX;
+
+    for (int i = 0; i < 8; i++)
+    {
+        Vector corner((i & 1) ? maxs.x : mins.x, (i & 2) ? maxs.y : mins.y, (i & 4) ? maxs.z : mins.z);
+
+        float w;
+        Vector clip = Project(m_viewProj, corner, w);
+
+        // reaching behind the camera, there's no rectangle to test
+        if (w < CULL_NEAR_W)
+            return true;
+
+        float x = clip.x / w, y = clip.y / w;
+        flMinX = std::min(flMinX, x);
+        flMaxX = std::max(flMaxX, x);
+        flMinY = std::min(flMinY, y);
+        flMaxY = std::max(flMaxY, y);
+        flNearest = std::min(flNearest, w);
+    }
+
+    // ndc to pixels, y down
+    int x0 = std::max((int)std::floor((flMinX * 0.5f + 0.5f) * m_iWidth), 0);
+    int x1 = std::min((int)std::floor((flMaxX * 0.5f + 0.5f) * m_iWidth), m_iWidth - 1);
+    int y0 = std::max((int)std::floor((0.5f - flMaxY * 0.5f) * m_iHeight), 0);
+    int y1 = std::min((int)std::floor((0.5f - flMinY * 0.5f) * m_iHeight), m_iHeight - 1);
+
+    // off screen boxes are the frustum test's business
+    if (x0 > x1 || y0 > y1)
+        return true;
+
+    for (int y = y0; y <= y1; y++)
+    {
+        const float* pRow = &m_vecDepth[(size_t)y * m_iWidth];
+
+        for (int x = x0; x <= x1; x++)
+        {
+            if (pRow[x] >= flNearest)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+int CCullingSet::Add(const Vector& mins, const Vector& maxs)
+{
+    int iInstance = m_nCount++;
+
+    // grows a whole block at a time so the kernels can always read full registers
+    if ((int)m_vecCenterX.size() < m_nCount)
+    {
+        size_t nSize = m_vecCenterX.size() + CULL_PAD;
+
+        for (std::vector<float>* pArray : { &m_vecCenterX, &m_vecCenterY, &m_vecCenterZ, &m_vecExtentX, &m_vecExtentY, &m_vecExtentZ })
+            pArray->resize(nSize, 0.0f);
+    }
+
+    Set(iInstance, mins, maxs);
+    return iInstance;
+}
+
+void CCullingSet::Set(int iInstance, const Vector& mins, const Vector& maxs)
+{
+    if (iInstance < 0 || iInstance >= m_nCount)
+        return;
+
+    m_vecCenterX[iInstance] = (mins.x + maxs.x) * 0.5f;
+    m_vecCenterY[iInstance] = (mins.y + maxs.y) * 0.5f;
+    m_vecCenterZ[iInstance] = (mins.z + maxs.z) * 0.5f;
+
+    m_vecExtentX[iInstance] = (maxs.x - mins.x) * 0.5f;
+    m_vecExtentY[iInstance] = (maxs.y - mins.y) * 0.5f;
+    m_vecExtentZ[iInstance] = (maxs.z - mins.z) * 0.5f;
+}
+
+int CCullingSet::AddModel(const CModel& model, int iSequence, const matrix3x4_t& toWorld)
+{
+    int iInstance = Add(Vector(0.0f), Vector(0.0f));
+    SetModel(iInstance, model, iSequence, toWorld);
+    return iInstance;
+}
+
+void CCullingSet::SetModel(int iInstance, const CModel& model, int iSequence, const matrix3x4_t& toWorld)
+{
+    const std::vector<CSequence>& sequences = model.GetSequences();
+
+    Vector mins, maxs;
+
+    if (iSequence >= 0 && iSequence < (int)sequences.size())
+    {
+        const CSequence& seq = sequences[iSequence];
+        mins.Init(seq.m_bbMin.x, seq.m_bbMin.y, seq.m_bbMin.z);
+        maxs.Init(seq.m_bbMax.x, seq.m_bbMax.y, seq.m_bbMax.z);
+    }
+    else
+    {
+        mins.Init(model.HullMins().x, model.HullMins().y, model.HullMins().z);
+        maxs.Init(model.HullMaxs().x, model.HullMaxs().y, model.HullMaxs().z);
+    }
+
+    Vector center, extent;
+    TransformBox(mins, maxs, toWorld, center, extent);
+
+    Set(iInstance, center - extent, center + extent);
+}
+
+void CCullingSet::Clear()
+{
+    for (std::vector<float>* pArray : { &m_vecCenterX, &m_vecCenterY, &m_vecCenterZ, &m_vecExtentX, &m_vecExtentY, &m_vecExtentZ })
+        pArray->clear();
+
+    m_nCount = 0;
+}
+
+int CCullingSet::CullFrustum(const CCullPlane* pPlanes, int nPlanes, int* pVisible) const
+{
+    static const CullFn pfnCull = SelectCull();
+
+    if (m_nCount == 0)
+        return 0;
+
+    const float* ppBoxes[6] = { m_vecCenterX.data(), m_vecCenterY.data(), m_vecCenterZ.data(), m_vecExtentX.data(), m_vecExtentY.data(), m_vecExtentZ.data() };
+
+    return pfnCull(ppBoxes, m_nCount, pPlanes, nPlanes, pVisible);
+}
+
+int CCullingSet::CullFrustumOcclusion(const CCullPlane* pPlanes, int nPlanes, const COcclusionBuffer& buffer, int* pVisible) const
+{
+    int nVisible = CullFrustum(pPlanes, nPlanes, pVisible);
+    int nKept = 0;
+
+    for (int i = 0; i < nVisible; i++)
+    {
+        int iInstance = pVisible[i];
+
+        Vector center(m_vecCenterX[iInstance], m_vecCenterY[iInstance], m_vecCenterZ[iInstance]);
+        Vector extent(m_vecExtentX[iInstance], m_vecExtentY[iInstance], m_vecExtentZ[iInstance]);
+
+        if (buffer.BoxVisible(center - extent, center + extent))
+            pVisible[nKept++] = iInstance;
+    }
+
+    return nKept;
+}
@@ -0,0 +1,120 @@
+#include "mdlevents.h"
+#include "mdlmemory.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+int CEventTimeline::Intern(const char* pszString)
+{
+    auto it = m_StringMap.find(pszString);
+
+    if (it != m_StringMap.end())
+        return it->second;
+
+    int iString = (int)m_vecStrings.size();
+    m_vecStrings.push_back(pszString);
+    m_StringMap.emplace(m_vecStrings.back(), iString);
+
+    return iString;
+}
+
+bool CEventTimeline::Build(const studiohdr_t* pMdl)
+{
+    m_vecSequences.clear();
+    m_vecCycles.clear();
+    m_vecEvents.clear();
+    m_vecStrings.clear();
+    m_StringMap.clear();
+
+    if (!pMdl)
+        return false;
+
+    // string 0 is the empty name of events that only have a number
+    Intern("");
+
+    std::vector<CAnimEvent> vecSorted;
+
+    for (int i = 0; i < pMdl->numlocalseq; i++)
+    {
+        const mstudioseqdesc_t* pSeqDesc = pMdl->pLocalSeqdesc(i);
+
+        CSequenceEvents seq;
+        seq.m_iFirst = (int)m_vecEvents.size();
+        seq.m_iCount = std::max(pSeqDesc->numevents, 0);
+        seq.m_bLooping = (pSeqDesc->flags & STUDIO_LOOPING) != 0;
+
+        vecSorted.clear();
+
+        for (int j = 0; j < seq.m_iCount; j++)
+        {
+            const mstudioevent_t* pEvent = pSeqDesc->pEvent(j);
+
+            CAnimEvent event;
+            event.m_flCycle = pEvent->cycle;
+            event.m_iEvent = pEvent->event;
+            event.m_iType = pEvent->type;
+            event.m_iName = pEvent->szeventindex != 0 ? Intern(pEvent->pszEventName()) : 0;
+
+            // options isn't terminated when all 64 characters are used
+            std::string strOptions(pEvent->options, strnlen(pEvent->options, sizeof(pEvent->options)));
+            event.m_iOptions = Intern(strOptions.c_str());
+
+            vecSorted.push_back(event);
+        }
+
+        // events on the same cycle keep their file order
+        std::stable_sort(vecSorted.begin(), vecSorted.end(), [](const CAnimEvent& a, const CAnimEvent& b) { return a.m_flCycle < b.m_flCycle; });
+
+        for (const CAnimEvent& event : vecSorted)
+        {
+            m_vecCycles.push_back(event.m_flCycle);
+            m_vecEvents.push_back(event);
+        }
+
+        m_vecSequences.push_back(seq);
+    }
+
+    return true;
+}
+
+int CEventTimeline::Range(const CSequenceEvents& seq, float flFrom, float flTo, int iWritten, const CAnimEvent** ppEvents, int nMaxEvents) const
+{
+    const float* pBegin = m_vecCycles.data() + seq.m_iFirst;
+    const float* pEnd = pBegin + seq.m_iCount;
+
+    int iFirst = (int)(std::lower_bound(pBegin, pEnd, flFrom) - pBegin);
+    int iLast = (int)(std::lower_bound(pBegin + iFirst, pEnd, flTo) - pBegin);
+
+    for (int i = iFirst; i < iLast && iWritten + (i - iFirst) < nMaxEvents; i++)
+        ppEvents[iWritten + (i - iFirst)] = &m_vecEvents[seq.m_iFirst + i];
+
+    return iLast - iFirst;
+}
+
+int CEventTimeline::Query(int iSequence, float flCycleFrom, float flCycleTo, const CAnimEvent** ppEvents, int nMaxEvents) const
+{
+    if (iSequence < 0 || iSequence >= (int)m_vecSequences.size())
+        return 0;
+
+    const CSequenceEvents& seq = m_vecSequences[iSequence];
+
+    if (seq.m_iCount == 0)
+        return 0;
+
+    if (flCycleFrom <= flCycleTo)
+        return Range(seq, flCycleFrom, flCycleTo, 0, ppEvents, nMaxEvents);
+
+    if (!seq.m_bLooping)
+        return 0;
+
+    // wrapped through the end of the loop, the tail of the cycle fires before the head
+    int nTail = Range(seq, flCycleFrom, FLT_MAX, 0, ppEvents, nMaxEvents);
+    return nTail + Range(seq, -FLT_MAX, flCycleTo, nTail, ppEvents, nMaxEvents);
+}
+
+size_t CEventTimeline::MemoryUsage() const
+{
+    return HeapBytes(m_vecSequences) + HeapBytes(m_vecCycles) + HeapBytes(m_vecEvents) + HeapBytes(m_vecStrings) + HeapBytes(m_StringMap);
+}
@@ -0,0 +1,172 @@
+#include "mdlfile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::string FindGameFile(const std::string& strFrom, const std::string& strName)
+{
+    std::filesystem::path name(strName);
+    std::filesystem::path dir = std::filesystem::path(strFrom).parent_path();
+
+    std::error_code ec;
+
+    if (std::filesystem::exists(dir / name.filename(), ec))
+        return (dir / name.filename()).string();
+
+    for (std::filesystem::path base = dir; !base.empty(); base = base.parent_path())
+    {
+        if (std::filesystem::exists(base / name, ec))
+            return (base / name).string();
+
+        if (base == base.parent_path())
+            break;
+    }
+
+    return "";
+}
+
+std::string CanonicalPath(const std::string& filename)
+{
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::weakly_canonical(filename, ec);
+    return ec ? filename : path.string();
+}
+
+std::string StripExtension(const std::string& filename)
+{
+    size_t iExt = filename.find_last_of("./\\");
+    return (iExt != std::string::npos && filename[iExt] == '.') ? filename.substr(0, iExt) : filename;
+}
+
+std::string LowerCase(const std::string& str)
+{
+    std::string strLower = str;
+    std::transform(strLower.begin(), strLower.end(), strLower.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+    return strLower;
+}
+
+CMappedFile::~CMappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool CMappedFile::Open(const std::string& filename)
+{
+    Close();
+
+    HANDLE hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (!hMapping)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    const void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (!pView)
+    {
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+
+    m_hFile = hFile;
+    m_hMapping = hMapping;
+    m_pData = (const char*)pView;
+    m_nSize = (size_t)size.QuadPart;
+
+    return true;
+}
+
+void CMappedFile::Close()
+{
+    if (m_pData)
+        UnmapViewOfFile(m_pData);
+
+    if (m_hMapping)
+        CloseHandle((HANDLE)m_hMapping);
+
+    if (m_hFile)
+        CloseHandle((HANDLE)m_hFile);
+
+    m_pData = nullptr;
+    m_nSize = 0;
+    m_hMapping = nullptr;
+    m_hFile = nullptr;
+}
+
+#else
+
+bool CMappedFile::Open(const std::string& filename)
+{
+    Close();
+
+    int iFile = open(filename.c_str(), O_RDONLY);
+
+    if (iFile < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(iFile, &st) != 0 || st.st_size <= 0)
+    {
+        close(iFile);
+        return false;
+    }
+
+    void* pView = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, iFile, 0);
+
+    if (pView == MAP_FAILED)
+    {
+        close(iFile);
+        return false;
+    }
+
+    m_iFile = iFile;
+    m_pData = (const char*)pView;
+    m_nSize = (size_t)st.st_size;
+
+    return true;
+}
+
+void CMappedFile::Close()
+{
+    if (m_pData)
+        munmap((void*)m_pData, m_nSize);
+
+    if (m_iFile >= 0)
+        close(m_iFile);
+
+    m_pData = nullptr;
+    m_nSize = 0;
+    m_iFile = -1;
+}
+
+#endif
@@ -0,0 +1,499 @@
+#include "mdlflex.h"
+#include "mdlmemory.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+
+namespace
+{
+    CFlexOp MakeOp(int iOpCode, int iDst, int iIndex = 0, int iIndex2 = 0,
+        float a = 0.0f, float b = 0.0f, float c = 0.0f, float d = 0.0f)
+    {
+        CFlexOp op;
+        op.m_nOpCode = (unsigned char)iOpCode;
+        op.m_nDst = (unsigned char)iDst;
+        op.m_nIndex = (unsigned short)iIndex;
+        op.m_nIndex2 = (unsigned short)iIndex2;
+        op.m_flArgs[0] = a;
+        op.m_flArgs[1] = b;
+        op.m_flArgs[2] = c;
+        op.m_flArgs[3] = d;
+
+        return op;
+    }
+
+    // RemapValClamped(controller, A, B, C, D) folded into a multiply-add and a clamp
+    CFlexOp MakeRemapOp(int iDst, int iController, float A, float B, float C, float D)
+    {
+        if (A == B)
+            return MakeOp(FLEXOP_STEP, iDst, iController, 0, B, D, C);
+
+        float flScale = 1.0f / (B - A);
+        return MakeOp(FLEXOP_REMAP, iDst, iController, 0, flScale, -A * flScale, D - C, C);
+    }
+
+    // tracks which stack slots still hold a literal pushed by STUDIO_CONST. some
+    // ops take controller indices from the stack, those literals are consumed at
+    // compile time and the op that pushed them is dropped.
+    struct CFlexStack
+    {
+        int m_iProducer[FLEX_MAX_REGISTERS];
+        float m_flConst[FLEX_MAX_REGISTERS];
+
+        int m_iDepth = 0;
+
+        void Push(int iProducer, float flConst = 0.0f)
+        {
+            m_iProducer[m_iDepth] = iProducer;
+            m_flConst[m_iDepth] = flConst;
+            m_iDepth++;
+        }
+
+        void Overwrite(int iSlot)
+        {
+            m_iProducer[iSlot] = -1;
+        }
+
+        bool TakeIndex(int iSlot, std::vector<CFlexOp>& vecOps, int& iIndex)
+        {
+            if (iSlot < 0 || m_iProducer[iSlot] < 0)
+                return false;
+
+            vecOps[m_iProducer[iSlot]].m_nOpCode = FLEXOP_NOP;
+            iIndex = (int)m_flConst[iSlot];
+
+            return true;
+        }
+    };
+}
+
+bool CFlexProgram::Compile(const studiohdr_t* pMdl)
+{
+    m_vecOps.clear();
+
+    m_iControllerCount = pMdl->numflexcontrollers;
+    m_iFlexDescCount = pMdl->numflexdesc;
+    m_iRuleCount = pMdl->numflexrules;
+    m_iInvalidRuleCount = 0;
+
+    for (int i = 0; i < m_iRuleCount; i++)
+    {
+        mstudioflexrule_t* pRule = pMdl->pFlexRule(i);
+
+        if (!pRule)
+            break;
+
+        if (!CompileRule(pMdl, pRule))
+            m_iInvalidRuleCount++;
+    }
+
+    return m_iInvalidRuleCount == 0;
+}
+
+bool CFlexProgram::CompileRule(const studiohdr_t* pMdl, const mstudioflexrule_t* pRule)
+{
+    if (pRule->flex < 0 || pRule->flex >= m_iFlexDescCount)
+        return false;
+
+    std::vector<CFlexOp> ops;
+    ops.reserve(pRule->numops + 4);
+
+    CFlexStack stack;
+    int& k = stack.m_iDepth;
+
+    auto ValidController = [&](int i) { return i >= 0 && i < m_iControllerCount; };
+    auto Controller = [&](int i) { return pMdl->pFlexcontroller(i); };
+
+    bool bValid = true;
+
+    for (int i = 0; i < pRule->numops && bValid; i++)
+    {
+        const mstudioflexop_t* pOp = pRule->iFlexOp(i);
+
+        switch (pOp->op)
+        {
+        case STUDIO_CONST:
+            if (k >= FLEX_MAX_REGISTERS)
+            {
+                bValid = false;
+                break;
+            }
+
+            stack.Push((int)ops.size(), pOp->d.value);
+            ops.push_back(MakeOp(FLEXOP_CONST, k - 1, 0, 0, pOp->d.value));
+            break;
+
+        case STUDIO_FETCH1:
+        case STUDIO_2WAY_0:
+        case STUDIO_2WAY_1:
+            if (k >= FLEX_MAX_REGISTERS || !ValidController(pOp->d.index))
+            {
+                bValid = false;
+                break;
+            }
+
+            if (pOp->op == STUDIO_FETCH1)
+                ops.push_back(MakeOp(FLEXOP_CONTROLLER, k, pOp->d.index));
+            else if (pOp->op == STUDIO_2WAY_0)
+                ops.push_back(MakeRemapOp(k, pOp->d.index, -1.0f, 0.0f, 1.0f, 0.0f));
+            else
+                ops.push_back(MakeRemapOp(k, pOp->d.index, 0.0f, 1.0f, 0.0f, 1.0f));
+
+            stack.Push(-1);
+            break;
+
+        case STUDIO_FETCH2:
+            if (k >= FLEX_MAX_REGISTERS || pOp->d.index < 0 || pOp->d.index >= m_iFlexDescCount)
+            {
+                bValid = false;
+                break;
+            }
+
+            ops.push_back(MakeOp(FLEXOP_WEIGHT, k, pOp->d.index));
+            stack.Push(-1);
+            break;
+
+        case STUDIO_ADD:
+        case STUDIO_SUB:
+        case STUDIO_MUL:
+        case STUDIO_DIV:
+        case STUDIO_MAX:
+        case STUDIO_MIN:
+        {
+            if (k < 2)
+            {
+                bValid = false;
+                break;
+            }
+
+            int iOpCode = FLEXOP_ADD;
+            switch (pOp->op)
+            {
+            case STUDIO_SUB: iOpCode = FLEXOP_SUB; break;
+            case STUDIO_MUL: iOpCode = FLEXOP_MUL; break;
+            case STUDIO_DIV: iOpCode = FLEXOP_DIV; break;
+            case STUDIO_MAX: iOpCode = FLEXOP_MAX; break;
+            case STUDIO_MIN: iOpCode = FLEXOP_MIN; break;
+            }
+
+            ops.push_back(MakeOp(iOpCode, k - 2, k - 1));
+            stack.Overwrite(k - 2);
+            k--;
+            break;
+        }
+
+        case STUDIO_NEG:
+            if (k < 1)
+            {
+                bValid = false;
+                break;
+            }
+
+            ops.push_back(MakeOp(FLEXOP_NEG, k - 1));
+            stack.Overwrite(k - 1);
+            break;
+
+        case STUDIO_COMBO:
+        case STUDIO_DOMINATE:
+        {
+            int m = pOp->d.index;
+            int km = k - m;
+            int iFirst = (pOp->op == STUDIO_DOMINATE) ? km - 1 : km;
+
+            if (m < 1 || iFirst < 0)
+            {
+                bValid = false;
+                break;
+            }
+
+            for (int j = km + 1; j < k; j++)
+                ops.push_back(MakeOp(FLEXOP_MUL, km, j));
+
+            stack.Overwrite(km);
+
+            if (pOp->op == STUDIO_DOMINATE)
+            {
+                ops.push_back(MakeOp(FLEXOP_DOMINATE, km - 1, km));
+                stack.Overwrite(km - 1);
+                k -= m;
+            }
+            else
+            {
+                k = km + 1;
+            }
+            break;
+        }
+
+        case STUDIO_NWAY:
+        {
+            // stack: ramp x, y, z, w, value controller
+            int iValue;
+            if (k < 5 || !ValidController(pOp->d.index) || !stack.TakeIndex(k - 1, ops, iValue) || !ValidController(iValue))
+            {
+                bValid = false;
+                break;
+            }
+
+            ops.push_back(MakeOp(FLEXOP_NWAY, k - 5, pOp->d.index, iValue));
+            stack.Overwrite(k - 5);
+            k -= 4;
+            break;
+        }
+
+        case STUDIO_DME_LOWER_EYELID:
+        case STUDIO_DME_UPPER_EYELID:
+        {
+            // stack: eye up/down, blink, close lid. the blink controller does not
+            // contribute to the result, it is only validated and dropped.
+            int iCloseLid, iBlink, iEyeUpDown;
+            if (k < 3 || !ValidController(pOp->d.index) ||
+                !stack.TakeIndex(k - 1, ops, iCloseLid) || !ValidController(iCloseLid) ||
+                !stack.TakeIndex(k - 2, ops, iBlink) || iBlink >= m_iControllerCount ||
+                !stack.TakeIndex(k - 3, ops, iEyeUpDown) || iEyeUpDown >= m_iControllerCount)
+            {
+                bValid = false;
+                break;
+            }
+
+            bool bLower = pOp->op == STUDIO_DME_LOWER_EYELID;
+            int iDst = k - 3;
+
+            // lower: (1 - max(updown, 0)) * (1 - closelidv) * closelid
+            // upper: (1 + min(updown, 0)) * closelidv * closelid
+            if (iEyeUpDown >= 0)
+                ops.push_back(MakeRemapOp(iDst, iEyeUpDown, Controller(iEyeUpDown)->min, Controller(iEyeUpDown)->max, -1.0f, 1.0f));
+            else
+                ops.push_back(MakeOp(FLEXOP_CONST, iDst, 0, 0, 0.0f));
+
+            ops.push_back(MakeOp(FLEXOP_CONST, iDst + 1, 0, 0, 0.0f));
+            ops.push_back(MakeOp(bLower ? FLEXOP_MAX : FLEXOP_MIN, iDst, iDst + 1));
+            ops.push_back(MakeOp(FLEXOP_SCALEBIAS, iDst, 0, 0, bLower ? -1.0f : 1.0f, 1.0f));
+
+            const mstudioflexcontroller_t* pCloseLidV = Controller(pOp->d.index);
+            ops.push_back(MakeRemapOp(iDst + 1, pOp->d.index, pCloseLidV->min, pCloseLidV->max, 0.0f, 1.0f));
+            if (bLower)
+                ops.push_back(MakeOp(FLEXOP_SCALEBIAS, iDst + 1, 0, 0, -1.0f, 1.0f));
+            ops.push_back(MakeOp(FLEXOP_MUL, iDst, iDst + 1));
+
+            const mstudioflexcontroller_t* pCloseLid = Controller(iCloseLid);
+            ops.push_back(MakeRemapOp(iDst + 1, iCloseLid, pCloseLid->min, pCloseLid->max, 0.0f, 1.0f));
+            ops.push_back(MakeOp(FLEXOP_MUL, iDst, iDst + 1));
+
+            stack.Overwrite(iDst);
+            k -= 2;
+            break;
+        }
+
+        default:
+            // STUDIO_EXP and the parser-only tokens never make it into a compiled model
+            bValid = false;
+            break;
+        }
+    }
+
+    if (!bValid || k < 1)
+    {
+        // a broken rule leaves its flex at rest instead of poisoning the whole program
+        m_vecOps.push_back(MakeOp(FLEXOP_CONST, 0, 0, 0, 0.0f));
+        m_vecOps.push_back(MakeOp(FLEXOP_STORE, 0, pRule->flex));
+        return false;
+    }
+
+    ops.push_back(MakeOp(FLEXOP_STORE, 0, pRule->flex));
+
+    for (const CFlexOp& op : ops)
+    {
+        if (op.m_nOpCode != FLEXOP_NOP)
+            m_vecOps.push_back(op);
+    }
+
+    return true;
+}
+
+void CFlexProgram::Evaluate(const float* pControllers, float* pWeights, int nInstances) const
+{
+    Evaluate(pControllers, pWeights, nInstances, nInstances);
+}
+
+void CFlexProgram::Evaluate(const float* pControllers, float* pWeights, int nInstances, int nStride) const
+{
+    if (nInstances <= 0)
+        return;
+
+    float registers[FLEX_MAX_REGISTERS * FLEX_BATCH_SIZE];
+
+    // rules may read weights written by earlier rules, anything without a rule stays at rest
+    for (int i = 0; i < m_iFlexDescCount; i++)
+        std::fill(pWeights + (size_t)i * nStride, pWeights + (size_t)i * nStride + nInstances, 0.0f);
+
+    for (int iBase = 0; iBase < nInstances; iBase += FLEX_BATCH_SIZE)
+    {
+        int nCount = std::min(FLEX_BATCH_SIZE, nInstances - iBase);
+        Run(pControllers + iBase, pWeights + iBase, nStride, nCount, registers);
+    }
+}
+
+void CFlexProgram::Run(const float* pControllers, float* pWeights, int nStride, int nCount, float* pRegisters) const
+{
+    for (const CFlexOp& op : m_vecOps)
+    {
+        float* r = pRegisters + op.m_nDst * FLEX_BATCH_SIZE;
+
+        // m_nIndex is a register for the two operand ops and a controller or flex for
+        // the rest, so each case only forms the pointer it reads through
+        auto Register = [&]() { return pRegisters + op.m_nIndex * FLEX_BATCH_SIZE; };
+        auto Controller = [&]() { return pControllers + (size_t)op.m_nIndex * nStride; };
+
+        const float a = op.m_flArgs[0];
+        const float b = op.m_flArgs[1];
+        const float c = op.m_flArgs[2];
+        const float d = op.m_flArgs[3];
+
+        switch (op.m_nOpCode)
+        {
+        case FLEXOP_CONST:
+            for (int i = 0; i < nCount; i++)
+                r[i] = a;
+            break;
+
+        case FLEXOP_CONTROLLER:
+        {
+            const float* pController = Controller();
+            for (int i = 0; i < nCount; i++)
+                r[i] = pController[i];
+            break;
+        }
+
+        case FLEXOP_WEIGHT:
+        {
+            const float* pWeight = pWeights + (size_t)op.m_nIndex * nStride;
+            for (int i = 0; i < nCount; i++)
+                r[i] = pWeight[i];
+            break;
+        }
+
+        case FLEXOP_REMAP:
+        {
+            const float* pController = Controller();
+            for (int i = 0; i < nCount; i++)
+                r[i] = std::min(std::max(pController[i] * a + b, 0.0f), 1.0f) * c + d;
+            break;
+        }
+
+        case FLEXOP_STEP:
+        {
+            const float* pController = Controller();
+            for (int i = 0; i < nCount; i++)
+                r[i] = pController[i] >= a ? b : c;
+            break;
+        }
+
+        case FLEXOP_ADD:
+        {
+            const float* rIn = Register();
+            for (int i = 0; i < nCount; i++)
+                r[i] += rIn[i];
+            break;
+        }
+
+        case FLEXOP_SUB:
+        {
+            const float* rIn = Register();
+            for (int i = 0; i < nCount; i++)
+                r[i] -= rIn[i];
+            break;
+        }
+
+        case FLEXOP_MUL:
+        {
+            const float* rIn = Register();
+            for (int i = 0; i < nCount; i++)
+                r[i] *= rIn[i];
+            break;
+        }
+
+        case FLEXOP_DIV:
+        {
+            const float* rIn = Register();
+            for (int i = 0; i < nCount; i++)
+                r[i] = rIn[i] > 0.0001f ? r[i] / rIn[i] : 0.0f;
+            break;
+        }
+
+        case FLEXOP_MIN:
+        {
+            const float* rIn = Register();
+            for (int i = 0; i < nCount; i++)
+                r[i] = std::min(r[i], rIn[i]);
+            break;
+        }
+
+        case FLEXOP_MAX:
+        {
+            const float* rIn = Register();
+            for (int i = 0; i < nCount; i++)
+                r[i] = std::max(r[i], rIn[i]);
+            break;
+        }
+
+        case FLEXOP_NEG:
+            for (int i = 0; i < nCount; i++)
+                r[i] = -r[i];
+            break;
+
+        case FLEXOP_SCALEBIAS:
+            for (int i = 0; i < nCount; i++)
+                r[i] = r[i] * a + b;
+            break;
+
+        case FLEXOP_DOMINATE:
+        {
+            const float* rIn = Register();
+            for (int i = 0; i < nCount; i++)
+                r[i] *= 1.0f - rIn[i];
+            break;
+        }
+
+        case FLEXOP_NWAY:
+        {
+            const float* pController = Controller();
+            const float* pValue = pControllers + (size_t)op.m_nIndex2 * nStride;
+            const float* x = r;
+            const float* y = r + FLEX_BATCH_SIZE;
+            const float* z = r + FLEX_BATCH_SIZE * 2;
+            const float* w = r + FLEX_BATCH_SIZE * 3;
+
+            for (int i = 0; i < nCount; i++)
+            {
+                float v = pValue[i];
+                float flRamp;
+
+                if (v <= x[i] || v >= w[i])
+                    flRamp = 0.0f;
+                else if (v < y[i])
+                    flRamp = (v - x[i]) / (y[i] - x[i]);
+                else if (v > z[i])
+                    flRamp = 1.0f - (v - z[i]) / (w[i] - z[i]);
+                else
+                    flRamp = 1.0f;
+
+                r[i] = flRamp * pController[i];
+            }
+            break;
+        }
+
+        case FLEXOP_STORE:
+        {
+            float* pWeight = pWeights + (size_t)op.m_nIndex * nStride;
+            for (int i = 0; i < nCount; i++)
+                pWeight[i] = r[i];
+            break;
+        }
+        }
+    }
+}
+
+size_t CFlexProgram::MemoryUsage() const
+{
+    return HeapBytes(m_vecOps);
+}
@@ -0,0 +1,393 @@
+#include "mdlik.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#define KNEEMAX_EPSILON 0.9998f // about 1 degree short of a straight leg
+
+namespace
+{
+    inline fltx4 Dot4(const FourVectors& a, const FourVectors& b)
+    {
+        return MaddSIMD(a.x, b.x, MaddSIMD(a.y, b.y, MulSIMD(a.z, b.z)));
+    }
+
+    inline FourVectors Sub4(const FourVectors& a, const FourVectors& b)
+    {
+        return FourVectors{ SubSIMD(a.x, b.x), SubSIMD(a.y, b.y), SubSIMD(a.z, b.z) };
+    }
+
+    inline FourVectors Scale4(const FourVectors& a, const fltx4& s)
+    {
+        return FourVectors{ MulSIMD(a.x, s), MulSIMD(a.y, s), MulSIMD(a.z, s) };
+    }
+
+    // a + b * s
+    inline FourVectors Madd4(const FourVectors& a, const FourVectors& b, const fltx4& s)
+    {
+        return FourVectors{ MaddSIMD(b.x, s, a.x), MaddSIMD(b.y, s, a.y), MaddSIMD(b.z, s, a.z) };
+    }
+
+    inline FourVectors MaskedAssign4(const fltx4& mask, const FourVectors& a, const FourVectors& b)
+    {
+        return FourVectors{ MaskedAssign(mask, a.x, b.x), MaskedAssign(mask, a.y, b.y), MaskedAssign(mask, a.z, b.z) };
+    }
+
+    // lanes of four chains gathered out of their bone matrices
+    struct alignas(16) CIKLanes
+    {
+        float m_thigh[3][4];
+        float m_knee[3][4];
+        float m_foot[3][4];
+        float m_target[3][4];
+        float m_kneeDir[3][4];
+
+        float m_outKnee[3][4];	// relative to the thigh
+        float m_outFoot[3][4];
+    };
+
+    inline FourVectors LoadLanes(const float v[3][4])
+    {
+        return FourVectors{ LoadAlignedSIMD(v[0]), LoadAlignedSIMD(v[1]), LoadAlignedSIMD(v[2]) };
+    }
+
+    inline void StoreLanes(float v[3][4], const FourVectors& a)
+    {
+        StoreAlignedSIMD(v[0], a.x);
+        StoreAlignedSIMD(v[1], a.y);
+        StoreAlignedSIMD(v[2], a.z);
+    }
+
+    inline void SetLane(float v[3][4], int iLane, const Vector& a)
+    {
+        v[0][iLane] = a.x;
+        v[1][iLane] = a.y;
+        v[2][iLane] = a.z;
+    }
+
+    inline Vector GetLane(const float v[3][4], int iLane)
+    {
+        return Vector(v[0][iLane], v[1][iLane], v[2][iLane]);
+    }
+
+    // Studio_SolveIK and CIKSolver::solve for four chains, returns the mask of lanes with a solution
+    int SolveLanes(CIKLanes& lanes)
+    {
+        FourVectors thigh = LoadLanes(lanes.m_thigh);
+        FourVectors knee = LoadLanes(lanes.m_knee);
+        FourVectors foot = LoadLanes(lanes.m_foot);
+
+        FourVectors ikFoot = Sub4(LoadLanes(lanes.m_target), thigh);
+        FourVectors ikKnee = Sub4(knee, thigh);
+        FourVectors ikShin = Sub4(foot, knee);
+
+        fltx4 l1 = SqrtSIMD(Dot4(ikKnee, ikKnee));
+        fltx4 l2 = SqrtSIMD(Dot4(ikShin, ikShin));
+        fltx4 lMin = MinSIMD(l1, l2);
+
+        fltx4 len = SqrtSIMD(Dot4(ikFoot, ikFoot));
+
+        // exaggerate knee targets for legs that are nearly straight
+        fltx4 d = MaxSIMD(AddSIMD(l1, l2), SubSIMD(len, lMin));
+        d = MulSIMD(d, ReplicateX4(100.0f));
+
+        FourVectors ikTargetKnee = Madd4(ikKnee, LoadLanes(lanes.m_kneeDir), d);
+
+        // too far, stop just short of straight
+        fltx4 maxLen = MulSIMD(AddSIMD(l1, l2), ReplicateX4(KNEEMAX_EPSILON));
+        fltx4 bTooFar = CmpGtSIMD(len, maxLen);
+        ikFoot = MaskedAssign4(bTooFar, Scale4(ikFoot, DivSIMD(maxLen, len)), ikFoot);
+        len = MinSIMD(len, maxLen);
+
+        // too close to get an accurate direction, about an 80 degree knee bend, go along the animated leg instead
+        fltx4 minDist = MaxSIMD(MulSIMD(AbsSIMD(SubSIMD(l1, l2)), ReplicateX4(1.15f)), MulSIMD(lMin, ReplicateX4(0.15f)));
+        fltx4 bTooClose = CmpLtSIMD(len, minDist);
+
+        FourVectors leg = Sub4(foot, thigh);
+        leg = Scale4(leg, MulSIMD(ReciprocalSqrtSaturateSIMD(Dot4(leg, leg)), minDist));
+        ikFoot = MaskedAssign4(bTooClose, leg, ikFoot);
+        len = MaskedAssign(bTooClose, minDist, len);
+
+        // the knee lies in the plane of the foot and knee target
+        fltx4 invLen = ReciprocalSqrtSaturateSIMD(Dot4(ikFoot, ikFoot));
+        FourVectors X = Scale4(ikFoot, invLen);
+
+        FourVectors Y = Madd4(ikTargetKnee, X, NegSIMD(Dot4(ikTargetKnee, X)));
+        Y = Scale4(Y, ReciprocalSqrtSaturateSIMD(Dot4(Y, Y)));
+
+        // distance along X to the knee, and out along Y
+        fltx4 dx = MulSIMD(AddSIMD(len, DivSIMD(SubSIMD(MulSIMD(l1, l1), MulSIMD(l2, l2)), len)), ReplicateX4(0.5f));
+        fltx4 dxClamped = MaxSIMD(LoadZeroSIMD(), MinSIMD(l1, dx));
+        fltx4 dy = SqrtSIMD(MsubSIMD(dxClamped, dxClamped, MulSIMD(l1, l1)));
+
+        FourVectors outKnee = Madd4(Scale4(X, dxClamped), Y, dy);
+
+        StoreLanes(lanes.m_outKnee, outKnee);
+        StoreLanes(lanes.m_outFoot, ikFoot);
+
+        fltx4 bSolved = AndSIMD(CmpGtSIMD(dxClamped, SubSIMD(len, l2)), CmpLtSIMD(dxClamped, l1));
+        return TestSignSIMD(bSolved);
+    }
+
+    inline void MatrixGetColumn(const matrix3x4_t& m, int i, Vector& v)
+    {
+        v = Vector(m[0][i], m[1][i], m[2][i]);
+    }
+
+    inline void MatrixSetColumn(const Vector& v, int i, matrix3x4_t& m)
+    {
+        m[0][i] = v.x;
+        m[1][i] = v.y;
+        m[2][i] = v.z;
+    }
+
+    inline void Normalize(Vector& v)
+    {
+        float flLength = sqrtf(DotProduct(v, v));
+        if (flLength > 0.0f)
+            v = v * (1.0f / flLength);
+    }
+
+    // points the matrix's x axis along vecAlignTo keeping its y axis as close as it can be
+    void Studio_AlignIKMatrix(matrix3x4_t& mat, const Vector& vecAlignTo)
+    {
+        Vector x = vecAlignTo;
+        Normalize(x);
+
+        Vector y;
+        MatrixGetColumn(mat, 1, y);
+
+        Vector z = CrossProduct(x, y);
+        Normalize(z);
+
+        y = CrossProduct(z, x);
+
+        MatrixSetColumn(x, 0, mat);
+        MatrixSetColumn(y, 1, mat);
+        MatrixSetColumn(z, 2, mat);
+    }
+}
+
+CIKSolver::CIKSolver(const CModel& model) : m_Model(model)
+{
+    int nBones = model.GetSkeletonLayout().BoneCount();
+
+    for (const CIKChain& ikChain : model.GetIKChains())
+    {
+        CChain chain{ -1, -1, -1, Vector(0.0f) };
+        bool bValid = ikChain.m_vecBones.size() == 3;
+
+        if (bValid)
+        {
+            chain.m_iThigh = ikChain.m_vecBones[0];
+            chain.m_iKnee = ikChain.m_vecBones[1];
+            chain.m_iFoot = ikChain.m_vecBones[2];
+
+            const Vector3D& kneeDir = ikChain.m_vecKneeDirs[0];
+            chain.m_vecKneeDir = Vector(kneeDir.x, kneeDir.y, kneeDir.z);
+
+            for (int iBone : ikChain.m_vecBones)
+                bValid = bValid && iBone >= 0 && iBone < nBones;
+        }
+
+        m_vecChains.push_back(chain);
+        m_vecValid.push_back(bValid);
+    }
+}
+
+void CIKSolver::Add(const CIKRequest& request)
+{
+    if (request.m_iChain < 0 || request.m_iChain >= (int)m_vecChains.size() || !m_vecValid[request.m_iChain])
+        return;
+
+    m_vecRequests.push_back(CQueuedRequest{ request, -1.0f });
+}
+
+void CIKSolver::AddTargets(const CIKTarget* pTargets, matrix3x4_t* const* ppBoneToWorlds, int nEntities)
+{
+    int nChains = (int)m_vecChains.size();
+
+    for (int e = 0; e < nEntities; e++)
+    {
+        for (int i = 0; i < nChains; i++)
+        {
+            const CIKTarget& target = pTargets[(size_t)e * nChains + i];
+
+            if (!m_vecValid[i] || target.m_flPosWeight <= 0.0f)
+                continue;
+
+            CIKRequest request;
+            request.m_pBoneToWorld = ppBoneToWorlds[e];
+            request.m_iChain = i;
+            request.m_vecTarget = target.m_vecTarget;
+            request.m_qTarget = target.m_qTarget;
+            request.m_flPosWeight = target.m_flPosWeight;
+            request.m_flRotWeight = target.m_flRotWeight;
+
+            m_vecRequests.push_back(CQueuedRequest{ request, -1.0f });
+        }
+    }
+}
+
+void CIKSolver::AddLocks(int iSequence, matrix3x4_t* pBoneToWorld, const matrix3x4_t* pLockedBoneToWorld)
+{
+    const std::vector<CSequence>& sequences = m_Model.GetSequences();
+
+    auto addLock = [&](const CIKLock& lock)
+    {
+        if (lock.m_iChain < 0 || lock.m_iChain >= (int)m_vecChains.size() || !m_vecValid[lock.m_iChain])
+            return;
+
+        const matrix3x4_t& locked = pLockedBoneToWorld[m_vecChains[lock.m_iChain].m_iFoot];
+
+        CIKRequest request;
+        request.m_pBoneToWorld = pBoneToWorld;
+        request.m_iChain = lock.m_iChain;
+        MatrixPosition(locked, request.m_vecTarget);
+        MatrixQuaternion(locked, request.m_qTarget);
+        request.m_flPosWeight = lock.m_flPosWeight;
+        request.m_flRotWeight = 1.0f;
+
+        // the local weight is how much of the animated rotation relative to the knee survives
+        m_vecRequests.push_back(CQueuedRequest{ request, lock.m_flLocalQWeight });
+    };
+
+    if (iSequence >= 0 && iSequence < (int)sequences.size())
+    {
+        for (const CIKLock& lock : sequences[iSequence].m_vecIKLocks)
+            addLock(lock);
+    }
+
+    for (const CIKLock& lock : m_Model.GetIKAutoplayLocks())
+        addLock(lock);
+}
+
+int CIKSolver::Solve()
+{
+    int nSolved = 0;
+    int nRequests = (int)m_vecRequests.size();
+
+    CIKLanes lanes;
+
+    for (int iFirst = 0; iFirst < nRequests; iFirst += 4)
+    {
+        int nLanes = nRequests - iFirst < 4 ? nRequests - iFirst : 4;
+        int iStraight = 0;
+
+        for (int iLane = 0; iLane < 4; iLane++)
+        {
+            // unused lanes repeat the first request, their results are dropped
+            const CIKRequest& request = m_vecRequests[iFirst + (iLane < nLanes ? iLane : 0)].m_Request;
+            const CChain& chain = m_vecChains[request.m_iChain];
+            const matrix3x4_t* pBones = request.m_pBoneToWorld;
+
+            Vector thigh, knee, foot;
+            MatrixPosition(pBones[chain.m_iThigh], thigh);
+            MatrixPosition(pBones[chain.m_iKnee], knee);
+            MatrixPosition(pBones[chain.m_iFoot], foot);
+
+            Vector kneeDir;
+
+            if (DotProduct(chain.m_vecKneeDir, chain.m_vecKneeDir) > 0.0f)
+            {
+                VectorRotate(chain.m_vecKneeDir, pBones[chain.m_iThigh], kneeDir);
+            }
+            else
+            {
+                // the knee bends the way it sticks out of the animated leg, a leg too straight to tell isn't solved
+                Vector leg = foot - thigh;
+
+                float l1 = sqrtf(DotProduct(knee - thigh, knee - thigh));
+                float l2 = sqrtf(DotProduct(foot - knee, foot - knee));
+                float l3 = sqrtf(DotProduct(leg, leg));
+
+                if (l3 > (l1 + l2) * KNEEMAX_EPSILON)
+                {
+                    iStraight |= 1 << iLane;
+                    kneeDir = Vector(0.0f);
+                }
+                else
+                {
+                    kneeDir = (knee - thigh) - leg * (l1 / l3);
+                    Normalize(kneeDir);
+                }
+            }
+
+            SetLane(lanes.m_thigh, iLane, thigh);
+            SetLane(lanes.m_knee, iLane, knee);
+            SetLane(lanes.m_foot, iLane, foot);
+            SetLane(lanes.m_target, iLane, foot + (request.m_vecTarget - foot) * request.m_flPosWeight);
+            SetLane(lanes.m_kneeDir, iLane, kneeDir);
+        }
+
+        int iSolved = SolveLanes(lanes) & ~iStraight;
+
+        for (int iLane = 0; iLane < nLanes; iLane++)
+        {
+            const CQueuedRequest& queued = m_vecRequests[iFirst + iLane];
+            const CIKRequest& request = queued.m_Request;
+            const CChain& chain = m_vecChains[request.m_iChain];
+
+            bool bSolved = (iSolved & (1 << iLane)) != 0;
+            bool bLock = queued.m_flLocalQWeight >= 0.0f;
+
+            if (!bSolved && !bLock)
+                continue;
+
+            matrix3x4_t& mThigh = request.m_pBoneToWorld[chain.m_iThigh];
+            matrix3x4_t& mKnee = request.m_pBoneToWorld[chain.m_iKnee];
+            matrix3x4_t& mFoot = request.m_pBoneToWorld[chain.m_iFoot];
+
+            Quaternion qKnee, qFoot;
+            MatrixQuaternion(mKnee, qKnee);
+            MatrixQuaternion(mFoot, qFoot);
+
+            Vector vecFoot;
+            MatrixPosition(mFoot, vecFoot);
+
+            // the foot's animated rotation relative to the knee, before the knee moves
+            Quaternion qInvKnee, qAnimLocal;
+            QuaternionConjugate(qKnee, qInvKnee);
+            QuaternionMult(qInvKnee, qFoot, qAnimLocal);
+
+            if (bSolved)
+            {
+                Vector thigh = GetLane(lanes.m_thigh, iLane);
+                Vector ikKnee = GetLane(lanes.m_outKnee, iLane);
+                Vector ikFoot = GetLane(lanes.m_outFoot, iLane);
+
+                Studio_AlignIKMatrix(mThigh, ikKnee);
+                Studio_AlignIKMatrix(mKnee, ikFoot - ikKnee);
+
+                MatrixSetColumn(thigh + ikKnee, 3, mKnee);
+                vecFoot = thigh + ikFoot;
+
+                nSolved++;
+            }
+
+            if (bLock)
+            {
+                // the foot takes the locked rotation, then relative to the (new) knee it's
+                // slerped back towards the animated one, as CIKContext::SolveLock does
+                Quaternion qLockLocal;
+                MatrixQuaternion(mKnee, qKnee);
+                QuaternionConjugate(qKnee, qInvKnee);
+                QuaternionMult(qInvKnee, request.m_qTarget, qLockLocal);
+
+                Quaternion qLocal;
+                QuaternionSlerp(qLockLocal, qAnimLocal, queued.m_flLocalQWeight, qLocal);
+                QuaternionMult(qKnee, qLocal, qFoot);
+            }
+            else if (request.m_flRotWeight > 0.0f)
+            {
+                // otherwise the foot keeps its world rotation unless the request blends towards its own
+                QuaternionSlerp(qFoot, request.m_qTarget, request.m_flRotWeight, qFoot);
+            }
+
+            QuaternionMatrix(qFoot, vecFoot, mFoot);
+        }
+    }
+
+    m_vecRequests.clear();
+    return nSolved;
+}
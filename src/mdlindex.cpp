@@ -0,0 +1,410 @@
+#include "mdlindex.h"
+#include "mdlobj.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    // names from different tools disagree on case and path separators
+    std::string Normalize(const std::string& strName)
+    {
+        std::string str = strName;
+
+        for (char& c : str)
+            c = c == '\\' ? '/' : (char)std::tolower((unsigned char)c);
+
+        return str;
+    }
+
+    void WriteVarint(std::vector<char>& vecOut, uint32_t nValue)
+    {
+        while (nValue >= 0x80)
+        {
+            vecOut.push_back((char)(nValue | 0x80));
+            nValue >>= 7;
+        }
+
+        vecOut.push_back((char)nValue);
+    }
+
+    // NULL past the end
+    const unsigned char* ReadVarint(const unsigned char* p, const unsigned char* pEnd, uint32_t& nValue)
+    {
+        nValue = 0;
+
+        for (int iShift = 0; p < pEnd && iShift < 35; iShift += 7)
+        {
+            unsigned char c = *p++;
+            nValue |= (uint32_t)(c & 0x7f) << iShift;
+
+            if (!(c & 0x80))
+                return p;
+        }
+
+        return nullptr;
+    }
+
+    void Append(std::vector<char>& vecOut, const void* pData, size_t nSize)
+    {
+        vecOut.insert(vecOut.end(), (const char*)pData, (const char*)pData + nSize);
+    }
+}
+
+bool CModelIndex::Open(const std::string& filename)
+{
+    Close();
+
+    if (!m_File.Open(filename))
+        return false;
+
+    if (Open(m_File.Data(), m_File.Size()))
+        return true;
+
+    m_File.Close();
+    return false;
+}
+
+bool CModelIndex::Open(const char* pData, size_t nSize)
+{
+    if (pData != m_File.Data())
+        Close();
+
+    const CModelIndexHeader* pHeader = (const CModelIndexHeader*)pData;
+
+    if (!pData || nSize < sizeof(CModelIndexHeader) || pHeader->m_nMagic != MODELINDEX_MAGIC || pHeader->m_nVersion != MODELINDEX_VERSION)
+        return false;
+
+    // the sections are in header order, each ending where the next starts
+    size_t nModelEnd = pHeader->m_nModelIndex + (size_t)pHeader->m_nModels * sizeof(uint32_t);
+    size_t nTermEnd = pHeader->m_nTermIndex + (size_t)pHeader->m_nTerms * sizeof(CModelIndexTerm);
+
+    if (pHeader->m_nSize > nSize || pHeader->m_nModelIndex < sizeof(CModelIndexHeader) || pHeader->m_nModelIndex % 4 != 0 || pHeader->m_nTermIndex % 4 != 0
+        || nModelEnd > pHeader->m_nTermIndex || nTermEnd > pHeader->m_nStringIndex
+        || pHeader->m_nStringIndex > pHeader->m_nPostingIndex || pHeader->m_nPostingIndex > pHeader->m_nSize)
+        return false;
+
+    const uint32_t* pModels = (const uint32_t*)(pData + pHeader->m_nModelIndex);
+    const CModelIndexTerm* pTerms = (const CModelIndexTerm*)(pData + pHeader->m_nTermIndex);
+
+    // every string has to end inside the string section
+    uint32_t nStrings = pHeader->m_nPostingIndex - pHeader->m_nStringIndex;
+    uint32_t nPostings = pHeader->m_nSize - pHeader->m_nPostingIndex;
+
+    if (nStrings > 0 && pData[pHeader->m_nPostingIndex - 1] != '\0')
+        return false;
+
+    for (uint32_t i = 0; i < pHeader->m_nModels; i++)
+    {
+        if (pModels[i] >= nStrings)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < pHeader->m_nTerms; i++)
+    {
+        if (pTerms[i].m_nName >= nStrings || pTerms[i].m_iKind >= INDEXTERM_COUNT || pTerms[i].m_nPostings > nPostings || pTerms[i].m_nCount > pHeader->m_nModels)
+            return false;
+    }
+
+    m_pHeader = pHeader;
+    m_pModels = pModels;
+    m_pTerms = pTerms;
+    m_pStrings = pData + pHeader->m_nStringIndex;
+    m_pPostings = (const unsigned char*)pData + pHeader->m_nPostingIndex;
+    m_pEnd = (const unsigned char*)pData + pHeader->m_nSize;
+
+    return true;
+}
+
+void CModelIndex::Close()
+{
+    m_File.Close();
+
+    m_pHeader = nullptr;
+    m_pModels = nullptr;
+    m_pTerms = nullptr;
+    m_pStrings = nullptr;
+    m_pPostings = nullptr;
+    m_pEnd = nullptr;
+}
+
+const char* CModelIndex::ModelName(int iModel) const
+{
+    return (iModel >= 0 && iModel < ModelCount()) ? m_pStrings + m_pModels[iModel] : nullptr;
+}
+
+int CModelIndex::FindTerm(IndexTerm_t iKind, const std::string& strName) const
+{
+    if (!m_pHeader)
+        return -1;
+
+    std::string strKey = Normalize(strName);
+
+    const CModelIndexTerm* pEnd = m_pTerms + m_pHeader->m_nTerms;
+    const CModelIndexTerm* pTerm = std::lower_bound(m_pTerms, pEnd, strKey, [&](const CModelIndexTerm& term, const std::string& str)
+    {
+        if (term.m_iKind != (uint32_t)iKind)
+            return term.m_iKind < (uint32_t)iKind;
+
+        return std::strcmp(m_pStrings + term.m_nName, str.c_str()) < 0;
+    });
+
+    if (pTerm == pEnd || pTerm->m_iKind != (uint32_t)iKind || strKey != m_pStrings + pTerm->m_nName)
+        return -1;
+
+    return (int)(pTerm - m_pTerms);
+}
+
+IndexTerm_t CModelIndex::TermKind(int iTerm) const
+{
+    return (iTerm >= 0 && iTerm < TermCount()) ? (IndexTerm_t)m_pTerms[iTerm].m_iKind : INDEXTERM_COUNT;
+}
+
+const char* CModelIndex::TermName(int iTerm) const
+{
+    return (iTerm >= 0 && iTerm < TermCount()) ? m_pStrings + m_pTerms[iTerm].m_nName : nullptr;
+}
+
+int CModelIndex::TermModelCount(int iTerm) const
+{
+    return (iTerm >= 0 && iTerm < TermCount()) ? (int)m_pTerms[iTerm].m_nCount : 0;
+}
+
+void CModelIndex::Models(int iTerm, std::vector<int>& vecModels) const
+{
+    vecModels.clear();
+
+    if (iTerm < 0 || iTerm >= TermCount())
+        return;
+
+    const CModelIndexTerm& term = m_pTerms[iTerm];
+    const unsigned char* p = m_pPostings + term.m_nPostings;
+
+    vecModels.reserve(term.m_nCount);
+
+    int iModel = -1;
+
+    for (uint32_t i = 0; i < term.m_nCount; i++)
+    {
+        uint32_t nGap;
+
+        // a corrupt list ends early rather than reading past the file
+        if (!(p = ReadVarint(p, m_pEnd, nGap)) || nGap >= m_pHeader->m_nModels - (uint32_t)(iModel + 1))
+            return;
+
+        iModel += (int)nGap + 1;
+        vecModels.push_back(iModel);
+    }
+}
+
+bool CModelIndex::Find(IndexTerm_t iKind, const std::string& strName, std::vector<int>& vecModels) const
+{
+    int iTerm = FindTerm(iKind, strName);
+
+    Models(iTerm, vecModels);
+    return iTerm >= 0;
+}
+
+int CModelIndexBuilder::Intern(IndexTerm_t iKind, const std::string& strName)
+{
+    std::string strKey = (char)('0' + iKind) + Normalize(strName);
+
+    auto it = m_TermIds.find(strKey);
+    if (it != m_TermIds.end())
+        return it->second;
+
+    int iTerm = (int)m_vecTerms.size();
+
+    m_TermIds.emplace(strKey, iTerm);
+    m_vecTerms.push_back(strKey);
+
+    return iTerm;
+}
+
+void CModelIndexBuilder::Load(const CModelIndex& index)
+{
+    std::vector<int> vecModels;
+
+    for (int i = 0; i < index.TermCount(); i++)
+    {
+        int iTerm = Intern(index.TermKind(i), index.TermName(i));
+
+        index.Models(i, vecModels);
+
+        for (int iModel : vecModels)
+            m_Models[index.ModelName(iModel)].push_back(iTerm);
+    }
+
+    // models without a single term only show up in the model table
+    for (int i = 0; i < index.ModelCount(); i++)
+        m_Models[index.ModelName(i)];
+}
+
+void CModelIndexBuilder::Add(const std::string& strModel, const CModel& model)
+{
+    std::vector<int>& vecTerms = m_Models[strModel];
+    vecTerms.clear();
+
+    for (const std::string& strMaterial : model.GetMaterials())
+        vecTerms.push_back(Intern(INDEXTERM_MATERIAL, strMaterial));
+
+    if (!model.SurfaceProp().empty())
+        vecTerms.push_back(Intern(INDEXTERM_SURFACEPROP, model.SurfaceProp()));
+
+    for (int i = 0; i < model.GetSkeletonLayout().BoneCount(); i++)
+    {
+        const CModelBone* pBone = model.Bone(i);
+
+        if (!pBone)
+            continue;
+
+        vecTerms.push_back(Intern(INDEXTERM_BONE, pBone->m_strName));
+
+        if (!pBone->m_strSurfaceProp.empty())
+            vecTerms.push_back(Intern(INDEXTERM_SURFACEPROP, pBone->m_strSurfaceProp));
+    }
+}
+
+void CModelIndexBuilder::Remove(const std::string& strModel)
+{
+    m_Models.erase(strModel);
+}
+
+void CModelIndexBuilder::Clear()
+{
+    m_TermIds.clear();
+    m_vecTerms.clear();
+    m_Models.clear();
+}
+
+void CModelIndexBuilder::Write(std::vector<char>& vecOut) const
+{
+    std::vector<const std::string*> vecNames;
+    vecNames.reserve(m_Models.size());
+
+    for (const auto& entry : m_Models)
+        vecNames.push_back(&entry.first);
+
+    std::sort(vecNames.begin(), vecNames.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+
+    // invert, models go in ascending so every list comes out sorted
+    std::vector<std::vector<int>> vecPostings(m_vecTerms.size());
+
+    for (int i = 0; i < (int)vecNames.size(); i++)
+    {
+        for (int iTerm : m_Models.at(*vecNames[i]))
+        {
+            std::vector<int>& vecModels = vecPostings[iTerm];
+
+            // a model can name a term more than once
+            if (vecModels.empty() || vecModels.back() != i)
+                vecModels.push_back(i);
+        }
+    }
+
+    // terms nothing has any more are left out, the rest are sorted for lookups
+    std::vector<int> vecTerms;
+
+    for (int i = 0; i < (int)m_vecTerms.size(); i++)
+    {
+        if (!vecPostings[i].empty())
+            vecTerms.push_back(i);
+    }
+
+    std::sort(vecTerms.begin(), vecTerms.end(), [this](int a, int b) { return m_vecTerms[a] < m_vecTerms[b]; });
+
+    std::vector<char> vecStrings;
+    std::vector<char> vecPostingData;
+    std::vector<uint32_t> vecModelNames;
+    std::vector<CModelIndexTerm> vecTermTable;
+
+    for (const std::string* pName : vecNames)
+    {
+        vecModelNames.push_back((uint32_t)vecStrings.size());
+        Append(vecStrings, pName->c_str(), pName->size() + 1);
+    }
+
+    for (int iTerm : vecTerms)
+    {
+        const std::string& strKey = m_vecTerms[iTerm];
+        const std::vector<int>& vecModels = vecPostings[iTerm];
+
+        CModelIndexTerm term;
+        term.m_nName = (uint32_t)vecStrings.size();
+        term.m_iKind = (uint32_t)(strKey[0] - '0');
+        term.m_nPostings = (uint32_t)vecPostingData.size();
+        term.m_nCount = (uint32_t)vecModels.size();
+
+        Append(vecStrings, strKey.c_str() + 1, strKey.size());
+
+        int iLast = -1;
+        for (int iModel : vecModels)
+        {
+            WriteVarint(vecPostingData, (uint32_t)(iModel - iLast - 1));
+            iLast = iModel;
+        }
+
+        vecTermTable.push_back(term);
+    }
+
+    CModelIndexHeader header;
+    header.m_nMagic = MODELINDEX_MAGIC;
+    header.m_nVersion = MODELINDEX_VERSION;
+    header.m_nModels = (uint32_t)vecModelNames.size();
+    header.m_nTerms = (uint32_t)vecTermTable.size();
+    header.m_nModelIndex = sizeof(CModelIndexHeader);
+    header.m_nTermIndex = header.m_nModelIndex + header.m_nModels * sizeof(uint32_t);
+    header.m_nStringIndex = header.m_nTermIndex + header.m_nTerms * sizeof(CModelIndexTerm);
+    header.m_nPostingIndex = header.m_nStringIndex + (uint32_t)vecStrings.size();
+    header.m_nSize = header.m_nPostingIndex + (uint32_t)vecPostingData.size();
+
+    vecOut.clear();
+    vecOut.reserve(header.m_nSize);
+
+    Append(vecOut, &header, sizeof(header));
+    Append(vecOut, vecModelNames.data(), vecModelNames.size() * sizeof(uint32_t));
+    Append(vecOut, vecTermTable.data(), vecTermTable.size() * sizeof(CModelIndexTerm));
+    Append(vecOut, vecStrings.data(), vecStrings.size());
+    Append(vecOut, vecPostingData.data(), vecPostingData.size());
+}
+
+bool CModelIndexBuilder::Write(const std::string& filename) const
+{
+    std::vector<char> vecData;
+    Write(vecData);
+
+    // readers may have the old index mapped, truncating it under them would fault
+    // their reads. the new one goes next to it and is renamed over it when complete
+    std::string strTemp = filename + ".tmp";
+
+    {
+        std::ofstream file(strTemp, std::ofstream::binary | std::ofstream::trunc);
+
+        if (!file.is_open())
+            return false;
+
+        file.write(vecData.data(), vecData.size());
+        file.close();
+
+        if (!file)
+        {
+            std::remove(strTemp.c_str());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(strTemp, filename, error);
+
+    if (error)
+    {
+        std::remove(strTemp.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,165 @@
+#include "mdlinstance.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+
+#include <algorithm>
+
+CModelInstances::CModelInstances(std::shared_ptr<const CModel> pModel, int nReserve) :
+    m_pModel(std::move(pModel)), m_PoseEvaluator(*m_pModel)
+{
+    m_nBones = m_pModel->GetSkeletonLayout().BoneCount();
+    m_nPoseParameters = (int)m_pModel->GetPoseParameters().size();
+    m_nFlexControllers = m_pModel->GetFlexProgram().ControllerCount();
+    m_nFlexWeights = m_pModel->GetFlexProgram().FlexDescCount();
+    m_nIKChains = (int)m_pModel->GetIKChains().size();
+
+    float flZero[POSE_CONTROLLER_INPUTS] = {};
+    m_PoseEvaluator.EncodeControllers(flZero, m_flDefaultControllers, 1);
+
+    Reserve(nReserve);
+}
+
+void CModelInstances::Reserve(int nInstances)
+{
+    if (nInstances <= m_nCapacity)
+        return;
+
+    int nOldCapacity = m_nCapacity;
+    m_nCapacity = nInstances;
+
+    m_vecHandles.resize(m_nCapacity);
+    m_vecSequences.resize(m_nCapacity);
+    m_vecCycles.resize(m_nCapacity);
+    m_vecPoses.resize(m_nCapacity);
+    m_vecPoseParameters.resize((size_t)m_nCapacity * m_nPoseParameters);
+    m_vecControllers.resize((size_t)m_nCapacity * POSE_CONTROLLER_INPUTS);
+    m_vecIKTargets.resize((size_t)m_nCapacity * m_nIKChains);
+    m_vecBoneToWorld.resize((size_t)m_nCapacity * m_nBones);
+
+    // the flex arenas are strided by capacity, so their rows spread out
+    std::vector<float> vecFlexControllers((size_t)m_nCapacity * m_nFlexControllers, 0.0f);
+    std::vector<float> vecFlexWeights((size_t)m_nCapacity * m_nFlexWeights, 0.0f);
+
+    for (int i = 0; i < m_nFlexControllers; i++)
+        std::copy_n(m_vecFlexControllers.begin() + (size_t)i * nOldCapacity, m_nCount, vecFlexControllers.begin() + (size_t)i * m_nCapacity);
+
+    for (int i = 0; i < m_nFlexWeights; i++)
+        std::copy_n(m_vecFlexWeights.begin() + (size_t)i * nOldCapacity, m_nCount, vecFlexWeights.begin() + (size_t)i * m_nCapacity);
+
+    m_vecFlexControllers.swap(vecFlexControllers);
+    m_vecFlexWeights.swap(vecFlexWeights);
+
+    m_vecBoneToWorlds.resize(m_nCapacity);
+
+    for (int i = 0; i < m_nCapacity; i++)
+        m_vecBoneToWorlds[i] = BoneToWorld(i);
+}
+
+CInstanceHandle CModelInstances::Spawn()
+{
+    int iSlot;
+
+    if (!m_vecFreeSlots.empty())
+    {
+        iSlot = m_vecFreeSlots.back();
+        m_vecFreeSlots.pop_back();
+    }
+    else
+    {
+        iSlot = (int)m_vecSlots.size();
+        m_vecSlots.push_back(CSlot{ -1, 0 });
+    }
+
+    if (m_nCount == m_nCapacity)
+        Reserve(std::max(m_nCapacity * 2, 16));
+
+    int iRow = m_nCount++;
+
+    m_vecSlots[iSlot].m_iRow = iRow;
+    m_vecHandles[iRow] = CInstanceHandle{ iSlot, m_vecSlots[iSlot].m_iSerial };
+
+    ResetRow(iRow);
+    return m_vecHandles[iRow];
+}
+
+bool CModelInstances::Despawn(const CInstanceHandle& handle)
+{
+    int iRow = Row(handle);
+    if (iRow < 0)
+        return false;
+
+    int iLast = --m_nCount;
+
+    if (iRow != iLast)
+    {
+        MoveRow(iLast, iRow);
+        m_vecSlots[m_vecHandles[iRow].m_iSlot].m_iRow = iRow;
+    }
+
+    CSlot& slot = m_vecSlots[handle.m_iSlot];
+    slot.m_iRow = -1;
+    slot.m_iSerial++;
+
+    m_vecFreeSlots.push_back(handle.m_iSlot);
+    return true;
+}
+
+void CModelInstances::Clear()
+{
+    for (int i = 0; i < m_nCount; i++)
+    {
+        CSlot& slot = m_vecSlots[m_vecHandles[i].m_iSlot];
+        slot.m_iRow = -1;
+        slot.m_iSerial++;
+
+        m_vecFreeSlots.push_back(m_vecHandles[i].m_iSlot);
+    }
+
+    m_nCount = 0;
+}
+
+void CModelInstances::ResetRow(int iRow)
+{
+    m_vecSequences[iRow] = 0;
+    m_vecCycles[iRow] = 0.0f;
+
+    // the layout keeps the rest pose, so this works with the header dropped too
+    Studio_InitPose(m_pModel->GetSkeletonLayout(), m_vecPoses[iRow]);
+
+    std::fill_n(PoseParameters() + (size_t)iRow * m_nPoseParameters, m_nPoseParameters, 0.0f);
+    std::copy_n(m_flDefaultControllers, POSE_CONTROLLER_INPUTS, Controllers() + (size_t)iRow * POSE_CONTROLLER_INPUTS);
+
+    for (int i = 0; i < m_nFlexControllers; i++)
+        m_vecFlexControllers[(size_t)i * m_nCapacity + iRow] = 0.0f;
+
+    for (int i = 0; i < m_nFlexWeights; i++)
+        m_vecFlexWeights[(size_t)i * m_nCapacity + iRow] = 0.0f;
+
+    CIKTarget noTarget{ Vector(0.0f), Quaternion{ 0.0f, 0.0f, 0.0f, 1.0f }, 0.0f, 0.0f };
+    std::fill_n(IKTargets() + (size_t)iRow * m_nIKChains, m_nIKChains, noTarget);
+
+    matrix3x4_t* pBoneToWorld = BoneToWorld(iRow);
+
+    for (int i = 0; i < m_nBones; i++)
+        SetIdentityMatrix(pBoneToWorld[i]);
+}
+
+void CModelInstances::MoveRow(int iFrom, int iTo)
+{
+    m_vecHandles[iTo] = m_vecHandles[iFrom];
+    m_vecSequences[iTo] = m_vecSequences[iFrom];
+    m_vecCycles[iTo] = m_vecCycles[iFrom];
+    m_vecPoses[iTo] = m_vecPoses[iFrom];
+
+    std::copy_n(PoseParameters() + (size_t)iFrom * m_nPoseParameters, m_nPoseParameters, PoseParameters() + (size_t)iTo * m_nPoseParameters);
+    std::copy_n(Controllers() + (size_t)iFrom * POSE_CONTROLLER_INPUTS, POSE_CONTROLLER_INPUTS, Controllers() + (size_t)iTo * POSE_CONTROLLER_INPUTS);
+
+    for (int i = 0; i < m_nFlexControllers; i++)
+        m_vecFlexControllers[(size_t)i * m_nCapacity + iTo] = m_vecFlexControllers[(size_t)i * m_nCapacity + iFrom];
+
+    for (int i = 0; i < m_nFlexWeights; i++)
+        m_vecFlexWeights[(size_t)i * m_nCapacity + iTo] = m_vecFlexWeights[(size_t)i * m_nCapacity + iFrom];
+
+    std::copy_n(IKTargets() + (size_t)iFrom * m_nIKChains, m_nIKChains, IKTargets() + (size_t)iTo * m_nIKChains);
+    std::copy_n(BoneToWorld(iFrom), m_nBones, BoneToWorld(iTo));
+}
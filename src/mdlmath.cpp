@@ -0,0 +1,600 @@
+#include "mdlmath.h"
+
+#include <cmath>
+
+namespace
+{
+    // SoA streams are loaded four at a time, a short tail goes through a zero padded copy
+    inline fltx4 LoadTail(const float* p, int n)
+    {
+        if (n >= 4)
+            return LoadUnalignedSIMD(p);
+
+        float tmp[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < n; i++)
+            tmp[i] = p[i];
+
+        return LoadUnalignedSIMD(tmp);
+    }
+
+    inline void StoreTail(float* p, const fltx4& a, int n)
+    {
+        if (n >= 4)
+        {
+            StoreUnalignedSIMD(p, a);
+            return;
+        }
+
+        float tmp[4];
+        StoreUnalignedSIMD(tmp, a);
+        for (int i = 0; i < n; i++)
+            p[i] = tmp[i];
+    }
+
+    inline FourQuaternions LoadQuaternions(const CQuaternionSoA& q, int i, int n)
+    {
+        return FourQuaternions{ LoadTail(q.x + i, n), LoadTail(q.y + i, n), LoadTail(q.z + i, n), LoadTail(q.w + i, n) };
+    }
+
+    inline void StoreQuaternions(const CQuaternionSoA& q, int i, const FourQuaternions& v, int n)
+    {
+        StoreTail(q.x + i, v.x, n);
+        StoreTail(q.y + i, v.y, n);
+        StoreTail(q.z + i, v.z, n);
+        StoreTail(q.w + i, v.w, n);
+    }
+
+    inline fltx4 Dot4SIMD(const FourQuaternions& p, const FourQuaternions& q)
+    {
+        return MaddSIMD(p.x, q.x, MaddSIMD(p.y, q.y, MaddSIMD(p.z, q.z, MulSIMD(p.w, q.w))));
+    }
+
+    // flips the sign of every lane of q where mask has its sign bit set
+    inline FourQuaternions FlipSignSIMD(const FourQuaternions& q, const fltx4& mask)
+    {
+        fltx4 sign = AndSIMD(mask, ReplicateX4(-0.0f));
+        return FourQuaternions{ XorSIMD(q.x, sign), XorSIMD(q.y, sign), XorSIMD(q.z, sign), XorSIMD(q.w, sign) };
+    }
+
+    inline fltx4 MatrixRowSIMD(const matrix3x4_t& m, int i)
+    {
+        return LoadUnalignedSIMD(m.m_flMatVal[i]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// single value
+//-----------------------------------------------------------------------------
+
+void AngleQuaternion(const RadianEuler& angles, Quaternion& q)
+{
+    float sr = sinf(angles.x * 0.5f), cr = cosf(angles.x * 0.5f);
+    float sp = sinf(angles.y * 0.5f), cp = cosf(angles.y * 0.5f);
+    float sy = sinf(angles.z * 0.5f), cy = cosf(angles.z * 0.5f);
+
+    float srXcp = sr * cp, crXsp = cr * sp;
+    q.x = srXcp * cy - crXsp * sy;
+    q.y = crXsp * cy + srXcp * sy;
+
+    float crXcp = cr * cp, srXsp = sr * sp;
+    q.z = crXcp * sy - srXsp * cy;
+    q.w = crXcp * cy + srXsp * sy;
+}
+
+void QuaternionAngles(const Quaternion& q, RadianEuler& angles)
+{
+    matrix3x4_t matrix;
+    QuaternionMatrix(q, Vector(0.0f), matrix);
+
+    float xyDist = sqrtf(matrix[0][0] * matrix[0][0] + matrix[1][0] * matrix[1][0]);
+
+    if (xyDist > 0.001f)
+    {
+        angles.z = atan2f(matrix[1][0], matrix[0][0]);
+        angles.y = atan2f(-matrix[2][0], xyDist);
+        angles.x = atan2f(matrix[2][1], matrix[2][2]);
+    }
+    else
+    {
+        // looking straight up or down, roll folds into yaw
+        angles.z = atan2f(-matrix[0][1], matrix[1][1]);
+        angles.y = atan2f(-matrix[2][0], xyDist);
+        angles.x = 0.0f;
+    }
+}
+
+// make sure quaternions are within 180 degrees of one another, if not, reverse q
+void QuaternionAlign(const Quaternion& p, const Quaternion& q, Quaternion& qt)
+{
+    float a = 0.0f, b = 0.0f;
+    a += (p.x - q.x) * (p.x - q.x) + (p.y - q.y) * (p.y - q.y) + (p.z - q.z) * (p.z - q.z) + (p.w - q.w) * (p.w - q.w);
+    b += (p.x + q.x) * (p.x + q.x) + (p.y + q.y) * (p.y + q.y) + (p.z + q.z) * (p.z + q.z) + (p.w + q.w) * (p.w + q.w);
+
+    if (a > b)
+    {
+        qt.x = -q.x; qt.y = -q.y; qt.z = -q.z; qt.w = -q.w;
+    }
+    else if (&qt != &q)
+    {
+        qt = q;
+    }
+}
+
+float QuaternionNormalize(Quaternion& q)
+{
+    float flLen = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+
+    if (flLen > 0.0f)
+    {
+        float flInv = 1.0f / flLen;
+        q.x *= flInv; q.y *= flInv; q.z *= flInv; q.w *= flInv;
+    }
+
+    return flLen;
+}
+
+void QuaternionBlend(const Quaternion& p, const Quaternion& q, float t, Quaternion& qt)
+{
+    Quaternion q2;
+    QuaternionAlign(p, q, q2);
+
+    float sclp = 1.0f - t;
+    float sclq = t;
+
+    qt.x = sclp * p.x + sclq * q2.x;
+    qt.y = sclp * p.y + sclq * q2.y;
+    qt.z = sclp * p.z + sclq * q2.z;
+    qt.w = sclp * p.w + sclq * q2.w;
+
+    QuaternionNormalize(qt);
+}
+
+void QuaternionSlerp(const Quaternion& p, const Quaternion& q, float t, Quaternion& qt)
+{
+    Quaternion q2;
+    QuaternionAlign(p, q, q2);
+
+    float cosom = p.x * q2.x + p.y * q2.y + p.z * q2.z + p.w * q2.w;
+    float sclp, sclq;
+
+    if ((1.0f - cosom) > 0.000001f)
+    {
+        float omega = acosf(cosom);
+        float sinom = sinf(omega);
+        sclp = sinf((1.0f - t) * omega) / sinom;
+        sclq = sinf(t * omega) / sinom;
+    }
+    else
+    {
+        // close enough that a lerp is exact to float precision
+        sclp = 1.0f - t;
+        sclq = t;
+    }
+
+    qt.x = sclp * p.x + sclq * q2.x;
+    qt.y = sclp * p.y + sclq * q2.y;
+    qt.z = sclp * p.z + sclq * q2.z;
+    qt.w = sclp * p.w + sclq * q2.w;
+}
+
+void QuaternionMult(const Quaternion& p, const Quaternion& q, Quaternion& qt)
+{
+    Quaternion q2;
+    QuaternionAlign(p, q, q2);
+
+    Quaternion r;
+    r.x = p.x * q2.w + p.y * q2.z - p.z * q2.y + p.w * q2.x;
+    r.y = -p.x * q2.z + p.y * q2.w + p.z * q2.x + p.w * q2.y;
+    r.z = p.x * q2.y - p.y * q2.x + p.z * q2.w + p.w * q2.z;
+    r.w = -p.x * q2.x - p.y * q2.y - p.z * q2.z + p.w * q2.w;
+
+    qt = r;
+}
+
+void QuaternionConjugate(const Quaternion& p, Quaternion& q)
+{
+    q.x = -p.x;
+    q.y = -p.y;
+    q.z = -p.z;
+    q.w = p.w;
+}
+
+void QuaternionMatrix(const Quaternion& q, const Vector& pos, matrix3x4_t& matrix)
+{
+    matrix[0][0] = 1.0f - 2.0f * q.y * q.y - 2.0f * q.z * q.z;
+    matrix[1][0] = 2.0f * q.x * q.y + 2.0f * q.w * q.z;
+    matrix[2][0] = 2.0f * q.x * q.z - 2.0f * q.w * q.y;
+
+    matrix[0][1] = 2.0f * q.x * q.y - 2.0f * q.w * q.z;
+    matrix[1][1] = 1.0f - 2.0f * q.x * q.x - 2.0f * q.z * q.z;
+    matrix[2][1] = 2.0f * q.y * q.z + 2.0f * q.w * q.x;
+
+    matrix[0][2] = 2.0f * q.x * q.z + 2.0f * q.w * q.y;
+    matrix[1][2] = 2.0f * q.y * q.z - 2.0f * q.w * q.x;
+    matrix[2][2] = 1.0f - 2.0f * q.x * q.x - 2.0f * q.y * q.y;
+
+    matrix[0][3] = pos.x;
+    matrix[1][3] = pos.y;
+    matrix[2][3] = pos.z;
+}
+
+void MatrixQuaternion(const matrix3x4_t& matrix, Quaternion& q)
+{
+    float trace = matrix[0][0] + matrix[1][1] + matrix[2][2];
+
+    if (trace >= 0.0f)
+    {
+        float s = sqrtf(trace + 1.0f) * 2.0f;
+        q.x = (matrix[2][1] - matrix[1][2]) / s;
+        q.y = (matrix[0][2] - matrix[2][0]) / s;
+        q.z = (matrix[1][0] - matrix[0][1]) / s;
+        q.w = 0.25f * s;
+    }
+    else if (matrix[0][0] > matrix[1][1] && matrix[0][0] > matrix[2][2])
+    {
+        float s = sqrtf(1.0f + matrix[0][0] - matrix[1][1] - matrix[2][2]) * 2.0f;
+        q.x = 0.25f * s;
+        q.y = (matrix[0][1] + matrix[1][0]) / s;
+        q.z = (matrix[0][2] + matrix[2][0]) / s;
+        q.w = (matrix[2][1] - matrix[1][2]) / s;
+    }
+    else if (matrix[1][1] > matrix[2][2])
+    {
+        float s = sqrtf(1.0f + matrix[1][1] - matrix[0][0] - matrix[2][2]) * 2.0f;
+        q.x = (matrix[0][1] + matrix[1][0]) / s;
+        q.y = 0.25f * s;
+        q.z = (matrix[1][2] + matrix[2][1]) / s;
+        q.w = (matrix[0][2] - matrix[2][0]) / s;
+    }
+    else
+    {
+        float s = sqrtf(1.0f + matrix[2][2] - matrix[0][0] - matrix[1][1]) * 2.0f;
+        q.x = (matrix[0][2] + matrix[2][0]) / s;
+        q.y = (matrix[1][2] + matrix[2][1]) / s;
+        q.z = 0.25f * s;
+        q.w = (matrix[1][0] - matrix[0][1]) / s;
+    }
+}
+
+void MatrixPosition(const matrix3x4_t& matrix, Vector& position)
+{
+    position.x = matrix[0][3];
+    position.y = matrix[1][3];
+    position.z = matrix[2][3];
+}
+
+void SetIdentityMatrix(matrix3x4_t& matrix)
+{
+    matrix = matrix3x4_t(
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f);
+}
+
+// out = in1 * in2, rows are done one fltx4 at a time. all inputs are read
+// before the row that could alias them is written so out may be in1 or in2
+void ConcatTransforms(const matrix3x4_t& in1, const matrix3x4_t& in2, matrix3x4_t& out)
+{
+    fltx4 b0 = MatrixRowSIMD(in2, 0);
+    fltx4 b1 = MatrixRowSIMD(in2, 1);
+    fltx4 b2 = MatrixRowSIMD(in2, 2);
+
+    // implicit fourth row of in2 is (0, 0, 0, 1)
+    float lastRow[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    fltx4 b3 = LoadUnalignedSIMD(lastRow);
+
+    for (int i = 0; i < 3; i++)
+    {
+        const float* a = in1[i];
+        fltx4 row = MulSIMD(ReplicateX4(a[0]), b0);
+        row = MaddSIMD(ReplicateX4(a[1]), b1, row);
+        row = MaddSIMD(ReplicateX4(a[2]), b2, row);
+        row = MaddSIMD(ReplicateX4(a[3]), b3, row);
+        StoreUnalignedSIMD(out[i], row);
+    }
+}
+
+void MatrixInvert(const matrix3x4_t& in, matrix3x4_t& out)
+{
+    Vector tmp(in[0][3], in[1][3], in[2][3]);
+
+    if (&in == &out)
+    {
+        float t;
+        t = out[0][1]; out[0][1] = out[1][0]; out[1][0] = t;
+        t = out[0][2]; out[0][2] = out[2][0]; out[2][0] = t;
+        t = out[1][2]; out[1][2] = out[2][1]; out[2][1] = t;
+    }
+    else
+    {
+        out[0][0] = in[0][0]; out[0][1] = in[1][0]; out[0][2] = in[2][0];
+        out[1][0] = in[0][1]; out[1][1] = in[1][1]; out[1][2] = in[2][1];
+        out[2][0] = in[0][2]; out[2][1] = in[1][2]; out[2][2] = in[2][2];
+    }
+
+    out[0][3] = -(tmp.x * out[0][0] + tmp.y * out[0][1] + tmp.z * out[0][2]);
+    out[1][3] = -(tmp.x * out[1][0] + tmp.y * out[1][1] + tmp.z * out[1][2]);
+    out[2][3] = -(tmp.x * out[2][0] + tmp.y * out[2][1] + tmp.z * out[2][2]);
+}
+
+bool MatrixInverseGeneral(const matrix3x4_t& in, matrix3x4_t& out)
+{
+    // cofactors of the 3x3 part
+    float c00 = in[1][1] * in[2][2] - in[1][2] * in[2][1];
+    float c01 = in[1][2] * in[2][0] - in[1][0] * in[2][2];
+    float c02 = in[1][0] * in[2][1] - in[1][1] * in[2][0];
+
+    float det = in[0][0] * c00 + in[0][1] * c01 + in[0][2] * c02;
+
+    if (fabsf(det) < 1e-12f)
+        return false;
+
+    float inv = 1.0f / det;
+
+    matrix3x4_t r;
+    r[0][0] = c00 * inv;
+    r[1][0] = c01 * inv;
+    r[2][0] = c02 * inv;
+
+    r[0][1] = (in[0][2] * in[2][1] - in[0][1] * in[2][2]) * inv;
+    r[1][1] = (in[0][0] * in[2][2] - in[0][2] * in[2][0]) * inv;
+    r[2][1] = (in[0][1] * in[2][0] - in[0][0] * in[2][1]) * inv;
+
+    r[0][2] = (in[0][1] * in[1][2] - in[0][2] * in[1][1]) * inv;
+    r[1][2] = (in[0][2] * in[1][0] - in[0][0] * in[1][2]) * inv;
+    r[2][2] = (in[0][0] * in[1][1] - in[0][1] * in[1][0]) * inv;
+
+    for (int i = 0; i < 3; i++)
+        r[i][3] = -(r[i][0] * in[0][3] + r[i][1] * in[1][3] + r[i][2] * in[2][3]);
+
+    out = r;
+    return true;
+}
+
+void VectorTransform(const Vector& in, const matrix3x4_t& matrix, Vector& out)
+{
+    Vector r;
+    r.x = in.x * matrix[0][0] + in.y * matrix[0][1] + in.z * matrix[0][2] + matrix[0][3];
+    r.y = in.x * matrix[1][0] + in.y * matrix[1][1] + in.z * matrix[1][2] + matrix[1][3];
+    r.z = in.x * matrix[2][0] + in.y * matrix[2][1] + in.z * matrix[2][2] + matrix[2][3];
+    out = r;
+}
+
+void VectorITransform(const Vector& in, const matrix3x4_t& matrix, Vector& out)
+{
+    Vector tmp(in.x - matrix[0][3], in.y - matrix[1][3], in.z - matrix[2][3]);
+    VectorIRotate(tmp, matrix, out);
+}
+
+void VectorRotate(const Vector& in, const matrix3x4_t& matrix, Vector& out)
+{
+    Vector r;
+    r.x = in.x * matrix[0][0] + in.y * matrix[0][1] + in.z * matrix[0][2];
+    r.y = in.x * matrix[1][0] + in.y * matrix[1][1] + in.z * matrix[1][2];
+    r.z = in.x * matrix[2][0] + in.y * matrix[2][1] + in.z * matrix[2][2];
+    out = r;
+}
+
+void VectorIRotate(const Vector& in, const matrix3x4_t& matrix, Vector& out)
+{
+    Vector r;
+    r.x = in.x * matrix[0][0] + in.y * matrix[1][0] + in.z * matrix[2][0];
+    r.y = in.x * matrix[0][1] + in.y * matrix[1][1] + in.z * matrix[2][1];
+    r.z = in.x * matrix[0][2] + in.y * matrix[1][2] + in.z * matrix[2][2];
+    out = r;
+}
+
+//-----------------------------------------------------------------------------
+// four-at-a-time
+//-----------------------------------------------------------------------------
+
+FourQuaternions QuaternionAlignSIMD(const FourQuaternions& p, const FourQuaternions& q)
+{
+    return FlipSignSIMD(q, CmpLtSIMD(Dot4SIMD(p, q), LoadZeroSIMD()));
+}
+
+FourQuaternions QuaternionNormalizeSIMD(const FourQuaternions& q)
+{
+    fltx4 inv = ReciprocalSqrtSaturateSIMD(Dot4SIMD(q, q));
+    return FourQuaternions{ MulSIMD(q.x, inv), MulSIMD(q.y, inv), MulSIMD(q.z, inv), MulSIMD(q.w, inv) };
+}
+
+FourQuaternions QuaternionBlendSIMD(const FourQuaternions& p, const FourQuaternions& q, const fltx4& t)
+{
+    FourQuaternions q2 = QuaternionAlignSIMD(p, q);
+    fltx4 sclp = SubSIMD(ReplicateX4(1.0f), t);
+
+    FourQuaternions r;
+    r.x = MaddSIMD(sclp, p.x, MulSIMD(t, q2.x));
+    r.y = MaddSIMD(sclp, p.y, MulSIMD(t, q2.y));
+    r.z = MaddSIMD(sclp, p.z, MulSIMD(t, q2.z));
+    r.w = MaddSIMD(sclp, p.w, MulSIMD(t, q2.w));
+
+    return QuaternionNormalizeSIMD(r);
+}
+
+// normalized lerp with the interpolation parameter bent by a polynomial in
+// the angle between the inputs, which tracks slerp's constant angular speed
+// without any trig (zeux, "approximating slerp")
+FourQuaternions QuaternionSlerpSIMD(const FourQuaternions& p, const FourQuaternions& q, const fltx4& t)
+{
+    fltx4 ca = Dot4SIMD(p, q);
+    fltx4 d = AbsSIMD(ca);
+
+    fltx4 A = MaddSIMD(d, MaddSIMD(d, MaddSIMD(d, ReplicateX4(-1.43519f), ReplicateX4(3.55645f)), ReplicateX4(-3.2452f)), ReplicateX4(1.0904f));
+    fltx4 B = MaddSIMD(d, MaddSIMD(d, ReplicateX4(0.215638f), ReplicateX4(-1.06021f)), ReplicateX4(0.848013f));
+
+    fltx4 half = ReplicateX4(0.5f);
+    fltx4 tc = SubSIMD(t, half);
+    fltx4 k = MaddSIMD(MulSIMD(A, tc), tc, B);
+    fltx4 ot = MaddSIMD(MulSIMD(MulSIMD(t, tc), SubSIMD(t, ReplicateX4(1.0f))), k, t);
+
+    FourQuaternions q2 = FlipSignSIMD(q, ca);
+    fltx4 sclp = SubSIMD(ReplicateX4(1.0f), ot);
+
+    FourQuaternions r;
+    r.x = MaddSIMD(sclp, p.x, MulSIMD(ot, q2.x));
+    r.y = MaddSIMD(sclp, p.y, MulSIMD(ot, q2.y));
+    r.z = MaddSIMD(sclp, p.z, MulSIMD(ot, q2.z));
+    r.w = MaddSIMD(sclp, p.w, MulSIMD(ot, q2.w));
+
+    return QuaternionNormalizeSIMD(r);
+}
+
+FourQuaternions QuaternionMultSIMD(const FourQuaternions& p, const FourQuaternions& q)
+{
+    FourQuaternions q2 = QuaternionAlignSIMD(p, q);
+
+    FourQuaternions r;
+    r.x = AddSIMD(SubSIMD(MaddSIMD(p.x, q2.w, MulSIMD(p.y, q2.z)), MulSIMD(p.z, q2.y)), MulSIMD(p.w, q2.x));
+    r.y = AddSIMD(AddSIMD(MsubSIMD(p.x, q2.z, MulSIMD(p.y, q2.w)), MulSIMD(p.z, q2.x)), MulSIMD(p.w, q2.y));
+    r.z = AddSIMD(MaddSIMD(p.z, q2.w, MsubSIMD(p.y, q2.x, MulSIMD(p.x, q2.y))), MulSIMD(p.w, q2.z));
+    r.w = SubSIMD(MulSIMD(p.w, q2.w), MaddSIMD(p.x, q2.x, MaddSIMD(p.y, q2.y, MulSIMD(p.z, q2.z))));
+    return r;
+}
+
+// v + w * t + cross(q, t) with t = 2 * cross(q, v)
+FourVectors QuaternionRotateSIMD(const FourQuaternions& q, const FourVectors& v)
+{
+    fltx4 two = ReplicateX4(2.0f);
+    fltx4 tx = MulSIMD(two, MsubSIMD(q.z, v.y, MulSIMD(q.y, v.z)));
+    fltx4 ty = MulSIMD(two, MsubSIMD(q.x, v.z, MulSIMD(q.z, v.x)));
+    fltx4 tz = MulSIMD(two, MsubSIMD(q.y, v.x, MulSIMD(q.x, v.y)));
+
+    FourVectors r;
+    r.x = AddSIMD(MaddSIMD(q.w, tx, v.x), MsubSIMD(q.z, ty, MulSIMD(q.y, tz)));
+    r.y = AddSIMD(MaddSIMD(q.w, ty, v.y), MsubSIMD(q.x, tz, MulSIMD(q.z, tx)));
+    r.z = AddSIMD(MaddSIMD(q.w, tz, v.z), MsubSIMD(q.y, tx, MulSIMD(q.x, ty)));
+    return r;
+}
+
+//-----------------------------------------------------------------------------
+// batch
+//-----------------------------------------------------------------------------
+
+void QuaternionNormalizeSoA(const CQuaternionSoA& q, int nCount)
+{
+    for (int i = 0; i < nCount; i += 4)
+    {
+        int n = nCount - i;
+        StoreQuaternions(q, i, QuaternionNormalizeSIMD(LoadQuaternions(q, i, n)), n);
+    }
+}
+
+void QuaternionBlendSoA(const CQuaternionSoA& p, const CQuaternionSoA& q, float t, const CQuaternionSoA& out, int nCount)
+{
+    fltx4 t4 = ReplicateX4(t);
+
+    for (int i = 0; i < nCount; i += 4)
+    {
+        int n = nCount - i;
+        StoreQuaternions(out, i, QuaternionBlendSIMD(LoadQuaternions(p, i, n), LoadQuaternions(q, i, n), t4), n);
+    }
+}
+
+void QuaternionSlerpSoA(const CQuaternionSoA& p, const CQuaternionSoA& q, float t, const CQuaternionSoA& out, int nCount)
+{
+    fltx4 t4 = ReplicateX4(t);
+
+    for (int i = 0; i < nCount; i += 4)
+    {
+        int n = nCount - i;
+        StoreQuaternions(out, i, QuaternionSlerpSIMD(LoadQuaternions(p, i, n), LoadQuaternions(q, i, n), t4), n);
+    }
+}
+
+void QuaternionMultSoA(const CQuaternionSoA& p, const CQuaternionSoA& q, const CQuaternionSoA& out, int nCount)
+{
+    for (int i = 0; i < nCount; i += 4)
+    {
+        int n = nCount - i;
+        StoreQuaternions(out, i, QuaternionMultSIMD(LoadQuaternions(p, i, n), LoadQuaternions(q, i, n)), n);
+    }
+}
+
+void QuaternionAccumulateSoA(const CQuaternionSoA& out, const CQuaternionSoA& src, float flWeight, int nCount)
+{
+    fltx4 weight = ReplicateX4(flWeight);
+
+    for (int i = 0; i < nCount; i += 4)
+    {
+        int n = nCount - i;
+        FourQuaternions a = LoadQuaternions(out, i, n);
+        FourQuaternions b = LoadQuaternions(src, i, n);
+
+        // flip the incoming rotation onto the accumulator's hemisphere
+        fltx4 w = XorSIMD(weight, AndSIMD(Dot4SIMD(a, b), ReplicateX4(-0.0f)));
+
+        a.x = MaddSIMD(b.x, w, a.x);
+        a.y = MaddSIMD(b.y, w, a.y);
+        a.z = MaddSIMD(b.z, w, a.z);
+        a.w = MaddSIMD(b.w, w, a.w);
+
+        StoreQuaternions(out, i, a, n);
+    }
+}
+
+void QuaternionMatrixSoA(const CQuaternionSoA& q, const CVectorSoA& pos, matrix3x4_t* pOut, int nCount)
+{
+    fltx4 one = ReplicateX4(1.0f);
+    fltx4 two = ReplicateX4(2.0f);
+
+    for (int i = 0; i < nCount; i += 4)
+    {
+        int n = nCount - i;
+        FourQuaternions v = LoadQuaternions(q, i, n);
+
+        fltx4 x2 = MulSIMD(v.x, two), y2 = MulSIMD(v.y, two), z2 = MulSIMD(v.z, two);
+        fltx4 xx = MulSIMD(v.x, x2), yy = MulSIMD(v.y, y2), zz = MulSIMD(v.z, z2);
+        fltx4 xy = MulSIMD(v.x, y2), xz = MulSIMD(v.x, z2), yz = MulSIMD(v.y, z2);
+        fltx4 wx = MulSIMD(v.w, x2), wy = MulSIMD(v.w, y2), wz = MulSIMD(v.w, z2);
+
+        // one register per matrix element, transposed into four matrix rows at a time
+        fltx4 r0[4] = { SubSIMD(SubSIMD(one, yy), zz), SubSIMD(xy, wz), AddSIMD(xz, wy), LoadTail(pos.x + i, n) };
+        fltx4 r1[4] = { AddSIMD(xy, wz), SubSIMD(SubSIMD(one, xx), zz), SubSIMD(yz, wx), LoadTail(pos.y + i, n) };
+        fltx4 r2[4] = { SubSIMD(xz, wy), AddSIMD(yz, wx), SubSIMD(SubSIMD(one, xx), yy), LoadTail(pos.z + i, n) };
+
+        TransposeSIMD(r0[0], r0[1], r0[2], r0[3]);
+        TransposeSIMD(r1[0], r1[1], r1[2], r1[3]);
+        TransposeSIMD(r2[0], r2[1], r2[2], r2[3]);
+
+        for (int j = 0; j < 4 && j < n; j++)
+        {
+            StoreUnalignedSIMD(pOut[i + j][0], r0[j]);
+            StoreUnalignedSIMD(pOut[i + j][1], r1[j]);
+            StoreUnalignedSIMD(pOut[i + j][2], r2[j]);
+        }
+    }
+}
+
+void VectorTransformSoA(const matrix3x4_t& matrix, const CVectorSoA& in, const CVectorSoA& out, int nCount)
+{
+    fltx4 m[3][4];
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 4; c++)
+            m[r][c] = ReplicateX4(matrix[r][c]);
+    }
+
+    for (int i = 0; i < nCount; i += 4)
+    {
+        int n = nCount - i;
+        fltx4 x = LoadTail(in.x + i, n), y = LoadTail(in.y + i, n), z = LoadTail(in.z + i, n);
+
+        StoreTail(out.x + i, MaddSIMD(x, m[0][0], MaddSIMD(y, m[0][1], MaddSIMD(z, m[0][2], m[0][3]))), n);
+        StoreTail(out.y + i, MaddSIMD(x, m[1][0], MaddSIMD(y, m[1][1], MaddSIMD(z, m[1][2], m[1][3]))), n);
+        StoreTail(out.z + i, MaddSIMD(x, m[2][0], MaddSIMD(y, m[2][1], MaddSIMD(z, m[2][2], m[2][3]))), n);
+    }
+}
+
+void ConcatTransformsBatch(const matrix3x4_t* pIn1, const matrix3x4_t* pIn2, matrix3x4_t* pOut, int nCount)
+{
+    for (int i = 0; i < nCount; i++)
+        ConcatTransforms(pIn1[i], pIn2[i], pOut[i]);
+}
+
+void MatrixInvertBatch(const matrix3x4_t* pIn, matrix3x4_t* pOut, int nCount)
+{
+    for (int i = 0; i < nCount; i++)
+        MatrixInvert(pIn[i], pOut[i]);
+}
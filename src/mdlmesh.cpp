@@ -0,0 +1,270 @@
+#include "mdlmesh.h"
+#include "mdlfile.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+#include "valve/optimize.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+
+using namespace OptimizedModel;
+
+namespace
+{
+    // the lod 0 vertex order, fixups put the culled lod sorted pool back into mesh order
+    bool LoadVertices(const CMappedFile& file, int iChecksum, std::vector<const mstudiovertex_t*>& vecVertices)
+    {
+        const vertexFileHeader_t* pHeader = (const vertexFileHeader_t*)file.Data();
+
+        if (!InRange<vertexFileHeader_t>(pHeader, file) || pHeader->id != MODEL_VERTEX_FILE_ID || pHeader->version != MODEL_VERTEX_FILE_VERSION || pHeader->checksum != iChecksum)
+            return false;
+
+        int nVertices = pHeader->numLODVertexes[0];
+
+        if (nVertices < 0 || !InRange<mstudiovertex_t>(pHeader->pVertex(0), file, nVertices))
+            return false;
+
+        if (pHeader->numFixups <= 0)
+        {
+            for (int i = 0; i < nVertices; i++)
+                vecVertices.push_back(pHeader->pVertex(i));
+
+            return true;
+        }
+
+        const vertexFileFixup_t* pFixups = (const vertexFileFixup_t*)(file.Data() + pHeader->fixupTableStart);
+
+        if (!InRange<vertexFileFixup_t>(pFixups, file, pHeader->numFixups))
+            return false;
+
+        for (int i = 0; i < pHeader->numFixups; i++)
+        {
+            const vertexFileFixup_t& fixup = pFixups[i];
+
+            if (fixup.lod < 0 || fixup.sourceVertexID < 0 || fixup.numVertexes < 0 || fixup.sourceVertexID + fixup.numVertexes > nVertices)
+                continue;
+
+            for (int j = 0; j < fixup.numVertexes; j++)
+                vecVertices.push_back(pHeader->pVertex(fixup.sourceVertexID + j));
+        }
+
+        return true;
+    }
+
+    bool OpenStrips(const std::string& base, int iChecksum, CMappedFile& file)
+    {
+        for (const char* pszExt : { ".dx90.vtx", ".vtx", ".dx80.vtx", ".sw.vtx" })
+        {
+            if (!file.Open(base + pszExt))
+                continue;
+
+            const FileHeader_t* pHeader = (const FileHeader_t*)file.Data();
+
+            if (InRange<FileHeader_t>(pHeader, file) && pHeader->version == OPTIMIZED_MODEL_FILE_VERSION && pHeader->checkSum == iChecksum)
+                return true;
+
+            file.Close();
+        }
+
+        return false;
+    }
+}
+
+bool CSkinnedMesh::Load(const CModel& model, int iBody)
+{
+    m_vecPositions.clear();
+    m_vecWeights.clear();
+    m_vecIndices.clear();
+    m_vecTriangleBones.clear();
+    m_vecPoseToBone.clear();
+
+    const studiohdr_t* pMdl = model.StudioHdr();
+
+    if (!pMdl)
+        return false;
+
+    std::string base = StripExtension(model.FileName());
+
+    CMappedFile vertexFile, stripFile;
+    std::vector<const mstudiovertex_t*> vecPool;
+
+    if (!vertexFile.Open(base + ".vvd") || !LoadVertices(vertexFile, pMdl->checksum, vecPool) || !OpenStrips(base, pMdl->checksum, stripFile))
+        return false;
+
+    const FileHeader_t* pStrips = (const FileHeader_t*)stripFile.Data();
+
+    // pool vertex -> our vertex, only the ones a triangle uses are kept
+    std::vector<int> vecRemap(vecPool.size(), -1);
+
+    auto AddVertex = [&](int iPool)
+    {
+        if (vecRemap[iPool] < 0)
+        {
+            const mstudiovertex_t* pVertex = vecPool[iPool];
+            const mstudioboneweight_t& weights = pVertex->m_BoneWeights;
+
+            CVertexWeights vertex;
+            vertex.m_nBones = std::min((int)weights.numbones, MAX_NUM_BONES_PER_VERT);
+
+            for (int i = 0; i < 3; i++)
+            {
+                bool bUsed = i < vertex.m_nBones && weights.bone[i] >= 0 && weights.bone[i] < pMdl->numbones;
+                vertex.m_iBone[i] = bUsed ? weights.bone[i] : 0;
+                vertex.m_flWeight[i] = bUsed ? weights.weight[i] : 0.0f;
+            }
+
+            vecRemap[iPool] = (int)m_vecPositions.size();
+            m_vecPositions.push_back(pVertex->m_vecPosition);
+            m_vecWeights.push_back(vertex);
+        }
+
+        return vecRemap[iPool];
+    };
+
+    for (int i = 0; i < pMdl->numbodyparts && i < pStrips->numBodyParts; i++)
+    {
+        const mstudiobodyparts_t* pBodyPart = pMdl->pBodypart(i);
+        const BodyPartHeader_t* pStripPart = pStrips->pBodyPart(i);
+
+        if (pBodyPart->nummodels <= 0 || !InRange<BodyPartHeader_t>(pStripPart, stripFile))
+            continue;
+
+        int iModel = (iBody / std::max(pBodyPart->base, 1)) % pBodyPart->nummodels;
+
+        const mstudiomodel_t* pModel = pBodyPart->pModel(iModel);
+        const ModelHeader_t* pStripModel = pStripPart->pModel(iModel);
+
+        if (iModel >= pStripPart->numModels || !InRange<ModelHeader_t>(pStripModel, stripFile) || pStripModel->numLODs <= 0)
+            continue;
+
+        const ModelLODHeader_t* pLOD = pStripModel->pLOD(0);
+
+        if (!InRange<ModelLODHeader_t>(pLOD, stripFile))
+            continue;
+
+        int iModelBase = pModel->vertexindex / (int)sizeof(mstudiovertex_t);
+
+        for (int j = 0; j < pModel->nummeshes && j < pLOD->numMeshes; j++)
+        {
+            const MeshHeader_t* pStripMesh = pLOD->pMesh(j);
+
+            if (!InRange<MeshHeader_t>(pStripMesh, stripFile))
+                continue;
+
+            int iMeshBase = iModelBase + pModel->pMesh(j)->vertexoffset;
+
+            for (int k = 0; k < pStripMesh->numStripGroups; k++)
+            {
+                const StripGroupHeader_t* pGroup = pStripMesh->pStripGroup(k);
+
+                if (!InRange<StripGroupHeader_t>(pGroup, stripFile) || !InRange<Vertex_t>(pGroup->pVertex(0), stripFile, pGroup->numVerts) || !InRange<unsigned short>(pGroup->pIndex(0), stripFile, pGroup->numIndices))
+                    continue;
+
+                // -1 for anything that doesn't resolve to a pool vertex
+                auto Resolve = [&](int iIndex)
+                {
+                    int iGroupVertex = *pGroup->pIndex(iIndex);
+
+                    if (iGroupVertex >= pGroup->numVerts)
+                        return -1;
+
+                    int iPool = iMeshBase + pGroup->pVertex(iGroupVertex)->origMeshVertID;
+                    return (iPool >= 0 && iPool < (int)vecPool.size()) ? iPool : -1;
+                };
+
+                auto AddTriangle = [&](int a, int b, int c)
+                {
+                    if (a < 0 || b < 0 || c < 0 || a == b || b == c || a == c)
+                        return;
+
+                    m_vecIndices.push_back(AddVertex(a));
+                    m_vecIndices.push_back(AddVertex(b));
+                    m_vecIndices.push_back(AddVertex(c));
+                };
+
+                for (int s = 0; s < pGroup->numStrips; s++)
+                {
+                    const StripHeader_t* pStrip = pGroup->pStrip(s);
+
+                    if (!InRange<StripHeader_t>(pStrip, stripFile) || pStrip->indexOffset < 0 || pStrip->numIndices < 0 || pStrip->indexOffset + pStrip->numIndices > pGroup->numIndices)
+                        continue;
+
+                    int iFirst = pStrip->indexOffset;
+
+                    if (pStrip->flags & STRIP_IS_TRISTRIP)
+                    {
+                        for (int t = 0; t + 2 < pStrip->numIndices; t++)
+                        {
+                            // every other triangle of a strip is wound the other way
+                            if (t & 1)
+                                AddTriangle(Resolve(iFirst + t + 1), Resolve(iFirst + t), Resolve(iFirst + t + 2));
+                            else
+                                AddTriangle(Resolve(iFirst + t), Resolve(iFirst + t + 1), Resolve(iFirst + t + 2));
+                        }
+                    }
+                    else
+                    {
+                        for (int t = 0; t + 2 < pStrip->numIndices; t += 3)
+                            AddTriangle(Resolve(iFirst + t), Resolve(iFirst + t + 1), Resolve(iFirst + t + 2));
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<float> vecBoneWeights(pMdl->numbones);
+
+    for (int i = 0; i < TriangleCount(); i++)
+    {
+        std::fill(vecBoneWeights.begin(), vecBoneWeights.end(), 0.0f);
+        int iBest = 0;
+
+        for (int j = 0; j < 3; j++)
+        {
+            const CVertexWeights& vertex = m_vecWeights[m_vecIndices[i * 3 + j]];
+
+            for (int k = 0; k < vertex.m_nBones; k++)
+            {
+                float& flWeight = vecBoneWeights[vertex.m_iBone[k]];
+                flWeight += vertex.m_flWeight[k];
+
+                if (flWeight > vecBoneWeights[iBest])
+                    iBest = vertex.m_iBone[k];
+            }
+        }
+
+        m_vecTriangleBones.push_back(iBest);
+    }
+
+    for (int i = 0; i < pMdl->numbones; i++)
+        m_vecPoseToBone.push_back(pMdl->pBone(i)->poseToBone);
+
+    return true;
+}
+
+void CSkinnedMesh::Skin(const matrix3x4_t* pBoneToWorld, Vector* pOut) const
+{
+    std::vector<matrix3x4_t> vecSkin(m_vecPoseToBone.size());
+    ConcatTransformsBatch(pBoneToWorld, m_vecPoseToBone.data(), vecSkin.data(), (int)vecSkin.size());
+
+    for (int i = 0; i < VertexCount(); i++)
+    {
+        const CVertexWeights& vertex = m_vecWeights[i];
+
+        if (vertex.m_nBones <= 0)
+        {
+            pOut[i] = m_vecPositions[i];
+            continue;
+        }
+
+        Vector result(0.0f), p;
+
+        for (int j = 0; j < vertex.m_nBones; j++)
+        {
+            VectorTransform(m_vecPositions[i], vecSkin[vertex.m_iBone[j]], p);
+            result += p * vertex.m_flWeight[j];
+        }
+
+        pOut[i] = result;
+    }
+}
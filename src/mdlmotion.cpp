@@ -0,0 +1,197 @@
+#include "mdlmotion.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // rotates a vector about z by a yaw in degrees
+    inline Vector VectorYawRotate(const Vector& in, float flYaw)
+    {
+        float flRad = flYaw * (3.14159265358979323846f / 180.0f);
+        float sy = sinf(flRad), cy = cosf(flRad);
+
+        return Vector(in.x * cy - in.y * sy, in.x * sy + in.y * cy, in.z);
+    }
+}
+
+CRootMotion::CRootMotion(const CModel& model) : m_Model(model), m_BlendSpace(model)
+{
+    const studiohdr_t* pMdl = model.StudioHdr();
+
+    // movements are only in the file, without it every animation is treated as having none
+    if (!pMdl)
+        return;
+
+    int nAnims = (int)model.GetAnimations().size();
+
+    m_vecAnims.resize(nAnims);
+
+    for (int i = 0; i < nAnims; i++)
+    {
+        const mstudioanimdesc_t* pAnimDesc = pMdl->pLocalAnimdesc(i);
+        CAnimMotion& anim = m_vecAnims[i];
+
+        anim.m_iFirstBlock = (int)m_vecStartFrame.size();
+        anim.m_iBlockCount = std::max(pAnimDesc->nummovements, 0);
+        anim.m_iFrameOffset = (int)m_vecFrameBlocks.size();
+        anim.m_flLastFrame = (float)std::max(pAnimDesc->numframes - 1, 0);
+        anim.m_vecLoopPos = Vector(0.0f);
+        anim.m_flLoopYaw = 0.0f;
+        anim.m_bStatic = anim.m_iBlockCount == 0 && !(pAnimDesc->flags & STUDIO_DELTA);
+
+        if (anim.m_iBlockCount == 0)
+            continue;
+
+        // each block's start is where the previous one ended, the file already stores those running totals
+        float flPrevFrame = 0.0f;
+        float flPrevYaw = 0.0f;
+        Vector vecPrevPos(0.0f);
+
+        for (int j = 0; j < anim.m_iBlockCount; j++)
+        {
+            const mstudiomovement_t* pMove = pAnimDesc->pMovement(j);
+
+            m_vecStartFrame.push_back(flPrevFrame);
+            m_vecFrameRange.push_back(pMove->endframe - flPrevFrame);
+            m_vecV0.push_back(pMove->v0);
+            m_vecDV.push_back(pMove->v1 - pMove->v0);
+            m_vecStartYaw.push_back(flPrevYaw);
+            m_vecEndYaw.push_back(pMove->angle);
+            m_vecStartPos.push_back(vecPrevPos);
+            m_vecDirection.push_back(pMove->vector);
+
+            flPrevFrame = (float)pMove->endframe;
+            flPrevYaw = pMove->angle;
+            vecPrevPos = pMove->position;
+        }
+
+        anim.m_vecLoopPos = vecPrevPos;
+        anim.m_flLoopYaw = flPrevYaw;
+
+        // a fractional frame lands in the same block as the whole frame above it, frames past the last block use the last block
+        int iBlock = 0;
+        for (int iFrame = 0; iFrame <= (int)anim.m_flLastFrame; iFrame++)
+        {
+            while (iBlock < anim.m_iBlockCount - 1 && pAnimDesc->pMovement(iBlock)->endframe < iFrame)
+                iBlock++;
+
+            m_vecFrameBlocks.push_back(iBlock);
+        }
+    }
+}
+
+void CRootMotion::Position(const CAnimMotion& anim, float flCycle, Vector& vecPos, float& flYaw) const
+{
+    int iLoops = 0;
+    if (flCycle > 1.0f)
+        iLoops = (int)flCycle;
+    else if (flCycle < 0.0f)
+        iLoops = (int)flCycle - 1;
+
+    flCycle -= iLoops;
+
+    float flFrame = flCycle * anim.m_flLastFrame;
+
+    int iFrame = (int)flFrame;
+    if (iFrame < flFrame)
+        iFrame++;
+
+    iFrame = std::min(iFrame, (int)anim.m_flLastFrame);
+
+    int i = anim.m_iFirstBlock + m_vecFrameBlocks[anim.m_iFrameOffset + iFrame];
+
+    float f = m_vecFrameRange[i] > 0.0f ? (flFrame - m_vecStartFrame[i]) / m_vecFrameRange[i] : 1.0f;
+    f = std::min(f, 1.0f);
+
+    float d = m_vecV0[i] * f + 0.5f * m_vecDV[i] * f * f;
+
+    vecPos = m_vecStartPos[i] + m_vecDirection[i] * d;
+    flYaw = m_vecStartYaw[i] * (1.0f - f) + m_vecEndYaw[i] * f;
+
+    if (iLoops != 0)
+    {
+        vecPos += anim.m_vecLoopPos * (float)iLoops;
+        flYaw += anim.m_flLoopYaw * iLoops;
+    }
+}
+
+bool CRootMotion::AnimPosition(int iAnim, float flCycle, Vector& vecPos, float& flYaw) const
+{
+    vecPos = Vector(0.0f);
+    flYaw = 0.0f;
+
+    if (iAnim < 0 || iAnim >= (int)m_vecAnims.size() || m_vecAnims[iAnim].m_iBlockCount == 0)
+        return false;
+
+    Position(m_vecAnims[iAnim], flCycle, vecPos, flYaw);
+    return true;
+}
+
+bool CRootMotion::AnimMovement(int iAnim, float flCycleFrom, float flCycleTo, Vector& vecDeltaPos, float& flDeltaYaw) const
+{
+    vecDeltaPos = Vector(0.0f);
+    flDeltaYaw = 0.0f;
+
+    if (iAnim < 0 || iAnim >= (int)m_vecAnims.size() || m_vecAnims[iAnim].m_iBlockCount == 0)
+        return false;
+
+    const CAnimMotion& anim = m_vecAnims[iAnim];
+
+    Vector vecStart, vecEnd;
+    float flStartYaw, flEndYaw;
+    Position(anim, flCycleFrom, vecStart, flStartYaw);
+    Position(anim, flCycleTo, vecEnd, flEndYaw);
+
+    flDeltaYaw = flEndYaw - flStartYaw;
+    vecDeltaPos = VectorYawRotate(vecEnd - vecStart, -flStartYaw);
+
+    return true;
+}
+
+bool CRootMotion::SeqMovement(int iSequence, float flCycleFrom, float flCycleTo, const float* pPoseParameters, Vector& vecDeltaPos, float& flDeltaYaw) const
+{
+    vecDeltaPos = Vector(0.0f);
+    flDeltaYaw = 0.0f;
+
+    CBlendCell cell;
+    if (!m_BlendSpace.FindCell(iSequence, pPoseParameters, cell))
+        return false;
+
+    const std::vector<float>& vecWeights = m_Model.GetSequences()[iSequence].m_vecBoneWeights;
+    bool bRootWeighted = vecWeights.empty() || vecWeights[0] > 0.0f;
+
+    bool bFound = false;
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (cell.m_flWeights[i] == 0.0f)
+            continue;
+
+        Vector vecPos;
+        float flYaw;
+
+        if (AnimMovement(cell.m_iAnims[i], flCycleFrom, flCycleTo, vecPos, flYaw))
+        {
+            bFound = true;
+            vecDeltaPos += vecPos * cell.m_flWeights[i];
+            flDeltaYaw += flYaw * cell.m_flWeights[i];
+        }
+        else if (bRootWeighted && cell.m_iAnims[i] >= 0 && cell.m_iAnims[i] < (int)m_vecAnims.size() && m_vecAnims[cell.m_iAnims[i]].m_bStatic)
+        {
+            bFound = true;
+        }
+    }
+
+    return bFound;
+}
+
+void CRootMotion::SeqMovement(const int* pSequences, const float* pCyclesFrom, const float* pCyclesTo, const float* pPoseParameters, int nEntities, Vector* pDeltaPos, float* pDeltaYaw) const
+{
+    int nPoseParameters = m_BlendSpace.PoseParameterCount();
+
+    for (int e = 0; e < nEntities; e++)
+        SeqMovement(pSequences[e], pCyclesFrom[e], pCyclesTo[e], pPoseParameters + (size_t)e * nPoseParameters, pDeltaPos[e], pDeltaYaw[e]);
+}
@@ -12,16 +12,34 @@ namespace
         std::transform(str.begin(), str.end(), str.begin(),
             [](unsigned char c) { return std::tolower(c); });
     }
+
+    // ui records point straight at their controllers, turn those back into indices
+    int FlexControllerIndex(const studiohdr_t* pMdl, const mstudioflexcontroller_t* pController)
+    {
+        if (!pController || pMdl->numflexcontrollers <= 0)
+            return -1;
+
+        const byte* pBase = (const byte*)pMdl + pMdl->flexcontrollerindex;
+        ptrdiff_t offset = (const byte*)pController - pBase;
+
+        if (offset < 0 || offset % sizeof(mstudioflexcontroller_t) != 0)
+            return -1;
+
+        int iIndex = (int)(offset / sizeof(mstudioflexcontroller_t));
+        return iIndex < pMdl->numflexcontrollers ? iIndex : -1;
+    }
 }
 
-CModel::CModel(const std::string& filename)
+CModel::CModel(const std::string& filename, RawDataPolicy_t iRawDataPolicy)
 {
     m_BoneMap.reserve(MAXSTUDIOBONES);
     m_vecBoneControllers.reserve(MAXSTUDIOBONECTRLS);
     m_vecTextures.reserve(MAXSTUDIOSKINS);
 
     if (filename != "")
-        LoadFile(filename);
+        LoadFile(filename, iRawDataPolicy);
+
+    CountMemory();
 }
 
 const CModelBone* CModel::Bone(int iIndex) const
@@ -52,8 +70,20 @@ const std::string* CModel::Texture(int iIndex) const
     return pMat;
 }
 
-bool CModel::LoadFile(const std::string& filename)
+int CModel::FindAttachment(const std::string& strName) const
 {
+    std::string strKey = strName;
+    ToLower(strKey);
+
+    auto it = m_AttachmentMap.find(strKey);
+    return it != m_AttachmentMap.end() ? it->second : -1;
+}
+
+bool CModel::LoadFile(const std::string& filename, RawDataPolicy_t iRawDataPolicy)
+{
+    MDL_LOAD_CLOCK(m_LoadStats, filename);
+    MDL_LOAD_PHASE(LOADPHASE_READ);
+
     std::ifstream file;
 
     file.open(filename, std::ifstream::binary);
@@ -66,6 +96,8 @@ bool CModel::LoadFile(const std::string& filename)
 
     file.close();
 
+    MDL_LOAD_PHASE(LOADPHASE_COPY);
+
     std::string contents = buffer.str();
     std::vector<char> cstr(contents.c_str(), contents.c_str() + contents.size() + 1);
 
@@ -75,18 +107,51 @@ bool CModel::LoadFile(const std::string& filename)
         return false;
 
     m_vecRawData = cstr;
+    m_strFileName = filename;
+
+#ifdef MDL_LOAD_STATS
+    m_LoadStats.m_nFileBytes = (int64_t)contents.size();
+    m_LoadStats.m_nModels = 1;
+#endif
+
+    MDL_LOAD_PHASE_END();
 
     CacheModelInfo(pModel);
 
+    MDL_LOAD_PHASE(LOADPHASE_COMPACT);
+
+    // everything's decoded by now, keep only what's still read through the header
+    if (iRawDataPolicy == RAWDATA_COMPACT)
+    {
+        std::vector<char> vecCompact;
+
+        if (Studio_CompactRawData(m_vecRawData, vecCompact))
+        {
+            m_vecRawData.swap(vecCompact);
+            m_iRawDataPolicy = RAWDATA_COMPACT;
+        }
+    }
+    else if (iRawDataPolicy == RAWDATA_DROP)
+    {
+        m_vecRawData.clear();
+        m_vecRawData.shrink_to_fit();
+        m_iRawDataPolicy = RAWDATA_DROP;
+    }
+
     return true;
 }
 
 void CModel::CacheModelInfo(studiohdr_t* pMdl)
 {
+    MDL_LOAD_CLOCK(m_LoadStats, m_strFileName);
+    MDL_LOAD_PHASE(LOADPHASE_TEXTURES);
+
     m_strModelName = pMdl->name;
 
     ToLower(m_strModelName);
 
+    m_strSurfaceProp = pMdl->surfacepropindex ? pMdl->pszSurfaceProp() : "";
+
     m_iVersion = pMdl->version;
 
     int iMatCount = pMdl->numtextures;
@@ -105,6 +170,8 @@ void CModel::CacheModelInfo(studiohdr_t* pMdl)
     m_hullMins = pMdl->hull_min;
     m_hullMaxs = pMdl->hull_max;
 
+    MDL_LOAD_PHASE(LOADPHASE_BONES);
+
     m_iBoneCount = pMdl->numbones;
 
     mstudiobone_t* pBone;
@@ -121,6 +188,8 @@ void CModel::CacheModelInfo(studiohdr_t* pMdl)
         m_BoneMap.insert({ i, bone });
     }
 
+    MDL_LOAD_PHASE(LOADPHASE_CONTROLLERS);
+
     m_iBoneControllerCount = pMdl->numbonecontrollers;
 
     mstudiobonecontroller_t* pController;
@@ -137,6 +206,8 @@ void CModel::CacheModelInfo(studiohdr_t* pMdl)
         m_vecBoneControllers.push_back(ctrl);
     }
   
+    MDL_LOAD_PHASE(LOADPHASE_BODYPARTS);
+
     m_iBodyPartsCount = pMdl->numbodyparts;
 
     mstudiobodyparts_t* pBodyParts;
@@ -153,8 +224,87 @@ void CModel::CacheModelInfo(studiohdr_t* pMdl)
         m_vecBodyParts.push_back(parts);
     }
 
+    MDL_LOAD_PHASE(LOADPHASE_POSEPARAMS);
+
+    m_iPoseParameterCount = pMdl->numlocalposeparameters;
+
+    mstudioposeparamdesc_t* pPose;
+    for (int i = 0; i < m_iPoseParameterCount; i++)
+    {
+        pPose = pMdl->pLocalPoseParameter(i);
+
+        if (!pPose)
+            break;
+
+        CPoseParameter param;
+        param.Cache(pPose);
+
+        m_vecPoseParameters.push_back(param);
+    }
+
+    MDL_LOAD_PHASE(LOADPHASE_ANIMATIONS);
+
+    m_iAnimationCount = pMdl->numlocalanim;
+
+    mstudioanimdesc_t* pAnimDesc;
+    for (int i = 0; i < m_iAnimationCount; i++)
+    {
+        pAnimDesc = pMdl->pLocalAnimdesc(i);
+
+        if (!pAnimDesc)
+            break;
+
+        CAnimDesc anim;
+        anim.Cache(pAnimDesc);
+
+        m_vecAnimations.push_back(anim);
+    }
+
+    MDL_LOAD_PHASE(LOADPHASE_SEQUENCES);
+
     m_iSequenceCount = pMdl->numlocalseq;
-    // TODO: Store sequences!
+
+    mstudioseqdesc_t* pSeqDesc;
+    for (int i = 0; i < m_iSequenceCount; i++)
+    {
+        pSeqDesc = pMdl->pLocalSeqdesc(i);
+
+        if (!pSeqDesc)
+            break;
+
+        CSequence seq;
+        seq.Cache(pSeqDesc);
+
+        m_vecSequences.push_back(seq);
+    }
+
+    MDL_LOAD_PHASE(LOADPHASE_IK);
+
+    m_iIKChainCount = pMdl->numikchains;
+
+    mstudioikchain_t* pChain;
+    for (int i = 0; i < m_iIKChainCount; i++)
+    {
+        pChain = pMdl->pIKChain(i);
+
+        if (!pChain)
+            break;
+
+        CIKChain chain;
+        chain.Cache(pChain);
+
+        m_vecIKChains.push_back(chain);
+    }
+
+    for (int i = 0; i < pMdl->numlocalikautoplaylocks; i++)
+    {
+        CIKLock lock;
+        lock.Cache(pMdl->pLocalIKAutolock(i));
+
+        m_vecIKAutoplayLocks.push_back(lock);
+    }
+
+    MDL_LOAD_PHASE(LOADPHASE_HITBOXSETS);
 
     m_iHitBoxSetCount = pMdl->numhitboxsets;
 
@@ -172,6 +322,166 @@ void CModel::CacheModelInfo(studiohdr_t* pMdl)
 
         m_vecHitBoxSets.push_back(set);
     }
+
+    MDL_LOAD_PHASE(LOADPHASE_ATTACHMENTS);
+
+    m_iAttachmentCount = pMdl->numlocalattachments;
+
+    mstudioattachment_t* pAttachment;
+    for (int i = 0; i < m_iAttachmentCount; i++)
+    {
+        pAttachment = pMdl->pLocalAttachment(i);
+
+        if (!pAttachment)
+            break;
+
+        CAttachment attachment;
+        attachment.Cache(pAttachment);
+
+        std::string strKey = attachment.m_strName;
+        ToLower(strKey);
+        m_AttachmentMap.insert({ strKey, i });
+
+        m_vecAttachments.push_back(attachment);
+    }
+
+    MDL_LOAD_PHASE(LOADPHASE_FLEX);
+
+    m_iFlexDescCount = pMdl->numflexdesc;
+
+    if (m_iFlexDescCount >= 1)
+    {
+        m_vecFlexDescs.reserve(m_iFlexDescCount);
+
+        for (int i = 0; i < m_iFlexDescCount; i++)
+            m_vecFlexDescs.push_back(pMdl->pFlexdesc(i)->pszFACS());
+    }
+
+    m_iFlexControllerCount = pMdl->numflexcontrollers;
+
+    mstudioflexcontroller_t* pFlexController;
+    for (int i = 0; i < m_iFlexControllerCount; i++)
+    {
+        pFlexController = pMdl->pFlexcontroller(i);
+
+        if (!pFlexController)
+            break;
+
+        CFlexController ctrl;
+        ctrl.Cache(pFlexController);
+
+        m_vecFlexControllers.push_back(ctrl);
+    }
+
+    m_iFlexControllerUICount = pMdl->numflexcontrollerui;
+
+    mstudioflexcontrollerui_t* pFlexUI;
+    for (int i = 0; i < m_iFlexControllerUICount; i++)
+    {
+        pFlexUI = pMdl->pFlexControllerUI(i);
+
+        if (!pFlexUI)
+            break;
+
+        CFlexControllerUI ui;
+        ui.Cache(pFlexUI);
+
+        if (pFlexUI->stereo)
+        {
+            ui.m_iControllers[0] = FlexControllerIndex(pMdl, pFlexUI->pLeftController());
+            ui.m_iControllers[1] = FlexControllerIndex(pMdl, pFlexUI->pRightController());
+        }
+        else
+        {
+            ui.m_iControllers[0] = FlexControllerIndex(pMdl, pFlexUI->pController());
+        }
+
+        ui.m_iControllers[2] = FlexControllerIndex(pMdl, pFlexUI->pNWayValueController());
+
+        m_vecFlexControllerUIs.push_back(ui);
+    }
+
+    MDL_LOAD_PHASE(LOADPHASE_DERIVED);
+
+    // flex rules are compiled once here, instances only ever run the flat program
+    m_iFlexRuleCount = pMdl->numflexrules;
+    m_FlexProgram.Compile(pMdl);
+
+    m_EventTimeline.Build(pMdl);
+    m_TransitionGraph.Build(pMdl);
+    m_SkeletonLayout.Build(pMdl);
+}
+
+void CModel::CountMemory()
+{
+    CModelMemory mem;
+
+    mem.m_nRawData = HeapBytes(m_vecRawData);
+
+    mem.m_nBones = HeapBytes(m_BoneMap);
+    for (const auto& bone : m_BoneMap)
+        mem.m_nBones += HeapBytes(bone.second.m_strName) + HeapBytes(bone.second.m_strSurfaceProp);
+
+    mem.m_nBodyParts = HeapBytes(m_vecBodyParts);
+    for (const CModelBodyParts& parts : m_vecBodyParts)
+    {
+        mem.m_nBodyParts += HeapBytes(parts.m_strName) + HeapBytes(parts.m_vecStudioModels);
+
+        for (const CStudioModel& model : parts.m_vecStudioModels)
+        {
+            mem.m_nBodyParts += HeapBytes(model.m_strName) + HeapBytes(model.m_vecEyeBalls);
+
+            for (const CStudioEyeBall& eye : model.m_vecEyeBalls)
+                mem.m_nBodyParts += HeapBytes(eye.m_strName);
+        }
+    }
+
+    mem.m_nHitBoxes = HeapBytes(m_vecHitBoxSets);
+    for (const CHitBoxSet& set : m_vecHitBoxSets)
+    {
+        mem.m_nHitBoxes += HeapBytes(set.m_strName) + HeapBytes(set.m_vecHitBoxes);
+
+        for (const CBBox& box : set.m_vecHitBoxes)
+            mem.m_nHitBoxes += HeapBytes(box.m_strName);
+    }
+
+    mem.m_nMaterials = HeapBytes(m_vecTextures);
+
+    mem.m_nAnimations = HeapBytes(m_vecAnimations);
+    for (const CAnimDesc& anim : m_vecAnimations)
+    {
+        mem.m_nAnimations += HeapBytes(anim.m_strName) + HeapBytes(anim.m_vecIKRules);
+
+        for (const CIKRule& rule : anim.m_vecIKRules)
+            mem.m_nAnimations += HeapBytes(rule.m_strAttachment);
+    }
+
+    mem.m_nSequences = HeapBytes(m_vecSequences);
+    for (const CSequence& seq : m_vecSequences)
+    {
+        mem.m_nSequences += HeapBytes(seq.m_strLabel) + HeapBytes(seq.m_strActivityName) + HeapBytes(seq.m_vecAnims)
+            + HeapBytes(seq.m_vecPoseKeys) + HeapBytes(seq.m_vecBoneWeights) + HeapBytes(seq.m_vecIKLocks);
+    }
+
+    mem.m_nFlex = HeapBytes(m_vecFlexDescs) + HeapBytes(m_vecFlexControllers) + HeapBytes(m_vecFlexControllerUIs) + m_FlexProgram.MemoryUsage();
+    for (const CFlexController& ctrl : m_vecFlexControllers)
+        mem.m_nFlex += HeapBytes(ctrl.m_strName) + HeapBytes(ctrl.m_strType);
+    for (const CFlexControllerUI& ui : m_vecFlexControllerUIs)
+        mem.m_nFlex += HeapBytes(ui.m_strName);
+
+    mem.m_nDerived = m_EventTimeline.MemoryUsage() + m_TransitionGraph.MemoryUsage() + m_SkeletonLayout.MemoryUsage();
+
+    mem.m_nOther = sizeof(CModel) + HeapBytes(m_vecBoneControllers) + HeapBytes(m_vecAttachments) + HeapBytes(m_AttachmentMap)
+        + HeapBytes(m_vecPoseParameters) + HeapBytes(m_vecIKChains) + HeapBytes(m_vecIKAutoplayLocks)
+        + HeapBytes(m_strModelName) + HeapBytes(m_strFileName) + HeapBytes(m_strSurfaceProp);
+    for (const CAttachment& attachment : m_vecAttachments)
+        mem.m_nOther += HeapBytes(attachment.m_strName);
+    for (const CPoseParameter& param : m_vecPoseParameters)
+        mem.m_nOther += HeapBytes(param.m_strName);
+    for (const CIKChain& chain : m_vecIKChains)
+        mem.m_nOther += HeapBytes(chain.m_strName) + HeapBytes(chain.m_vecBones) + HeapBytes(chain.m_vecKneeDirs);
+
+    m_Memory = mem;
 }
 
 void CStudioEyeBall::Cache(mstudioeyeball_t* pEyeBall)
@@ -239,9 +549,20 @@ void CStudioModel::Cache(mstudiomodel_t* pModel)
     }
 }
 
+void CAttachment::Cache(mstudioattachment_t* pAttachment)
+{
+    m_strName = pAttachment->pszName();
+
+    m_iFlags = pAttachment->flags;
+    m_iBone = pAttachment->localbone;
+
+    m_matLocal = pAttachment->local;
+}
+
 void CModelBone::Cache(mstudiobone_t* pBone)
 {
     m_strName = pBone->pszName();
+    m_strSurfaceProp = pBone->surfacepropidx ? pBone->pszSurfaceProp() : "";
 
     m_iContents = pBone->contents;
     m_iFlags = pBone->flags;
@@ -290,6 +611,180 @@ void CBoneController::Cache(mstudiobonecontroller_t* pController)
     m_flStart = pController->start;
 }
 
+void CFlexController::Cache(mstudioflexcontroller_t* pController)
+{
+    m_strName = pController->pszName();
+    m_strType = pController->pszType();
+
+    m_flMin = pController->min;
+    m_flMax = pController->max;
+}
+
+void CFlexControllerUI::Cache(mstudioflexcontrollerui_t* pUI)
+{
+    m_strName = pUI->pszName();
+
+    m_iRemapType = pUI->remaptype;
+    m_bStereo = pUI->stereo;
+}
+
+void CPoseParameter::Cache(mstudioposeparamdesc_t* pPose)
+{
+    m_strName = pPose->pszName();
+
+    m_iFlags = pPose->flags;
+
+    m_flStart = pPose->start;
+    m_flEnd = pPose->end;
+    m_flLoop = pPose->loop;
+}
+
+void CAnimDesc::Cache(mstudioanimdesc_t* pAnimDesc)
+{
+    m_strName = pAnimDesc->pszName();
+
+    m_flFPS = pAnimDesc->fps;
+    m_iFlags = pAnimDesc->flags;
+
+    m_iFrameCount = pAnimDesc->numframes;
+    m_iMovementCount = pAnimDesc->nummovements;
+
+    m_iAnimBlock = pAnimDesc->animblock;
+    m_iSectionFrames = pAnimDesc->sectionframes;
+
+    m_iIKRuleCount = pAnimDesc->numikrules;
+
+    if (pAnimDesc->ikruleindex != 0)
+    {
+        m_vecIKRules.resize(m_iIKRuleCount);
+
+        for (int i = 0; i < m_iIKRuleCount; i++)
+            m_vecIKRules[i].Cache(pAnimDesc->pIKRule(i));
+    }
+}
+
+void CIKChain::Cache(mstudioikchain_t* pChain)
+{
+    m_strName = pChain->pszName();
+    m_iLinkType = pChain->linktype;
+
+    for (int i = 0; i < pChain->numlinks; i++)
+    {
+        mstudioiklink_t* pLink = pChain->pLink(i);
+
+        Vector3D kneeDir;
+        kneeDir = pLink->kneeDir;
+
+        m_vecBones.push_back(pLink->bone);
+        m_vecKneeDirs.push_back(kneeDir);
+    }
+}
+
+void CIKRule::Cache(mstudioikrule_t* pRule)
+{
+    m_iType = pRule->type;
+    m_iChain = pRule->chain;
+    m_iBone = pRule->bone;
+    m_iSlot = pRule->slot;
+
+    m_flHeight = pRule->height;
+    m_flRadius = pRule->radius;
+    m_flFloor = pRule->floor;
+
+    m_vecPos = pRule->pos;
+    m_q = pRule->q;
+
+    m_flStart = pRule->start;
+    m_flPeak = pRule->peak;
+    m_flTail = pRule->tail;
+    m_flEnd = pRule->end;
+
+    m_flContact = pRule->contact;
+    m_flDrop = pRule->drop;
+    m_flTop = pRule->top;
+
+    m_strAttachment = pRule->szattachmentindex != 0 ? pRule->pszAttachment() : "";
+}
+
+void CIKLock::Cache(mstudioiklock_t* pLock)
+{
+    m_iChain = pLock->chain;
+    m_iFlags = pLock->flags;
+
+    m_flPosWeight = pLock->flPosWeight;
+    m_flLocalQWeight = pLock->flLocalQWeight;
+}
+
+void CSequence::Cache(mstudioseqdesc_t* pSeqDesc)
+{
+    m_strLabel = pSeqDesc->pszLabel();
+    m_strActivityName = pSeqDesc->pszActivityName();
+
+    m_iFlags = pSeqDesc->flags;
+    m_iActivity = pSeqDesc->activity;
+    m_iActivityWeight = pSeqDesc->actweight;
+
+    m_iEventCount = pSeqDesc->numevents;
+
+    m_bbMin = pSeqDesc->bbmin;
+    m_bbMax = pSeqDesc->bbmax;
+
+    for (int i = 0; i < 2; i++)
+    {
+        m_iGroupSize[i] = pSeqDesc->groupsize[i];
+        m_iParamIndex[i] = pSeqDesc->paramindex[i];
+        m_flParamStart[i] = pSeqDesc->paramstart[i];
+        m_flParamEnd[i] = pSeqDesc->paramend[i];
+    }
+
+    m_vecAnims.reserve(m_iGroupSize[0] * m_iGroupSize[1]);
+
+    for (int y = 0; y < m_iGroupSize[1]; y++)
+    {
+        for (int x = 0; x < m_iGroupSize[0]; x++)
+            m_vecAnims.push_back(pSeqDesc->anim(x, y));
+    }
+
+    if (pSeqDesc->posekeyindex != 0)
+    {
+        m_vecPoseKeys.reserve(m_iGroupSize[0] + m_iGroupSize[1]);
+
+        for (int iParam = 0; iParam < 2; iParam++)
+        {
+            for (int i = 0; i < m_iGroupSize[iParam]; i++)
+                m_vecPoseKeys.push_back(pSeqDesc->poseKey(iParam, i));
+        }
+    }
+
+    int iBoneCount = pSeqDesc->pStudiohdr()->numbones;
+
+    if (pSeqDesc->weightlistindex != 0)
+    {
+        m_vecBoneWeights.reserve(iBoneCount);
+
+        for (int i = 0; i < iBoneCount; i++)
+            m_vecBoneWeights.push_back(pSeqDesc->weight(i));
+    }
+
+    for (int i = 0; i < pSeqDesc->numiklocks; i++)
+    {
+        CIKLock lock;
+        lock.Cache(pSeqDesc->pIKLock(i));
+
+        m_vecIKLocks.push_back(lock);
+    }
+
+    m_flFadeInTime = pSeqDesc->fadeintime;
+    m_flFadeOutTime = pSeqDesc->fadeouttime;
+
+    m_iEntryNode = pSeqDesc->localentrynode;
+    m_iExitNode = pSeqDesc->localexitnode;
+    m_iNodeFlags = pSeqDesc->nodeflags;
+
+    m_iNextSequence = pSeqDesc->nextseq;
+    m_iCyclePoseIndex = pSeqDesc->cycleposeindex;
+}
+
 void CHitBoxSet::Cache(mstudiohitboxset_t* pPtr)
 {
     m_strName = pPtr->pszName();
@@ -0,0 +1,547 @@
+#include "mdlphy.h"
+#include "mdlfile.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+#include "valve/phyfile.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+#define METERS_TO_INCHES (1.0f / 0.0254f)
+#define PHY_PLANE_EPSILON 0.01f // game units, coplanar triangles share one plane
+
+namespace
+{
+    // ivp is y down and in meters
+    inline Vector IVPToGame(const float* p)
+    {
+        return Vector(p[0], p[2], -p[1]) * METERS_TO_INCHES;
+    }
+
+    // reads quoted strings, bare words and braces out of the key value text
+    class CTokenizer
+    {
+    public:
+        CTokenizer(const std::string& str) : m_str(str) {}
+
+        bool Next(std::string& strToken)
+        {
+            while (m_iPos < m_str.size() && std::isspace((unsigned char)m_str[m_iPos]))
+                m_iPos++;
+
+            if (m_iPos >= m_str.size() || m_str[m_iPos] == '\0')
+                return false;
+
+            char c = m_str[m_iPos];
+
+            if (c == '{' || c == '}')
+            {
+                strToken.assign(1, c);
+                m_iPos++;
+                return true;
+            }
+
+            if (c == '"')
+            {
+                size_t iEnd = m_str.find('"', m_iPos + 1);
+                if (iEnd == std::string::npos)
+                    iEnd = m_str.size();
+
+                strToken = m_str.substr(m_iPos + 1, iEnd - m_iPos - 1);
+                m_iPos = iEnd + 1;
+                return true;
+            }
+
+            size_t iStart = m_iPos;
+            while (m_iPos < m_str.size() && !std::isspace((unsigned char)m_str[m_iPos]) && m_str[m_iPos] != '{' && m_str[m_iPos] != '}' && m_str[m_iPos] != '"' && m_str[m_iPos] != '\0')
+                m_iPos++;
+
+            strToken = m_str.substr(iStart, m_iPos - iStart);
+            return true;
+        }
+
+    private:
+        const std::string& m_str;
+        size_t m_iPos = 0;
+    };
+}
+
+bool CCollisionModel::Load(const CModel& model)
+{
+    const studiohdr_t* pMdl = model.StudioHdr();
+
+    if (!pMdl)
+        return false;
+
+    if (!Load(StripExtension(model.FileName()) + ".phy"))
+        return false;
+
+    if (m_iChecksum != pMdl->checksum)
+    {
+        Load(std::string());
+        return false;
+    }
+
+    m_vecBoneNames.clear();
+
+    for (int i = 0; i < pMdl->numbones; i++)
+        m_vecBoneNames.push_back(LowerCase(pMdl->pBone(i)->pszName()));
+
+    return true;
+}
+
+bool CCollisionModel::Load(const std::string& filename)
+{
+    m_vecSolidHulls.clear();
+    m_vecHulls.clear();
+    m_vecPointX.clear();
+    m_vecPointY.clear();
+    m_vecPointZ.clear();
+    m_vecPlaneX.clear();
+    m_vecPlaneY.clear();
+    m_vecPlaneZ.clear();
+    m_vecPlaneD.clear();
+    m_strKeyValues.clear();
+    m_vecBoneNames.clear();
+    m_iChecksum = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_KeyValuesMutex);
+        m_bKeyValuesParsed = false;
+        m_vecSolidInfo.clear();
+    }
+
+    CMappedFile file;
+
+    if (filename.empty() || !file.Open(filename))
+        return false;
+
+    if (!Decode(file.Data(), file.Size()))
+    {
+        m_vecSolidHulls.clear();
+        m_vecHulls.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool CCollisionModel::Decode(const char* pData, size_t nSize)
+{
+    const char* pEnd = pData + nSize;
+
+    if (!InRange<phyheader_t>(pData, pData, pEnd))
+        return false;
+
+    const phyheader_t* pHeader = (const phyheader_t*)pData;
+
+    if (pHeader->size < (int)sizeof(phyheader_t) || (size_t)pHeader->size > nSize || pHeader->solidCount < 0)
+        return false;
+
+    m_iChecksum = pHeader->checkSum;
+
+    const char* pSolid = pData + pHeader->size;
+    m_vecSolidHulls.push_back(0);
+
+    for (int i = 0; i < pHeader->solidCount; i++)
+    {
+        if (!InRange<int>(pSolid, pData, pEnd))
+            return false;
+
+        int iSize = *(const int*)pSolid;
+        const char* pSolidEnd = pSolid + sizeof(int) + iSize;
+
+        if (iSize < 0 || pSolidEnd > pEnd)
+            return false;
+
+        const compactsurfaceheader_t* pSurfaceHeader = (const compactsurfaceheader_t*)pSolid;
+        const char* pSurface = pSolid + sizeof(int);
+
+        if (InRange<compactsurfaceheader_t>(pSolid, pSolid, pSolidEnd) && pSurfaceHeader->vphysicsID == VPHYSICS_COLLISION_ID)
+        {
+            // only polygon soups decode into hulls, anything else stays an empty solid
+            pSurface = pSurfaceHeader->modelType == COLLIDE_POLY ? pSolid + sizeof(compactsurfaceheader_t) : nullptr;
+        }
+
+        const ivpcompactsurface_t* pIVP = (const ivpcompactsurface_t*)pSurface;
+
+        if (pSurface && InRange<ivpcompactsurface_t>(pSurface, pSurface, pSolidEnd) && pIVP->dummy[2] == IVP_COMPACT_SURFACE_ID)
+        {
+            std::vector<const ivpcompactledgetreenode_t*> vecNodes{ (const ivpcompactledgetreenode_t*)(pSurface + pIVP->offset_ledgetree_root) };
+
+            while (!vecNodes.empty())
+            {
+                const ivpcompactledgetreenode_t* pNode = vecNodes.back();
+                vecNodes.pop_back();
+
+                if (!InRange<ivpcompactledgetreenode_t>(pNode, pSurface, pSolidEnd))
+                    continue;
+
+                if (!pNode->IsTerminal())
+                {
+                    // children always come after their parent, which also stops loops
+                    if (pNode->offset_right_node > 0)
+                        vecNodes.push_back(pNode->pRight());
+
+                    vecNodes.push_back(pNode->pLeft());
+                    continue;
+                }
+
+                const ivpcompactledge_t* pLedge = (const ivpcompactledge_t*)((const char*)pNode + pNode->offset_compact_ledge);
+                DecodeLedge(pLedge, pSurface, pSolidEnd);
+            }
+        }
+
+        m_vecSolidHulls.push_back((int)m_vecHulls.size());
+        pSolid = pSolidEnd;
+    }
+
+    // the rest is the key value text, up to its terminator
+    const char* pText = pSolid;
+    const char* pTextEnd = std::find(pText, pEnd, '\0');
+    m_strKeyValues.assign(pText, pTextEnd);
+
+    return true;
+}
+
+void CCollisionModel::DecodeLedge(const ivpcompactledge_t* pLedge, const char* pBegin, const char* pEnd)
+{
+    if (!InRange<ivpcompactledge_t>(pLedge, pBegin, pEnd) || pLedge->n_triangles <= 0)
+        return;
+
+    int nTriangles = pLedge->n_triangles;
+
+    if (!InRange<ivpcompacttriangle_t>(pLedge->pTriangle(0), pBegin, pEnd, nTriangles))
+        return;
+
+    // every ledge of a solid indexes one shared point array, so only the points this
+    // ledge's triangles use belong to the hull (and to its bounds and center)
+    std::vector<int> vecIndices;
+    vecIndices.reserve(nTriangles * 3);
+
+    for (int i = 0; i < nTriangles; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            vecIndices.push_back(pLedge->pTriangle(i)->c_three_edges[j].start_point_index);
+    }
+
+    std::sort(vecIndices.begin(), vecIndices.end());
+    vecIndices.erase(std::unique(vecIndices.begin(), vecIndices.end()), vecIndices.end());
+
+    if (!InRange<float>(pLedge->pPoint(0), pBegin, pEnd, (vecIndices.back() + 1) * 4))
+        return;
+
+    int nPoints = (int)vecIndices.size();
+
+    CCollisionHull hull;
+    hull.m_iFirstPoint = (int)m_vecPointX.size();
+    hull.m_nPoints = nPoints;
+    hull.m_iFirstPlane = (int)m_vecPlaneX.size();
+    hull.m_nPlanes = 0;
+
+    std::vector<Vector> vecPoints(nPoints);
+    Vector center(0.0f);
+
+    for (int i = 0; i < nPoints; i++)
+    {
+        vecPoints[i] = IVPToGame(pLedge->pPoint(vecIndices[i]));
+        center += vecPoints[i];
+
+        m_vecPointX.push_back(vecPoints[i].x);
+        m_vecPointY.push_back(vecPoints[i].y);
+        m_vecPointZ.push_back(vecPoints[i].z);
+    }
+
+    center *= 1.0f / nPoints;
+
+    // a triangle's corner among this hull's points
+    auto Corner = [&](const ivpcompacttriangle_t* pTri, int iEdge) -> const Vector&
+    {
+        int iIndex = pTri->c_three_edges[iEdge].start_point_index;
+        return vecPoints[std::lower_bound(vecIndices.begin(), vecIndices.end(), iIndex) - vecIndices.begin()];
+    };
+
+    hull.m_vecMins = hull.m_vecMaxs = vecPoints[0];
+
+    for (const Vector& p : vecPoints)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            hull.m_vecMins[j] = std::min(hull.m_vecMins[j], p[j]);
+            hull.m_vecMaxs[j] = std::max(hull.m_vecMaxs[j], p[j]);
+        }
+    }
+
+    for (int i = 0; i < nTriangles; i++)
+    {
+        const ivpcompacttriangle_t* pTri = pLedge->pTriangle(i);
+
+        const Vector& a = Corner(pTri, 0);
+        const Vector& b = Corner(pTri, 1);
+        const Vector& c = Corner(pTri, 2);
+
+        Vector n = CrossProduct(b - a, c - a);
+        float flLength = std::sqrt(DotProduct(n, n));
+
+        if (flLength <= 1.0e-6f)
+            continue;
+
+        n *= 1.0f / flLength;
+        float d = DotProduct(n, a);
+
+        // winding isn't relied on, the hull's center is always inside
+        if (DotProduct(n, center) > d)
+        {
+            n = -n;
+            d = -d;
+        }
+
+        bool bDuplicate = false;
+
+        for (int j = hull.m_iFirstPlane; j < (int)m_vecPlaneX.size() && !bDuplicate; j++)
+        {
+            float flDot = n.x * m_vecPlaneX[j] + n.y * m_vecPlaneY[j] + n.z * m_vecPlaneZ[j];
+            bDuplicate = flDot > 0.9999f && std::fabs(d - m_vecPlaneD[j]) < PHY_PLANE_EPSILON;
+        }
+
+        if (bDuplicate)
+            continue;
+
+        m_vecPlaneX.push_back(n.x);
+        m_vecPlaneY.push_back(n.y);
+        m_vecPlaneZ.push_back(n.z);
+        m_vecPlaneD.push_back(d);
+        hull.m_nPlanes++;
+    }
+
+    m_vecHulls.push_back(hull);
+}
+
+void CCollisionModel::ParseKeyValues() const
+{
+    m_vecSolidInfo.assign(SolidCount(), CCollisionSolidInfo());
+
+    CTokenizer tokens(m_strKeyValues);
+    std::string strBlock, strKey, strValue;
+    int iNextSolid = 0;
+
+    while (tokens.Next(strBlock))
+    {
+        if (!tokens.Next(strKey) || strKey != "{")
+            break;
+
+        bool bSolid = LowerCase(strBlock) == "solid";
+        CCollisionSolidInfo info;
+        int iIndex = iNextSolid;
+
+        while (tokens.Next(strKey) && strKey != "}")
+        {
+            if (!tokens.Next(strValue))
+                break;
+
+            // nested blocks aren't used by any solid key, skip over them
+            if (strValue == "{")
+            {
+                int iDepth = 1;
+                while (iDepth > 0 && tokens.Next(strValue))
+                    iDepth += strValue == "{" ? 1 : (strValue == "}" ? -1 : 0);
+                continue;
+            }
+
+            if (!bSolid)
+                continue;
+
+            strKey = LowerCase(strKey);
+
+            if (strKey == "index")
+                iIndex = std::atoi(strValue.c_str());
+            else if (strKey == "name")
+                info.m_strName = strValue;
+            else if (strKey == "parent")
+                info.m_strParent = strValue;
+            else if (strKey == "surfaceprop")
+                info.m_strSurfaceProp = strValue;
+            else if (strKey == "mass")
+                info.m_flMass = (float)std::atof(strValue.c_str());
+        }
+
+        if (!bSolid)
+            continue;
+
+        iNextSolid++;
+
+        if (iIndex < 0 || iIndex >= SolidCount())
+            continue;
+
+        auto it = std::find(m_vecBoneNames.begin(), m_vecBoneNames.end(), LowerCase(info.m_strName));
+        info.m_iBone = it != m_vecBoneNames.end() ? (int)(it - m_vecBoneNames.begin()) : -1;
+
+        m_vecSolidInfo[iIndex] = info;
+    }
+}
+
+const CCollisionSolidInfo* CCollisionModel::SolidInfo(int iSolid) const
+{
+    std::lock_guard<std::mutex> lock(m_KeyValuesMutex);
+
+    if (!m_bKeyValuesParsed)
+    {
+        ParseKeyValues();
+        m_bKeyValuesParsed = true;
+    }
+
+    return (iSolid >= 0 && iSolid < (int)m_vecSolidInfo.size()) ? &m_vecSolidInfo[iSolid] : nullptr;
+}
+
+int CCollisionModel::FindSolid(int iBone) const
+{
+    for (int i = 0; i < SolidCount(); i++)
+    {
+        if (SolidInfo(i)->m_iBone == iBone)
+            return i;
+    }
+
+    return -1;
+}
+
+void CCollisionModel::PointsInSolid(int iSolid, const Vector* pPoints, int nPoints, bool* pInside) const
+{
+    int iFirstHull = SolidFirstHull(iSolid);
+    int iEndHull = iFirstHull + SolidHullCount(iSolid);
+
+    fltx4 epsilon = ReplicateX4(1.0e-3f);
+    fltx4 allOnes = CmpEqSIMD(epsilon, epsilon);
+
+    for (int i = 0; i < nPoints; i += 4)
+    {
+        // the last block repeats its final point into the unused lanes
+        alignas(16) float px[4], py[4], pz[4];
+
+        for (int j = 0; j < 4; j++)
+        {
+            const Vector& p = pPoints[std::min(i + j, nPoints - 1)];
+            px[j] = p.x;
+            py[j] = p.y;
+            pz[j] = p.z;
+        }
+
+        FourVectors p{ LoadAlignedSIMD(px), LoadAlignedSIMD(py), LoadAlignedSIMD(pz) };
+        fltx4 inside = LoadZeroSIMD();
+
+        for (int iHull = iFirstHull; iHull < iEndHull && TestSignSIMD(inside) != 0xF; iHull++)
+        {
+            const CCollisionHull& hull = m_vecHulls[iHull];
+            fltx4 outside = LoadZeroSIMD();
+
+            for (int k = hull.m_iFirstPlane, kEnd = k + hull.m_nPlanes; k < kEnd; k++)
+            {
+                fltx4 dist = MulSIMD(p.x, ReplicateX4(m_vecPlaneX[k]));
+                dist = MaddSIMD(p.y, ReplicateX4(m_vecPlaneY[k]), dist);
+                dist = MaddSIMD(p.z, ReplicateX4(m_vecPlaneZ[k]), dist);
+                dist = SubSIMD(dist, ReplicateX4(m_vecPlaneD[k]));
+
+                outside = OrSIMD(outside, CmpGtSIMD(dist, epsilon));
+
+                if (TestSignSIMD(outside) == 0xF)
+                    break;
+            }
+
+            if (hull.m_nPlanes > 0)
+                inside = OrSIMD(inside, AndNotSIMD(outside, allOnes));
+        }
+
+        int iMask = TestSignSIMD(inside);
+
+        for (int j = 0; j < 4 && i + j < nPoints; j++)
+            pInside[i + j] = (iMask & (1 << j)) != 0;
+    }
+}
+
+int CCollisionModel::RaysVsSolid(int iSolid, const Vector* pStarts, const Vector* pDeltas, int nRays, float* pFractions) const
+{
+    int iFirstHull = SolidFirstHull(iSolid);
+    int iEndHull = iFirstHull + SolidHullCount(iSolid);
+    int nHits = 0;
+
+    fltx4 zero = LoadZeroSIMD();
+    fltx4 one = ReplicateX4(1.0f);
+    fltx4 allOnes = CmpEqSIMD(zero, zero);
+
+    for (int i = 0; i < nRays; i += 4)
+    {
+        alignas(16) float sx[4], sy[4], sz[4], dx[4], dy[4], dz[4];
+
+        for (int j = 0; j < 4; j++)
+        {
+            int iRay = std::min(i + j, nRays - 1);
+            sx[j] = pStarts[iRay].x;
+            sy[j] = pStarts[iRay].y;
+            sz[j] = pStarts[iRay].z;
+            dx[j] = pDeltas[iRay].x;
+            dy[j] = pDeltas[iRay].y;
+            dz[j] = pDeltas[iRay].z;
+        }
+
+        FourVectors start{ LoadAlignedSIMD(sx), LoadAlignedSIMD(sy), LoadAlignedSIMD(sz) };
+        FourVectors delta{ LoadAlignedSIMD(dx), LoadAlignedSIMD(dy), LoadAlignedSIMD(dz) };
+
+        fltx4 fraction = one;
+        fltx4 hit = zero;
+
+        for (int iHull = iFirstHull; iHull < iEndHull; iHull++)
+        {
+            const CCollisionHull& hull = m_vecHulls[iHull];
+
+            if (hull.m_nPlanes == 0)
+                continue;
+
+            // clip each ray against every plane, it's in the hull between the last entry and the first exit
+            fltx4 enter = zero;
+            fltx4 exit = one;
+            fltx4 miss = zero;
+
+            for (int k = hull.m_iFirstPlane, kEnd = k + hull.m_nPlanes; k < kEnd; k++)
+            {
+                fltx4 nx = ReplicateX4(m_vecPlaneX[k]);
+                fltx4 ny = ReplicateX4(m_vecPlaneY[k]);
+                fltx4 nz = ReplicateX4(m_vecPlaneZ[k]);
+
+                fltx4 dist = MaddSIMD(start.z, nz, MaddSIMD(start.y, ny, MulSIMD(start.x, nx)));
+                dist = SubSIMD(dist, ReplicateX4(m_vecPlaneD[k]));
+                fltx4 denom = MaddSIMD(delta.z, nz, MaddSIMD(delta.y, ny, MulSIMD(delta.x, nx)));
+
+                fltx4 entering = CmpLtSIMD(denom, zero);
+                fltx4 leaving = CmpGtSIMD(denom, zero);
+                fltx4 parallel = AndNotSIMD(OrSIMD(entering, leaving), allOnes);
+
+                // lanes that divide by zero are masked off below
+                fltx4 t = DivSIMD(NegSIMD(dist), MaskedAssign(parallel, one, denom));
+
+                enter = MaskedAssign(entering, MaxSIMD(enter, t), enter);
+                exit = MaskedAssign(leaving, MinSIMD(exit, t), exit);
+                miss = OrSIMD(miss, AndSIMD(parallel, CmpGtSIMD(dist, zero)));
+            }
+
+            fltx4 hullHit = AndNotSIMD(miss, CmpLeSIMD(enter, exit));
+            fraction = MaskedAssign(hullHit, MinSIMD(fraction, enter), fraction);
+            hit = OrSIMD(hit, hullHit);
+        }
+
+        alignas(16) float out[4];
+        StoreAlignedSIMD(out, fraction);
+        int iMask = TestSignSIMD(hit);
+
+        for (int j = 0; j < 4 && i + j < nRays; j++)
+        {
+            pFractions[i + j] = out[j];
+
+            if (iMask & (1 << j))
+                nHits++;
+        }
+    }
+
+    return nHits;
+}
@@ -0,0 +1,204 @@
+#include "mdlpose.h"
+#include "mdlanim.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#include <cmath>
+
+CPoseEvaluator::CPoseEvaluator(const CModel& model)
+{
+    for (const CPoseParameter& pose : model.GetPoseParameters())
+    {
+        float flRange = pose.m_flEnd - pose.m_flStart;
+
+        m_vecPoseStart.push_back(pose.m_flStart);
+        m_vecPoseRange.push_back(flRange);
+        m_vecPoseScale.push_back(flRange != 0.0f ? 1.0f / flRange : 0.0f);
+
+        // same wrap as Studio_SetPoseParameter, keeps the value within loop / 2 of the range's middle
+        float flWrap = (pose.m_flStart + pose.m_flEnd) / 2.0f + pose.m_flLoop / 2.0f;
+        m_vecPoseLoop.push_back(pose.m_flLoop);
+        m_vecPoseShift.push_back(pose.m_flLoop != 0.0f ? pose.m_flLoop - flWrap : 0.0f);
+    }
+
+    for (int i = 0; i < POSE_CONTROLLER_INPUTS; i++)
+        m_iInputController[i] = -1;
+
+    for (const CBoneController& ctrl : model.GetBoneControllers())
+    {
+        const CModelBone* pBone = model.Bone(ctrl.m_iBone);
+
+        if (!pBone || ctrl.m_iBone >= POSE_MAX_BONES || ctrl.m_iInputField < 0 || ctrl.m_iInputField >= POSE_CONTROLLER_INPUTS)
+            continue;
+
+        CController controller;
+        controller.m_iBone = ctrl.m_iBone;
+        controller.m_iBoneFlags = pBone->m_iFlags;
+        controller.m_iInput = ctrl.m_iInputField;
+        controller.m_flStart = ctrl.m_flStart;
+        controller.m_flEnd = ctrl.m_flEnd;
+
+        switch (ctrl.m_iType & STUDIO_TYPES)
+        {
+        case STUDIO_X:  controller.m_iAxis = 0; controller.m_bRotation = false; break;
+        case STUDIO_Y:  controller.m_iAxis = 1; controller.m_bRotation = false; break;
+        case STUDIO_Z:  controller.m_iAxis = 2; controller.m_bRotation = false; break;
+        case STUDIO_XR: controller.m_iAxis = 0; controller.m_bRotation = true; break;
+        case STUDIO_YR: controller.m_iAxis = 1; controller.m_bRotation = true; break;
+        case STUDIO_ZR: controller.m_iAxis = 2; controller.m_bRotation = true; break;
+        default:
+            // still encoded, just never applied, the same as the engine
+            controller.m_iAxis = -1;
+            controller.m_bRotation = (ctrl.m_iType & (STUDIO_XR | STUDIO_YR | STUDIO_ZR)) != 0;
+            break;
+        }
+
+        if (m_iInputController[controller.m_iInput] < 0)
+            m_iInputController[controller.m_iInput] = (int)m_vecControllers.size();
+
+        m_vecControllers.push_back(controller);
+    }
+}
+
+void CPoseEvaluator::NormalizePoseParameters(const float* pValues, float* pNormalized, int nEntities) const
+{
+    int nParams = PoseParameterCount();
+
+    const float* pStart = m_vecPoseStart.data();
+    const float* pScale = m_vecPoseScale.data();
+    const float* pLoop = m_vecPoseLoop.data();
+    const float* pShift = m_vecPoseShift.data();
+
+    for (int e = 0; e < nEntities; e++)
+    {
+        const float* pIn = pValues + e * nParams;
+        float* pOut = pNormalized + e * nParams;
+
+        for (int i = 0; i < nParams; i++)
+        {
+            float flValue = pIn[i];
+
+            if (pLoop[i] != 0.0f)
+                flValue = flValue - pLoop[i] * floorf((flValue + pShift[i]) / pLoop[i]);
+
+            flValue = (flValue - pStart[i]) * pScale[i];
+            pOut[i] = flValue < 0.0f ? 0.0f : (flValue > 1.0f ? 1.0f : flValue);
+        }
+    }
+}
+
+void CPoseEvaluator::DecodePoseParameters(const float* pNormalized, float* pValues, int nEntities) const
+{
+    int nParams = PoseParameterCount();
+
+    const float* pStart = m_vecPoseStart.data();
+    const float* pRange = m_vecPoseRange.data();
+
+    for (int e = 0; e < nEntities; e++)
+    {
+        const float* pIn = pNormalized + e * nParams;
+        float* pOut = pValues + e * nParams;
+
+        for (int i = 0; i < nParams; i++)
+            pOut[i] = pStart[i] + pIn[i] * pRange[i];
+    }
+}
+
+void CPoseEvaluator::EncodeControllers(const float* pValues, float* pNormalized, int nEntities) const
+{
+    for (int iInput = 0; iInput < POSE_CONTROLLER_INPUTS; iInput++)
+    {
+        int iController = m_iInputController[iInput];
+
+        if (iController < 0)
+        {
+            for (int e = 0; e < nEntities; e++)
+                pNormalized[e * POSE_CONTROLLER_INPUTS + iInput] = 0.0f;
+
+            continue;
+        }
+
+        const CController& ctrl = m_vecControllers[iController];
+
+        float flStart = ctrl.m_flStart;
+        float flEnd = ctrl.m_flEnd;
+        float flMid = (flStart + flEnd) / 2.0f;
+        float flScale = flEnd != flStart ? 255.0f / (flEnd - flStart) : 0.0f;
+
+        for (int e = 0; e < nEntities; e++)
+        {
+            float flValue = pValues[e * POSE_CONTROLLER_INPUTS + iInput];
+
+            // wrapped as in Studio_SetController
+            if (ctrl.m_bRotation)
+            {
+                if (flEnd < flStart)
+                    flValue = -flValue;
+
+                if (flStart + 359.0f >= flEnd)
+                {
+                    if (flValue > flMid + 180.0f)
+                        flValue -= 360.0f;
+                    if (flValue < flMid - 180.0f)
+                        flValue += 360.0f;
+                }
+                else if (flValue > 360.0f)
+                {
+                    flValue = flValue - (int)(flValue / 360.0f) * 360.0f;
+                }
+                else if (flValue < 0.0f)
+                {
+                    flValue = flValue + (int)((flValue / -360.0f) + 1) * 360.0f;
+                }
+            }
+
+            int iValue = (int)(flScale * (flValue - flStart));
+            iValue = iValue < 0 ? 0 : (iValue > 255 ? 255 : iValue);
+
+            pNormalized[e * POSE_CONTROLLER_INPUTS + iInput] = iValue * (1.0f / 255.0f);
+        }
+    }
+}
+
+void CPoseEvaluator::ApplyControllers(const float* pNormalized, CBonePose* pPoses, int nEntities, int iBoneMask) const
+{
+    for (const CController& ctrl : m_vecControllers)
+    {
+        if (ctrl.m_iAxis < 0 || !(ctrl.m_iBoneFlags & iBoneMask))
+            continue;
+
+        int k = ctrl.m_iBone;
+
+        for (int e = 0; e < nEntities; e++)
+        {
+            float flValue = pNormalized[e * POSE_CONTROLLER_INPUTS + ctrl.m_iInput];
+            flValue = flValue < 0.0f ? 0.0f : (flValue > 1.0f ? 1.0f : flValue);
+            flValue = (1.0f - flValue) * ctrl.m_flStart + flValue * ctrl.m_flEnd;
+
+            CBonePose& pose = pPoses[e];
+
+            if (!ctrl.m_bRotation)
+            {
+                float* pPos[3] = { pose.m_px, pose.m_py, pose.m_pz };
+                pPos[ctrl.m_iAxis][k] += flValue;
+                continue;
+            }
+
+            float flHalf = flValue * (3.14159265358979323846f / 360.0f);
+
+            Quaternion q2{ 0.0f, 0.0f, 0.0f, cosf(flHalf) };
+            (&q2.x)[ctrl.m_iAxis] = sinf(flHalf);
+
+            // QuaternionSM(1.0, q2, q, q) as in CalcBoneAdj, the adjustment goes on the left
+            Quaternion q{ pose.m_qx[k], pose.m_qy[k], pose.m_qz[k], pose.m_qw[k] };
+            QuaternionMult(q2, q, q);
+            QuaternionNormalize(q);
+
+            pose.m_qx[k] = q.x;
+            pose.m_qy[k] = q.y;
+            pose.m_qz[k] = q.z;
+            pose.m_qw[k] = q.w;
+        }
+    }
+}
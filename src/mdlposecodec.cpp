@@ -0,0 +1,459 @@
+#include "mdlposecodec.h"
+#include "mdlanim.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+
+#define POSECODEC_SMALL_BITS 7 // zigzagged position offsets below 1 << 7 take the short form
+#define POSECODEC_SQRT2 1.41421356237309504880f
+
+namespace
+{
+    // least significant bit first, so a value never straddles more than five bytes
+    class CBitWriter
+    {
+    public:
+        CBitWriter(std::vector<unsigned char>& vecOut) : m_vecOut(vecOut) {}
+
+        void Write(uint32_t iValue, int nBits)
+        {
+            m_iBits |= (uint64_t)iValue << m_nBits;
+            m_nBits += nBits;
+
+            while (m_nBits >= 8)
+            {
+                m_vecOut.push_back((unsigned char)m_iBits);
+                m_iBits >>= 8;
+                m_nBits -= 8;
+            }
+        }
+
+        void Flush()
+        {
+            if (m_nBits > 0)
+                m_vecOut.push_back((unsigned char)m_iBits);
+
+            m_iBits = 0;
+            m_nBits = 0;
+        }
+
+    private:
+        std::vector<unsigned char>& m_vecOut;
+        uint64_t m_iBits = 0;
+        int m_nBits = 0;
+    };
+
+    // reads past the end come back as zero and set the overflow flag
+    class CBitReader
+    {
+    public:
+        CBitReader(const unsigned char* pData, size_t nSize) : m_pData(pData), m_nSize(nSize) {}
+
+        uint32_t Read(int nBits)
+        {
+            while (m_nBits < nBits)
+            {
+                if (m_iByte < m_nSize)
+                    m_iBits |= (uint64_t)m_pData[m_iByte] << m_nBits;
+                else
+                    m_bOverflow = true;
+
+                m_iByte++;
+                m_nBits += 8;
+            }
+
+            uint32_t iValue = (uint32_t)(m_iBits & ((1ull << nBits) - 1));
+            m_iBits >>= nBits;
+            m_nBits -= nBits;
+            return iValue;
+        }
+
+        inline bool Overflow() const { return m_bOverflow; }
+
+    private:
+        const unsigned char* m_pData;
+        size_t m_nSize;
+        size_t m_iByte = 0;
+        uint64_t m_iBits = 0;
+        int m_nBits = 0;
+        bool m_bOverflow = false;
+    };
+
+    inline uint32_t ZigZag(int iValue)
+    {
+        return ((uint32_t)iValue << 1) ^ (uint32_t)(iValue >> 31);
+    }
+
+    inline int UnZigZag(uint32_t iValue)
+    {
+        return (int)(iValue >> 1) ^ -(int)(iValue & 1);
+    }
+
+    // rounds half away from zero and clamps to a short, ready for a truncating cast
+    inline fltx4 RoundShortSIMD(const fltx4& v)
+    {
+        fltx4 half = OrSIMD(AndSIMD(v, ReplicateX4(-0.0f)), ReplicateX4(0.5f));
+        fltx4 r = AddSIMD(v, half);
+        return MinSIMD(MaxSIMD(r, ReplicateX4(-32768.0f)), ReplicateX4(32767.0f));
+    }
+}
+
+CPoseCodec::CPoseCodec(const CModel& model, int iRotationBits)
+{
+    Init(model, model.GetSkeletonLayout().AllBones(), iRotationBits);
+}
+
+CPoseCodec::CPoseCodec(const CModel& model, const CBoneMask& mask, int iRotationBits)
+{
+    Init(model, mask, iRotationBits);
+}
+
+void CPoseCodec::Init(const CModel& model, const CBoneMask& mask, int iRotationBits)
+{
+    m_iRotationBits = std::clamp(iRotationBits, 1, 10);
+
+    const studiohdr_t* pMdl = model.StudioHdr();
+    if (!pMdl)
+        return;
+
+    model.GetSkeletonLayout().OrderedBones(mask, m_vecBones);
+
+    m_vecBones.erase(std::remove_if(m_vecBones.begin(), m_vecBones.end(), [](int iBone) { return iBone >= POSE_MAX_BONES; }), m_vecBones.end());
+
+    int nBones = (int)m_vecBones.size();
+    int nPadded = (nBones + 3) & ~3;
+
+    for (int j = 0; j < 3; j++)
+    {
+        m_vecBase[j].assign(nPadded, 0.0f);
+        m_vecScale[j].assign(nPadded, 0.0f);
+        m_vecInvScale[j].assign(nPadded, 0.0f);
+    }
+
+    m_vecAxes.assign(nBones, 0);
+
+    for (int i = 0; i < nBones; i++)
+    {
+        const mstudiobone_t* pBone = pMdl->pBone(m_vecBones[i]);
+
+        for (int j = 0; j < 3; j++)
+        {
+            float flScale = (&pBone->posscale.x)[j];
+
+            m_vecBase[j][i] = (&pBone->pos.x)[j];
+
+            if (flScale == 0.0f)
+                continue;
+
+            m_vecScale[j][i] = flScale;
+            m_vecInvScale[j][i] = 1.0f / flScale;
+            m_vecAxes[i] |= 1 << j;
+        }
+    }
+}
+
+void CPoseCodec::Quantize(const CBonePose& pose, CQuantizedPose& out) const
+{
+    int nBones = BoneCount();
+    int nPadded = (nBones + 3) & ~3;
+
+    out.m_vecRotations.resize(nBones);
+    out.m_vecPositions.resize(nBones * 3);
+
+    // the encoded bones gathered together, padding lanes are the identity at the default position
+    alignas(16) float src[7][POSE_MAX_BONES + 4];
+
+    for (int i = 0; i < nPadded; i++)
+    {
+        if (i < nBones)
+        {
+            int iBone = m_vecBones[i];
+
+            src[0][i] = pose.m_qx[iBone];
+            src[1][i] = pose.m_qy[iBone];
+            src[2][i] = pose.m_qz[iBone];
+            src[3][i] = pose.m_qw[iBone];
+            src[4][i] = pose.m_px[iBone];
+            src[5][i] = pose.m_py[iBone];
+            src[6][i] = pose.m_pz[iBone];
+        }
+        else
+        {
+            src[0][i] = src[1][i] = src[2][i] = 0.0f;
+            src[3][i] = 1.0f;
+            src[4][i] = m_vecBase[0][i];
+            src[5][i] = m_vecBase[1][i];
+            src[6][i] = m_vecBase[2][i];
+        }
+    }
+
+    float flMax = (float)((1 << m_iRotationBits) - 1);
+
+    fltx4 one = ReplicateX4(1.0f);
+    fltx4 two = ReplicateX4(2.0f);
+    fltx4 signBit = ReplicateX4(-0.0f);
+
+    // component in [-1/sqrt2, 1/sqrt2] to [0, flMax]
+    fltx4 quantScale = ReplicateX4(0.5f * POSECODEC_SQRT2 * flMax);
+    fltx4 quantBias = ReplicateX4(0.5f * flMax + 0.5f);
+    fltx4 quantMax = ReplicateX4(flMax);
+
+    alignas(16) float quant[7][4];
+
+    for (int i = 0; i < nPadded; i += 4)
+    {
+        fltx4 x = LoadAlignedSIMD(&src[0][i]);
+        fltx4 y = LoadAlignedSIMD(&src[1][i]);
+        fltx4 z = LoadAlignedSIMD(&src[2][i]);
+        fltx4 w = LoadAlignedSIMD(&src[3][i]);
+
+        // largest magnitude component, ties go to the first
+        fltx4 largest = x;
+        fltx4 index = LoadZeroSIMD();
+
+        fltx4 mask = CmpGtSIMD(AbsSIMD(y), AbsSIMD(largest));
+        largest = MaskedAssign(mask, y, largest);
+        index = MaskedAssign(mask, one, index);
+
+        mask = CmpGtSIMD(AbsSIMD(z), AbsSIMD(largest));
+        largest = MaskedAssign(mask, z, largest);
+        index = MaskedAssign(mask, two, index);
+
+        mask = CmpGtSIMD(AbsSIMD(w), AbsSIMD(largest));
+        largest = MaskedAssign(mask, w, largest);
+        index = MaskedAssign(mask, ReplicateX4(3.0f), index);
+
+        // q and -q are the same rotation, flip so the dropped component is positive
+        fltx4 flip = AndSIMD(largest, signBit);
+
+        x = XorSIMD(x, flip);
+        y = XorSIMD(y, flip);
+        z = XorSIMD(z, flip);
+        w = XorSIMD(w, flip);
+
+        fltx4 a = MaskedAssign(CmpEqSIMD(index, LoadZeroSIMD()), y, x);
+        fltx4 b = MaskedAssign(CmpLeSIMD(index, one), z, y);
+        fltx4 c = MaskedAssign(CmpLeSIMD(index, two), w, z);
+
+        a = MinSIMD(MaxSIMD(MaddSIMD(a, quantScale, quantBias), LoadZeroSIMD()), quantMax);
+        b = MinSIMD(MaxSIMD(MaddSIMD(b, quantScale, quantBias), LoadZeroSIMD()), quantMax);
+        c = MinSIMD(MaxSIMD(MaddSIMD(c, quantScale, quantBias), LoadZeroSIMD()), quantMax);
+
+        StoreAlignedSIMD(quant[0], index);
+        StoreAlignedSIMD(quant[1], a);
+        StoreAlignedSIMD(quant[2], b);
+        StoreAlignedSIMD(quant[3], c);
+
+        for (int j = 0; j < 3; j++)
+        {
+            fltx4 p = SubSIMD(LoadAlignedSIMD(&src[4 + j][i]), LoadUnalignedSIMD(&m_vecBase[j][i]));
+            StoreAlignedSIMD(quant[4 + j], RoundShortSIMD(MulSIMD(p, LoadUnalignedSIMD(&m_vecInvScale[j][i]))));
+        }
+
+        for (int k = 0; k < 4 && i + k < nBones; k++)
+        {
+            out.m_vecRotations[i + k] = ((uint32_t)quant[0][k] << (3 * m_iRotationBits))
+                | ((uint32_t)quant[1][k] << (2 * m_iRotationBits))
+                | ((uint32_t)quant[2][k] << m_iRotationBits)
+                | (uint32_t)quant[3][k];
+
+            for (int j = 0; j < 3; j++)
+                out.m_vecPositions[(i + k) * 3 + j] = (int16_t)(int)quant[4 + j][k];
+        }
+    }
+}
+
+void CPoseCodec::Dequantize(const CQuantizedPose& in, CBonePose& pose) const
+{
+    if (!IsPose(&in))
+        return;
+
+    int nBones = BoneCount();
+
+    float flMax = (float)((1 << m_iRotationBits) - 1);
+    uint32_t iMask = (1u << m_iRotationBits) - 1;
+
+    fltx4 one = ReplicateX4(1.0f);
+    fltx4 two = ReplicateX4(2.0f);
+
+    // [0, flMax] back to [-1/sqrt2, 1/sqrt2]
+    fltx4 dequantScale = ReplicateX4(POSECODEC_SQRT2 / flMax);
+    fltx4 dequantBias = ReplicateX4(-0.5f * POSECODEC_SQRT2);
+
+    alignas(16) float quant[7][4];
+    alignas(16) float dst[7][4];
+
+    for (int i = 0; i < nBones; i += 4)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            // padding lanes decode as whatever, they aren't stored
+            uint32_t iRot = i + k < nBones ? in.m_vecRotations[i + k] : 0;
+
+            quant[0][k] = (float)(iRot >> (3 * m_iRotationBits));
+            quant[1][k] = (float)((iRot >> (2 * m_iRotationBits)) & iMask);
+            quant[2][k] = (float)((iRot >> m_iRotationBits) & iMask);
+            quant[3][k] = (float)(iRot & iMask);
+
+            for (int j = 0; j < 3; j++)
+                quant[4 + j][k] = i + k < nBones ? (float)in.m_vecPositions[(i + k) * 3 + j] : 0.0f;
+        }
+
+        fltx4 index = LoadAlignedSIMD(quant[0]);
+        fltx4 a = MaddSIMD(LoadAlignedSIMD(quant[1]), dequantScale, dequantBias);
+        fltx4 b = MaddSIMD(LoadAlignedSIMD(quant[2]), dequantScale, dequantBias);
+        fltx4 c = MaddSIMD(LoadAlignedSIMD(quant[3]), dequantScale, dequantBias);
+
+        fltx4 sum = MaddSIMD(a, a, MaddSIMD(b, b, MulSIMD(c, c)));
+        fltx4 d = SqrtSIMD(MaxSIMD(SubSIMD(one, sum), LoadZeroSIMD()));
+
+        fltx4 is0 = CmpEqSIMD(index, LoadZeroSIMD());
+        fltx4 is1 = CmpEqSIMD(index, one);
+        fltx4 is2 = CmpEqSIMD(index, two);
+
+        fltx4 x = MaskedAssign(is0, d, a);
+        fltx4 y = MaskedAssign(is0, a, MaskedAssign(is1, d, b));
+        fltx4 z = MaskedAssign(CmpLeSIMD(index, one), b, MaskedAssign(is2, d, c));
+        fltx4 w = MaskedAssign(CmpLeSIMD(index, two), c, d);
+
+        // rounding leaves the length a little off one
+        fltx4 inv = ReciprocalSqrtSaturateSIMD(MaddSIMD(x, x, MaddSIMD(y, y, MaddSIMD(z, z, MulSIMD(w, w)))));
+
+        StoreAlignedSIMD(dst[0], MulSIMD(x, inv));
+        StoreAlignedSIMD(dst[1], MulSIMD(y, inv));
+        StoreAlignedSIMD(dst[2], MulSIMD(z, inv));
+        StoreAlignedSIMD(dst[3], MulSIMD(w, inv));
+
+        for (int j = 0; j < 3; j++)
+            StoreAlignedSIMD(dst[4 + j], MaddSIMD(LoadAlignedSIMD(quant[4 + j]), LoadUnalignedSIMD(&m_vecScale[j][i]), LoadUnalignedSIMD(&m_vecBase[j][i])));
+
+        for (int k = 0; k < 4 && i + k < nBones; k++)
+        {
+            int iBone = m_vecBones[i + k];
+
+            pose.m_qx[iBone] = dst[0][k];
+            pose.m_qy[iBone] = dst[1][k];
+            pose.m_qz[iBone] = dst[2][k];
+            pose.m_qw[iBone] = dst[3][k];
+            pose.m_px[iBone] = dst[4][k];
+            pose.m_py[iBone] = dst[5][k];
+            pose.m_pz[iBone] = dst[6][k];
+        }
+    }
+}
+
+void CPoseCodec::Write(const CQuantizedPose& pose, const CQuantizedPose* pBaseline, std::vector<unsigned char>& vecOut) const
+{
+    if (!IsPose(&pose))
+        return;
+
+    bool bDelta = IsPose(pBaseline);
+    int nRotationBits = 2 + 3 * m_iRotationBits;
+
+    CBitWriter writer(vecOut);
+    writer.Write(bDelta ? 1 : 0, 1);
+
+    for (int i = 0, n = BoneCount(); i < n; i++)
+    {
+        uint32_t iRot = pose.m_vecRotations[i];
+        const int16_t* pPos = &pose.m_vecPositions[i * 3];
+
+        if (!bDelta)
+        {
+            writer.Write(iRot, nRotationBits);
+
+            for (int j = 0; j < 3; j++)
+            {
+                if (m_vecAxes[i] & (1 << j))
+                    writer.Write((uint16_t)pPos[j], 16);
+            }
+
+            continue;
+        }
+
+        const int16_t* pBasePos = &pBaseline->m_vecPositions[i * 3];
+
+        bool bRotated = iRot != pBaseline->m_vecRotations[i];
+        writer.Write(bRotated ? 1 : 0, 1);
+
+        if (bRotated)
+            writer.Write(iRot, nRotationBits);
+
+        bool bMoved = pPos[0] != pBasePos[0] || pPos[1] != pBasePos[1] || pPos[2] != pBasePos[2];
+        writer.Write(bMoved ? 1 : 0, 1);
+
+        if (!bMoved)
+            continue;
+
+        for (int j = 0; j < 3; j++)
+        {
+            if (!(m_vecAxes[i] & (1 << j)))
+                continue;
+
+            uint32_t iOffset = ZigZag(pPos[j] - pBasePos[j]);
+            bool bSmall = iOffset < (1u << POSECODEC_SMALL_BITS);
+
+            writer.Write(bSmall ? 1 : 0, 1);
+
+            if (bSmall)
+                writer.Write(iOffset, POSECODEC_SMALL_BITS);
+            else
+                writer.Write((uint16_t)pPos[j], 16);
+        }
+    }
+
+    writer.Flush();
+}
+
+bool CPoseCodec::Read(const unsigned char* pData, size_t nSize, const CQuantizedPose* pBaseline, CQuantizedPose& out) const
+{
+    CBitReader reader(pData, nSize);
+
+    bool bDelta = reader.Read(1) != 0;
+    if (bDelta && !IsPose(pBaseline))
+        return false;
+
+    int nBones = BoneCount();
+    int nRotationBits = 2 + 3 * m_iRotationBits;
+
+    out.m_vecRotations.resize(nBones);
+    out.m_vecPositions.resize(nBones * 3);
+
+    for (int i = 0; i < nBones; i++)
+    {
+        int16_t* pPos = &out.m_vecPositions[i * 3];
+
+        if (!bDelta)
+        {
+            out.m_vecRotations[i] = reader.Read(nRotationBits);
+
+            for (int j = 0; j < 3; j++)
+                pPos[j] = (m_vecAxes[i] & (1 << j)) ? (int16_t)reader.Read(16) : 0;
+
+            continue;
+        }
+
+        const int16_t* pBasePos = &pBaseline->m_vecPositions[i * 3];
+
+        out.m_vecRotations[i] = reader.Read(1) ? reader.Read(nRotationBits) : pBaseline->m_vecRotations[i];
+
+        bool bMoved = reader.Read(1) != 0;
+
+        for (int j = 0; j < 3; j++)
+        {
+            pPos[j] = pBasePos[j];
+
+            if (!bMoved || !(m_vecAxes[i] & (1 << j)))
+                continue;
+
+            if (reader.Read(1))
+                pPos[j] = (int16_t)(pBasePos[j] + UnZigZag(reader.Read(POSECODEC_SMALL_BITS)));
+            else
+                pPos[j] = (int16_t)reader.Read(16);
+        }
+    }
+
+    return !reader.Overflow();
+}
@@ -0,0 +1,469 @@
+#include "mdlprocbone.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define PROC_PARALLEL_EPSILON 1.0e-5f
+
+namespace
+{
+    inline float AcosClamped(float f)
+    {
+        return std::acos(std::min(std::max(f, -1.0f), 1.0f));
+    }
+
+    inline float Normalize(Vector& v)
+    {
+        float flLength = std::sqrt(DotProduct(v, v));
+
+        if (flLength > 0.0f)
+            v *= 1.0f / flLength;
+
+        return flLength;
+    }
+
+    void AxisAngleQuaternion(const Vector& axis, float flAngle, Quaternion& q)
+    {
+        float s = std::sin(flAngle * 0.5f);
+        q.Init(axis.x * s, axis.y * s, axis.z * s, std::cos(flAngle * 0.5f));
+    }
+
+    // any unit vector at a right angle to v
+    Vector Perpendicular(const Vector& v)
+    {
+        Vector axis = std::fabs(v.x) < 0.9f ? CrossProduct(v, Vector(1.0f, 0.0f, 0.0f)) : CrossProduct(v, Vector(0.0f, 1.0f, 0.0f));
+        Normalize(axis);
+        return axis;
+    }
+
+    // bone to world of the control bone relative to its parent
+    void ControlLocal(const matrix3x4_t* pBoneToWorld, int iControl, int iControlParent, matrix3x4_t& out)
+    {
+        if (iControlParent < 0)
+        {
+            out = pBoneToWorld[iControl];
+            return;
+        }
+
+        matrix3x4_t parentInv;
+        MatrixInvert(pBoneToWorld[iControlParent], parentInv);
+        ConcatTransforms(parentInv, pBoneToWorld[iControl], out);
+    }
+
+    void ParentConcat(const matrix3x4_t* pBoneToWorld, int iParent, const matrix3x4_t& local, matrix3x4_t& out)
+    {
+        if (iParent < 0)
+            out = local;
+        else
+            ConcatTransforms(pBoneToWorld[iParent], local, out);
+    }
+}
+
+CProceduralBones::CProceduralBones(const CModel& model)
+{
+    const studiohdr_t* pMdl = model.StudioHdr();
+
+    // the rules are only in the file, see mdlrawdata.h
+    if (!pMdl)
+        return;
+
+    const CSkeletonLayout& layout = model.GetSkeletonLayout();
+    const std::vector<CAttachment>& attachments = model.GetAttachments();
+    int nBones = layout.BoneCount();
+
+    auto ValidBone = [nBones](int iBone) { return iBone >= 0 && iBone < nBones; };
+    auto ParentOf = [&layout, &ValidBone](int iBone) { return ValidBone(iBone) ? layout.Parent(iBone) : -1; };
+
+    for (int i = 0; i < nBones; i++)
+    {
+        const mstudiobone_t* pBone = pMdl->pBone(i);
+        const void* pProc = pBone->pProcedure();
+
+        if (!pProc)
+            continue;
+
+        switch (pBone->proctype)
+        {
+        case STUDIO_PROC_AXISINTERP:
+        {
+            const mstudioaxisinterpbone_t* pAxis = (const mstudioaxisinterpbone_t*)pProc;
+
+            if (!ValidBone(pAxis->control) || pAxis->axis < 0 || pAxis->axis > 2)
+                break;
+
+            CAxisInterpRule rule;
+            rule.m_iBone = i;
+            rule.m_iParent = layout.Parent(i);
+            rule.m_iControl = pAxis->control;
+            rule.m_iControlParent = ParentOf(pAxis->control);
+            rule.m_iAxis = pAxis->axis;
+
+            for (int j = 0; j < 6; j++)
+            {
+                rule.m_pos[j] = pAxis->pos[j];
+                rule.m_quat[j] = pAxis->quat[j];
+            }
+
+            m_vecAxisInterp.push_back(rule);
+            break;
+        }
+        case STUDIO_PROC_QUATINTERP:
+        {
+            const mstudioquatinterpbone_t* pQuat = (const mstudioquatinterpbone_t*)pProc;
+
+            if (!ValidBone(pQuat->control) || pQuat->numtriggers <= 0)
+                break;
+
+            CQuatInterpRule rule;
+            rule.m_iBone = i;
+            rule.m_iParent = layout.Parent(i);
+            rule.m_iControl = pQuat->control;
+            rule.m_iControlParent = ParentOf(pQuat->control);
+            rule.m_iFirstTrigger = (int)m_vecTriggers.size();
+            rule.m_iTriggerCount = pQuat->numtriggers;
+
+            for (int j = 0; j < pQuat->numtriggers; j++)
+            {
+                const mstudioquatinterpinfo_t* pTrigger = pQuat->pTrigger(j);
+                m_vecTriggers.push_back(CQuatTrigger{ pTrigger->inv_tolerance, pTrigger->trigger, pTrigger->pos, pTrigger->quat });
+            }
+
+            m_vecQuatInterp.push_back(rule);
+            break;
+        }
+        case STUDIO_PROC_AIMATBONE:
+        case STUDIO_PROC_AIMATATTACH:
+        {
+            const mstudioaimatbone_t* pAim = (const mstudioaimatbone_t*)pProc;
+
+            if (!ValidBone(pAim->parent))
+                break;
+
+            CAimAtRule rule;
+            rule.m_iBone = i;
+            rule.m_iParent = pAim->parent;
+            rule.m_bAttachment = pBone->proctype == STUDIO_PROC_AIMATATTACH;
+            rule.m_vecAim = pAim->aimvector;
+            rule.m_vecUp = pAim->upvector;
+            rule.m_vecBasePos = pAim->basepos;
+
+            if (rule.m_bAttachment)
+            {
+                if (pAim->aim < 0 || pAim->aim >= (int)attachments.size() || !ValidBone(attachments[pAim->aim].m_iBone))
+                    break;
+
+                rule.m_iAimBone = attachments[pAim->aim].m_iBone;
+                rule.m_matAttachment = attachments[pAim->aim].m_matLocal;
+            }
+            else
+            {
+                if (!ValidBone(pAim->aim))
+                    break;
+
+                rule.m_iAimBone = pAim->aim;
+                SetIdentityMatrix(rule.m_matAttachment);
+            }
+
+            m_vecAimAt.push_back(rule);
+            break;
+        }
+        case STUDIO_PROC_JIGGLE:
+            m_vecJiggleBones.push_back(i);
+            break;
+        }
+    }
+
+    // a rule goes one pass after the latest procedural bone it reads. bones a rule
+    // reads that nothing procedural writes are done by forward kinematics already
+    std::vector<int> vecPass(nBones, -1);
+
+    for (const CAxisInterpRule& rule : m_vecAxisInterp)
+        vecPass[rule.m_iBone] = 0;
+    for (const CQuatInterpRule& rule : m_vecQuatInterp)
+        vecPass[rule.m_iBone] = 0;
+    for (const CAimAtRule& rule : m_vecAimAt)
+        vecPass[rule.m_iBone] = 0;
+
+    auto After = [&vecPass](int iBone, int iPass) { return iBone >= 0 && vecPass[iBone] >= 0 ? std::max(iPass, vecPass[iBone] + 1) : iPass; };
+
+    // a cycle never settles, so give up after as many rounds as there are rules
+    int nRules = RuleCount();
+
+    for (int iRound = 0; iRound < nRules; iRound++)
+    {
+        bool bChanged = false;
+
+        for (const CAxisInterpRule& rule : m_vecAxisInterp)
+        {
+            int iPass = After(rule.m_iControlParent, After(rule.m_iControl, After(rule.m_iParent, 0)));
+            bChanged |= iPass != vecPass[rule.m_iBone];
+            vecPass[rule.m_iBone] = std::min(iPass, nRules);
+        }
+
+        for (const CQuatInterpRule& rule : m_vecQuatInterp)
+        {
+            int iPass = After(rule.m_iControlParent, After(rule.m_iControl, After(rule.m_iParent, 0)));
+            bChanged |= iPass != vecPass[rule.m_iBone];
+            vecPass[rule.m_iBone] = std::min(iPass, nRules);
+        }
+
+        for (const CAimAtRule& rule : m_vecAimAt)
+        {
+            int iPass = After(rule.m_iAimBone, After(rule.m_iParent, 0));
+            bChanged |= iPass != vecPass[rule.m_iBone];
+            vecPass[rule.m_iBone] = std::min(iPass, nRules);
+        }
+
+        if (!bChanged)
+            break;
+    }
+
+    // stable, so rules keep bone order within a pass
+    std::stable_sort(m_vecAxisInterp.begin(), m_vecAxisInterp.end(),
+        [&vecPass](const CAxisInterpRule& a, const CAxisInterpRule& b) { return vecPass[a.m_iBone] < vecPass[b.m_iBone]; });
+    std::stable_sort(m_vecQuatInterp.begin(), m_vecQuatInterp.end(),
+        [&vecPass](const CQuatInterpRule& a, const CQuatInterpRule& b) { return vecPass[a.m_iBone] < vecPass[b.m_iBone]; });
+    std::stable_sort(m_vecAimAt.begin(), m_vecAimAt.end(),
+        [&vecPass](const CAimAtRule& a, const CAimAtRule& b) { return vecPass[a.m_iBone] < vecPass[b.m_iBone]; });
+
+    size_t iAxis = 0, iQuat = 0, iAim = 0;
+
+    for (int iPass = 0; iAxis < m_vecAxisInterp.size() || iQuat < m_vecQuatInterp.size() || iAim < m_vecAimAt.size(); iPass++)
+    {
+        CPass pass;
+
+        pass.m_iAxisInterp[0] = (int)iAxis;
+        while (iAxis < m_vecAxisInterp.size() && vecPass[m_vecAxisInterp[iAxis].m_iBone] == iPass)
+            iAxis++;
+        pass.m_iAxisInterp[1] = (int)iAxis;
+
+        pass.m_iQuatInterp[0] = (int)iQuat;
+        while (iQuat < m_vecQuatInterp.size() && vecPass[m_vecQuatInterp[iQuat].m_iBone] == iPass)
+            iQuat++;
+        pass.m_iQuatInterp[1] = (int)iQuat;
+
+        pass.m_iAimAt[0] = (int)iAim;
+        while (iAim < m_vecAimAt.size() && vecPass[m_vecAimAt[iAim].m_iBone] == iPass)
+            iAim++;
+        pass.m_iAimAt[1] = (int)iAim;
+
+        m_vecPasses.push_back(pass);
+    }
+}
+
+void CProceduralBones::Evaluate(matrix3x4_t* const* ppBoneToWorld, int nEntities) const
+{
+    for (const CPass& pass : m_vecPasses)
+    {
+        EvaluateAxisInterp(pass.m_iAxisInterp[0], pass.m_iAxisInterp[1], ppBoneToWorld, nEntities);
+        EvaluateQuatInterp(pass.m_iQuatInterp[0], pass.m_iQuatInterp[1], ppBoneToWorld, nEntities);
+        EvaluateAimAt(pass.m_iAimAt[0], pass.m_iAimAt[1], ppBoneToWorld, nEntities);
+    }
+}
+
+// blends the six poses by how far the control bone's axis leans along each of its parent's axes
+void CProceduralBones::EvaluateAxisInterp(int iFirst, int iEnd, matrix3x4_t* const* ppBoneToWorld, int nEntities) const
+{
+    for (int i = iFirst; i < iEnd; i++)
+    {
+        const CAxisInterpRule& rule = m_vecAxisInterp[i];
+
+        for (int e = 0; e < nEntities; e++)
+        {
+            matrix3x4_t* pBoneToWorld = ppBoneToWorld[e];
+            const matrix3x4_t& control = pBoneToWorld[rule.m_iControl];
+
+            Vector axis(control[0][rule.m_iAxis], control[1][rule.m_iAxis], control[2][rule.m_iAxis]);
+
+            if (rule.m_iControlParent >= 0)
+            {
+                Vector world = axis;
+                VectorIRotate(world, pBoneToWorld[rule.m_iControlParent], axis);
+            }
+
+            float w[3];
+            int n[3];
+
+            for (int j = 0; j < 3; j++)
+            {
+                w[j] = std::fabs(axis[j]);
+                n[j] = j * 2 + (axis[j] < 0.0f ? 1 : 0);
+            }
+
+            float flTotal = w[0] + w[1] + w[2];
+            if (flTotal <= 0.0f)
+                continue;
+
+            float flScale = 1.0f / flTotal;
+
+            Quaternion q, qt;
+            Vector pos(0.0f);
+            q.Init();
+
+            for (int j = 0; j < 3; j++)
+            {
+                QuaternionAlign(q, rule.m_quat[n[j]], qt);
+
+                float s = w[j] * flScale;
+                q.x += qt.x * s;
+                q.y += qt.y * s;
+                q.z += qt.z * s;
+                q.w += qt.w * s;
+                pos += rule.m_pos[n[j]] * s;
+            }
+
+            QuaternionNormalize(q);
+
+            matrix3x4_t local;
+            QuaternionMatrix(q, pos, local);
+            ParentConcat(pBoneToWorld, rule.m_iParent, local, pBoneToWorld[rule.m_iBone]);
+        }
+    }
+}
+
+// blends the trigger poses by how close the control bone's local rotation is to each trigger
+void CProceduralBones::EvaluateQuatInterp(int iFirst, int iEnd, matrix3x4_t* const* ppBoneToWorld, int nEntities) const
+{
+    std::vector<float> vecWeights;
+
+    for (int i = iFirst; i < iEnd; i++)
+    {
+        const CQuatInterpRule& rule = m_vecQuatInterp[i];
+        const CQuatTrigger* pTriggers = &m_vecTriggers[rule.m_iFirstTrigger];
+
+        vecWeights.resize(rule.m_iTriggerCount);
+
+        for (int e = 0; e < nEntities; e++)
+        {
+            matrix3x4_t* pBoneToWorld = ppBoneToWorld[e];
+
+            matrix3x4_t control;
+            ControlLocal(pBoneToWorld, rule.m_iControl, rule.m_iControlParent, control);
+
+            Quaternion src;
+            MatrixQuaternion(control, src);
+
+            float flTotal = 0.0f;
+
+            for (int j = 0; j < rule.m_iTriggerCount; j++)
+            {
+                const Quaternion& t = pTriggers[j].m_qTrigger;
+                float flDot = std::fabs(t.x * src.x + t.y * src.y + t.z * src.z + t.w * src.w);
+
+                vecWeights[j] = std::max(0.0f, 1.0f - 2.0f * AcosClamped(flDot) * pTriggers[j].m_flInvTolerance);
+                flTotal += vecWeights[j];
+            }
+
+            matrix3x4_t local;
+
+            if (flTotal <= 0.001f)
+            {
+                QuaternionMatrix(pTriggers[0].m_q, pTriggers[0].m_vecPos, local);
+            }
+            else
+            {
+                float flScale = 1.0f / flTotal;
+
+                Quaternion q, qt;
+                Vector pos(0.0f);
+                q.Init();
+
+                for (int j = 0; j < rule.m_iTriggerCount; j++)
+                {
+                    if (vecWeights[j] <= 0.0f)
+                        continue;
+
+                    float s = vecWeights[j] * flScale;
+                    QuaternionAlign(q, pTriggers[j].m_q, qt);
+
+                    q.x += qt.x * s;
+                    q.y += qt.y * s;
+                    q.z += qt.z * s;
+                    q.w += qt.w * s;
+                    pos += pTriggers[j].m_vecPos * s;
+                }
+
+                QuaternionNormalize(q);
+                QuaternionMatrix(q, pos, local);
+            }
+
+            ParentConcat(pBoneToWorld, rule.m_iParent, local, pBoneToWorld[rule.m_iBone]);
+        }
+    }
+}
+
+// turns the bone's aim vector at a bone or attachment, then twists it about that
+// direction so its up vector stays as close as it can to the parent's
+void CProceduralBones::EvaluateAimAt(int iFirst, int iEnd, matrix3x4_t* const* ppBoneToWorld, int nEntities) const
+{
+    for (int i = iFirst; i < iEnd; i++)
+    {
+        const CAimAtRule& rule = m_vecAimAt[i];
+
+        bool bTwist = 1.0f - std::fabs(DotProduct(rule.m_vecUp, rule.m_vecAim)) > PROC_PARALLEL_EPSILON;
+
+        for (int e = 0; e < nEntities; e++)
+        {
+            matrix3x4_t* pBoneToWorld = ppBoneToWorld[e];
+            const matrix3x4_t& parent = pBoneToWorld[rule.m_iParent];
+
+            Vector basePos, aimAtPos;
+            VectorTransform(rule.m_vecBasePos, parent, basePos);
+
+            if (rule.m_bAttachment)
+                VectorTransform(Vector(rule.m_matAttachment[0][3], rule.m_matAttachment[1][3], rule.m_matAttachment[2][3]), pBoneToWorld[rule.m_iAimBone], aimAtPos);
+            else
+                MatrixPosition(pBoneToWorld[rule.m_iAimBone], aimAtPos);
+
+            Vector aim = aimAtPos - basePos;
+            if (Normalize(aim) <= 0.0f)
+                continue;
+
+            float flDot = DotProduct(rule.m_vecAim, aim);
+            Vector axis = CrossProduct(rule.m_vecAim, aim);
+
+            if (Normalize(axis) <= PROC_PARALLEL_EPSILON)
+                axis = Perpendicular(rule.m_vecAim);
+
+            Quaternion qAim;
+            AxisAngleQuaternion(axis, AcosClamped(flDot), qAim);
+
+            Quaternion q = qAim;
+
+            if (bTwist)
+            {
+                matrix3x4_t aimRotation;
+                QuaternionMatrix(qAim, Vector(0.0f), aimRotation);
+
+                // both up vectors flattened onto the plane at a right angle to the aim
+                Vector up, parentUp;
+                VectorRotate(rule.m_vecUp, aimRotation, up);
+                VectorRotate(rule.m_vecUp, parent, parentUp);
+
+                up -= aim * DotProduct(aim, up);
+                parentUp -= aim * DotProduct(aim, parentUp);
+                Normalize(up);
+                Normalize(parentUp);
+
+                float flUpDot = DotProduct(up, parentUp);
+                Vector upAxis = CrossProduct(up, parentUp);
+
+                // facing the other way there's no cross product to turn about, but the aim is always at a right angle
+                if (1.0f - std::fabs(flUpDot) <= PROC_PARALLEL_EPSILON || Normalize(upAxis) <= 0.0f)
+                    upAxis = aim;
+
+                if (flUpDot < 1.0f - PROC_PARALLEL_EPSILON)
+                {
+                    Quaternion qUp;
+                    AxisAngleQuaternion(upAxis, AcosClamped(flUpDot), qUp);
+                    QuaternionMult(qUp, qAim, q);
+                }
+            }
+
+            QuaternionMatrix(q, basePos, pBoneToWorld[rule.m_iBone]);
+        }
+    }
+}
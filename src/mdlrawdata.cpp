@@ -0,0 +1,527 @@
+#include "mdlrawdata.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    // removes byte ranges from a buffer of relative offsets. every offset field
+    // a kept structure holds is registered with the structure it's relative to,
+    // and rewritten against where both ends land once the ranges are gone
+    class CCompactor
+    {
+    public:
+        CCompactor(const std::vector<char>& vecData) : m_vecData(vecData) {}
+
+        inline bool IsValid() const { return m_bValid; }
+
+        // a structure array, remembered so it can be checked against and dropped
+        template<typename T>
+        const T* Array(const void* pBase, int iIndex, int nCount)
+        {
+            int iStart = Offset(pBase) + iIndex;
+
+            if (nCount <= 0)
+                return nullptr;
+
+            if (iIndex == 0 || iStart < 0 || (size_t)iStart + (size_t)nCount * sizeof(T) > m_vecData.size())
+            {
+                m_bValid = false;
+                return nullptr;
+            }
+
+            return (const T*)(m_vecData.data() + iStart);
+        }
+
+        void Drop(const void* pStart, size_t nBytes)
+        {
+            if (nBytes > 0)
+                m_vecDropped.push_back(CRange{ Offset(pStart), Offset(pStart) + (int)nBytes });
+        }
+
+        // pField holds an offset relative to pBase
+        void Relocate(const void* pField, const void* pBase)
+        {
+            m_vecRelocs.push_back(CReloc{ Offset(pField), Offset(pBase) });
+        }
+
+        void Set(const void* pField, int iValue)
+        {
+            m_vecSets.push_back(CReloc{ Offset(pField), iValue });
+        }
+
+        bool Write(std::vector<char>& vecOut)
+        {
+            if (!m_bValid)
+                return false;
+
+            std::sort(m_vecDropped.begin(), m_vecDropped.end(), [](const CRange& a, const CRange& b) { return a.m_iStart < b.m_iStart; });
+
+            // structures never share bytes, overlapping ranges mean the counts are off
+            for (size_t i = 1; i < m_vecDropped.size(); i++)
+            {
+                if (m_vecDropped[i].m_iStart < m_vecDropped[i - 1].m_iEnd)
+                    return false;
+            }
+
+            // structures dropped back to back go as one range
+            std::vector<CRange> vecMerged;
+
+            for (const CRange& range : m_vecDropped)
+            {
+                if (!vecMerged.empty() && vecMerged.back().m_iEnd == range.m_iStart)
+                    vecMerged.back().m_iEnd = range.m_iEnd;
+                else
+                    vecMerged.push_back(range);
+            }
+
+            m_vecDropped.swap(vecMerged);
+
+            // whole 16 byte steps come out, so everything kept stays as aligned as
+            // it was. what's left of a range past the last step is zeroed in place
+            m_vecCut.clear();
+            m_vecRemoved.assign(1, 0);
+
+            for (const CRange& range : m_vecDropped)
+            {
+                m_vecCut.push_back(CRange{ range.m_iStart, range.m_iStart + ((range.m_iEnd - range.m_iStart) & ~15) });
+                m_vecRemoved.push_back(m_vecRemoved.back() + m_vecCut.back().m_iEnd - range.m_iStart);
+            }
+
+            // sized exactly, the point is to hold less
+            std::vector<char> vecData;
+            vecData.reserve(Map((int)m_vecData.size()));
+
+            int iKept = 0;
+            for (const CRange& cut : m_vecCut)
+            {
+                vecData.insert(vecData.end(), m_vecData.begin() + iKept, m_vecData.begin() + cut.m_iStart);
+                iKept = cut.m_iEnd;
+            }
+
+            vecData.insert(vecData.end(), m_vecData.begin() + iKept, m_vecData.end());
+
+            for (size_t i = 0; i < m_vecDropped.size(); i++)
+            {
+                int iTail = m_vecCut[i].m_iEnd;
+                std::memset(vecData.data() + Map(iTail), 0, m_vecDropped[i].m_iEnd - iTail);
+            }
+
+            for (const CReloc& reloc : m_vecRelocs)
+            {
+                int iValue;
+                std::memcpy(&iValue, m_vecData.data() + reloc.m_iField, sizeof(iValue));
+
+                int iTarget = reloc.m_iBase + iValue;
+
+                if (IsDropped(reloc.m_iField))
+                    continue;
+
+                iValue = IsDropped(iTarget) ? 0 : Map(iTarget) - Map(reloc.m_iBase);
+                std::memcpy(vecData.data() + Map(reloc.m_iField), &iValue, sizeof(iValue));
+            }
+
+            for (const CReloc& set : m_vecSets)
+            {
+                if (!IsDropped(set.m_iField))
+                    std::memcpy(vecData.data() + Map(set.m_iField), &set.m_iBase, sizeof(int));
+            }
+
+            vecOut.swap(vecData);
+            return true;
+        }
+
+    private:
+        struct CRange
+        {
+            int m_iStart;
+            int m_iEnd;
+        };
+
+        struct CReloc
+        {
+            int m_iField;
+            int m_iBase; // or the value, for sets
+        };
+
+        const std::vector<char>& m_vecData;
+
+        std::vector<CRange> m_vecDropped{};
+        std::vector<CRange> m_vecCut{}; // the part of each dropped range taken out
+        std::vector<int> m_vecRemoved{}; // bytes removed before each cut
+        std::vector<CReloc> m_vecRelocs{};
+        std::vector<CReloc> m_vecSets{};
+
+        bool m_bValid = true;
+
+        inline int Offset(const void* p) const
+        {
+            return (int)((const char*)p - m_vecData.data());
+        }
+
+        // ranges are sorted and apart by the time these run
+        bool IsDropped(int iOffset) const
+        {
+            auto it = std::upper_bound(m_vecDropped.begin(), m_vecDropped.end(), iOffset, [](int i, const CRange& range) { return i < range.m_iStart; });
+            return it != m_vecDropped.begin() && iOffset < (it - 1)->m_iEnd;
+        }
+
+        // where an offset lands once the cuts before it are gone
+        int Map(int iOffset) const
+        {
+            auto it = std::upper_bound(m_vecCut.begin(), m_vecCut.end(), iOffset, [](int i, const CRange& range) { return i < range.m_iEnd; });
+            return iOffset - m_vecRemoved[it - m_vecCut.begin()];
+        }
+    };
+
+    void CompactBones(CCompactor& compactor, const studiohdr_t* pMdl)
+    {
+        const mstudiobone_t* pBones = compactor.Array<mstudiobone_t>(pMdl, pMdl->boneindex, pMdl->numbones);
+
+        for (int i = 0; pBones && i < pMdl->numbones; i++)
+        {
+            const mstudiobone_t* pBone = &pBones[i];
+
+            compactor.Relocate(&pBone->sznameindex, pBone);
+            compactor.Relocate(&pBone->surfacepropidx, pBone);
+            compactor.Relocate(&pBone->procindex, pBone);
+
+            if (pBone->proctype == STUDIO_PROC_QUATINTERP && pBone->procindex)
+            {
+                const mstudioquatinterpbone_t* pProc = compactor.Array<mstudioquatinterpbone_t>(pBone, pBone->procindex, 1);
+
+                if (pProc)
+                    compactor.Relocate(&pProc->triggerindex, pProc);
+            }
+        }
+    }
+
+    void CompactAnimations(CCompactor& compactor, const studiohdr_t* pMdl)
+    {
+        const mstudioanimdesc_t* pAnims = compactor.Array<mstudioanimdesc_t>(pMdl, pMdl->localanimindex, pMdl->numlocalanim);
+
+        for (int i = 0; pAnims && i < pMdl->numlocalanim; i++)
+        {
+            const mstudioanimdesc_t* pAnim = &pAnims[i];
+
+            compactor.Relocate(&pAnim->baseptr, pAnim);
+            compactor.Relocate(&pAnim->sznameindex, pAnim);
+            compactor.Relocate(&pAnim->movementindex, pAnim);
+            compactor.Relocate(&pAnim->localhierarchyindex, pAnim);
+            compactor.Relocate(&pAnim->zeroframeindex, pAnim);
+
+            // data in .ani blocks is addressed within the block
+            if (pAnim->animblock == 0)
+                compactor.Relocate(&pAnim->animindex, pAnim);
+
+            if (pAnim->sectionframes != 0 && pAnim->sectionindex)
+            {
+                int nSections = pAnim->numframes / pAnim->sectionframes + 2;
+                const mstudioanimsections_t* pSections = compactor.Array<mstudioanimsections_t>(pAnim, pAnim->sectionindex, nSections);
+
+                compactor.Relocate(&pAnim->sectionindex, pAnim);
+
+                for (int j = 0; pSections && j < nSections; j++)
+                {
+                    if (pSections[j].animblock == 0)
+                        compactor.Relocate(&pSections[j].animindex, pAnim);
+                }
+            }
+
+            if (pAnim->ikruleindex)
+            {
+                const mstudioikrule_t* pRules = compactor.Array<mstudioikrule_t>(pAnim, pAnim->ikruleindex, pAnim->numikrules);
+
+                compactor.Relocate(&pAnim->ikruleindex, pAnim);
+
+                for (int j = 0; pRules && j < pAnim->numikrules; j++)
+                {
+                    compactor.Relocate(&pRules[j].compressedikerrorindex, &pRules[j]);
+                    compactor.Relocate(&pRules[j].ikerrorindex, &pRules[j]);
+                    compactor.Relocate(&pRules[j].szattachmentindex, &pRules[j]);
+                }
+            }
+        }
+    }
+
+    void CompactSequences(CCompactor& compactor, const studiohdr_t* pMdl)
+    {
+        const mstudioseqdesc_t* pSeqs = compactor.Array<mstudioseqdesc_t>(pMdl, pMdl->localseqindex, pMdl->numlocalseq);
+
+        for (int i = 0; pSeqs && i < pMdl->numlocalseq; i++)
+        {
+            const mstudioseqdesc_t* pSeq = &pSeqs[i];
+
+            compactor.Relocate(&pSeq->baseptr, pSeq);
+            compactor.Relocate(&pSeq->szlabelindex, pSeq);
+            compactor.Relocate(&pSeq->szactivitynameindex, pSeq);
+            compactor.Relocate(&pSeq->eventindex, pSeq);
+            compactor.Relocate(&pSeq->animindexindex, pSeq);
+            compactor.Relocate(&pSeq->movementindex, pSeq);
+            compactor.Relocate(&pSeq->autolayerindex, pSeq);
+            compactor.Relocate(&pSeq->weightlistindex, pSeq);
+            compactor.Relocate(&pSeq->posekeyindex, pSeq);
+            compactor.Relocate(&pSeq->iklockindex, pSeq);
+            compactor.Relocate(&pSeq->keyvalueindex, pSeq);
+            compactor.Relocate(&pSeq->activitymodifierindex, pSeq);
+
+            const mstudioevent_t* pEvents = compactor.Array<mstudioevent_t>(pSeq, pSeq->eventindex, pSeq->numevents);
+
+            for (int j = 0; pEvents && j < pSeq->numevents; j++)
+                compactor.Relocate(&pEvents[j].szeventindex, &pEvents[j]);
+
+            const mstudioactivitymodifier_t* pModifiers = compactor.Array<mstudioactivitymodifier_t>(pSeq, pSeq->activitymodifierindex, pSeq->numactivitymodifiers);
+
+            for (int j = 0; pModifiers && j < pSeq->numactivitymodifiers; j++)
+                compactor.Relocate(&pModifiers[j].sznameindex, &pModifiers[j]);
+        }
+    }
+
+    // body parts are kept down to their meshes, only the vertex animation goes
+    void CompactBodyParts(CCompactor& compactor, const studiohdr_t* pMdl)
+    {
+        const mstudiobodyparts_t* pParts = compactor.Array<mstudiobodyparts_t>(pMdl, pMdl->bodypartindex, pMdl->numbodyparts);
+
+        for (int i = 0; pParts && i < pMdl->numbodyparts; i++)
+        {
+            const mstudiobodyparts_t* pPart = &pParts[i];
+
+            compactor.Relocate(&pPart->sznameindex, pPart);
+            compactor.Relocate(&pPart->modelindex, pPart);
+
+            const mstudiomodel_t* pModels = compactor.Array<mstudiomodel_t>(pPart, pPart->modelindex, pPart->nummodels);
+
+            for (int j = 0; pModels && j < pPart->nummodels; j++)
+            {
+                const mstudiomodel_t* pModel = &pModels[j];
+
+                compactor.Relocate(&pModel->meshindex, pModel);
+                compactor.Relocate(&pModel->eyeballindex, pModel);
+                compactor.Relocate(&pModel->attachmentindex, pModel);
+
+                const mstudioeyeball_t* pEyes = compactor.Array<mstudioeyeball_t>(pModel, pModel->eyeballindex, pModel->numeyeballs);
+
+                for (int k = 0; pEyes && k < pModel->numeyeballs; k++)
+                    compactor.Relocate(&pEyes[k].sznameindex, &pEyes[k]);
+
+                const mstudiomesh_t* pMeshes = compactor.Array<mstudiomesh_t>(pModel, pModel->meshindex, pModel->nummeshes);
+
+                for (int k = 0; pMeshes && k < pModel->nummeshes; k++)
+                {
+                    const mstudiomesh_t* pMesh = &pMeshes[k];
+
+                    compactor.Relocate(&pMesh->modelindex, pMesh);
+
+                    const mstudioflex_t* pFlexes = compactor.Array<mstudioflex_t>(pMesh, pMesh->flexindex, pMesh->numflexes);
+
+                    for (int f = 0; pFlexes && f < pMesh->numflexes; f++)
+                    {
+                        const mstudioflex_t* pFlex = &pFlexes[f];
+                        size_t nSize = pFlex->vertanimtype == STUDIO_VERT_ANIM_NORMAL ? sizeof(mstudiovertanim_t) : sizeof(mstudiovertanim_wrinkle_t);
+
+                        if (compactor.Array<char>(pFlex, pFlex->vertindex, (int)(pFlex->numverts * nSize)))
+                            compactor.Drop((const char*)pFlex + pFlex->vertindex, pFlex->numverts * nSize);
+                    }
+
+                    if (pFlexes)
+                        compactor.Drop(pFlexes, pMesh->numflexes * sizeof(mstudioflex_t));
+
+                    compactor.Set(&pMesh->numflexes, 0);
+                    compactor.Set(&pMesh->flexindex, 0);
+                }
+            }
+        }
+    }
+
+    // the studiohdr2 extension and its tables, which nothing here reads
+    void DropExtension(CCompactor& compactor, const studiohdr_t* pMdl)
+    {
+        const studiohdr2_t* pHdr2 = pMdl->studiohdr2index ? compactor.Array<studiohdr2_t>(pMdl, pMdl->studiohdr2index, 1) : nullptr;
+
+        if (!pHdr2)
+            return;
+
+        if (auto pTransforms = compactor.Array<mstudiosrcbonetransform_t>(pHdr2, pHdr2->srcbonetransformindex, pHdr2->numsrcbonetransform))
+            compactor.Drop(pTransforms, pHdr2->numsrcbonetransform * sizeof(mstudiosrcbonetransform_t));
+
+        if (auto pLinear = pHdr2->linearboneindex ? compactor.Array<mstudiolinearbone_t>(pHdr2, pHdr2->linearboneindex, 1) : nullptr)
+        {
+            const std::pair<int, size_t> arrays[] = {
+                { pLinear->flagsindex, sizeof(int) },
+                { pLinear->parentindex, sizeof(int) },
+                { pLinear->posindex, sizeof(Vector) },
+                { pLinear->quatindex, sizeof(Quaternion) },
+                { pLinear->rotindex, sizeof(RadianEuler) },
+                { pLinear->posetoboneindex, sizeof(matrix3x4_t) },
+                { pLinear->posscaleindex, sizeof(Vector) },
+                { pLinear->rotscaleindex, sizeof(Vector) },
+                { pLinear->qalignmentindex, sizeof(Quaternion) },
+            };
+
+            // not every field is written, those left out are at 0
+            for (const auto& array : arrays)
+            {
+                if (array.first && compactor.Array<char>(pLinear, array.first, (int)(pLinear->numbones * array.second)))
+                    compactor.Drop((const char*)pLinear + array.first, pLinear->numbones * array.second);
+            }
+
+            compactor.Drop(pLinear, sizeof(mstudiolinearbone_t));
+        }
+
+        if (auto pDrivers = compactor.Array<mstudioboneflexdriver_t>(pHdr2, pHdr2->m_nBoneFlexDriverIndex, pHdr2->m_nBoneFlexDriverCount))
+        {
+            for (int i = 0; i < pHdr2->m_nBoneFlexDriverCount; i++)
+            {
+                if (auto pControls = compactor.Array<mstudioboneflexdrivercontrol_t>(&pDrivers[i], pDrivers[i].m_nControlIndex, pDrivers[i].m_nControlCount))
+                    compactor.Drop(pControls, pDrivers[i].m_nControlCount * sizeof(mstudioboneflexdrivercontrol_t));
+            }
+
+            compactor.Drop(pDrivers, pHdr2->m_nBoneFlexDriverCount * sizeof(mstudioboneflexdriver_t));
+        }
+
+        compactor.Drop(pHdr2, sizeof(studiohdr2_t));
+        compactor.Set(&pMdl->studiohdr2index, 0);
+    }
+
+    // sections decoded into CModel at load, dropped with the header's reference to them
+    void DropDecoded(CCompactor& compactor, const studiohdr_t* pMdl)
+    {
+        if (auto pTextures = compactor.Array<mstudiotexture_t>(pMdl, pMdl->textureindex, pMdl->numtextures))
+            compactor.Drop(pTextures, pMdl->numtextures * sizeof(mstudiotexture_t));
+
+        if (auto pCdTextures = compactor.Array<int>(pMdl, pMdl->cdtextureindex, pMdl->numcdtextures))
+            compactor.Drop(pCdTextures, pMdl->numcdtextures * sizeof(int));
+
+        if (auto pSkins = compactor.Array<short>(pMdl, pMdl->skinindex, pMdl->numskinref * pMdl->numskinfamilies))
+            compactor.Drop(pSkins, pMdl->numskinref * pMdl->numskinfamilies * sizeof(short));
+
+        if (auto pControllers = compactor.Array<mstudiobonecontroller_t>(pMdl, pMdl->bonecontrollerindex, pMdl->numbonecontrollers))
+            compactor.Drop(pControllers, pMdl->numbonecontrollers * sizeof(mstudiobonecontroller_t));
+
+        if (auto pSets = compactor.Array<mstudiohitboxset_t>(pMdl, pMdl->hitboxsetindex, pMdl->numhitboxsets))
+        {
+            for (int i = 0; i < pMdl->numhitboxsets; i++)
+            {
+                if (auto pBoxes = compactor.Array<mstudiobbox_t>(&pSets[i], pSets[i].hitboxindex, pSets[i].numhitboxes))
+                    compactor.Drop(pBoxes, pSets[i].numhitboxes * sizeof(mstudiobbox_t));
+            }
+
+            compactor.Drop(pSets, pMdl->numhitboxsets * sizeof(mstudiohitboxset_t));
+        }
+
+        if (auto pDescs = compactor.Array<mstudioflexdesc_t>(pMdl, pMdl->flexdescindex, pMdl->numflexdesc))
+            compactor.Drop(pDescs, pMdl->numflexdesc * sizeof(mstudioflexdesc_t));
+
+        if (auto pControllers = compactor.Array<mstudioflexcontroller_t>(pMdl, pMdl->flexcontrollerindex, pMdl->numflexcontrollers))
+            compactor.Drop(pControllers, pMdl->numflexcontrollers * sizeof(mstudioflexcontroller_t));
+
+        if (auto pRules = compactor.Array<mstudioflexrule_t>(pMdl, pMdl->flexruleindex, pMdl->numflexrules))
+        {
+            for (int i = 0; i < pMdl->numflexrules; i++)
+            {
+                if (auto pOps = compactor.Array<mstudioflexop_t>(&pRules[i], pRules[i].opindex, pRules[i].numops))
+                    compactor.Drop(pOps, pRules[i].numops * sizeof(mstudioflexop_t));
+            }
+
+            compactor.Drop(pRules, pMdl->numflexrules * sizeof(mstudioflexrule_t));
+        }
+
+        if (auto pUIs = compactor.Array<mstudioflexcontrollerui_t>(pMdl, pMdl->flexcontrolleruiindex, pMdl->numflexcontrollerui))
+            compactor.Drop(pUIs, pMdl->numflexcontrollerui * sizeof(mstudioflexcontrollerui_t));
+
+        const int* pCounts[] = { &pMdl->numtextures, &pMdl->numcdtextures, &pMdl->numskinref, &pMdl->numskinfamilies, &pMdl->numbonecontrollers,
+            &pMdl->numhitboxsets, &pMdl->numflexdesc, &pMdl->numflexcontrollers, &pMdl->numflexrules, &pMdl->numflexcontrollerui };
+
+        const int* pIndices[] = { &pMdl->textureindex, &pMdl->cdtextureindex, &pMdl->skinindex, &pMdl->bonecontrollerindex,
+            &pMdl->hitboxsetindex, &pMdl->flexdescindex, &pMdl->flexcontrollerindex, &pMdl->flexruleindex, &pMdl->flexcontrolleruiindex };
+
+        for (const int* pCount : pCounts)
+            compactor.Set(pCount, 0);
+
+        for (const int* pIndex : pIndices)
+            compactor.Set(pIndex, 0);
+    }
+}
+
+bool Studio_CompactRawData(const std::vector<char>& vecIn, std::vector<char>& vecOut)
+{
+    if (vecIn.size() < sizeof(studiohdr_t))
+        return false;
+
+    const studiohdr_t* pMdl = (const studiohdr_t*)vecIn.data();
+
+    CCompactor compactor(vecIn);
+
+    compactor.Relocate(&pMdl->boneindex, pMdl);
+    compactor.Relocate(&pMdl->localanimindex, pMdl);
+    compactor.Relocate(&pMdl->localseqindex, pMdl);
+    compactor.Relocate(&pMdl->bodypartindex, pMdl);
+    compactor.Relocate(&pMdl->localattachmentindex, pMdl);
+    compactor.Relocate(&pMdl->localnodeindex, pMdl);
+    compactor.Relocate(&pMdl->localnodenameindex, pMdl);
+    compactor.Relocate(&pMdl->ikchainindex, pMdl);
+    compactor.Relocate(&pMdl->mouthindex, pMdl);
+    compactor.Relocate(&pMdl->localposeparamindex, pMdl);
+    compactor.Relocate(&pMdl->surfacepropindex, pMdl);
+    compactor.Relocate(&pMdl->keyvalueindex, pMdl);
+    compactor.Relocate(&pMdl->localikautoplaylockindex, pMdl);
+    compactor.Relocate(&pMdl->includemodelindex, pMdl);
+    compactor.Relocate(&pMdl->szanimblocknameindex, pMdl);
+    compactor.Relocate(&pMdl->animblockindex, pMdl);
+    compactor.Relocate(&pMdl->bonetablebynameindex, pMdl);
+
+    // node names are a table of header relative offsets
+    if (const int* pNames = compactor.Array<int>(pMdl, pMdl->localnodenameindex, pMdl->numlocalnodes))
+    {
+        for (int i = 0; i < pMdl->numlocalnodes; i++)
+            compactor.Relocate(&pNames[i], pMdl);
+    }
+
+    if (auto pIncludes = compactor.Array<mstudiomodelgroup_t>(pMdl, pMdl->includemodelindex, pMdl->numincludemodels))
+    {
+        for (int i = 0; i < pMdl->numincludemodels; i++)
+        {
+            compactor.Relocate(&pIncludes[i].szlabelindex, &pIncludes[i]);
+            compactor.Relocate(&pIncludes[i].sznameindex, &pIncludes[i]);
+        }
+    }
+
+    if (auto pAttachments = compactor.Array<mstudioattachment_t>(pMdl, pMdl->localattachmentindex, pMdl->numlocalattachments))
+    {
+        for (int i = 0; i < pMdl->numlocalattachments; i++)
+            compactor.Relocate(&pAttachments[i].sznameindex, &pAttachments[i]);
+    }
+
+    if (auto pParams = compactor.Array<mstudioposeparamdesc_t>(pMdl, pMdl->localposeparamindex, pMdl->numlocalposeparameters))
+    {
+        for (int i = 0; i < pMdl->numlocalposeparameters; i++)
+            compactor.Relocate(&pParams[i].sznameindex, &pParams[i]);
+    }
+
+    if (auto pChains = compactor.Array<mstudioikchain_t>(pMdl, pMdl->ikchainindex, pMdl->numikchains))
+    {
+        for (int i = 0; i < pMdl->numikchains; i++)
+        {
+            compactor.Relocate(&pChains[i].sznameindex, &pChains[i]);
+            compactor.Relocate(&pChains[i].linkindex, &pChains[i]);
+        }
+    }
+
+    CompactBones(compactor, pMdl);
+    CompactAnimations(compactor, pMdl);
+    CompactSequences(compactor, pMdl);
+    CompactBodyParts(compactor, pMdl);
+    DropDecoded(compactor, pMdl);
+    DropExtension(compactor, pMdl);
+
+    std::vector<char> vecData;
+    if (!compactor.Write(vecData))
+        return false;
+
+    ((studiohdr_t*)vecData.data())->length = (int)vecData.size();
+
+    vecOut.swap(vecData);
+    return true;
+}
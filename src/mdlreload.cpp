@@ -0,0 +1,490 @@
+#include "mdlreload.h"
+#include "mdlfile.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // the header fields up to length, false if the file is shorter than length says,
+    // as it is while it's still being written
+    bool ReadHeader(const std::string& filename, int& iChecksum, int& iLength)
+    {
+        std::ifstream file(filename, std::ifstream::binary | std::ifstream::ate);
+
+        if (!file.is_open())
+            return false;
+
+        std::streamoff nSize = file.tellg();
+
+        char header[offsetof(studiohdr_t, length) + sizeof(int)];
+
+        file.seekg(0);
+        if (!file.read(header, sizeof(header)))
+            return false;
+
+        iChecksum = ((const studiohdr_t*)header)->checksum;
+        iLength = ((const studiohdr_t*)header)->length;
+
+        return iLength >= (int)sizeof(header) && iLength <= nSize;
+    }
+
+    // companions are named after the model: x.vvd, x.dx90.vtx, x.phy, x.ani
+    bool IsCompanion(const std::string& strStem, const std::string& strName)
+    {
+        return strName.size() > strStem.size() + 1 && strName.compare(0, strStem.size(), strStem) == 0 && strName[strStem.size()] == '.';
+    }
+
+#ifndef __linux__
+    int64_t WriteTime(const std::filesystem::path& path)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(path, ec);
+        return ec ? 0 : (int64_t)time.time_since_epoch().count();
+    }
+
+    struct CFileTime
+    {
+        std::string m_strDirectory;
+        std::string m_strName;
+        std::string m_strPath;
+        int64_t m_nTime;
+    };
+
+    void ListWriteTimes(const std::string& strDirectory, std::vector<CFileTime>& vecTimes)
+    {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(strDirectory, ec))
+            vecTimes.push_back(CFileTime{ strDirectory, entry.path().filename().string(), entry.path().string(), WriteTime(entry.path()) });
+    }
+#endif
+}
+
+CModelReloader::CModelReloader(RawDataPolicy_t iRawDataPolicy) : m_iRawDataPolicy(iRawDataPolicy)
+{
+#ifdef __linux__
+    m_iNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+CModelReloader::~CModelReloader()
+{
+    Stop();
+
+#ifdef __linux__
+    if (m_iNotify >= 0)
+        close(m_iNotify);
+#endif
+}
+
+std::shared_ptr<const CWatchedModel> CModelReloader::Watch(const std::string& filename)
+{
+    std::string strKey = CanonicalPath(filename);
+    std::string strDirectory = std::filesystem::path(strKey).parent_path().string();
+
+    bool bFirst;
+
+    // the directory is watched before the file is read, so a write landing while
+    // it's loaded is seen, either as a change or by the header check below
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto it = m_Models.find(strKey);
+        if (it != m_Models.end())
+            return it->second;
+
+        bFirst = WatchDirectory(strDirectory);
+    }
+
+#ifndef __linux__
+    if (bFirst)
+        RecordWriteTimes(strDirectory);
+#else
+    (void)bFirst;
+#endif
+
+    std::shared_ptr<CWatchedModel> pWatched = std::make_shared<CWatchedModel>();
+    std::shared_ptr<const CModel> pModel;
+
+    // header first, a write landing in between only costs another reload
+    if (ReadHeader(strKey, pWatched->m_iChecksum, pWatched->m_iLength))
+        pModel = std::make_shared<CModel>(strKey, m_iRawDataPolicy);
+
+    if (!pModel || pModel->FileName().empty())
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        UnwatchDirectory(strDirectory);
+        return nullptr;
+    }
+
+    std::filesystem::path path(strKey);
+
+    pWatched->m_strFileName = strKey;
+    pWatched->m_strDirectory = strDirectory;
+    pWatched->m_strStem = path.stem().string();
+    pWatched->m_pModel = pModel;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // another thread may have got there first, it holds the directory's watch already
+    auto result = m_Models.emplace(strKey, pWatched);
+
+    if (!result.second)
+    {
+        UnwatchDirectory(strDirectory);
+        return result.first->second;
+    }
+
+    // a change Poll() saw before the model was added was dropped, so the next Poll()
+    // rechecks the model if the file no longer matches what was loaded
+    int iChecksum, iLength;
+
+    if (!ReadHeader(strKey, iChecksum, iLength) || iChecksum != pWatched->m_iChecksum || iLength != pWatched->m_iLength)
+        m_vecRechecks.push_back(pWatched);
+
+    return pWatched;
+}
+
+void CModelReloader::Unwatch(const std::string& filename)
+{
+    std::string strKey = CanonicalPath(filename);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto it = m_Models.find(strKey);
+    if (it == m_Models.end())
+        return;
+
+    m_vecRechecks.erase(std::remove(m_vecRechecks.begin(), m_vecRechecks.end(), it->second), m_vecRechecks.end());
+
+    UnwatchDirectory(it->second->m_strDirectory);
+    m_Models.erase(it);
+}
+
+std::shared_ptr<const CModel> CModelReloader::Get(const std::string& filename)
+{
+    std::string strKey = CanonicalPath(filename);
+    std::shared_ptr<CWatchedModel> pWatched;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto it = m_Models.find(strKey);
+        if (it == m_Models.end())
+            return nullptr;
+
+        pWatched = it->second;
+    }
+
+    return pWatched->Get();
+}
+
+void CModelReloader::AddListener(ModelReloadFn pfnListener, void* pUser)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_vecListeners.push_back(CListener{ pfnListener, pUser });
+}
+
+void CModelReloader::RemoveListener(ModelReloadFn pfnListener, void* pUser)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_vecListeners.erase(std::remove_if(m_vecListeners.begin(), m_vecListeners.end(),
+        [&](const CListener& listener) { return listener.m_pfnListener == pfnListener && listener.m_pUser == pUser; }), m_vecListeners.end());
+}
+
+int CModelReloader::Poll(int iTimeoutMs)
+{
+    std::lock_guard<std::mutex> pollLock(m_PollMutex);
+
+    std::vector<CChange> vecChanges;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        for (const std::shared_ptr<CWatchedModel>& pWatched : m_vecRechecks)
+            vecChanges.push_back(CChange{ pWatched, pWatched->m_strFileName });
+
+        m_vecRechecks.clear();
+    }
+
+    FindChanges(vecChanges.empty() ? iTimeoutMs : 0, vecChanges);
+
+    int nSwapped = 0;
+
+    for (const CChange& change : vecChanges)
+    {
+        CWatchedModel& watched = *change.m_pWatched;
+
+        if (change.m_strChanged == watched.m_strFileName)
+        {
+            if (!Reload(watched))
+                continue;
+
+            nSwapped++;
+        }
+
+        Notify(watched, change.m_strChanged);
+    }
+
+    return nSwapped;
+}
+
+void CModelReloader::Start()
+{
+    if (m_Thread.joinable())
+        return;
+
+    m_bStop = false;
+    m_Thread = std::thread([this]()
+    {
+        while (!m_bStop)
+            Poll(100);
+    });
+}
+
+void CModelReloader::Stop()
+{
+    m_bStop = true;
+
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+bool CModelReloader::Reload(CWatchedModel& watched)
+{
+    int iChecksum, iLength;
+
+    // half written, the write finishing brings another event
+    if (!ReadHeader(watched.m_strFileName, iChecksum, iLength))
+        return false;
+
+    if (iChecksum == watched.m_iChecksum && iLength == watched.m_iLength)
+    {
+        m_nSkips++;
+        return false;
+    }
+
+    std::shared_ptr<const CModel> pModel = std::make_shared<CModel>(watched.m_strFileName, m_iRawDataPolicy);
+
+    if (pModel->FileName().empty())
+        return false;
+
+    // readers holding the old model keep it until they let go
+    std::atomic_store(&watched.m_pModel, pModel);
+
+    watched.m_iChecksum = iChecksum;
+    watched.m_iLength = iLength;
+
+    m_nReloads++;
+    return true;
+}
+
+void CModelReloader::Notify(const CWatchedModel& watched, const std::string& strChanged)
+{
+    std::vector<CListener> vecListeners;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        vecListeners = m_vecListeners;
+    }
+
+    std::shared_ptr<const CModel> pModel = watched.Get();
+
+    for (const CListener& listener : vecListeners)
+        listener.m_pfnListener(listener.m_pUser, watched.m_strFileName, strChanged, pModel);
+}
+
+// a change to a model or one of its companions, once per file per Poll()
+void CModelReloader::AddChange(const std::string& strDirectory, const std::string& strName, std::vector<CChange>& vecChanges)
+{
+    std::string strChanged = (std::filesystem::path(strDirectory) / strName).string();
+
+    for (const auto& entry : m_Models)
+    {
+        const std::shared_ptr<CWatchedModel>& pWatched = entry.second;
+
+        if (pWatched->m_strDirectory != strDirectory)
+            continue;
+
+        if (strChanged != pWatched->m_strFileName && !IsCompanion(pWatched->m_strStem, strName))
+            continue;
+
+        bool bSeen = std::any_of(vecChanges.begin(), vecChanges.end(),
+            [&](const CChange& change) { return change.m_pWatched == pWatched && change.m_strChanged == strChanged; });
+
+        if (!bSeen)
+            vecChanges.push_back(CChange{ pWatched, strChanged });
+    }
+}
+
+#ifdef __linux__
+
+bool CModelReloader::WatchDirectory(const std::string& strDirectory)
+{
+    auto& directory = m_Directories[strDirectory];
+
+    if (directory.second++ > 0)
+        return false;
+
+    // editors save by writing a new file and renaming it over the old one, so
+    // the directory is watched rather than the files
+    directory.first = m_iNotify >= 0 ? inotify_add_watch(m_iNotify, strDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) : -1;
+    return true;
+}
+
+void CModelReloader::UnwatchDirectory(const std::string& strDirectory)
+{
+    auto it = m_Directories.find(strDirectory);
+
+    if (it == m_Directories.end() || --it->second.second > 0)
+        return;
+
+    if (it->second.first >= 0)
+        inotify_rm_watch(m_iNotify, it->second.first);
+
+    m_Directories.erase(it);
+}
+
+void CModelReloader::FindChanges(int iTimeoutMs, std::vector<CChange>& vecChanges)
+{
+    if (m_iNotify < 0)
+        return;
+
+    pollfd pfd = { m_iNotify, POLLIN, 0 };
+
+    if (poll(&pfd, 1, iTimeoutMs) <= 0)
+        return;
+
+    alignas(inotify_event) char buffer[4096];
+
+    for (;;)
+    {
+        ssize_t nRead = read(m_iNotify, buffer, sizeof(buffer));
+
+        if (nRead <= 0)
+            break;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        for (char* p = buffer; p < buffer + nRead; )
+        {
+            const inotify_event* pEvent = (const inotify_event*)p;
+            p += sizeof(inotify_event) + pEvent->len;
+
+            // the queue overflowed and events were lost, so every model is rechecked.
+            // Reload() skips the ones whose header is unchanged
+            if (pEvent->mask & IN_Q_OVERFLOW)
+            {
+                for (const auto& entry : m_Models)
+                    AddChange(entry.second->m_strDirectory, std::filesystem::path(entry.first).filename().string(), vecChanges);
+
+                continue;
+            }
+
+            if (pEvent->len == 0)
+                continue;
+
+            auto it = std::find_if(m_Directories.begin(), m_Directories.end(),
+                [&](const auto& directory) { return directory.second.first == pEvent->wd; });
+
+            if (it != m_Directories.end())
+                AddChange(it->first, pEvent->name, vecChanges);
+        }
+    }
+}
+
+#else
+
+bool CModelReloader::WatchDirectory(const std::string& strDirectory)
+{
+    // the baseline is taken by Watch() through RecordWriteTimes(), off the lock
+    return m_Directories[strDirectory].second++ == 0;
+}
+
+// what's there now is the baseline, only later writes are changes. times a scan
+// recorded first are newer and kept
+void CModelReloader::RecordWriteTimes(const std::string& strDirectory)
+{
+    std::vector<CFileTime> vecTimes;
+    ListWriteTimes(strDirectory, vecTimes);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (const CFileTime& file : vecTimes)
+        m_WriteTimes.emplace(file.m_strPath, file.m_nTime);
+}
+
+void CModelReloader::UnwatchDirectory(const std::string& strDirectory)
+{
+    auto it = m_Directories.find(strDirectory);
+
+    if (it == m_Directories.end() || --it->second.second > 0)
+        return;
+
+    m_Directories.erase(it);
+
+    for (auto time = m_WriteTimes.begin(); time != m_WriteTimes.end(); )
+    {
+        if (std::filesystem::path(time->first).parent_path().string() == strDirectory)
+            time = m_WriteTimes.erase(time);
+        else
+            ++time;
+    }
+}
+
+// no change notifications, so the watched directories are scanned for newer files.
+// the disk is walked without m_Mutex, Get() and Watch() only wait for the compare
+void CModelReloader::FindChanges(int iTimeoutMs, std::vector<CChange>& vecChanges)
+{
+    auto Scan = [&]()
+    {
+        std::vector<std::string> vecDirectories;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            for (const auto& directory : m_Directories)
+                vecDirectories.push_back(directory.first);
+        }
+
+        std::vector<CFileTime> vecTimes;
+
+        for (const std::string& strDirectory : vecDirectories)
+            ListWriteTimes(strDirectory, vecTimes);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        for (const CFileTime& file : vecTimes)
+        {
+            int64_t& nSeen = m_WriteTimes[file.m_strPath];
+
+            if (file.m_nTime == nSeen)
+                continue;
+
+            nSeen = file.m_nTime;
+            AddChange(file.m_strDirectory, file.m_strName, vecChanges);
+        }
+    };
+
+    Scan();
+
+    if (vecChanges.empty() && iTimeoutMs > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(iTimeoutMs));
+        Scan();
+    }
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "mdlskeleton.h"
+#include "mdlmemory.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+
+bool CSkeletonLayout::Build(const studiohdr_t* pMdl)
+{
+    m_vecBones.clear();
+    m_vecOrder.clear();
+    m_vecLevels.clear();
+    m_vecHitboxMasks.clear();
+    m_AttachmentMask.reset();
+    m_AllBones.reset();
+
+    if (!pMdl)
+        return false;
+
+    // bones past the mask's size can't be represented, studiomdl never writes them
+    int nBones = std::min(std::max(pMdl->numbones, 0), SKELETON_MAX_BONES);
+
+    m_vecBones.resize(nBones);
+
+    for (int i = 0; i < nBones; i++)
+    {
+        const mstudiobone_t* pBone = pMdl->pBone(i);
+
+        CBoneInfo& bone = m_vecBones[i];
+        bone.m_iParent = (pBone->parent >= 0 && pBone->parent < nBones && pBone->parent != i) ? pBone->parent : -1;
+        bone.m_iDepth = -1;
+        bone.m_iFlags = pBone->flags;
+        bone.m_qRest = pBone->quat;
+        bone.m_vecRest = pBone->pos;
+
+        m_AllBones.set(i);
+    }
+
+    // parents normally come first in the file, but don't rely on it. a bone on a
+    // parent loop is cut loose from it and becomes a root
+    for (int i = 0; i < nBones; i++)
+    {
+        std::vector<int> vecChain;
+
+        int iBone = i;
+        while (iBone >= 0 && m_vecBones[iBone].m_iDepth < 0)
+        {
+            if (std::find(vecChain.begin(), vecChain.end(), iBone) != vecChain.end())
+            {
+                m_vecBones[iBone].m_iParent = -1;
+                m_vecBones[iBone].m_iDepth = 0;
+                break;
+            }
+
+            vecChain.push_back(iBone);
+            iBone = m_vecBones[iBone].m_iParent;
+        }
+
+        for (auto it = vecChain.rbegin(); it != vecChain.rend(); ++it)
+        {
+            int iParent = m_vecBones[*it].m_iParent;
+            m_vecBones[*it].m_iDepth = iParent >= 0 ? m_vecBones[iParent].m_iDepth + 1 : 0;
+        }
+    }
+
+    m_vecOrder.resize(nBones);
+
+    for (int i = 0; i < nBones; i++)
+        m_vecOrder[i] = i;
+
+    std::stable_sort(m_vecOrder.begin(), m_vecOrder.end(),
+        [this](int a, int b) { return m_vecBones[a].m_iDepth < m_vecBones[b].m_iDepth; });
+
+    for (int i = 0; i < nBones; i++)
+    {
+        while ((int)m_vecLevels.size() <= m_vecBones[m_vecOrder[i]].m_iDepth)
+            m_vecLevels.push_back(i);
+    }
+
+    m_vecLevels.push_back(nBones);
+
+    CBoneMask allHitboxes;
+
+    for (int i = 0; i < pMdl->numhitboxsets; i++)
+    {
+        const mstudiohitboxset_t* pSet = pMdl->pHitboxSet(i);
+
+        CBoneMask mask;
+        for (int j = 0; j < pSet->numhitboxes; j++)
+        {
+            int iBone = pSet->pHitbox(j)->bone;
+
+            if (iBone >= 0 && iBone < nBones)
+                mask.set(iBone);
+        }
+
+        mask = WithAncestors(mask);
+        allHitboxes |= mask;
+
+        m_vecHitboxMasks.push_back(mask);
+    }
+
+    m_vecHitboxMasks.push_back(allHitboxes);
+
+    for (int i = 0; i < pMdl->numlocalattachments; i++)
+    {
+        int iBone = pMdl->pLocalAttachment(i)->localbone;
+
+        if (iBone >= 0 && iBone < nBones)
+            m_AttachmentMask.set(iBone);
+    }
+
+    m_AttachmentMask = WithAncestors(m_AttachmentMask);
+
+    return true;
+}
+
+CBoneMask CSkeletonLayout::HitboxMask(int iSet) const
+{
+    if (m_vecHitboxMasks.empty())
+        return CBoneMask();
+
+    if (iSet < 0 || iSet >= (int)m_vecHitboxMasks.size() - 1)
+        return iSet < 0 ? m_vecHitboxMasks.back() : CBoneMask();
+
+    return m_vecHitboxMasks[iSet];
+}
+
+CBoneMask CSkeletonLayout::FlagMask(int iFlags) const
+{
+    CBoneMask mask;
+
+    for (int i = 0; i < BoneCount(); i++)
+    {
+        if (m_vecBones[i].m_iFlags & iFlags)
+            mask.set(i);
+    }
+
+    return WithAncestors(mask);
+}
+
+CBoneMask CSkeletonLayout::WithAncestors(const CBoneMask& mask) const
+{
+    CBoneMask result = mask & m_AllBones;
+
+    // children first, so a parent that gets set here passes it on further up
+    for (auto it = m_vecOrder.rbegin(); it != m_vecOrder.rend(); ++it)
+    {
+        int iParent = m_vecBones[*it].m_iParent;
+
+        if (iParent >= 0 && result.test(*it))
+            result.set(iParent);
+    }
+
+    return result;
+}
+
+void CSkeletonLayout::OrderedBones(const CBoneMask& mask, std::vector<int>& vecBones) const
+{
+    vecBones.clear();
+
+    for (int iBone : m_vecOrder)
+    {
+        if (mask.test(iBone))
+            vecBones.push_back(iBone);
+    }
+}
+
+size_t CSkeletonLayout::MemoryUsage() const
+{
+    return HeapBytes(m_vecBones) + HeapBytes(m_vecOrder) + HeapBytes(m_vecLevels) + HeapBytes(m_vecHitboxMasks);
+}
@@ -0,0 +1,238 @@
+#include "mdlstats.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <thread>
+
+namespace
+{
+    std::mutex g_SinkMutex;
+    LoadTraceFn g_pfnSink = nullptr;
+    void* g_pSinkUser = nullptr;
+
+    // SetLoadTraceSink() bumps the generation, then waits for the clocks of every
+    // older one to go, so the sink it replaced is no longer called when it returns
+    std::condition_variable g_SinkReleased;
+    uint64_t g_iSinkGeneration = 0;
+    std::map<uint64_t, int> g_SinkUsers; // clocks holding a sink, by generation
+
+#ifdef MDL_LOAD_STATS
+    thread_local int64_t g_nAllocs = 0;
+    thread_local int64_t g_nAllocBytes = 0;
+
+    int64_t NowNs()
+    {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+#endif
+
+    // paths are the only strings that go in, and windows ones have backslashes
+    void WriteJsonString(FILE* pFile, const std::string& str)
+    {
+        fputc('"', pFile);
+
+        for (unsigned char c : str)
+        {
+            if (c == '"' || c == '\\')
+                fprintf(pFile, "\\%c", c);
+            else if (c < 0x20)
+                fprintf(pFile, "\\u%04x", c);
+            else
+                fputc(c, pFile);
+        }
+
+        fputc('"', pFile);
+    }
+}
+
+void CountLoadAllocation(size_t nSize)
+{
+#ifdef MDL_LOAD_STATS
+    g_nAllocs++;
+    g_nAllocBytes += nSize;
+#else
+    (void)nSize;
+#endif
+}
+
+#ifdef MDL_LOAD_STATS
+
+CLoadPhaseClock::CLoadPhaseClock(CLoadStats& stats, const std::string& filename) :
+    m_Stats(stats), m_strFileName(filename)
+{
+    std::lock_guard<std::mutex> lock(g_SinkMutex);
+    m_pfnSink = g_pfnSink;
+    m_pSinkUser = g_pSinkUser;
+    m_iSinkGeneration = g_iSinkGeneration;
+
+    if (m_pfnSink)
+        g_SinkUsers[m_iSinkGeneration]++;
+}
+
+CLoadPhaseClock::~CLoadPhaseClock()
+{
+    End();
+
+    if (!m_pfnSink)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_SinkMutex);
+
+    auto it = g_SinkUsers.find(m_iSinkGeneration);
+    if (--it->second == 0)
+    {
+        g_SinkUsers.erase(it);
+        g_SinkReleased.notify_all();
+    }
+}
+
+void CLoadPhaseClock::Next(int iPhase)
+{
+    End();
+
+    m_iPhase = iPhase;
+    m_nStartAllocs = g_nAllocs;
+    m_nStartAllocBytes = g_nAllocBytes;
+    m_nStartNs = NowNs();
+}
+
+void CLoadPhaseClock::End()
+{
+    if (m_iPhase < 0)
+        return;
+
+    int64_t nDuration = NowNs() - m_nStartNs;
+
+    m_Stats.m_nPhaseNs[m_iPhase] += nDuration;
+    m_Stats.m_nPhaseAllocs[m_iPhase] += g_nAllocs - m_nStartAllocs;
+    m_Stats.m_nPhaseAllocBytes[m_iPhase] += g_nAllocBytes - m_nStartAllocBytes;
+
+    if (m_pfnSink)
+        m_pfnSink(m_pSinkUser, m_strFileName, m_iPhase, m_nStartNs, nDuration);
+
+    m_iPhase = -1;
+}
+
+#endif
+
+const char* LoadPhaseName(int iPhase)
+{
+    static const char* s_pszNames[LOADPHASE_COUNT] =
+    {
+        "read", "copy", "textures", "bones", "controllers", "bodyparts", "poseparams",
+        "animations", "sequences", "ik", "hitboxsets", "attachments", "flex", "derived", "compact"
+    };
+
+    return (iPhase >= 0 && iPhase < LOADPHASE_COUNT) ? s_pszNames[iPhase] : "unknown";
+}
+
+int64_t CLoadStats::TotalNs() const
+{
+    int64_t nTotal = 0;
+
+    for (int i = 0; i < LOADPHASE_COUNT; i++)
+        nTotal += m_nPhaseNs[i];
+
+    return nTotal;
+}
+
+int64_t CLoadStats::TotalAllocs() const
+{
+    int64_t nTotal = 0;
+
+    for (int i = 0; i < LOADPHASE_COUNT; i++)
+        nTotal += m_nPhaseAllocs[i];
+
+    return nTotal;
+}
+
+int64_t CLoadStats::TotalAllocBytes() const
+{
+    int64_t nTotal = 0;
+
+    for (int i = 0; i < LOADPHASE_COUNT; i++)
+        nTotal += m_nPhaseAllocBytes[i];
+
+    return nTotal;
+}
+
+CLoadStats& CLoadStats::operator+=(const CLoadStats& other)
+{
+    for (int i = 0; i < LOADPHASE_COUNT; i++)
+    {
+        m_nPhaseNs[i] += other.m_nPhaseNs[i];
+        m_nPhaseAllocs[i] += other.m_nPhaseAllocs[i];
+        m_nPhaseAllocBytes[i] += other.m_nPhaseAllocBytes[i];
+    }
+
+    m_nFileBytes += other.m_nFileBytes;
+    m_nModels += other.m_nModels;
+    return *this;
+}
+
+void SetLoadTraceSink(LoadTraceFn pfnSink, void* pUser)
+{
+    std::unique_lock<std::mutex> lock(g_SinkMutex);
+    g_pfnSink = pfnSink;
+    g_pSinkUser = pUser;
+
+    uint64_t iGeneration = ++g_iSinkGeneration;
+
+    g_SinkReleased.wait(lock, [iGeneration]() { return g_SinkUsers.empty() || g_SinkUsers.begin()->first >= iGeneration; });
+}
+
+CChromeTraceFile::~CChromeTraceFile()
+{
+    Close();
+}
+
+bool CChromeTraceFile::Open(const std::string& filename)
+{
+    Close();
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_pFile = fopen(filename.c_str(), "w");
+    if (!m_pFile)
+        return false;
+
+    fputs("[\n", m_pFile);
+    m_bFirst = true;
+    return true;
+}
+
+void CChromeTraceFile::Close()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (!m_pFile)
+        return;
+
+    fputs("\n]\n", m_pFile);
+    fclose(m_pFile);
+    m_pFile = nullptr;
+}
+
+void CChromeTraceFile::Sink(void* pUser, const std::string& filename, int iPhase, int64_t nStartNs, int64_t nDurationNs)
+{
+    CChromeTraceFile* pTrace = (CChromeTraceFile*)pUser;
+
+    std::lock_guard<std::mutex> lock(pTrace->m_Mutex);
+
+    if (!pTrace->m_pFile)
+        return;
+
+    unsigned long long iThread = (unsigned long long)std::hash<std::thread::id>()(std::this_thread::get_id()) & 0xffffffff;
+
+    // complete events, times in microseconds
+    fprintf(pTrace->m_pFile, "%s{\"name\":\"%s\",\"cat\":\"load\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"file\":",
+        pTrace->m_bFirst ? "" : ",\n", LoadPhaseName(iPhase), iThread, nStartNs / 1000.0, nDurationNs / 1000.0);
+
+    WriteJsonString(pTrace->m_pFile, filename);
+    fputs("}}", pTrace->m_pFile);
+
+    pTrace->m_bFirst = false;
+}
@@ -0,0 +1,119 @@
+#include "mdltransition.h"
+#include "mdlmemory.h"
+#include "valve/studio.h"
+
+bool CTransitionGraph::Build(const studiohdr_t* pMdl)
+{
+    m_iNodeCount = 0;
+    m_vecNodeNames.clear();
+    m_vecSequences.clear();
+    m_vecNextNode.clear();
+    m_vecRoutes.clear();
+
+    if (!pMdl)
+        return false;
+
+    int N = pMdl->numlocalnodes > 0 ? pMdl->numlocalnodes : 0;
+    m_iNodeCount = N;
+
+    for (int i = 0; i < N; i++)
+        m_vecNodeNames.push_back(pMdl->localnodenameindex != 0 ? pMdl->pszLocalNodeName(i) : "");
+
+    for (int i = 0; i < pMdl->numlocalseq; i++)
+    {
+        const mstudioseqdesc_t* pSeqDesc = pMdl->pLocalSeqdesc(i);
+
+        CSequenceNodes seq;
+        seq.m_iEntry = (pSeqDesc->localentrynode >= 1 && pSeqDesc->localentrynode <= N) ? pSeqDesc->localentrynode : 0;
+        seq.m_iExit = (pSeqDesc->localexitnode >= 1 && pSeqDesc->localexitnode <= N) ? pSeqDesc->localexitnode : 0;
+        seq.m_bReversible = pSeqDesc->nodeflags != 0;
+
+        m_vecSequences.push_back(seq);
+    }
+
+    // studiomdl already writes the next node for each pair, anything out of range is treated as unconnected.
+    // pairs it leaves at 0 stay unconnected even when sequences would chain them, the engine's
+    // Studio_FindTransitionSequence jumps straight to the goal for those and so does FindTransition()
+    m_vecNextNode.assign((size_t)N * N, 0);
+
+    if (pMdl->localnodeindex != 0)
+    {
+        for (int i = 0; i < N * N; i++)
+        {
+            int iNext = *pMdl->pLocalTransition(i);
+            m_vecNextNode[i] = iNext <= N ? iNext : 0;
+        }
+    }
+
+    // the sequence that takes each step, looked for in the same order as the engine does
+    m_vecRoutes.assign((size_t)N * N, CRoute{ -1, 1 });
+
+    for (int iFrom = 1; iFrom <= N; iFrom++)
+    {
+        for (int iTo = 1; iTo <= N; iTo++)
+        {
+            int iNext = m_vecNextNode[(iFrom - 1) * N + (iTo - 1)];
+
+            if (iFrom == iTo || iNext == 0)
+                continue;
+
+            CRoute& route = m_vecRoutes[(iFrom - 1) * N + (iTo - 1)];
+
+            for (int i = 0; i < (int)m_vecSequences.size(); i++)
+            {
+                const CSequenceNodes& seq = m_vecSequences[i];
+
+                if (seq.m_iEntry == iFrom && seq.m_iExit == iNext)
+                {
+                    route = CRoute{ i, 1 };
+                    break;
+                }
+
+                if (seq.m_bReversible && seq.m_iExit == iFrom && seq.m_iEntry == iNext)
+                {
+                    route = CRoute{ i, -1 };
+                    break;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+int CTransitionGraph::FindTransition(int iCurrent, int iGoal, int& iDir) const
+{
+    int iGoalNode = EntryNode(iGoal);
+
+    // sequences without nodes blend straight to the goal
+    if (EntryNode(iCurrent) == 0 || iGoalNode == 0)
+    {
+        iDir = 1;
+        return iGoal;
+    }
+
+    int iEndNode = iDir > 0 ? ExitNode(iCurrent) : EntryNode(iCurrent);
+
+    if (iEndNode == iGoalNode)
+    {
+        iDir = 1;
+        return iGoal;
+    }
+
+    if (iEndNode == 0)
+        return iGoal;
+
+    const CRoute& route = m_vecRoutes[(iEndNode - 1) * m_iNodeCount + (iGoalNode - 1)];
+
+    // no step between the two parts of the graph, jump to the goal
+    if (route.m_iSequence < 0)
+        return iGoal;
+
+    iDir = route.m_iDir;
+    return route.m_iSequence;
+}
+
+size_t CTransitionGraph::MemoryUsage() const
+{
+    return HeapBytes(m_vecNodeNames) + HeapBytes(m_vecSequences) + HeapBytes(m_vecNextNode) + HeapBytes(m_vecRoutes);
+}
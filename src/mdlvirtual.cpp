@@ -0,0 +1,324 @@
+#include "mdlvirtual.h"
+#include "mdlanim.h"
+#include "mdlbonemerge.h"
+#include "mdlfile.h"
+#include "mdlobj.h"
+#include "valve/studio.h"
+
+#include <algorithm>
+
+namespace
+{
+    // adds name -> iIndex unless the name is already taken, returns the index the name resolves to
+    int AddName(std::unordered_map<std::string, int>& names, const std::string& strName, int iIndex)
+    {
+        return names.emplace(LowerCase(strName), iIndex).first->second;
+    }
+
+    int FindName(const std::unordered_map<std::string, int>& names, const std::string& strName)
+    {
+        auto it = names.find(LowerCase(strName));
+        return it != names.end() ? it->second : -1;
+    }
+}
+
+std::shared_ptr<const CModel> CModelCache::Load(const std::string& filename)
+{
+    std::string strKey = CanonicalPath(filename);
+
+    std::promise<std::shared_ptr<const CModel>> promise;
+    std::shared_future<std::shared_ptr<const CModel>> future;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto it = m_Models.find(strKey);
+        if (it != m_Models.end())
+            future = it->second;
+        else
+            m_Models.emplace(strKey, promise.get_future().share());
+    }
+
+    // loaded, or being loaded by another thread
+    if (future.valid())
+        return future.get();
+
+    // without the lock, so loads of different models overlap
+    std::shared_ptr<const CModel> pModel = std::make_shared<CModel>(filename);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_LoadStats += pModel->LoadStats();
+    }
+
+    if (!pModel->StudioHdr())
+        pModel = nullptr;
+
+    promise.set_value(pModel);
+    return pModel;
+}
+
+std::shared_ptr<const CModel> CModelCache::LoadInclude(const CModel& model, const std::string& strName)
+{
+    std::string filename = FindGameFile(model.FileName(), strName);
+    return filename.empty() ? nullptr : Load(filename);
+}
+
+const CBoneRemap& CModelCache::BoneRemap(const CModel& model, const CModel& include)
+{
+    std::string strKey = CanonicalPath(model.FileName()) + '\n' + CanonicalPath(include.FileName());
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::unique_ptr<CBoneRemap>& pRemap = m_Remaps[strKey];
+    if (pRemap)
+        return *pRemap;
+
+    pRemap.reset(new CBoneRemap);
+
+    CBoneMerge merge;
+    merge.Build(include.StudioHdr(), model.StudioHdr());
+
+    pRemap->m_vecToMaster = merge.Map();
+    pRemap->m_vecFromMaster.assign(model.StudioHdr() ? model.StudioHdr()->numbones : 0, -1);
+
+    for (int i = 0; i < (int)pRemap->m_vecToMaster.size(); i++)
+    {
+        int iBone = pRemap->m_vecToMaster[i];
+
+        if (iBone >= 0 && pRemap->m_vecFromMaster[iBone] < 0)
+            pRemap->m_vecFromMaster[iBone] = i;
+    }
+
+    return *pRemap;
+}
+
+int CModelCache::ModelCount()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return (int)m_Models.size();
+}
+
+CLoadStats CModelCache::LoadStats()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_LoadStats;
+}
+
+void CModelCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Models.clear();
+    m_Remaps.clear();
+}
+
+CVirtualModel::CVirtualModel(const CModel& model, CModelCache& cache)
+{
+    AddGroup(model, nullptr);
+
+    // breadth first so a model's own includes win over the ones they pull in
+    for (size_t i = 0; i < m_vecGroups.size(); i++)
+    {
+        const CModel& group = *m_vecGroups[i].m_pModel;
+        const studiohdr_t* pMdl = group.StudioHdr();
+
+        if (!pMdl)
+            continue;
+
+        for (int j = 0; j < pMdl->numincludemodels; j++)
+        {
+            std::shared_ptr<const CModel> pInclude = cache.LoadInclude(group, pMdl->pModelGroup(j)->pszName());
+
+            if (!pInclude)
+                continue;
+
+            // includes can include each other, or the model itself
+            std::string strPath = CanonicalPath(pInclude->FileName());
+            bool bSeen = std::any_of(m_vecGroups.begin(), m_vecGroups.end(), [&](const CGroup& g) { return CanonicalPath(g.m_pModel->FileName()) == strPath; });
+            if (bSeen)
+                continue;
+
+            m_vecIncludes.push_back(pInclude);
+            AddGroup(*pInclude, &cache.BoneRemap(model, *pInclude));
+        }
+    }
+}
+
+void CVirtualModel::AddGroup(const CModel& model, const CBoneRemap* pRemap)
+{
+    int iGroup = (int)m_vecGroups.size();
+    bool bMaster = iGroup == 0;
+
+    m_vecGroups.push_back(CGroup{ &model, pRemap });
+    CGroup& group = m_vecGroups.back();
+
+    if (!model.StudioHdr())
+        return;
+
+    const std::vector<CSequence>& sequences = model.GetSequences();
+    const std::vector<CAnimDesc>& anims = model.GetAnimations();
+    const std::vector<CPoseParameter>& params = model.GetPoseParameters();
+
+    for (int i = 0; i < (int)sequences.size(); i++)
+    {
+        int iSequence = AddName(m_SequenceNames, sequences[i].m_strLabel, (int)m_vecSequences.size());
+
+        // the model's own entries always get their own slot so its indices stay valid
+        if (bMaster || iSequence == (int)m_vecSequences.size())
+        {
+            m_vecSequences.push_back(CVirtualIndex{ iGroup, i });
+            continue;
+        }
+
+        if (SequenceDesc(iSequence)->m_iFlags & STUDIO_OVERRIDE)
+            m_vecSequences[iSequence] = CVirtualIndex{ iGroup, i };
+    }
+
+    group.m_vecAnims.resize(anims.size());
+
+    for (int i = 0; i < (int)anims.size(); i++)
+    {
+        int iAnim = AddName(m_AnimNames, anims[i].m_strName, (int)m_vecAnims.size());
+
+        if (bMaster || iAnim == (int)m_vecAnims.size())
+        {
+            iAnim = (int)m_vecAnims.size();
+            m_vecAnims.push_back(CVirtualIndex{ iGroup, i });
+        }
+
+        group.m_vecAnims[i] = iAnim;
+    }
+
+    group.m_vecParams.resize(params.size());
+
+    for (int i = 0; i < (int)params.size(); i++)
+    {
+        int iParam = AddName(m_ParamNames, params[i].m_strName, (int)m_vecParams.size());
+
+        if (bMaster || iParam == (int)m_vecParams.size())
+        {
+            iParam = (int)m_vecParams.size();
+            m_vecParams.push_back(CVirtualIndex{ iGroup, i });
+        }
+
+        group.m_vecParams[i] = iParam;
+    }
+}
+
+const CSequence* CVirtualModel::SequenceDesc(int iSequence) const
+{
+    if (iSequence < 0 || iSequence >= SequenceCount())
+        return nullptr;
+
+    const CVirtualIndex& seq = m_vecSequences[iSequence];
+    return &m_vecGroups[seq.m_iGroup].m_pModel->GetSequences()[seq.m_iIndex];
+}
+
+const CAnimDesc* CVirtualModel::AnimDesc(int iAnim) const
+{
+    if (iAnim < 0 || iAnim >= AnimationCount())
+        return nullptr;
+
+    const CVirtualIndex& anim = m_vecAnims[iAnim];
+    return &m_vecGroups[anim.m_iGroup].m_pModel->GetAnimations()[anim.m_iIndex];
+}
+
+const CPoseParameter* CVirtualModel::PoseParameter(int iParam) const
+{
+    if (iParam < 0 || iParam >= PoseParameterCount())
+        return nullptr;
+
+    const CVirtualIndex& param = m_vecParams[iParam];
+    return &m_vecGroups[param.m_iGroup].m_pModel->GetPoseParameters()[param.m_iIndex];
+}
+
+int CVirtualModel::FindSequence(const std::string& strLabel) const
+{
+    return FindName(m_SequenceNames, strLabel);
+}
+
+int CVirtualModel::FindAnimation(const std::string& strName) const
+{
+    return FindName(m_AnimNames, strName);
+}
+
+int CVirtualModel::FindPoseParameter(const std::string& strName) const
+{
+    return FindName(m_ParamNames, strName);
+}
+
+int CVirtualModel::GroupAnimation(int iGroup, int iAnim) const
+{
+    if (iGroup < 0 || iGroup >= GroupCount())
+        return -1;
+
+    const std::vector<int>& anims = m_vecGroups[iGroup].m_vecAnims;
+    return (iAnim >= 0 && iAnim < (int)anims.size()) ? anims[iAnim] : -1;
+}
+
+int CVirtualModel::GroupPoseParameter(int iGroup, int iParam) const
+{
+    if (iGroup < 0 || iGroup >= GroupCount())
+        return -1;
+
+    const std::vector<int>& params = m_vecGroups[iGroup].m_vecParams;
+    return (iParam >= 0 && iParam < (int)params.size()) ? params[iParam] : -1;
+}
+
+int CVirtualModel::GroupBone(int iGroup, int iBone) const
+{
+    if (iGroup < 0 || iGroup >= GroupCount())
+        return -1;
+
+    const CBoneRemap* pRemap = m_vecGroups[iGroup].m_pBoneRemap;
+
+    if (!pRemap)
+        return (iBone >= 0 && iBone < m_vecGroups[0].m_pModel->GetSkeletonLayout().BoneCount()) ? iBone : -1;
+
+    return (iBone >= 0 && iBone < (int)pRemap->m_vecToMaster.size()) ? pRemap->m_vecToMaster[iBone] : -1;
+}
+
+bool CVirtualModel::CalcAnimation(int iAnim, float flCycle, CBonePose& pose) const
+{
+    const studiohdr_t* pMdl = m_vecGroups[0].m_pModel->StudioHdr();
+
+    if (!pMdl)
+        return false;
+
+    if (iAnim < 0 || iAnim >= AnimationCount())
+    {
+        Studio_InitPose(pMdl, pose);
+        return false;
+    }
+
+    const CVirtualIndex& anim = m_vecAnims[iAnim];
+    const CGroup& group = m_vecGroups[anim.m_iGroup];
+
+    if (!group.m_pBoneRemap)
+        return Studio_CalcAnimation(pMdl, anim.m_iIndex, flCycle, pose);
+
+    CBonePose local;
+    bool bResult = Studio_CalcAnimation(group.m_pModel->StudioHdr(), anim.m_iIndex, flCycle, local);
+
+    Studio_InitPose(pMdl, pose, (AnimDesc(iAnim)->m_iFlags & STUDIO_DELTA) != 0);
+
+    const std::vector<int>& toMaster = group.m_pBoneRemap->m_vecToMaster;
+    int nBones = std::min((int)toMaster.size(), POSE_MAX_BONES);
+
+    for (int i = 0; i < nBones; i++)
+    {
+        int iBone = toMaster[i];
+        if (iBone < 0 || iBone >= POSE_MAX_BONES)
+            continue;
+
+        pose.m_qx[iBone] = local.m_qx[i];
+        pose.m_qy[iBone] = local.m_qy[i];
+        pose.m_qz[iBone] = local.m_qz[i];
+        pose.m_qw[iBone] = local.m_qw[i];
+        pose.m_px[iBone] = local.m_px[i];
+        pose.m_py[iBone] = local.m_py[i];
+        pose.m_pz[iBone] = local.m_pz[i];
+    }
+
+    return bResult;
+}
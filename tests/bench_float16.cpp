@@ -0,0 +1,48 @@
+#include "valve/compressed_vector.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// throughput of each float16 kernel the host can run, over a buffer that fits in L2.
+// only meaningful from an optimized build (CMAKE_BUILD_TYPE=Release)
+int main()
+{
+    const int nCount = 64 * 1024;
+    const int nRepeats = 200;
+
+    std::vector<unsigned short> vecHalves(nCount);
+    std::vector<float> vecFloats(nCount);
+
+    for (int i = 0; i < nCount; i++)
+        vecFloats[i] = (i % 2001 - 1000) * 0.731f;
+
+    ConvertFloat32ToFloat16(vecFloats.data(), vecHalves.data(), nCount);
+
+    const CFloat16Kernel* pKernels;
+    int nKernels = GetFloat16Kernels(&pKernels);
+
+    printf("%-8s %14s %14s\n", "kernel", "half->float", "float->half");
+
+    for (int i = 0; i < nKernels; i++)
+    {
+        auto Time = [&](auto fn)
+        {
+            fn();
+
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < nRepeats; r++)
+                fn();
+
+            double flSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return (double)nCount * nRepeats / flSeconds / 1e6;
+        };
+
+        double flToFloat = Time([&]() { pKernels[i].m_pfnHalfToFloat(vecHalves.data(), vecFloats.data(), nCount); });
+        double flToHalf = Time([&]() { pKernels[i].m_pfnFloatToHalf(vecFloats.data(), vecHalves.data(), nCount); });
+
+        printf("%-8s %9.0f M/s %9.0f M/s\n", pKernels[i].m_pszName, flToFloat, flToHalf);
+    }
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "mdlmath.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// the SoA quaternion and matrix batches against a loop over their scalar forms,
+// at a skeleton sized count. only meaningful from an optimized build (CMAKE_BUILD_TYPE=Release)
+int main()
+{
+    const int nCount = 256;
+    const int nRepeats = 20000;
+
+    std::vector<Quaternion> vecP(nCount), vecQ(nCount), vecOut(nCount);
+    std::vector<float> p[4], q[4], out[4];
+    std::vector<matrix3x4_t> vecIn1(nCount), vecIn2(nCount), vecMatrices(nCount);
+
+    for (int c = 0; c < 4; c++)
+    {
+        p[c].resize(nCount);
+        q[c].resize(nCount);
+        out[c].resize(nCount);
+    }
+
+    for (int i = 0; i < nCount; i++)
+    {
+        vecP[i].Init(sinf(i * 0.37f), cosf(i * 0.11f), sinf(i * 0.73f), 1.0f);
+        vecQ[i].Init(cosf(i * 0.29f), sinf(i * 0.53f), 0.5f, cosf(i * 0.17f));
+        QuaternionNormalize(vecP[i]);
+        QuaternionNormalize(vecQ[i]);
+
+        for (int c = 0; c < 4; c++)
+        {
+            p[c][i] = vecP[i][c];
+            q[c][i] = vecQ[i][c];
+        }
+
+        QuaternionMatrix(vecP[i], Vector((float)i, 1.0f, 2.0f), vecIn1[i]);
+        QuaternionMatrix(vecQ[i], Vector(3.0f, (float)i, 4.0f), vecIn2[i]);
+    }
+
+    CQuaternionSoA soaP = { p[0].data(), p[1].data(), p[2].data(), p[3].data() };
+    CQuaternionSoA soaQ = { q[0].data(), q[1].data(), q[2].data(), q[3].data() };
+    CQuaternionSoA soaOut = { out[0].data(), out[1].data(), out[2].data(), out[3].data() };
+
+    auto Time = [&](auto fn)
+    {
+        fn();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < nRepeats; r++)
+            fn();
+
+        double flSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return flSeconds * 1e9 / ((double)nCount * nRepeats);
+    };
+
+    auto Print = [](const char* pszName, double flScalar, double flBatch)
+    {
+        printf("%-8s %8.2f ns %8.2f ns %6.1fx\n", pszName, flScalar, flBatch, flScalar / flBatch);
+    };
+
+    printf("%-8s %11s %11s\n", "", "scalar", "batch");
+
+    Print("slerp",
+        Time([&]() { for (int i = 0; i < nCount; i++) QuaternionSlerp(vecP[i], vecQ[i], 0.3f, vecOut[i]); }),
+        Time([&]() { QuaternionSlerpSoA(soaP, soaQ, 0.3f, soaOut, nCount); }));
+
+    Print("blend",
+        Time([&]() { for (int i = 0; i < nCount; i++) QuaternionBlend(vecP[i], vecQ[i], 0.3f, vecOut[i]); }),
+        Time([&]() { QuaternionBlendSoA(soaP, soaQ, 0.3f, soaOut, nCount); }));
+
+    Print("mult",
+        Time([&]() { for (int i = 0; i < nCount; i++) QuaternionMult(vecP[i], vecQ[i], vecOut[i]); }),
+        Time([&]() { QuaternionMultSoA(soaP, soaQ, soaOut, nCount); }));
+
+    Print("concat",
+        Time([&]() { for (int i = 0; i < nCount; i++) ConcatTransforms(vecIn1[i], vecIn2[i], vecMatrices[i]); }),
+        Time([&]() { ConcatTransformsBatch(vecIn1.data(), vecIn2.data(), vecMatrices.data(), nCount); }));
+
+    Print("invert",
+        Time([&]() { for (int i = 0; i < nCount; i++) MatrixInvert(vecIn1[i], vecMatrices[i]); }),
+        Time([&]() { MatrixInvertBatch(vecIn1.data(), vecMatrices.data(), nCount); }));
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "testmodel.h"
+
+#include "mdlanim.h"
+#include "mdlobj.h"
+#include "mdlposecodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    // ten bits per smallest three component steps 1.4e-3 apart, half a step off
+    // in each of three components and the fourth rebuilt from them
+    const float ROTATION_TOLERANCE = 2e-3f;
+    const float POSITION_TOLERANCE = 1e-4f;
+
+    int Check(const char* pszName, bool bOk)
+    {
+        printf("%-24s %s\n", pszName, bOk ? "ok" : "FAILED");
+        return bOk ? 0 : 1;
+    }
+
+    bool SameQuantized(const CQuantizedPose& a, const CQuantizedPose& b)
+    {
+        return a.m_vecRotations == b.m_vecRotations && a.m_vecPositions == b.m_vecPositions;
+    }
+
+    // every shorter prefix of a packet runs out before the last field
+    bool TruncationsRefused(const CPoseCodec& codec, const std::vector<unsigned char>& vecPacket, const CQuantizedPose* pBaseline)
+    {
+        for (size_t nSize = 0; nSize < vecPacket.size(); nSize++)
+        {
+            CQuantizedPose out;
+
+            if (codec.Read(vecPacket.data(), nSize, pBaseline, out))
+                return false;
+        }
+
+        return true;
+    }
+
+    // a sampled pose comes back within quantization error, and quantizing it again changes nothing
+    int TestQuantize(const CModel& model, const CPoseCodec& codec)
+    {
+        static CBonePose pose, decoded;
+
+        float flRotError = 0.0f;
+        float flPosError = 0.0f;
+        bool bStable = true;
+
+        for (int iAnim = 0; iAnim < (int)model.GetAnimations().size(); iAnim++)
+        {
+            for (int iStep = 0; iStep <= 8; iStep++)
+            {
+                Studio_InitPose(model.StudioHdr(), pose);
+                Studio_CalcAnimation(model.StudioHdr(), iAnim, iStep / 8.0f, pose);
+
+                CQuantizedPose quantized, requantized;
+                codec.Quantize(pose, quantized);
+                codec.Dequantize(quantized, decoded);
+                codec.Quantize(decoded, requantized);
+
+                bStable = bStable && SameQuantized(quantized, requantized);
+
+                for (int i = 0; i < TestModel::BONES; i++)
+                {
+                    // q and -q are the same rotation
+                    float flSign = pose.m_qx[i] * decoded.m_qx[i] + pose.m_qy[i] * decoded.m_qy[i] + pose.m_qz[i] * decoded.m_qz[i] + pose.m_qw[i] * decoded.m_qw[i] < 0.0f ? -1.0f : 1.0f;
+
+                    flRotError = std::max(flRotError, std::max(std::max(fabsf(pose.m_qx[i] - flSign * decoded.m_qx[i]), fabsf(pose.m_qy[i] - flSign * decoded.m_qy[i])),
+                        std::max(fabsf(pose.m_qz[i] - flSign * decoded.m_qz[i]), fabsf(pose.m_qw[i] - flSign * decoded.m_qw[i]))));
+
+                    flPosError = std::max(flPosError, std::max(std::max(fabsf(pose.m_px[i] - decoded.m_px[i]), fabsf(pose.m_py[i] - decoded.m_py[i])), fabsf(pose.m_pz[i] - decoded.m_pz[i])));
+                }
+            }
+        }
+
+        printf("%-24s max error %.3g (tolerance %.3g)\n", "rotation", flRotError, ROTATION_TOLERANCE);
+        printf("%-24s max error %.3g (tolerance %.3g)\n", "position", flPosError, POSITION_TOLERANCE);
+
+        int nFailed = 0;
+        nFailed += Check("quantized rotations", flRotError <= ROTATION_TOLERANCE);
+        nFailed += Check("quantized positions", flPosError <= POSITION_TOLERANCE);
+        nFailed += Check("requantize stable", bStable);
+        return nFailed;
+    }
+
+    int TestPackets(const CModel& model, const CPoseCodec& codec)
+    {
+        static CBonePose pose;
+
+        Studio_InitPose(model.StudioHdr(), pose);
+        Studio_CalcAnimation(model.StudioHdr(), 0, 0.25f, pose);
+
+        CQuantizedPose baseline;
+        codec.Quantize(pose, baseline);
+
+        // a full snapshot reads back without a baseline
+        std::vector<unsigned char> vecFull;
+        codec.Write(baseline, nullptr, vecFull);
+
+        CQuantizedPose full;
+        bool bFull = codec.Read(vecFull.data(), vecFull.size(), nullptr, full) && SameQuantized(full, baseline);
+
+        // nothing moved, two bits a bone
+        std::vector<unsigned char> vecSame;
+        codec.Write(baseline, &baseline, vecSame);
+
+        CQuantizedPose same;
+        bool bSame = vecSame.size() == (1 + 2 * TestModel::BONES + 7) / 8 && codec.Read(vecSame.data(), vecSame.size(), &baseline, same) &&
+            SameQuantized(same, baseline);
+
+        // another frame, then a small move and a large one on top
+        Studio_CalcAnimation(model.StudioHdr(), 1, 0.75f, pose);
+        pose.m_px[0] += 0.05f;
+        pose.m_py[2] -= 30.0f;
+
+        CQuantizedPose moved;
+        codec.Quantize(pose, moved);
+
+        std::vector<unsigned char> vecDelta;
+        codec.Write(moved, &baseline, vecDelta);
+
+        CQuantizedPose delta;
+        bool bDelta = !SameQuantized(moved, baseline) && vecDelta.size() < vecFull.size() &&
+            codec.Read(vecDelta.data(), vecDelta.size(), &baseline, delta) && SameQuantized(delta, moved);
+
+        // a delta needs the baseline it was written against
+        CQuantizedPose other;
+        CQuantizedPose wrongSize;
+        bool bNoBaseline = !codec.Read(vecDelta.data(), vecDelta.size(), nullptr, other) && !codec.Read(vecDelta.data(), vecDelta.size(), &wrongSize, other);
+
+        int nFailed = 0;
+        nFailed += Check("full packet", bFull);
+        nFailed += Check("unchanged delta", bSame);
+        nFailed += Check("delta packet", bDelta);
+        nFailed += Check("delta without baseline", bNoBaseline);
+        nFailed += Check("truncated full", TruncationsRefused(codec, vecFull, nullptr));
+        nFailed += Check("truncated delta", TruncationsRefused(codec, vecDelta, &baseline));
+        return nFailed;
+    }
+}
+
+int main()
+{
+    CTestModelWriter writer;
+    BuildTestModel(writer);
+
+    if (!writer.Write("test_codec.mdl"))
+    {
+        printf("couldn't write test_codec.mdl\n");
+        return 1;
+    }
+
+    int nFailed = 0;
+
+    {
+        CModel model("test_codec.mdl");
+
+        if (model.StudioHdr())
+        {
+            CPoseCodec codec(model);
+
+            nFailed += Check("bones encoded", codec.BoneCount() == TestModel::BONES);
+            nFailed += TestQuantize(model, codec);
+            nFailed += TestPackets(model, codec);
+        }
+        else
+        {
+            printf("couldn't load test_codec.mdl\n");
+            nFailed++;
+        }
+    }
+
+    remove("test_codec.mdl");
+    return nFailed ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+#include "testmodel.h"
+
+#include "mdlanim.h"
+#include "mdlblend.h"
+#include "mdlobj.h"
+#include "mdlrawdata.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    int Check(const char* pszName, bool bOk)
+    {
+        printf("%-24s %s\n", pszName, bOk ? "ok" : "FAILED");
+        return bOk ? 0 : 1;
+    }
+
+    bool SamePose(const CBonePose& a, const CBonePose& b, int nBones)
+    {
+        for (int i = 0; i < nBones; i++)
+        {
+            if (a.m_qx[i] != b.m_qx[i] || a.m_qy[i] != b.m_qy[i] || a.m_qz[i] != b.m_qz[i] || a.m_qw[i] != b.m_qw[i])
+                return false;
+
+            if (a.m_px[i] != b.m_px[i] || a.m_py[i] != b.m_py[i] || a.m_pz[i] != b.m_pz[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    // the sections compaction drops are gone and the header no longer points at them
+    int TestDropped(const std::vector<char>& vecFile, const std::vector<char>& vecCompact)
+    {
+        const studiohdr_t* pMdl = (const studiohdr_t*)vecCompact.data();
+
+        bool bDropped = pMdl->numtextures == 0 && pMdl->textureindex == 0 && pMdl->numhitboxsets == 0 && pMdl->hitboxsetindex == 0 &&
+            pMdl->numbonecontrollers == 0 && pMdl->bonecontrollerindex == 0 && pMdl->studiohdr2index == 0;
+
+        // everything dropped comes out but the zeroed tails, under 16 bytes per run
+        size_t nDropped = sizeof(mstudiotexture_t) + sizeof(mstudiohitboxset_t) + sizeof(mstudiobbox_t) +
+            TestModel::BONES * sizeof(mstudiobonecontroller_t) + sizeof(studiohdr2_t) + sizeof(mstudiolinearbone_t) +
+            TestModel::BONES * (2 * sizeof(int) + sizeof(Vector) + sizeof(Quaternion));
+
+        size_t nRemoved = vecFile.size() - vecCompact.size();
+
+        int nFailed = 0;
+        nFailed += Check("sections dropped", bDropped);
+        nFailed += Check("length", pMdl->length == (int)vecCompact.size());
+        nFailed += Check("bytes removed", nRemoved > nDropped - 16 * 4 && nRemoved <= nDropped && nRemoved % 16 == 0);
+        return nFailed;
+    }
+
+    // everything kept reads back through the compacted header as it did through the original
+    int TestHeader(const std::vector<char>& vecFile, const std::vector<char>& vecCompact)
+    {
+        const studiohdr_t* pOld = (const studiohdr_t*)vecFile.data();
+        const studiohdr_t* pNew = (const studiohdr_t*)vecCompact.data();
+
+        bool bBones = pOld->numbones == pNew->numbones && pNew->boneindex % 16 == pOld->boneindex % 16;
+
+        for (int i = 0; bBones && i < pOld->numbones; i++)
+        {
+            const mstudiobone_t* pA = pOld->pBone(i);
+            const mstudiobone_t* pB = pNew->pBone(i);
+
+            bBones = strcmp(pA->pszName(), pB->pszName()) == 0 && strcmp(pA->pszSurfaceProp(), pB->pszSurfaceProp()) == 0 &&
+                pA->parent == pB->parent && memcmp(&pA->pos, &pB->pos, sizeof(Vector)) == 0 && memcmp(&pA->quat, &pB->quat, sizeof(Quaternion)) == 0;
+        }
+
+        bBones = bBones && memcmp(pOld->GetBoneTableSortedByName(), pNew->GetBoneTableSortedByName(), pOld->numbones) == 0;
+
+        bool bAnims = pOld->numlocalanim == pNew->numlocalanim;
+
+        for (int i = 0; bAnims && i < pOld->numlocalanim; i++)
+        {
+            const mstudioanimdesc_t* pA = pOld->pLocalAnimdesc(i);
+            const mstudioanimdesc_t* pB = pNew->pLocalAnimdesc(i);
+
+            bAnims = strcmp(pA->pszName(), pB->pszName()) == 0 && pA->numframes == pB->numframes && pA->fps == pB->fps &&
+                (const char*)pB->pStudiohdr() == (const char*)pNew;
+        }
+
+        bool bSequences = pOld->numlocalseq == pNew->numlocalseq;
+
+        for (int i = 0; bSequences && i < pOld->numlocalseq; i++)
+        {
+            const mstudioseqdesc_t* pA = pOld->pLocalSeqdesc(i);
+            const mstudioseqdesc_t* pB = pNew->pLocalSeqdesc(i);
+
+            bSequences = strcmp(pA->pszLabel(), pB->pszLabel()) == 0 && strcmp(pA->pszActivityName(), pB->pszActivityName()) == 0 &&
+                pA->numblends == pB->numblends && memcmp(pA->pBoneweight(0), pB->pBoneweight(0), sizeof(float) * pOld->numbones) == 0;
+
+            for (int j = 0; bSequences && j < pA->numblends; j++)
+                bSequences = pA->anim(j % pA->groupsize[0], j / pA->groupsize[0]) == pB->anim(j % pB->groupsize[0], j / pB->groupsize[0]);
+        }
+
+        bool bParams = pOld->numlocalposeparameters == pNew->numlocalposeparameters &&
+            strcmp(pOld->pLocalPoseParameter(0)->pszName(), pNew->pLocalPoseParameter(0)->pszName()) == 0;
+
+        int nFailed = 0;
+        nFailed += Check("header bones", bBones);
+        nFailed += Check("header animations", bAnims);
+        nFailed += Check("header sequences", bSequences);
+        nFailed += Check("header pose parameters", bParams);
+        return nFailed;
+    }
+
+    // a CModel keeping the compacted copy decodes and samples the same as one keeping the file
+    int TestDecoded(const CModel& full, const CModel& compact)
+    {
+        const CSkeletonLayout& a = full.GetSkeletonLayout();
+        const CSkeletonLayout& b = compact.GetSkeletonLayout();
+
+        bool bSkeleton = a.BoneCount() == b.BoneCount();
+
+        for (int i = 0; bSkeleton && i < a.BoneCount(); i++)
+        {
+            bSkeleton = a.Parent(i) == b.Parent(i) && a.Flags(i) == b.Flags(i) &&
+                memcmp(&a.RestRotation(i), &b.RestRotation(i), sizeof(Quaternion)) == 0 && memcmp(&a.RestPosition(i), &b.RestPosition(i), sizeof(Vector)) == 0;
+        }
+
+        bool bAnims = full.GetAnimations().size() == compact.GetAnimations().size();
+
+        for (size_t i = 0; bAnims && i < full.GetAnimations().size(); i++)
+        {
+            const CAnimDesc& animA = full.GetAnimations()[i];
+            const CAnimDesc& animB = compact.GetAnimations()[i];
+
+            bAnims = animA.m_strName == animB.m_strName && animA.m_iFrameCount == animB.m_iFrameCount && animA.m_flFPS == animB.m_flFPS;
+        }
+
+        bool bSequences = full.GetSequences().size() == compact.GetSequences().size();
+
+        for (size_t i = 0; bSequences && i < full.GetSequences().size(); i++)
+        {
+            const CSequence& seqA = full.GetSequences()[i];
+            const CSequence& seqB = compact.GetSequences()[i];
+
+            bSequences = seqA.m_strLabel == seqB.m_strLabel && seqA.m_vecAnims == seqB.m_vecAnims && seqA.m_vecBoneWeights == seqB.m_vecBoneWeights;
+        }
+
+        bool bMaterials = full.GetMaterials() == compact.GetMaterials() && full.GetHitBoxSets().size() == compact.GetHitBoxSets().size() &&
+            full.GetBoneControllers().size() == compact.GetBoneControllers().size();
+
+        static CBonePose poseA, poseB;
+        bool bSampled = true;
+
+        for (int iAnim = 0; bSampled && iAnim < (int)full.GetAnimations().size(); iAnim++)
+        {
+            for (int iStep = 0; bSampled && iStep <= 8; iStep++)
+            {
+                Studio_InitPose(full.StudioHdr(), poseA);
+                Studio_InitPose(compact.StudioHdr(), poseB);
+
+                bSampled = Studio_CalcAnimation(full.StudioHdr(), iAnim, iStep / 8.0f, poseA) &&
+                    Studio_CalcAnimation(compact.StudioHdr(), iAnim, iStep / 8.0f, poseB) && SamePose(poseA, poseB, a.BoneCount());
+            }
+        }
+
+        CBlendSpace blendA(full), blendB(compact);
+        bool bBlended = blendA.PoseParameterCount() == blendB.PoseParameterCount();
+
+        for (int iStep = 0; bBlended && iStep <= 8; iStep++)
+        {
+            int iSequence = 0;
+            float flCycle = iStep / 8.0f;
+            float flParam = 1.0f - iStep / 4.0f;
+
+            bBlended = blendA.Evaluate(&iSequence, &flCycle, &flParam, 1, &poseA) && blendB.Evaluate(&iSequence, &flCycle, &flParam, 1, &poseB) &&
+                SamePose(poseA, poseB, a.BoneCount());
+        }
+
+        int nFailed = 0;
+        nFailed += Check("model policy", compact.RawDataPolicy() == RAWDATA_COMPACT && compact.GetRawData().size() < full.GetRawData().size());
+        nFailed += Check("model skeleton", bSkeleton);
+        nFailed += Check("model animations", bAnims);
+        nFailed += Check("model sequences", bSequences);
+        nFailed += Check("model decoded sections", bMaterials);
+        nFailed += Check("model sampling", bSampled);
+        nFailed += Check("model blending", bBlended);
+        return nFailed;
+    }
+}
+
+int main()
+{
+    CTestModelWriter writer;
+    BuildTestModel(writer);
+
+    std::vector<char> vecFile = writer.Data();
+    std::vector<char> vecCompact;
+
+    int nFailed = 0;
+
+    if (!Studio_CompactRawData(vecFile, vecCompact))
+    {
+        printf("couldn't compact the test model\n");
+        return 1;
+    }
+
+    nFailed += TestDropped(vecFile, vecCompact);
+    nFailed += TestHeader(vecFile, vecCompact);
+
+    std::vector<char> vecTruncated(vecFile.begin(), vecFile.begin() + vecFile.size() / 2);
+    std::vector<char> vecUntouched(1, 'x');
+    nFailed += Check("truncated file refused", !Studio_CompactRawData(vecTruncated, vecUntouched) && vecUntouched.size() == 1);
+
+    if (!writer.Write("test_compact.mdl"))
+    {
+        printf("couldn't write test_compact.mdl\n");
+        return 1;
+    }
+
+    {
+        CModel full("test_compact.mdl");
+        CModel compact("test_compact.mdl", RAWDATA_COMPACT);
+
+        if (full.StudioHdr() && compact.StudioHdr())
+        {
+            nFailed += TestDecoded(full, compact);
+        }
+        else
+        {
+            printf("couldn't load test_compact.mdl\n");
+            nFailed++;
+        }
+    }
+
+    remove("test_compact.mdl");
+    return nFailed ? 1 : 0;
+}
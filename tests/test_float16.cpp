@@ -0,0 +1,148 @@
+#include "valve/compressed_vector.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // the scalar converters every kernel has to match bit for bit
+    class float16_reference : public float16
+    {
+    public:
+        using float16::Convert16bitFloatTo32bits;
+        using float16::ConvertFloatTo16bits;
+    };
+
+    uint32_t FloatBits(float f)
+    {
+        uint32_t n;
+        std::memcpy(&n, &f, sizeof(n));
+        return n;
+    }
+
+    float BitsFloat(uint32_t n)
+    {
+        float f;
+        std::memcpy(&f, &n, sizeof(f));
+        return f;
+    }
+
+    // every half, all 65536 of them
+    int TestHalfToFloat(const CFloat16Kernel& kernel)
+    {
+        std::vector<unsigned short> vecIn(65536);
+        std::vector<float> vecOut(65536);
+
+        for (int i = 0; i < 65536; i++)
+            vecIn[i] = (unsigned short)i;
+
+        kernel.m_pfnHalfToFloat(vecIn.data(), vecOut.data(), (int)vecIn.size());
+
+        int nErrors = 0;
+
+        for (int i = 0; i < 65536; i++)
+        {
+            uint32_t nExpected = FloatBits(float16_reference::Convert16bitFloatTo32bits(vecIn[i]));
+
+            if (FloatBits(vecOut[i]) != nExpected && nErrors++ < 8)
+                printf("%s half to float: 0x%04x gave 0x%08x, expected 0x%08x\n", kernel.m_pszName, i, FloatBits(vecOut[i]), nExpected);
+        }
+
+        return nErrors;
+    }
+
+    // every half's float and its neighbours, the specials, and a stride through
+    // all 2^32 bit patterns, so every rounding and clamping edge gets hit
+    int TestFloatToHalf(const CFloat16Kernel& kernel)
+    {
+        std::vector<float> vecIn;
+        vecIn.reserve(65536 * 9 + (1 << 22));
+
+        for (int i = 0; i < 65536; i++)
+        {
+            uint32_t nBits = FloatBits(float16_reference::Convert16bitFloatTo32bits((unsigned short)i));
+
+            for (int d = -4; d <= 4; d++)
+                vecIn.push_back(BitsFloat(nBits + d));
+        }
+
+        for (uint64_t n = 0; n < (1ull << 32); n += 1021)
+            vecIn.push_back(BitsFloat((uint32_t)n));
+
+        const uint32_t specials[] = { 0x00000000, 0x80000000, 0x7f800000, 0xff800000, 0x7fc00000, 0xffc00000, 0x7f800001, 0x00000001, 0x80000001, 0x7f7fffff, 0xff7fffff };
+
+        for (uint32_t nBits : specials)
+            vecIn.push_back(BitsFloat(nBits));
+
+        // odd count, so the scalar tail after the vector loop runs too
+        if (vecIn.size() % 2 == 0)
+            vecIn.push_back(1.0f);
+
+        std::vector<unsigned short> vecOut(vecIn.size());
+        kernel.m_pfnFloatToHalf(vecIn.data(), vecOut.data(), (int)vecIn.size());
+
+        int nErrors = 0;
+
+        for (size_t i = 0; i < vecIn.size(); i++)
+        {
+            unsigned short nExpected = float16_reference::ConvertFloatTo16bits(vecIn[i]);
+
+            if (vecOut[i] != nExpected && nErrors++ < 8)
+                printf("%s float to half: 0x%08x gave 0x%04x, expected 0x%04x\n", kernel.m_pszName, FloatBits(vecIn[i]), vecOut[i], nExpected);
+        }
+
+        return nErrors;
+    }
+
+    // the public entry points with every length up to a few vectors and unaligned starts
+    int TestDispatch()
+    {
+        unsigned short halves[64 + 3];
+        float floats[64 + 3];
+        float back[64 + 3];
+
+        for (int i = 0; i < 64 + 3; i++)
+            floats[i] = (i - 30) * 1.37f;
+
+        int nErrors = 0;
+
+        for (int iStart = 0; iStart < 3; iStart++)
+        {
+            for (int n = 0; n <= 64; n++)
+            {
+                ConvertFloat32ToFloat16(floats + iStart, halves + iStart, n);
+                ConvertFloat16ToFloat32(halves + iStart, back + iStart, n);
+
+                for (int i = iStart; i < iStart + n; i++)
+                {
+                    if (halves[i] != float16_reference::ConvertFloatTo16bits(floats[i]) || FloatBits(back[i]) != FloatBits(float16_reference::Convert16bitFloatTo32bits(halves[i])))
+                        nErrors++;
+                }
+            }
+        }
+
+        if (nErrors)
+            printf("dispatch: %d mismatches\n", nErrors);
+
+        return nErrors;
+    }
+}
+
+int main()
+{
+    const CFloat16Kernel* pKernels;
+    int nKernels = GetFloat16Kernels(&pKernels);
+
+    int nErrors = TestDispatch();
+
+    for (int i = 0; i < nKernels; i++)
+    {
+        int nKernelErrors = TestHalfToFloat(pKernels[i]) + TestFloatToHalf(pKernels[i]);
+        printf("%-8s %s\n", pKernels[i].m_pszName, nKernelErrors ? "FAILED" : "ok");
+
+        nErrors += nKernelErrors;
+    }
+
+    return nErrors ? 1 : 0;
+}
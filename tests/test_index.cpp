@@ -0,0 +1,108 @@
+#include "testmodel.h"
+
+#include "mdlindex.h"
+#include "mdlobj.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+    int Check(const char* pszName, bool bOk)
+    {
+        printf("%-30s %s\n", pszName, bOk ? "ok" : "FAILED");
+        return bOk ? 0 : 1;
+    }
+
+    // the names of the models with a term, in index order
+    std::vector<std::string> FindModels(const CModelIndex& index, IndexTerm_t iKind, const std::string& strName)
+    {
+        std::vector<int> vecModels;
+        std::vector<std::string> vecNames;
+
+        if (index.Find(iKind, strName, vecModels))
+        {
+            for (int iModel : vecModels)
+                vecNames.push_back(index.ModelName(iModel));
+        }
+
+        return vecNames;
+    }
+
+    typedef std::vector<std::string> CNames;
+
+    // the test model with its own material and surface prop
+    bool WriteMetalModel(const std::string& strPath)
+    {
+        CTestModelWriter writer;
+        BuildTestModel(writer, "test/metal.mdl", 5678);
+
+        int iTexture = writer.Header()->textureindex;
+        writer.At<mstudiotexture_t>(iTexture)->sznameindex = writer.String("models/test/metal") - iTexture;
+        writer.Header()->surfacepropindex = writer.String("metal");
+
+        return writer.Write(strPath);
+    }
+}
+
+int main()
+{
+    CTestModelWriter writer;
+    BuildTestModel(writer);
+
+    if (!writer.Write("test_index_flesh.mdl") || !WriteMetalModel("test_index_metal.mdl"))
+    {
+        printf("couldn't write the test models\n");
+        return 1;
+    }
+
+    int nFailed = 0;
+
+    {
+        CModel flesh("test_index_flesh.mdl");
+        CModel metal("test_index_metal.mdl");
+
+        std::string strFleshMaterial = flesh.GetMaterials().empty() ? "" : flesh.GetMaterials()[0];
+        std::string strMetalMaterial = metal.GetMaterials().empty() ? "" : metal.GetMaterials()[0];
+
+        nFailed += Check("models load", flesh.StudioHdr() && metal.StudioHdr() && !strFleshMaterial.empty() && strFleshMaterial != strMetalMaterial);
+
+        CModelIndexBuilder builder;
+        builder.Add("a.mdl", flesh);
+        builder.Add("b.mdl", metal);
+        nFailed += Check("write", builder.Write("test_index.idx"));
+
+        CModelIndex index;
+        nFailed += Check("open", index.Open("test_index.idx") && index.ModelCount() == 2);
+
+        nFailed += Check("find bone", FindModels(index, INDEXTERM_BONE, "HEAD") == CNames{ "a.mdl", "b.mdl" });
+        nFailed += Check("find material", FindModels(index, INDEXTERM_MATERIAL, strMetalMaterial) == CNames{ "b.mdl" });
+        nFailed += Check("find surfaceprop", FindModels(index, INDEXTERM_SURFACEPROP, "metal") == CNames{ "b.mdl" });
+        nFailed += Check("find missing", FindModels(index, INDEXTERM_BONE, "tail").empty());
+
+        // update the index while it's still open: drop a, add c, re-add b
+        CModelIndexBuilder update;
+        update.Load(index);
+        update.Remove("a.mdl");
+        update.Add("c.mdl", flesh);
+        update.Add("b.mdl", metal);
+        nFailed += Check("rewrite while open", update.Write("test_index.idx"));
+
+        // the open index still reads the file it mapped
+        nFailed += Check("old index readable", FindModels(index, INDEXTERM_MATERIAL, strFleshMaterial) == CNames{ "a.mdl" });
+
+        CModelIndex updated;
+        nFailed += Check("reopen", updated.Open("test_index.idx") && updated.ModelCount() == 2);
+
+        nFailed += Check("find bone after update", FindModels(updated, INDEXTERM_BONE, "head") == CNames{ "b.mdl", "c.mdl" });
+        nFailed += Check("find material after update", FindModels(updated, INDEXTERM_MATERIAL, strFleshMaterial) == CNames{ "c.mdl" });
+        nFailed += Check("find surfaceprop after update", FindModels(updated, INDEXTERM_SURFACEPROP, "METAL") == CNames{ "b.mdl" });
+    }
+
+    remove("test_index_flesh.mdl");
+    remove("test_index_metal.mdl");
+    remove("test_index.idx");
+
+    return nFailed ? 1 : 0;
+}
@@ -0,0 +1,302 @@
+#include "mdlmath.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // how far the SIMD forms may be from the scalar ones. the slerp approximation
+    // measures 3.6e-4 at worst, with or without FMA, and mdlmath.h quotes this bound.
+    // the rest only differ by rounding
+    const float SLERP_TOLERANCE = 4e-4f;
+    const float QUATERNION_TOLERANCE = 1e-5f;
+    const float MATRIX_TOLERANCE = 1e-4f;
+
+    // odd so the SoA forms run their partial last group
+    const int COUNT = 4099;
+
+    std::mt19937 g_Random(1234);
+
+    float RandomFloat(float flMin, float flMax)
+    {
+        return std::uniform_real_distribution<float>(flMin, flMax)(g_Random);
+    }
+
+    Quaternion RandomQuaternion()
+    {
+        Quaternion q;
+        q.Init(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f));
+        QuaternionNormalize(q);
+        return q;
+    }
+
+    // a unit quaternion close to q, the small angle cases slerp has to get right
+    Quaternion NearbyQuaternion(const Quaternion& q, float flSpread)
+    {
+        Quaternion r;
+        r.Init(q.x + RandomFloat(-flSpread, flSpread), q.y + RandomFloat(-flSpread, flSpread), q.z + RandomFloat(-flSpread, flSpread), q.w + RandomFloat(-flSpread, flSpread));
+        QuaternionNormalize(r);
+        return r;
+    }
+
+    matrix3x4_t RandomTransform()
+    {
+        matrix3x4_t matrix;
+        Vector pos(RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f));
+        QuaternionMatrix(RandomQuaternion(), pos, matrix);
+        return matrix;
+    }
+
+    // quaternions laid out as the SoA forms want them
+    struct CQuaternions
+    {
+        std::vector<float> x, y, z, w;
+
+        CQuaternions() : x(COUNT), y(COUNT), z(COUNT), w(COUNT) {}
+
+        CQuaternionSoA SoA() { return CQuaternionSoA{ x.data(), y.data(), z.data(), w.data() }; }
+
+        void Set(int i, const Quaternion& q) { x[i] = q.x; y[i] = q.y; z[i] = q.z; w[i] = q.w; }
+
+        Quaternion Get(int i) const
+        {
+            Quaternion q;
+            q.Init(x[i], y[i], z[i], w[i]);
+            return q;
+        }
+    };
+
+    float QuaternionError(const Quaternion& a, const Quaternion& b)
+    {
+        return std::max(std::max(fabsf(a.x - b.x), fabsf(a.y - b.y)), std::max(fabsf(a.z - b.z), fabsf(a.w - b.w)));
+    }
+
+    float MatrixError(const matrix3x4_t& a, const matrix3x4_t& b)
+    {
+        float flError = 0.0f;
+
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 4; j++)
+                flError = std::max(flError, fabsf(a[i][j] - b[i][j]));
+        }
+
+        return flError;
+    }
+
+    int Report(const char* pszName, float flError, float flTolerance)
+    {
+        bool bOk = flError <= flTolerance;
+        printf("%-12s max error %.3g (tolerance %.3g) %s\n", pszName, flError, flTolerance, bOk ? "ok" : "FAILED");
+        return bOk ? 0 : 1;
+    }
+
+    // pairs from anywhere on the sphere, nearly equal, and nearly opposite
+    void RandomPairs(CQuaternions& p, CQuaternions& q)
+    {
+        for (int i = 0; i < COUNT; i++)
+        {
+            Quaternion a = RandomQuaternion();
+            Quaternion b;
+
+            switch (i % 4)
+            {
+            case 0:
+            case 1:
+                b = RandomQuaternion();
+                break;
+            case 2:
+                b = NearbyQuaternion(a, 0.01f);
+                break;
+            default:
+                b = NearbyQuaternion(a, 0.01f);
+                b.Init(-b.x, -b.y, -b.z, -b.w);
+                break;
+            }
+
+            p.Set(i, a);
+            q.Set(i, b);
+        }
+    }
+
+    int TestSlerp()
+    {
+        CQuaternions p, q, out;
+        RandomPairs(p, q);
+
+        float flError = 0.0f;
+
+        for (int iStep = 0; iStep <= 16; iStep++)
+        {
+            float t = iStep / 16.0f;
+            QuaternionSlerpSoA(p.SoA(), q.SoA(), t, out.SoA(), COUNT);
+
+            for (int i = 0; i < COUNT; i++)
+            {
+                Quaternion expected;
+                QuaternionSlerp(p.Get(i), q.Get(i), t, expected);
+                flError = std::max(flError, QuaternionError(out.Get(i), expected));
+            }
+        }
+
+        return Report("slerp", flError, SLERP_TOLERANCE);
+    }
+
+    int TestBlend()
+    {
+        CQuaternions p, q, out;
+        RandomPairs(p, q);
+
+        float flError = 0.0f;
+
+        for (int iStep = 0; iStep <= 8; iStep++)
+        {
+            float t = iStep / 8.0f;
+            QuaternionBlendSoA(p.SoA(), q.SoA(), t, out.SoA(), COUNT);
+
+            for (int i = 0; i < COUNT; i++)
+            {
+                Quaternion expected;
+                QuaternionBlend(p.Get(i), q.Get(i), t, expected);
+                flError = std::max(flError, QuaternionError(out.Get(i), expected));
+            }
+        }
+
+        return Report("blend", flError, QUATERNION_TOLERANCE);
+    }
+
+    int TestMult()
+    {
+        CQuaternions p, q, out;
+        RandomPairs(p, q);
+
+        QuaternionMultSoA(p.SoA(), q.SoA(), out.SoA(), COUNT);
+
+        float flError = 0.0f;
+
+        for (int i = 0; i < COUNT; i++)
+        {
+            Quaternion expected;
+            QuaternionMult(p.Get(i), q.Get(i), expected);
+            flError = std::max(flError, QuaternionError(out.Get(i), expected));
+        }
+
+        return Report("mult", flError, QUATERNION_TOLERANCE);
+    }
+
+    int TestNormalize()
+    {
+        CQuaternions q;
+
+        for (int i = 0; i < COUNT; i++)
+        {
+            Quaternion r;
+            r.Init(RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f));
+            q.Set(i, r);
+        }
+
+        CQuaternions normalized = q;
+        QuaternionNormalizeSoA(normalized.SoA(), COUNT);
+
+        float flError = 0.0f;
+
+        for (int i = 0; i < COUNT; i++)
+        {
+            Quaternion expected = q.Get(i);
+            QuaternionNormalize(expected);
+            flError = std::max(flError, QuaternionError(normalized.Get(i), expected));
+        }
+
+        return Report("normalize", flError, QUATERNION_TOLERANCE);
+    }
+
+    int TestQuaternionMatrix()
+    {
+        CQuaternions q;
+        std::vector<float> x(COUNT), y(COUNT), z(COUNT);
+
+        for (int i = 0; i < COUNT; i++)
+        {
+            q.Set(i, RandomQuaternion());
+            x[i] = RandomFloat(-100.0f, 100.0f);
+            y[i] = RandomFloat(-100.0f, 100.0f);
+            z[i] = RandomFloat(-100.0f, 100.0f);
+        }
+
+        std::vector<matrix3x4_t> vecOut(COUNT);
+        QuaternionMatrixSoA(q.SoA(), CVectorSoA{ x.data(), y.data(), z.data() }, vecOut.data(), COUNT);
+
+        float flError = 0.0f;
+
+        for (int i = 0; i < COUNT; i++)
+        {
+            matrix3x4_t expected;
+            QuaternionMatrix(q.Get(i), Vector(x[i], y[i], z[i]), expected);
+            flError = std::max(flError, MatrixError(vecOut[i], expected));
+        }
+
+        return Report("matrix", flError, QUATERNION_TOLERANCE);
+    }
+
+    int TestConcatTransforms()
+    {
+        std::vector<matrix3x4_t> vecIn1(COUNT), vecIn2(COUNT), vecOut(COUNT);
+
+        for (int i = 0; i < COUNT; i++)
+        {
+            vecIn1[i] = RandomTransform();
+            vecIn2[i] = RandomTransform();
+        }
+
+        ConcatTransformsBatch(vecIn1.data(), vecIn2.data(), vecOut.data(), COUNT);
+
+        float flError = 0.0f;
+
+        for (int i = 0; i < COUNT; i++)
+        {
+            matrix3x4_t expected;
+            ConcatTransforms(vecIn1[i], vecIn2[i], expected);
+            flError = std::max(flError, MatrixError(vecOut[i], expected));
+        }
+
+        return Report("concat", flError, MATRIX_TOLERANCE);
+    }
+
+    int TestMatrixInvert()
+    {
+        std::vector<matrix3x4_t> vecIn(COUNT), vecOut(COUNT);
+
+        for (int i = 0; i < COUNT; i++)
+            vecIn[i] = RandomTransform();
+
+        MatrixInvertBatch(vecIn.data(), vecOut.data(), COUNT);
+
+        float flError = 0.0f;
+
+        for (int i = 0; i < COUNT; i++)
+        {
+            matrix3x4_t expected;
+            MatrixInvert(vecIn[i], expected);
+            flError = std::max(flError, MatrixError(vecOut[i], expected));
+        }
+
+        return Report("invert", flError, MATRIX_TOLERANCE);
+    }
+}
+
+int main()
+{
+    int nFailed = 0;
+
+    nFailed += TestSlerp();
+    nFailed += TestBlend();
+    nFailed += TestMult();
+    nFailed += TestNormalize();
+    nFailed += TestQuaternionMatrix();
+    nFailed += TestConcatTransforms();
+    nFailed += TestMatrixInvert();
+
+    return nFailed ? 1 : 0;
+}
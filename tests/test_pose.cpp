@@ -0,0 +1,173 @@
+#include "testmodel.h"
+
+#include "mdlanim.h"
+#include "mdlmath.h"
+#include "mdlobj.h"
+#include "mdlpose.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    const float QUATERNION_TOLERANCE = 1e-5f;
+    const float POSITION_TOLERANCE = 1e-5f;
+
+    // the engine's QuaternionScale
+    void ReferenceQuaternionScale(const Quaternion& p, float t, Quaternion& q)
+    {
+        float sinom = std::min(sqrtf(p.x * p.x + p.y * p.y + p.z * p.z), 1.0f);
+        float sinsom = sinf(asinf(sinom) * t);
+
+        t = sinsom / (sinom + 1.192092896e-07f);
+        q.x = p.x * t;
+        q.y = p.y * t;
+        q.z = p.z * t;
+
+        float r = sqrtf(std::max(1.0f - sinsom * sinsom, 0.0f));
+        q.w = p.w < 0.0f ? -r : r;
+    }
+
+    // CalcBoneAdj, one bone at a time straight from the header
+    void ReferenceCalcBoneAdj(const studiohdr_t* pMdl, Quaternion* q, Vector* pos, const float* pControllers)
+    {
+        for (int j = 0; j < pMdl->numbonecontrollers; j++)
+        {
+            const mstudiobonecontroller_t* pController = pMdl->pBonecontroller(j);
+            int k = pController->bone;
+
+            float value = std::min(std::max(pControllers[pController->inputfield], 0.0f), 1.0f);
+            value = (1.0f - value) * pController->start + value * pController->end;
+
+            int iAxis = -1;
+            bool bRotation = false;
+
+            switch (pController->type & STUDIO_TYPES)
+            {
+            case STUDIO_XR: iAxis = 0; bRotation = true; break;
+            case STUDIO_YR: iAxis = 1; bRotation = true; break;
+            case STUDIO_ZR: iAxis = 2; bRotation = true; break;
+            case STUDIO_X: iAxis = 0; break;
+            case STUDIO_Y: iAxis = 1; break;
+            case STUDIO_Z: iAxis = 2; break;
+            }
+
+            if (iAxis < 0)
+                continue;
+
+            if (!bRotation)
+            {
+                (&pos[k].x)[iAxis] += value;
+                continue;
+            }
+
+            // AngleQuaternion of a single axis angle
+            float flHalf = value * (3.14159265358979323846f / 360.0f);
+            Quaternion q0{ 0.0f, 0.0f, 0.0f, cosf(flHalf) };
+            (&q0.x)[iAxis] = sinf(flHalf);
+
+            // QuaternionSM(1.0, q0, q[k], q[k])
+            Quaternion p1, q1;
+            ReferenceQuaternionScale(q0, 1.0f, p1);
+            QuaternionMult(p1, q[k], q1);
+            QuaternionNormalize(q1);
+            q[k] = q1;
+        }
+    }
+
+    int TestApplyControllers(const CModel& model)
+    {
+        const studiohdr_t* pMdl = model.StudioHdr();
+        CPoseEvaluator evaluator(model);
+
+        // every input from one end of its range to the other, the zr controller past 180
+        const int nEntities = 9;
+
+        float flValues[nEntities * POSE_CONTROLLER_INPUTS] = {};
+
+        for (int e = 0; e < nEntities; e++)
+        {
+            float t = e / (float)(nEntities - 1);
+            flValues[e * POSE_CONTROLLER_INPUTS + 0] = -90.0f + 180.0f * t;
+            flValues[e * POSE_CONTROLLER_INPUTS + 1] = 350.0f * t;
+            flValues[e * POSE_CONTROLLER_INPUTS + 2] = -5.0f + 10.0f * (1.0f - t);
+        }
+
+        float flNormalized[nEntities * POSE_CONTROLLER_INPUTS];
+        evaluator.EncodeControllers(flValues, flNormalized, nEntities);
+
+        static CBonePose poses[nEntities];
+
+        for (int e = 0; e < nEntities; e++)
+            Studio_InitPose(pMdl, poses[e]);
+
+        evaluator.ApplyControllers(flNormalized, poses, nEntities);
+
+        float flRotError = 0.0f;
+        float flPosError = 0.0f;
+
+        for (int e = 0; e < nEntities; e++)
+        {
+            Quaternion q[TestModel::BONES];
+            Vector pos[TestModel::BONES];
+
+            for (int i = 0; i < TestModel::BONES; i++)
+            {
+                q[i] = pMdl->pBone(i)->quat;
+                pos[i] = pMdl->pBone(i)->pos;
+            }
+
+            ReferenceCalcBoneAdj(pMdl, q, pos, flNormalized + e * POSE_CONTROLLER_INPUTS);
+
+            for (int i = 0; i < TestModel::BONES; i++)
+            {
+                const CBonePose& pose = poses[e];
+
+                flRotError = std::max(flRotError, std::max(std::max(fabsf(pose.m_qx[i] - q[i].x), fabsf(pose.m_qy[i] - q[i].y)),
+                    std::max(fabsf(pose.m_qz[i] - q[i].z), fabsf(pose.m_qw[i] - q[i].w))));
+
+                flPosError = std::max(flPosError, std::max(std::max(fabsf(pose.m_px[i] - pos[i].x), fabsf(pose.m_py[i] - pos[i].y)), fabsf(pose.m_pz[i] - pos[i].z)));
+            }
+        }
+
+        bool bRotOk = flRotError <= QUATERNION_TOLERANCE;
+        bool bPosOk = flPosError <= POSITION_TOLERANCE;
+
+        printf("%-12s max error %.3g (tolerance %.3g) %s\n", "rotation", flRotError, QUATERNION_TOLERANCE, bRotOk ? "ok" : "FAILED");
+        printf("%-12s max error %.3g (tolerance %.3g) %s\n", "position", flPosError, POSITION_TOLERANCE, bPosOk ? "ok" : "FAILED");
+
+        return (bRotOk ? 0 : 1) + (bPosOk ? 0 : 1);
+    }
+}
+
+int main()
+{
+    CTestModelWriter writer;
+    BuildTestModel(writer);
+
+    if (!writer.Write("test_pose.mdl"))
+    {
+        printf("couldn't write test_pose.mdl\n");
+        return 1;
+    }
+
+    int nFailed = 0;
+
+    {
+        CModel model("test_pose.mdl");
+
+        if (model.StudioHdr())
+        {
+            nFailed += TestApplyControllers(model);
+        }
+        else
+        {
+            printf("couldn't load test_pose.mdl\n");
+            nFailed++;
+        }
+    }
+
+    remove("test_pose.mdl");
+    return nFailed ? 1 : 0;
+}
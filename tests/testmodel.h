@@ -0,0 +1,353 @@
+#pragma once
+
+#include "valve/studio.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// writes small .mdl files for the tests. offsets are handed out from a fixed
+// buffer, so pointers into it stay valid while a model is being put together
+class CTestModelWriter
+{
+public:
+	CTestModelWriter() : m_vecData(1 << 16, 0) {}
+
+	int Alloc(size_t nSize, size_t nAlign = 4)
+	{
+		m_nUsed = (m_nUsed + nAlign - 1) & ~(nAlign - 1);
+
+		int iOffset = (int)m_nUsed;
+		m_nUsed += nSize;
+
+		if (m_nUsed > m_vecData.size())
+		{
+			fprintf(stderr, "test model doesn't fit its buffer\n");
+			std::abort();
+		}
+
+		return iOffset;
+	}
+
+	int String(const char* psz)
+	{
+		int iOffset = Alloc(strlen(psz) + 1, 1);
+		strcpy(&m_vecData[iOffset], psz);
+		return iOffset;
+	}
+
+	template<class T> T* At(int iOffset) { return (T*)&m_vecData[iOffset]; }
+
+	studiohdr_t* Header() { return At<studiohdr_t>(0); }
+
+	// the file as it's written
+	std::vector<char> Data()
+	{
+		Header()->length = (int)m_nUsed;
+		return std::vector<char>(m_vecData.begin(), m_vecData.begin() + m_nUsed);
+	}
+
+	bool Write(const std::string& strPath)
+	{
+		std::vector<char> vecData = Data();
+
+		FILE* pFile = fopen(strPath.c_str(), "wb");
+		if (!pFile)
+			return false;
+
+		bool bOk = fwrite(vecData.data(), 1, vecData.size(), pFile) == vecData.size();
+		return fclose(pFile) == 0 && bOk;
+	}
+
+private:
+	std::vector<char> m_vecData;
+	size_t m_nUsed = 0;
+};
+
+namespace TestModel
+{
+	const int BONES = 3;
+	const int FRAMES = 5;
+
+	// run length encoded values, one per frame
+	inline int AnimValues(CTestModelWriter& writer, const short* pValues, int nValues)
+	{
+		int iOffset = writer.Alloc(sizeof(mstudioanimvalue_t) * (nValues + 1), 2);
+
+		mstudioanimvalue_t* pValue = writer.At<mstudioanimvalue_t>(iOffset);
+		pValue[0].num.valid = (byte)nValues;
+		pValue[0].num.total = (byte)nValues;
+
+		for (int i = 0; i < nValues; i++)
+			pValue[i + 1].value = pValues[i];
+
+		return iOffset;
+	}
+
+	inline void Bones(CTestModelWriter& writer)
+	{
+		static const char* s_pszNames[BONES] = { "root", "spine", "head" };
+
+		// rest rotations that don't commute with the controllers' axes
+		static const Quaternion s_qRest[BONES] = {
+			{ 0.0f, 0.0f, 0.0f, 1.0f },
+			{ 0.0f, 0.34202014f, 0.0f, 0.93969262f },		// 40 degrees about y
+			{ 0.25881905f, 0.0f, 0.0f, 0.96592583f },		// 30 degrees about x
+		};
+
+		studiohdr_t* pHdr = writer.Header();
+		pHdr->numbones = BONES;
+		pHdr->boneindex = writer.Alloc(sizeof(mstudiobone_t) * BONES);
+
+		for (int i = 0; i < BONES; i++)
+		{
+			int iBone = pHdr->boneindex + i * (int)sizeof(mstudiobone_t);
+
+			mstudiobone_t* pBone = writer.At<mstudiobone_t>(iBone);
+			pBone->sznameindex = writer.String(s_pszNames[i]) - iBone;
+			pBone->surfacepropidx = writer.String("flesh") - iBone;
+			pBone->parent = i - 1;
+			pBone->pos = Vector(0.0f, 0.0f, i ? 10.0f : 0.0f);
+			pBone->quat = s_qRest[i];
+			pBone->posscale = Vector(0.01f);
+			pBone->rotscale = Vector(0.001f);
+			pBone->flags = BONE_USED_BY_VERTEX_LOD0 | (i == 2 ? BONE_USED_BY_HITBOX : 0);
+
+			for (int j = 0; j < 6; j++)
+				pBone->bonecontroller[j] = -1;
+		}
+
+		// by name, alphabetically
+		static const byte s_iByName[BONES] = { 2, 0, 1 };
+
+		pHdr->bonetablebynameindex = writer.Alloc(BONES, 1);
+		memcpy(writer.At<byte>(pHdr->bonetablebynameindex), s_iByName, BONES);
+	}
+
+	inline void Controllers(CTestModelWriter& writer)
+	{
+		struct CSetup
+		{
+			int m_iBone;
+			int m_iType;
+			float m_flStart;
+			float m_flEnd;
+		};
+
+		static const CSetup s_Setup[] = {
+			{ 1, STUDIO_XR, -90.0f, 90.0f },
+			{ 2, STUDIO_ZR, 0.0f, 360.0f },
+			{ 2, STUDIO_X, -5.0f, 5.0f },
+		};
+
+		const int nControllers = sizeof(s_Setup) / sizeof(s_Setup[0]);
+
+		studiohdr_t* pHdr = writer.Header();
+		pHdr->numbonecontrollers = nControllers;
+		pHdr->bonecontrollerindex = writer.Alloc(sizeof(mstudiobonecontroller_t) * nControllers);
+
+		for (int i = 0; i < nControllers; i++)
+		{
+			mstudiobonecontroller_t* pController = writer.At<mstudiobonecontroller_t>(pHdr->bonecontrollerindex) + i;
+			pController->bone = s_Setup[i].m_iBone;
+			pController->type = s_Setup[i].m_iType;
+			pController->start = s_Setup[i].m_flStart;
+			pController->end = s_Setup[i].m_flEnd;
+			pController->inputfield = i;
+		}
+	}
+
+	// two looping animations: bone 1 turns about z and slides along x, bone 2 holds a raw rotation
+	inline void Animations(CTestModelWriter& writer)
+	{
+		const int nAnims = 2;
+
+		studiohdr_t* pHdr = writer.Header();
+		pHdr->numlocalanim = nAnims;
+		pHdr->localanimindex = writer.Alloc(sizeof(mstudioanimdesc_t) * nAnims);
+
+		for (int a = 0; a < nAnims; a++)
+		{
+			int iDesc = pHdr->localanimindex + a * (int)sizeof(mstudioanimdesc_t);
+
+			char szName[32];
+			snprintf(szName, sizeof(szName), "anim%d", a);
+
+			mstudioanimdesc_t* pDesc = writer.At<mstudioanimdesc_t>(iDesc);
+			pDesc->baseptr = -iDesc;
+			pDesc->sznameindex = writer.String(szName) - iDesc;
+			pDesc->fps = 30.0f;
+			pDesc->numframes = FRAMES;
+			pDesc->flags = STUDIO_LOOPING;
+
+			int iAnim = writer.Alloc(sizeof(mstudioanim_t) + 2 * sizeof(mstudioanim_valueptr_t));
+			pDesc->animindex = iAnim - iDesc;
+
+			mstudioanim_t* pAnim = writer.At<mstudioanim_t>(iAnim);
+			pAnim->bone = 1;
+			pAnim->flags = STUDIO_ANIM_ANIMROT | STUDIO_ANIM_ANIMPOS;
+
+			short iRot[FRAMES], iPos[FRAMES];
+
+			for (int f = 0; f < FRAMES; f++)
+			{
+				iRot[f] = (short)(f * 100 * (a + 1));
+				iPos[f] = (short)(f * 50 * (a + 1));
+			}
+
+			int iRotValues = AnimValues(writer, iRot, FRAMES);
+			int iPosValues = AnimValues(writer, iPos, FRAMES);
+
+			mstudioanim_valueptr_t* pRotV = pAnim->pRotV();
+			pRotV->offset[2] = (short)(iRotValues - (iAnim + (int)sizeof(mstudioanim_t)));
+
+			mstudioanim_valueptr_t* pPosV = pAnim->pPosV();
+			pPosV->offset[0] = (short)(iPosValues - (iAnim + (int)sizeof(mstudioanim_t) + (int)sizeof(mstudioanim_valueptr_t)));
+
+			int iRaw = writer.Alloc(sizeof(mstudioanim_t) + sizeof(Quaternion48), 2);
+			pAnim->nextoffset = (short)(iRaw - iAnim);
+
+			mstudioanim_t* pRaw = writer.At<mstudioanim_t>(iRaw);
+			pRaw->bone = 2;
+			pRaw->flags = STUDIO_ANIM_RAWROT;
+
+			Quaternion48* pQuat = pRaw->pQuat48();
+			pQuat->x = 32768 + a * 4000;
+			pQuat->y = 32768;
+			pQuat->z = 16384;
+			pQuat->wneg = 0;
+		}
+	}
+
+	// one sequence blending the two animations across move_x
+	inline void Sequences(CTestModelWriter& writer)
+	{
+		studiohdr_t* pHdr = writer.Header();
+
+		pHdr->numlocalposeparameters = 1;
+		pHdr->localposeparamindex = writer.Alloc(sizeof(mstudioposeparamdesc_t));
+
+		mstudioposeparamdesc_t* pPose = writer.At<mstudioposeparamdesc_t>(pHdr->localposeparamindex);
+		pPose->sznameindex = writer.String("move_x") - pHdr->localposeparamindex;
+		pPose->start = -1.0f;
+		pPose->end = 1.0f;
+
+		pHdr->numlocalseq = 1;
+		pHdr->localseqindex = writer.Alloc(sizeof(mstudioseqdesc_t));
+
+		int iSeq = pHdr->localseqindex;
+
+		mstudioseqdesc_t* pSeq = writer.At<mstudioseqdesc_t>(iSeq);
+		pSeq->baseptr = -iSeq;
+		pSeq->szlabelindex = writer.String("move") - iSeq;
+		pSeq->szactivitynameindex = writer.String("ACT_WALK") - iSeq;
+		pSeq->flags = STUDIO_LOOPING;
+		pSeq->paramindex[0] = 0;
+		pSeq->paramindex[1] = -1;
+		pSeq->paramstart[0] = -1.0f;
+		pSeq->paramend[0] = 1.0f;
+		pSeq->groupsize[0] = 2;
+		pSeq->groupsize[1] = 1;
+		pSeq->numblends = 2;
+		pSeq->cycleposeindex = -1;
+
+		pSeq->animindexindex = writer.Alloc(sizeof(short) * 2, 2) - iSeq;
+		short* pAnims = writer.At<short>(iSeq + pSeq->animindexindex);
+		pAnims[0] = 0;
+		pAnims[1] = 1;
+
+		pSeq->weightlistindex = writer.Alloc(sizeof(float) * BONES) - iSeq;
+		float* pWeights = writer.At<float>(iSeq + pSeq->weightlistindex);
+
+		for (int i = 0; i < BONES; i++)
+			pWeights[i] = 1.0f;
+	}
+
+	// sections CModel decodes at load, so there is something for compaction to drop
+	inline void Materials(CTestModelWriter& writer)
+	{
+		studiohdr_t* pHdr = writer.Header();
+
+		pHdr->numtextures = 1;
+		pHdr->textureindex = writer.Alloc(sizeof(mstudiotexture_t));
+		writer.At<mstudiotexture_t>(pHdr->textureindex)->sznameindex = writer.String("models/test/skin") - pHdr->textureindex;
+
+		pHdr->numhitboxsets = 1;
+		pHdr->hitboxsetindex = writer.Alloc(sizeof(mstudiohitboxset_t));
+
+		int iSet = pHdr->hitboxsetindex;
+		int iName = writer.String("default");
+		int iBox = writer.Alloc(sizeof(mstudiobbox_t));
+
+		mstudiohitboxset_t* pSet = writer.At<mstudiohitboxset_t>(iSet);
+		pSet->sznameindex = iName - iSet;
+		pSet->numhitboxes = 1;
+		pSet->hitboxindex = iBox - iSet;
+
+		mstudiobbox_t* pBox = writer.At<mstudiobbox_t>(iBox);
+		pBox->bone = 2;
+		pBox->bbmin = Vector(-4.0f);
+		pBox->bbmax = Vector(4.0f);
+	}
+
+	// the studiohdr2 extension with a linear bone table, also for compaction to drop
+	inline void Extension(CTestModelWriter& writer)
+	{
+		int iHdr2 = writer.Alloc(sizeof(studiohdr2_t));
+		writer.Header()->studiohdr2index = iHdr2;
+
+		int iLinear = writer.Alloc(sizeof(mstudiolinearbone_t));
+		writer.At<studiohdr2_t>(iHdr2)->linearboneindex = iLinear - iHdr2;
+		writer.At<studiohdr2_t>(iHdr2)->flMaxEyeDeflection = 0.5f;
+
+		int iFlags = writer.Alloc(sizeof(int) * BONES);
+		int iParents = writer.Alloc(sizeof(int) * BONES);
+		int iPos = writer.Alloc(sizeof(Vector) * BONES);
+		int iQuat = writer.Alloc(sizeof(Quaternion) * BONES, 16);
+
+		mstudiolinearbone_t* pLinear = writer.At<mstudiolinearbone_t>(iLinear);
+		pLinear->numbones = BONES;
+		pLinear->flagsindex = iFlags - iLinear;
+		pLinear->parentindex = iParents - iLinear;
+		pLinear->posindex = iPos - iLinear;
+		pLinear->quatindex = iQuat - iLinear;
+
+		for (int i = 0; i < BONES; i++)
+		{
+			const mstudiobone_t* pBone = writer.Header()->pBone(i);
+
+			writer.At<int>(iFlags)[i] = pBone->flags;
+			writer.At<int>(iParents)[i] = pBone->parent;
+			writer.At<Vector>(iPos)[i] = pBone->pos;
+			writer.At<Quaternion>(iQuat)[i] = pBone->quat;
+		}
+	}
+}
+
+// a three bone chain with bone controllers, two animations, a sequence
+// blending them, a texture, a hitbox and a studiohdr2 extension
+inline void BuildTestModel(CTestModelWriter& writer, const char* pszName = "test/test.mdl", int iChecksum = 1234)
+{
+	writer.Alloc(sizeof(studiohdr_t));
+
+	studiohdr_t* pHdr = writer.Header();
+	pHdr->id = (('T' << 24) + ('S' << 16) + ('D' << 8) + 'I'); // "IDST"
+	pHdr->version = STUDIO_VERSION;
+	pHdr->checksum = iChecksum;
+	snprintf(pHdr->name, sizeof(pHdr->name), "%s", pszName);
+	pHdr->hull_min = Vector(-16.0f, -16.0f, 0.0f);
+	pHdr->hull_max = Vector(16.0f, 16.0f, 72.0f);
+
+	TestModel::Bones(writer);
+	TestModel::Controllers(writer);
+	TestModel::Animations(writer);
+	TestModel::Sequences(writer);
+	TestModel::Materials(writer);
+	TestModel::Extension(writer);
+
+	pHdr = writer.Header();
+	pHdr->surfacepropindex = writer.String("flesh");
+	pHdr->szanimblocknameindex = writer.String("");
+}